@@ -130,7 +130,8 @@ core.protocol_versions = {
 	["5.10.0"] = 46,
 	["5.11.0"] = 47,
 	["5.12.0"] = 48,
-	["1.3.0"] = 1000
+	["1.3.0"] = 1000,
+	["1.4.0"] = 1001
 }
 
 setmetatable(core.protocol_versions, {__newindex = function()
@@ -0,0 +1,153 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#include "activeobject.h"
+#include <cmath>
+#include <sstream>
+#include "util/numeric.h"
+#include "util/serialize.h"
+
+// Fixed point factors of the compact form
+static constexpr f32 COMPACT_POS_FACTOR = 64.0f;
+static constexpr f32 COMPACT_VEL_FACTOR = 16.0f;
+static constexpr f32 COMPACT_ROT_FACTOR = 65536.0f / 360.0f;
+static constexpr f32 COMPACT_INTERVAL_FACTOR = 1000.0f;
+
+enum : u8 {
+	COMPACT_INTERPOLATE = 0x01,
+	COMPACT_END_POSITION = 0x02,
+	COMPACT_VELOCITY = 0x04,
+	COMPACT_ACCELERATION = 0x08,
+	COMPACT_ROTATION = 0x10,
+};
+
+static bool fits(f32 v, f32 factor, f32 min, f32 max)
+{
+	// also rejects NaN
+	const f32 scaled = std::round(v * factor);
+	return scaled >= min && scaled <= max;
+}
+
+static bool fits_v3(v3f v, f32 factor, f32 min, f32 max)
+{
+	return fits(v.X, factor, min, max) && fits(v.Y, factor, min, max) &&
+		fits(v.Z, factor, min, max);
+}
+
+static void write_scaled_s16(std::ostream &os, v3f v, f32 factor)
+{
+	writeV3S16(os, v3s16(std::round(v.X * factor), std::round(v.Y * factor),
+		std::round(v.Z * factor)));
+}
+
+void AOPositionUpdate::serialize(std::ostream &os) const
+{
+	writeV3F32(os, position);
+	writeV3F32(os, velocity);
+	writeV3F32(os, acceleration);
+	writeV3F32(os, rotation);
+	writeU8(os, do_interpolate);
+	// for interpolation
+	writeU8(os, is_end_position);
+	writeF32(os, update_interval);
+}
+
+void AOPositionUpdate::deSerialize(std::istream &is)
+{
+	position = readV3F32(is);
+	velocity = readV3F32(is);
+	acceleration = readV3F32(is);
+	rotation = readV3F32(is);
+	do_interpolate = readU8(is);
+	is_end_position = readU8(is);
+	update_interval = readF32(is);
+}
+
+bool AOPositionUpdate::serializeCompact(std::ostream &os) const
+{
+	if (!fits_v3(position, COMPACT_POS_FACTOR, S32_MIN, S32_MAX) ||
+			!fits_v3(velocity, COMPACT_VEL_FACTOR, S16_MIN, S16_MAX) ||
+			!fits_v3(acceleration, COMPACT_VEL_FACTOR, S16_MIN, S16_MAX) ||
+			!fits(update_interval, COMPACT_INTERVAL_FACTOR, 0, U16_MAX))
+		return false;
+	const v3f rot = wrapDegrees_0_360_v3f(rotation);
+	if (!fits_v3(rot, 1.0f, 0.0f, 360.0f))
+		return false;
+
+	u8 flags = 0;
+	if (do_interpolate)
+		flags |= COMPACT_INTERPOLATE;
+	if (is_end_position)
+		flags |= COMPACT_END_POSITION;
+	if (velocity != v3f())
+		flags |= COMPACT_VELOCITY;
+	if (acceleration != v3f())
+		flags |= COMPACT_ACCELERATION;
+	if (rot != v3f())
+		flags |= COMPACT_ROTATION;
+
+	writeU8(os, flags);
+	writeV3S32(os, v3s32(std::round(position.X * COMPACT_POS_FACTOR),
+		std::round(position.Y * COMPACT_POS_FACTOR),
+		std::round(position.Z * COMPACT_POS_FACTOR)));
+	if (flags & COMPACT_VELOCITY)
+		write_scaled_s16(os, velocity, COMPACT_VEL_FACTOR);
+	if (flags & COMPACT_ACCELERATION)
+		write_scaled_s16(os, acceleration, COMPACT_VEL_FACTOR);
+	if (flags & COMPACT_ROTATION) {
+		// 360 degrees wrap around to 0
+		writeU16(os, (u32)std::round(rot.X * COMPACT_ROT_FACTOR) & 0xffff);
+		writeU16(os, (u32)std::round(rot.Y * COMPACT_ROT_FACTOR) & 0xffff);
+		writeU16(os, (u32)std::round(rot.Z * COMPACT_ROT_FACTOR) & 0xffff);
+	}
+	writeU16(os, std::round(update_interval * COMPACT_INTERVAL_FACTOR));
+	return true;
+}
+
+void AOPositionUpdate::deSerializeCompact(std::istream &is)
+{
+	const u8 flags = readU8(is);
+	do_interpolate = flags & COMPACT_INTERPOLATE;
+	is_end_position = flags & COMPACT_END_POSITION;
+
+	const v3s32 pos = readV3S32(is);
+	position = v3f(pos.X, pos.Y, pos.Z) / COMPACT_POS_FACTOR;
+	velocity = v3f();
+	acceleration = v3f();
+	rotation = v3f();
+	if (flags & COMPACT_VELOCITY) {
+		const v3s16 v = readV3S16(is);
+		velocity = v3f(v.X, v.Y, v.Z) / COMPACT_VEL_FACTOR;
+	}
+	if (flags & COMPACT_ACCELERATION) {
+		const v3s16 v = readV3S16(is);
+		acceleration = v3f(v.X, v.Y, v.Z) / COMPACT_VEL_FACTOR;
+	}
+	if (flags & COMPACT_ROTATION) {
+		rotation.X = readU16(is) / COMPACT_ROT_FACTOR;
+		rotation.Y = readU16(is) / COMPACT_ROT_FACTOR;
+		rotation.Z = readU16(is) / COMPACT_ROT_FACTOR;
+	}
+	update_interval = readU16(is) / COMPACT_INTERVAL_FACTOR;
+}
+
+std::string AOPositionUpdate::compactCommand(std::string_view full)
+{
+	if (full.empty() || full[0] != AO_CMD_UPDATE_POSITION)
+		return "";
+
+	AOPositionUpdate update;
+	std::istringstream is(std::string(full.substr(1)), std::ios::binary);
+	try {
+		update.deSerialize(is);
+	} catch (SerializationError &e) {
+		return "";
+	}
+
+	std::ostringstream os(std::ios::binary);
+	writeU8(os, AO_CMD_UPDATE_POSITION_COMPACT);
+	if (!update.serializeCompact(os))
+		return "";
+	return os.str();
+}
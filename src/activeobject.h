@@ -7,6 +7,7 @@
 #include "irr_aabb3d.h"
 #include "irr_v3d.h"
 #include <Utils/quaternion.h>
+#include <iosfwd>
 #include <string>
 #include <unordered_map>
 
@@ -56,7 +57,40 @@ enum ActiveObjectCommand {
 	AO_CMD_OBSOLETE1,
 	// ^ UPDATE_NAMETAG_ATTRIBUTES deprecated since 0.4.14, removed in 5.3.0
 	AO_CMD_SPAWN_INFANT,
-	AO_CMD_SET_ANIMATION_SPEED
+	AO_CMD_SET_ANIMATION_SPEED,
+	// Quantized AO_CMD_UPDATE_POSITION, protocol version >= 1001
+	AO_CMD_UPDATE_POSITION_COMPACT
+};
+
+/*
+	Payload of AO_CMD_UPDATE_POSITION and AO_CMD_UPDATE_POSITION_COMPACT
+
+	The compact form stores the position in fixed point with 1/64 unit
+	precision, velocity and acceleration in 16 bits and leaves out the vectors
+	that are zero, which takes 16 to 40 bytes instead of 55.
+*/
+struct AOPositionUpdate
+{
+	v3f position;
+	v3f velocity;
+	v3f acceleration;
+	v3f rotation;
+	bool do_interpolate = false;
+	bool is_end_position = false;
+	f32 update_interval = 0.0f;
+
+	// The command byte is not included
+	void serialize(std::ostream &os) const;
+	void deSerialize(std::istream &is);
+
+	// Returns false if a value does not fit, nothing is written then
+	bool serializeCompact(std::ostream &os) const;
+	void deSerializeCompact(std::istream &is);
+
+	// Converts a full AO_CMD_UPDATE_POSITION message, including the command
+	// byte, to AO_CMD_UPDATE_POSITION_COMPACT. Returns an empty string if
+	// the update cannot be represented in compact form.
+	static std::string compactCommand(std::string_view full);
 };
 
 struct BoneOverride
@@ -0,0 +1,116 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#include "catch.h"
+#include "dummygamedef.h"
+#include "dummymap.h"
+#include "server/blockmodifier.h"
+#include "threading/workerpool.h"
+#include "util/numeric.h"
+
+namespace {
+
+class TestABM : public ActiveBlockModifier {
+public:
+	TestABM(const std::string &trigger, const std::string &neighbor) :
+		m_trigger({trigger}), m_required({neighbor})
+	{}
+
+	const std::vector<std::string> &getTriggerContents() const { return m_trigger; }
+	const std::vector<std::string> &getRequiredNeighbors() const { return m_required; }
+	const std::vector<std::string> &getWithoutNeighbors() const { return m_without; }
+	float getTriggerInterval() { return 1.0f; }
+	u32 getTriggerChance() { return 5; }
+	bool getSimpleCatchUp() { return false; }
+	s16 getMinY() { return S16_MIN; }
+	s16 getMaxY() { return S16_MAX; }
+
+private:
+	std::vector<std::string> m_trigger, m_required, m_without;
+};
+
+// Terrain-like mix of contents so that both cached and scanned blocks occur
+void fill_terrain(DummyMap &map, v3s16 bpmin, v3s16 bpmax, content_t c_dirt,
+	content_t c_grass, content_t c_water)
+{
+	for (s16 z = bpmin.Z; z <= bpmax.Z; z++)
+	for (s16 y = bpmin.Y; y <= bpmax.Y; y++)
+	for (s16 x = bpmin.X; x <= bpmax.X; x++) {
+		MapBlock *block = map.getBlockNoCreateNoEx({x, y, z});
+		for (size_t i = 0; i < MapBlock::nodecount; i++) {
+			u32 r = myrand() % 16;
+			content_t c = r < 8 ? CONTENT_AIR : (r < 13 ? c_dirt :
+				(r < 15 ? c_grass : c_water));
+			block->getData()[i] = MapNode(c);
+		}
+	}
+}
+
+}
+
+template <s16 SIZE>
+void benchABMScan(Catch::Benchmark::Chronometer &meter, unsigned int threads)
+{
+	DummyGameDef gamedef;
+	NodeDefManager *ndef = gamedef.getWritableNodeDefManager();
+	content_t c[3];
+	const char *names[3] = {"dirt", "grass", "water"};
+	for (int i = 0; i < 3; i++) {
+		ContentFeatures f;
+		f.name = names[i];
+		c[i] = ndef->set(f.name, f);
+	}
+
+	const v3s16 bpmin(0, 0, 0), bpmax(SIZE - 1, SIZE - 1, SIZE - 1);
+	DummyMap map(&gamedef, bpmin, bpmax);
+	fill_terrain(map, bpmin, bpmax, c[0], c[1], c[2]);
+
+	std::vector<ABMWithState> abms;
+	abms.emplace_back(new TestABM("dirt", "air"));
+	abms.emplace_back(new TestABM("grass", "water"));
+	abms.emplace_back(new TestABM("water", "dirt"));
+	ABMHandler handler(abms, 1.0f, ndef, false);
+
+	std::vector<ABMBlockScan> jobs(SIZE * SIZE * SIZE);
+	{
+		size_t i = 0;
+		for (s16 z = bpmin.Z; z <= bpmax.Z; z++)
+		for (s16 y = bpmin.Y; y <= bpmax.Y; y++)
+		for (s16 x = bpmin.X; x <= bpmax.X; x++) {
+			MapBlock *block = map.getBlockNoCreateNoEx({x, y, z});
+			handler.prepareScan(&map, block, jobs[i++], myrand());
+		}
+	}
+
+	// one thread means serial execution
+	WorkerPool pool("ABMScanBench", threads - 1);
+	meter.measure([&] {
+		size_t found = 0;
+		pool.parallelFor(jobs.size(), [&] (size_t i) {
+			jobs[i].candidates.clear();
+			handler.scan(jobs[i]);
+		});
+		for (auto &job : jobs)
+			found += job.candidates.size();
+		return found;
+	});
+
+	for (auto &it : abms)
+		delete it.abm;
+}
+
+#define BENCH_ABM_SCAN(_size, _threads) \
+	BENCHMARK_ADVANCED("scan_" #_size "^3_blocks_" #_threads "_threads") \
+		(Catch::Benchmark::Chronometer meter) \
+	{ benchABMScan<_size>(meter, _threads); };
+
+TEST_CASE("benchmark_abm")
+{
+	BENCH_ABM_SCAN(4, 1)
+	BENCH_ABM_SCAN(4, 4)
+	BENCH_ABM_SCAN(8, 1)
+	BENCH_ABM_SCAN(8, 4)
+	BENCH_ABM_SCAN(16, 1)
+	BENCH_ABM_SCAN(16, 4)
+}
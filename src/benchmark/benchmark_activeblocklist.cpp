@@ -0,0 +1,100 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#include "catch.h"
+#include "serverenvironment.h"
+#include "server/player_sao.h"
+#include "util/numeric.h"
+
+namespace {
+
+constexpr s16 ACTIVE_BLOCK_RANGE = 4;
+constexpr float POS_RANGE = 1500 * BS;
+
+inline v3f randpos()
+{
+	return v3f(myrand_range(-POS_RANGE, POS_RANGE),
+		myrand_range(-20 * BS, 60 * BS),
+		myrand_range(-POS_RANGE, POS_RANGE));
+}
+
+struct Players {
+	std::vector<std::unique_ptr<PlayerSAO>> owned;
+	std::vector<PlayerSAO*> list;
+
+	Players(size_t n)
+	{
+		for (size_t i = 0; i < n; i++) {
+			owned.emplace_back(std::make_unique<PlayerSAO>(nullptr, nullptr, 1, false));
+			owned.back()->setId(i + 1);
+			owned.back()->setBasePosition(randpos());
+			list.push_back(owned.back().get());
+		}
+	}
+
+	// Moves every player roughly the distance walked in one update interval
+	void walk()
+	{
+		for (auto *sao : list) {
+			v3f off(myrand_range(-8 * BS, 8 * BS), 0, myrand_range(-8 * BS, 8 * BS));
+			sao->setBasePosition(sao->getBasePosition() + off);
+		}
+	}
+};
+
+// Compare against the set of blocks computed from scratch
+void check(const ActiveBlockList &abl, const Players &players)
+{
+	std::unordered_set<v3s16> expected;
+	for (auto *sao : players.list) {
+		v3s16 p0 = getNodeBlockPos(floatToInt(sao->getBasePosition(), BS));
+		const s16 r = ACTIVE_BLOCK_RANGE;
+		v3s16 p;
+		for (p.X = p0.X - r; p.X <= p0.X + r; p.X++)
+		for (p.Y = p0.Y - r; p.Y <= p0.Y + r; p.Y++)
+		for (p.Z = p0.Z - r; p.Z <= p0.Z + r; p.Z++) {
+			if (p.getDistanceFrom(p0) <= r)
+				expected.insert(p);
+		}
+	}
+	REQUIRE(abl.m_list == expected);
+	REQUIRE(abl.m_abm_list == expected);
+}
+
+}
+
+template <size_t N>
+void benchActiveBlockListUpdate(Catch::Benchmark::Chronometer &meter)
+{
+	Players players(N);
+	ActiveBlockList abl;
+	std::set<v3s16> removed, added, extra_added;
+	abl.update(players.list, ACTIVE_BLOCK_RANGE, ACTIVE_BLOCK_RANGE,
+		removed, added, extra_added);
+	players.walk();
+	abl.update(players.list, ACTIVE_BLOCK_RANGE, ACTIVE_BLOCK_RANGE,
+		removed, added, extra_added);
+	check(abl, players);
+
+	meter.measure([&] {
+		players.walk();
+		removed.clear();
+		added.clear();
+		abl.update(players.list, ACTIVE_BLOCK_RANGE, ACTIVE_BLOCK_RANGE,
+			removed, added, extra_added);
+		return added.size() + removed.size();
+	});
+	check(abl, players);
+}
+
+#define BENCH_UPDATE(_count) \
+	BENCHMARK_ADVANCED("update_" #_count "_players")(Catch::Benchmark::Chronometer meter) \
+	{ benchActiveBlockListUpdate<_count>(meter); };
+
+TEST_CASE("ActiveBlockList") {
+	BENCH_UPDATE(1)
+	BENCH_UPDATE(10)
+	BENCH_UPDATE(50)
+	BENCH_UPDATE(200)
+}
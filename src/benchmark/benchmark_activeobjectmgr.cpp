@@ -94,6 +94,70 @@ void benchGetObjectsInArea(Catch::Benchmark::Chronometer &meter)
 	mgr.clear(); // implementation expects this
 }
 
+// Queries around many points, like mobs looking for targets
+template <size_t N>
+void benchGetObjectsInsideRadii(Catch::Benchmark::Chronometer &meter, bool batched)
+{
+	constexpr size_t QUERY_COUNT = 1000;
+	server::ActiveObjectMgr mgr;
+	server::ActiveObjectMgr::BatchQueryResult batch_result;
+	std::vector<ServerActiveObject*> result;
+	std::vector<v3f> centers(QUERY_COUNT);
+
+	fill(mgr, N);
+	meter.measure([&] {
+		for (v3f &center : centers)
+			center = randpos();
+		if (batched) {
+			mgr.getObjectsInsideRadii(centers, 30.0f, batch_result);
+			return batch_result.objects.size();
+		}
+		size_t x = 0;
+		for (v3f center : centers) {
+			result.clear();
+			mgr.getObjectsInsideRadius(center, 30.0f, result, nullptr);
+			x += result.size();
+		}
+		return x;
+	});
+
+	mgr.clear(); // implementation expects this
+}
+
+// What SendActiveObjectRemoveAdd() does for a number of players
+template <size_t N>
+void benchGetAddedActiveObjects(Catch::Benchmark::Chronometer &meter, bool use_grid)
+{
+	constexpr u16 PLAYER_COUNT = 100;
+	constexpr f32 RADIUS = 500;
+	server::ActiveObjectMgr mgr;
+	std::vector<v3f> players;
+	for (u16 i = 0; i < PLAYER_COUNT; i++)
+		players.push_back(randpos());
+	const std::set<u16> current_objects;
+	std::vector<u16> added;
+
+	fill(mgr, N);
+	meter.measure([&] {
+		size_t x = 0;
+		for (u16 i = 0; i < PLAYER_COUNT; i++) {
+			added.clear();
+			if (use_grid) {
+				// not an object id, but the grid does not care
+				mgr.getAddedActiveObjectsForObserver(U16_MAX - i, players[i],
+					"", RADIUS, 0, current_objects, added);
+			} else {
+				mgr.getAddedActiveObjectsAroundPos(players[i],
+					"", RADIUS, 0, current_objects, added);
+			}
+			x += added.size();
+		}
+		return x;
+	});
+
+	mgr.clear(); // implementation expects this
+}
+
 #define BENCH_INSIDE_RADIUS(_count) \
 	BENCHMARK_ADVANCED("inside_radius_" #_count)(Catch::Benchmark::Chronometer meter) \
 	{ benchGetObjectsInsideRadius<_count>(meter); };
@@ -102,6 +166,18 @@ void benchGetObjectsInArea(Catch::Benchmark::Chronometer &meter)
 	BENCHMARK_ADVANCED("in_area_" #_count)(Catch::Benchmark::Chronometer meter) \
 	{ benchGetObjectsInArea<_count>(meter); };
 
+#define BENCH_INSIDE_RADII(_count) \
+	BENCHMARK_ADVANCED("inside_radius_1000_queries_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchGetObjectsInsideRadii<_count>(meter, false); }; \
+	BENCHMARK_ADVANCED("inside_radii_batched_1000_queries_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchGetObjectsInsideRadii<_count>(meter, true); };
+
+#define BENCH_ADDED_OBJECTS(_count) \
+	BENCHMARK_ADVANCED("added_objects_naive_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchGetAddedActiveObjects<_count>(meter, false); }; \
+	BENCHMARK_ADVANCED("added_objects_grid_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchGetAddedActiveObjects<_count>(meter, true); };
+
 TEST_CASE("ActiveObjectMgr") {
 	BENCH_INSIDE_RADIUS(200)
 	BENCH_INSIDE_RADIUS(1450)
@@ -110,6 +186,12 @@ TEST_CASE("ActiveObjectMgr") {
 	BENCH_IN_AREA(200)
 	BENCH_IN_AREA(1450)
 	BENCH_IN_AREA(10000)
+
+	BENCH_INSIDE_RADII(1450)
+	BENCH_INSIDE_RADII(10000)
+
+	BENCH_ADDED_OBJECTS(1450)
+	BENCH_ADDED_OBJECTS(10000)
 }
 
 // TODO benchmark active object manager update costs
@@ -0,0 +1,251 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#include "catch.h"
+#include "collision.h"
+#include "dummygamedef.h"
+#include "dummymap.h"
+#include "emerge.h"
+#include "environment.h"
+#include "filesys.h"
+#include "mock_server.h"
+#include "nodedef.h"
+#include "noise.h"
+#include "server/luaentity_sao.h"
+#include "threading/workerpool.h"
+#include <fstream>
+
+namespace {
+
+// Size of the synthetic map in blocks, along X and Z
+constexpr s16 MAP_SIZE = 8;
+// Same number of objects per chunk as the server uses
+constexpr size_t CHUNK_SIZE = 16;
+constexpr float DTIME = 0.09f;
+
+const char *entity_lua_src = R"(
+core.register_entity(":bench:mob", {
+	initial_properties = {
+		physical = true,
+		collide_with_objects = true,
+		collisionbox = {-0.3, 0, -0.3, 0.3, 1.5, 0.3},
+		static_save = false,
+	}
+})
+)";
+
+// Flat ground with scattered obstacles, entities walking around on it
+struct World {
+	std::string dir;
+	std::unique_ptr<MockServer> server;
+	std::unique_ptr<MetricsBackend> mb;
+	std::unique_ptr<EmergeManager> emerge;
+	std::unique_ptr<ServerEnvironment> env;
+	std::vector<LuaEntitySAO *> entities;
+
+	World(size_t entity_count)
+	{
+		dir = fs::CreateTempDir();
+		REQUIRE(!dir.empty());
+		const std::string helper_lua = dir + DIR_DELIM "bench.lua";
+		{
+			std::ofstream ofs(helper_lua, std::ios::out | std::ios::binary);
+			ofs << entity_lua_src;
+			std::ofstream ofs2(dir + DIR_DELIM "world.mt",
+				std::ios::out | std::ios::binary);
+			ofs2 << "backend = dummy\n";
+		}
+
+		server = std::make_unique<MockServer>(dir);
+		server->createScripting();
+		try {
+			auto script = server->getScriptIface();
+			script->loadBuiltin();
+			script->loadMod(helper_lua, BUILTIN_MOD_NAME);
+		} catch (ModError &e) {
+			FAIL(e.what());
+		}
+
+		ContentFeatures f;
+		f.name = "bench:stone";
+		const content_t c_stone =
+			server->getWritableNodeDefManager()->set(f.name, f);
+
+		mb = std::make_unique<MetricsBackend>();
+		emerge = std::make_unique<EmergeManager>(server.get(), mb.get());
+		auto map = std::make_unique<ServerMap>(dir, server.get(),
+			emerge.get(), mb.get());
+		env = std::make_unique<ServerEnvironment>(std::move(map),
+			server.get(), mb.get());
+		env->loadMeta();
+
+		PcgRandom r(42);
+		Map &map_ref = env->getMap();
+		for (s16 z = 0; z < MAP_SIZE; z++)
+		for (s16 x = 0; x < MAP_SIZE; x++)
+		for (s16 y = -1; y <= 0; y++) {
+			MapBlock *block = map_ref.emergeBlock({x, y, z}, true);
+			REQUIRE(block);
+			for (size_t i = 0; i < MapBlock::nodecount; i++) {
+				// ground below y = 0, an obstacle every now and then above
+				bool solid = y < 0 || r.range(0, 63) == 0;
+				block->getData()[i] = MapNode(solid ? c_stone : CONTENT_AIR);
+			}
+			block->expireIsAirCache();
+		}
+
+		const float extent = MAP_SIZE * MAP_BLOCKSIZE * BS;
+		for (size_t i = 0; i < entity_count; i++) {
+			const v3f pos(r.range(BS, extent - BS), r.range(0, 2 * BS),
+				r.range(BS, extent - BS));
+			auto obj_u = std::make_unique<LuaEntitySAO>(env.get(), pos,
+				"bench:mob", "");
+			auto obj = obj_u.get();
+			REQUIRE(env->addActiveObject(std::move(obj_u)));
+			obj->setVelocity(v3f(r.range(-4, 4), 0, r.range(-4, 4)) * BS);
+			obj->setAcceleration(v3f(0, -10 * BS, 0));
+			entities.push_back(obj);
+		}
+	}
+
+	~World()
+	{
+		entities.clear();
+		env->deactivateBlocksAndObjects();
+		env.reset();
+		emerge.reset();
+		server.reset();
+		fs::RecursiveDelete(dir);
+	}
+};
+
+// Environment without objects for collisionMoveSimple()
+class NodeEnvironment : public Environment {
+	DummyMap map;
+public:
+	NodeEnvironment(IGameDef *gamedef, v3s16 bpmin, v3s16 bpmax) :
+		Environment(gamedef), map(gamedef, bpmin, bpmax)
+	{}
+
+	void step(f32 dtime) override {}
+
+	Map &getMap() override { return map; }
+
+	void getSelectedActiveObjects(const core::line3d<f32> &shootline_on_map,
+		std::vector<PointedThing> &objects,
+		const std::optional<Pointabilities> &pointabilities) override {}
+};
+
+}
+
+// collisionMoveSimple() for many objects on ground with stairs, which have
+// several boxes that depend on param2
+void benchCollisionMoveSimple(Catch::Benchmark::Chronometer &meter,
+	size_t entity_count, bool use_cache)
+{
+	DummyGameDef gamedef;
+	NodeDefManager *ndef = gamedef.getWritableNodeDefManager();
+	content_t c_stone, c_stair;
+	{
+		ContentFeatures f;
+		f.name = "stone";
+		c_stone = ndef->set(f.name, f);
+		f.name = "stair";
+		f.drawtype = NDT_NODEBOX;
+		f.param_type_2 = CPT2_FACEDIR;
+		f.node_box.type = NODEBOX_FIXED;
+		f.node_box.fixed = {
+			aabb3f(v3f(-0.5f, -0.5f, -0.5f) * BS, v3f(0.5f, 0.0f, 0.5f) * BS),
+			aabb3f(v3f(-0.5f, 0.0f, 0.0f) * BS, v3f(0.5f, 0.5f, 0.5f) * BS),
+		};
+		c_stair = ndef->set(f.name, f);
+	}
+
+	const v3s16 bpmin(0, -1, 0), bpmax(MAP_SIZE - 1, 0, MAP_SIZE - 1);
+	NodeEnvironment env(&gamedef, bpmin, bpmax);
+	Map &map = env.getMap();
+	map.use_collision_cache = use_cache;
+
+	PcgRandom r(42);
+	for (s16 z = bpmin.Z; z <= bpmax.Z; z++)
+	for (s16 y = bpmin.Y; y <= bpmax.Y; y++)
+	for (s16 x = bpmin.X; x <= bpmax.X; x++) {
+		MapBlock *block = map.getBlockNoCreateNoEx({x, y, z});
+		for (size_t i = 0; i < MapBlock::nodecount; i++) {
+			const u32 k = r.range(0, 63);
+			MapNode n(CONTENT_AIR);
+			if (y < 0 || k == 0)
+				n = MapNode(c_stone);
+			else if (k < 5)
+				n = MapNode(c_stair, 0, r.range(0, 23));
+			block->getData()[i] = n;
+		}
+		block->expireIsAirCache();
+		block->expireCollisionBoxes();
+	}
+
+	const aabb3f box(v3f(-0.3f, 0, -0.3f) * BS, v3f(0.3f, 1.5f, 0.3f) * BS);
+	const float extent = MAP_SIZE * MAP_BLOCKSIZE * BS;
+	std::vector<std::pair<v3f, v3f>> entities;
+	for (size_t i = 0; i < entity_count; i++) {
+		const v3f pos(r.range(BS, extent - BS), r.range(0, 2 * BS),
+			r.range(BS, extent - BS));
+		entities.emplace_back(pos, v3f(r.range(-4, 4), 0, r.range(-4, 4)) * BS);
+	}
+
+	meter.measure([&] {
+		size_t collisions = 0;
+		for (auto &it : entities) {
+			v3f pos = it.first, speed = it.second;
+			auto res = collisionMoveSimple(&env, &gamedef, box, 0.6f * BS,
+				DTIME, &pos, &speed, v3f(0, -10 * BS, 0));
+			collisions += res.collisions.size();
+		}
+		return collisions;
+	});
+}
+
+// The parallel phase of the entity step, see ActiveObjectMgr::prepareStep()
+void benchEntityCollisions(Catch::Benchmark::Chronometer &meter,
+	size_t entity_count, unsigned int threads)
+{
+	World world(entity_count);
+	auto &entities = world.entities;
+
+	// one thread means serial execution
+	WorkerPool pool("CollisionBench", threads - 1);
+	meter.measure([&] {
+		const size_t num_chunks = (entities.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+		pool.parallelFor(num_chunks, [&] (size_t chunk) {
+			const size_t first = chunk * CHUNK_SIZE;
+			const size_t last = std::min(entities.size(), first + CHUNK_SIZE);
+			for (size_t i = first; i < last; i++)
+				entities[i]->prepareStep(DTIME);
+		});
+		return entities.size();
+	});
+}
+
+#define BENCH_COLLISIONS(_count, _threads) \
+	BENCHMARK_ADVANCED("collisions_" #_count "_entities_" #_threads "_threads") \
+		(Catch::Benchmark::Chronometer meter) \
+	{ benchEntityCollisions(meter, _count, _threads); };
+
+#define BENCH_MOVE_SIMPLE(_count, _cache, _use_cache) \
+	BENCHMARK_ADVANCED("move_simple_" #_count "_entities_" #_cache) \
+		(Catch::Benchmark::Chronometer meter) \
+	{ benchCollisionMoveSimple(meter, _count, _use_cache); };
+
+TEST_CASE("benchmark_collision")
+{
+	BENCH_MOVE_SIMPLE(1000, uncached, false)
+	BENCH_MOVE_SIMPLE(1000, cached, true)
+
+	BENCH_COLLISIONS(1000, 1)
+	BENCH_COLLISIONS(1000, 4)
+	BENCH_COLLISIONS(5000, 1)
+	BENCH_COLLISIONS(5000, 4)
+	BENCH_COLLISIONS(10000, 1)
+	BENCH_COLLISIONS(10000, 4)
+}
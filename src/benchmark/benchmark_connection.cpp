@@ -0,0 +1,138 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#include "catch.h"
+#include "network/connection.h"
+#include "network/networkpacket.h"
+#include "network/peerhandler.h"
+#include "network/socket.h"
+#include "porting.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+// Every iteration transfers this many packets over loopback, so the
+// throughput in packets per second is PACKET_COUNT / mean time.
+constexpr int PACKET_COUNT = 1000;
+constexpr int PACKET_SIZE = 500;
+constexpr u16 PORT = 30021;
+
+namespace {
+
+struct Handler : public con::PeerHandler
+{
+	void peerAdded(con::IPeer *peer) override { last_id = peer->id; }
+	void deletingPeer(con::IPeer *peer, bool timeout) override {}
+
+	std::atomic<session_t> last_id{0};
+};
+
+// Receives and discards everything sent to it
+struct Sink {
+	UDPSocket socket;
+	std::atomic<bool> stop{false};
+	std::thread thread;
+
+	Sink() : socket(false)
+	{
+		socket.Bind(Address(127, 0, 0, 1, PORT));
+		socket.setTimeoutMs(10);
+		thread = std::thread([this] {
+			constexpr int count = 64;
+			std::unique_ptr<u8[]> data(new u8[count * PACKET_SIZE]);
+			Address senders[count];
+			int sizes[count];
+			while (!stop)
+				socket.ReceiveMany(senders, data.get(), PACKET_SIZE, sizes, count);
+		});
+	}
+
+	~Sink()
+	{
+		stop = true;
+		thread.join();
+	}
+};
+
+}
+
+// One system call per packet
+void benchSocketSend(Catch::Benchmark::Chronometer &meter)
+{
+	Sink sink;
+	UDPSocket socket(false);
+	const Address address(127, 0, 0, 1, PORT);
+	const std::string data(PACKET_SIZE, 'x');
+
+	meter.measure([&] {
+		for (int i = 0; i < PACKET_COUNT; i++)
+			socket.Send(address, data.data(), data.size());
+	});
+}
+
+// Batches of 64, like ConnectionSendThread does
+void benchSocketSendMany(Catch::Benchmark::Chronometer &meter)
+{
+	Sink sink;
+	UDPSocket socket(false);
+	constexpr int batch = 64;
+	const std::string data(PACKET_SIZE, 'x');
+	Address addresses[batch];
+	const u8 *datas[batch];
+	int sizes[batch];
+	for (int i = 0; i < batch; i++) {
+		addresses[i] = Address(127, 0, 0, 1, PORT);
+		datas[i] = reinterpret_cast<const u8 *>(data.data());
+		sizes[i] = data.size();
+	}
+
+	meter.measure([&] {
+		for (int i = 0; i < PACKET_COUNT; i += batch)
+			socket.SendMany(addresses, datas, sizes, std::min(batch, PACKET_COUNT - i));
+	});
+}
+
+// Reliable packets from a server to a client through the whole stack
+void benchConnectionReliable(Catch::Benchmark::Chronometer &meter)
+{
+	Handler hand_server, hand_client;
+	std::unique_ptr<con::IConnection> server(con::createMTP(5.0f, false, &hand_server));
+	std::unique_ptr<con::IConnection> client(con::createMTP(5.0f, false, &hand_client));
+	server->Serve(Address(127, 0, 0, 1, PORT));
+	client->Connect(Address(127, 0, 0, 1, PORT));
+
+	NetworkPacket pkt;
+	const u64 start = porting::getTimeMs();
+	while (!client->Connected() || hand_server.last_id == 0) {
+		REQUIRE(porting::getTimeMs() - start < 5000);
+		client->ReceiveTimeoutMs(&pkt, 10);
+		server->ReceiveTimeoutMs(&pkt, 10);
+	}
+	const session_t client_id = hand_server.last_id;
+
+	meter.measure([&] {
+		for (int i = 0; i < PACKET_COUNT; i++) {
+			NetworkPacket pkt(0x4b, PACKET_SIZE);
+			pkt.putRawString(std::string(PACKET_SIZE, 'x'));
+			server->Send(client_id, 0, &pkt, true);
+		}
+		int received = 0;
+		while (received < PACKET_COUNT) {
+			NetworkPacket pkt;
+			REQUIRE(client->ReceiveTimeoutMs(&pkt, 5000));
+			received++;
+		}
+		return received;
+	});
+}
+
+TEST_CASE("Connection") {
+	BENCHMARK_ADVANCED("socket_send")(Catch::Benchmark::Chronometer meter)
+	{ benchSocketSend(meter); };
+	BENCHMARK_ADVANCED("socket_sendmany")(Catch::Benchmark::Chronometer meter)
+	{ benchSocketSendMany(meter); };
+	BENCHMARK_ADVANCED("connection_reliable")(Catch::Benchmark::Chronometer meter)
+	{ benchConnectionReliable(meter); };
+}
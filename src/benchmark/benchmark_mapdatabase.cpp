@@ -0,0 +1,219 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#include "catch.h"
+#include "database/database-mmap.h"
+#include "database/database-sqlite3.h"
+#include "filesys.h"
+#include "noise.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+constexpr int BLOCK_COUNT = 10000;
+constexpr int BATCH = 500;
+// typical size of a compressed block on disk
+constexpr size_t DATA_SIZE = 2000;
+
+typedef MapDatabase *(*DatabaseCreator)(const std::string &dir);
+
+MapDatabase *createSQLite3(const std::string &dir)
+{
+	return new MapDatabaseSQLite3(dir);
+}
+
+MapDatabase *createSQLite3Fast(const std::string &dir)
+{
+	return new MapDatabaseSQLite3(dir, true, 64 * 1024);
+}
+
+#ifndef _WIN32
+MapDatabase *createMmap(const std::string &dir)
+{
+	return new MapDatabaseMmap(dir);
+}
+#endif
+
+inline v3s16 blockPos(int i)
+{
+	return v3s16(i % 32, (i / 32) % 16, i / (32 * 16));
+}
+
+std::string blockData(PcgRandom &r)
+{
+	std::string data(DATA_SIZE, '\0');
+	for (char &c : data)
+		c = r.next() & 0xff;
+	return data;
+}
+
+struct TempDatabase {
+	std::string dir;
+	std::unique_ptr<MapDatabase> db;
+
+	TempDatabase(DatabaseCreator create)
+	{
+		dir = fs::CreateTempDir();
+		REQUIRE(!dir.empty());
+		db.reset(create(dir));
+
+		PcgRandom r(42);
+		db->beginSave();
+		for (int i = 0; i < BLOCK_COUNT; i++)
+			REQUIRE(db->saveBlock(blockPos(i), blockData(r)));
+		db->endSave();
+	}
+
+	~TempDatabase()
+	{
+		db.reset();
+		fs::RecursiveDelete(dir);
+	}
+};
+
+}
+
+void benchMapDatabaseSave(Catch::Benchmark::Chronometer &meter, DatabaseCreator create)
+{
+	TempDatabase tmp(create);
+	PcgRandom r(1);
+	std::vector<std::string> data;
+	for (int i = 0; i < BATCH; i++)
+		data.push_back(blockData(r));
+
+	meter.measure([&] {
+		// overwrites, like a running server does
+		tmp.db->beginSave();
+		for (int i = 0; i < BATCH; i++)
+			tmp.db->saveBlock(blockPos(r.range(0, BLOCK_COUNT - 1)), data[i]);
+		tmp.db->endSave();
+	});
+}
+
+void benchMapDatabaseLoad(Catch::Benchmark::Chronometer &meter, DatabaseCreator create)
+{
+	TempDatabase tmp(create);
+	PcgRandom r(2);
+	std::string data;
+
+	meter.measure([&] {
+		size_t total = 0;
+		for (int i = 0; i < BATCH; i++) {
+			tmp.db->loadBlock(blockPos(r.range(0, BLOCK_COUNT - 1)), &data);
+			total += data.size();
+		}
+		return total;
+	});
+}
+
+// Loads while another thread keeps saving, like emerge threads do
+void benchMapDatabaseLoadDuringSave(Catch::Benchmark::Chronometer &meter,
+	DatabaseCreator create)
+{
+	TempDatabase tmp(create);
+	std::atomic<bool> stop(false);
+	std::thread writer([&] {
+		PcgRandom r(3);
+		const std::string data = blockData(r);
+		while (!stop) {
+			tmp.db->beginSave();
+			for (int i = 0; i < 50; i++)
+				tmp.db->saveBlock(blockPos(r.range(0, BLOCK_COUNT - 1)), data);
+			tmp.db->endSave();
+		}
+	});
+
+	PcgRandom r(4);
+	std::string data;
+	meter.measure([&] {
+		size_t total = 0;
+		for (int i = 0; i < BATCH; i++) {
+			tmp.db->loadBlock(blockPos(r.range(0, BLOCK_COUNT - 1)), &data);
+			total += data.size();
+		}
+		return total;
+	});
+
+	stop = true;
+	writer.join();
+}
+
+// Loads from several threads, like emerge threads loading from disk.
+// They either share the database behind a lock or have a read handle each.
+void benchMapDatabaseLoadThreads(Catch::Benchmark::Chronometer &meter,
+	DatabaseCreator create, int threads, bool handles)
+{
+	// Number of blocks per loadBlocks() call
+	constexpr int PREFETCH = 32;
+
+	TempDatabase tmp(create);
+	std::mutex mutex;
+	std::vector<std::unique_ptr<MapDatabaseReadHandle>> db_handles;
+	for (int t = 0; handles && t < threads; t++) {
+		db_handles.push_back(tmp.db->createReadHandle());
+		REQUIRE(db_handles.back());
+	}
+
+	auto load = [&] (int t) {
+		PcgRandom r(5 + t);
+		std::vector<v3s16> batch, unavailable;
+		size_t total = 0;
+		auto cb = [&] (const v3s16 &pos, std::string &data) {
+			total += data.size();
+		};
+		for (int i = 0; i < BATCH; i += PREFETCH) {
+			batch.clear();
+			for (int j = 0; j < PREFETCH; j++)
+				batch.push_back(blockPos(r.range(0, BLOCK_COUNT - 1)));
+			if (handles) {
+				db_handles[t]->loadBlocks(batch, cb, unavailable);
+			} else {
+				std::lock_guard<std::mutex> lock(mutex);
+				tmp.db->loadBlocks(batch, cb);
+			}
+		}
+		return total;
+	};
+
+	meter.measure([&] {
+		std::vector<std::thread> workers;
+		for (int t = 1; t < threads; t++)
+			workers.emplace_back(load, t);
+		size_t total = load(0);
+		for (auto &it : workers)
+			it.join();
+		return total;
+	});
+}
+
+#define BENCH_DATABASE(_name, _create) \
+	BENCHMARK_ADVANCED("save_" #_name)(Catch::Benchmark::Chronometer meter) \
+	{ benchMapDatabaseSave(meter, _create); }; \
+	BENCHMARK_ADVANCED("load_" #_name)(Catch::Benchmark::Chronometer meter) \
+	{ benchMapDatabaseLoad(meter, _create); }; \
+	BENCHMARK_ADVANCED("load_during_save_" #_name)(Catch::Benchmark::Chronometer meter) \
+	{ benchMapDatabaseLoadDuringSave(meter, _create); };
+
+#define BENCH_LOAD_THREADS(_name, _create, _threads) \
+	BENCHMARK_ADVANCED("load_" #_name "_locked_" #_threads "_threads")(Catch::Benchmark::Chronometer meter) \
+	{ benchMapDatabaseLoadThreads(meter, _create, _threads, false); }; \
+	BENCHMARK_ADVANCED("load_" #_name "_handles_" #_threads "_threads")(Catch::Benchmark::Chronometer meter) \
+	{ benchMapDatabaseLoadThreads(meter, _create, _threads, true); };
+
+TEST_CASE("MapDatabase") {
+	BENCH_DATABASE(sqlite3, createSQLite3)
+	BENCH_DATABASE(sqlite3_high_throughput, createSQLite3Fast)
+#ifndef _WIN32
+	BENCH_DATABASE(mmap, createMmap)
+#endif
+}
+
+TEST_CASE("MapDatabase threaded load") {
+	BENCH_LOAD_THREADS(sqlite3_high_throughput, createSQLite3Fast, 1)
+	BENCH_LOAD_THREADS(sqlite3_high_throughput, createSQLite3Fast, 2)
+	BENCH_LOAD_THREADS(sqlite3_high_throughput, createSQLite3Fast, 4)
+	BENCH_LOAD_THREADS(sqlite3_high_throughput, createSQLite3Fast, 8)
+}
@@ -0,0 +1,285 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#include "catch.h"
+#include "dummygamedef.h"
+#include "dummymap.h"
+#include "mapgen/mapgen.h"
+#include "mapgen/mg_decoration.h"
+#include "mapgen/mg_ore.h"
+#include "nodedef.h"
+#include "noise.h"
+#include "util/numeric.h"
+
+namespace {
+
+// One mapchunk with the default chunksize of 5
+constexpr s16 CHUNK_SIZE = 80;
+
+// Biome ids of the biome map, 0 is BIOME_NONE
+enum : biome_t {
+	BIOME_GRASSLAND = 1,
+	BIOME_FOREST,
+	BIOME_DESERT,
+	BIOME_TUNDRA,
+};
+
+struct Contents {
+	content_t stone, dirt, grass, sand, water, gravel, clay;
+	std::vector<content_t> ores;
+	std::vector<content_t> plants;
+};
+
+Contents register_nodes(NodeDefManager *ndef)
+{
+	auto add = [&] (const std::string &name, bool walkable = true) {
+		ContentFeatures f;
+		f.name = name;
+		f.walkable = walkable;
+		return ndef->set(f.name, f);
+	};
+
+	Contents c;
+	c.stone = add("stone");
+	c.dirt = add("dirt");
+	c.grass = add("dirt_with_grass");
+	c.sand = add("sand");
+	c.water = add("water", false);
+	c.gravel = add("gravel");
+	c.clay = add("clay");
+	for (const char *ore : {"coal", "iron", "tin", "copper", "gold", "mese", "diamond"})
+		c.ores.push_back(add(std::string("stone_with_") + ore));
+	for (int i = 0; i < 24; i++)
+		c.plants.push_back(add("plant_" + std::to_string(i), false));
+	return c;
+}
+
+// Roughly the ores of a typical game: layers of scatter ores, blobs of
+// soft nodes and a few veins, some of them only in certain biomes
+void register_ores(OreManager &oremgr, const Contents &c)
+{
+	const NoiseParams np_blob(0, 1, v3f(5, 5, 5), 766, 1, 0, 2.0);
+	const NoiseParams np_vein(0, 1, v3f(50, 50, 50), 2355, 3, 0.6, 2.0);
+
+	auto add = [&] (OreType type, content_t c_ore, content_t c_wherein,
+			u32 scarcity, s16 num_ores, s16 size, s16 y_min, s16 y_max) {
+		Ore *ore = OreManager::create(type);
+		ore->c_ore = c_ore;
+		ore->c_wherein = {c_wherein};
+		ore->clust_scarcity = scarcity;
+		ore->clust_num_ores = num_ores;
+		ore->clust_size = size;
+		ore->y_min = y_min;
+		ore->y_max = y_max;
+		ore->ore_param2 = 0;
+		ore->nthresh = 0;
+		ore->np = np_blob;
+		oremgr.add(ore);
+		return ore;
+	};
+
+	// three depth layers for every ore
+	for (size_t i = 0; i < c.ores.size(); i++) {
+		const u32 rarity = 8 + 2 * i;
+		add(ORE_SCATTER, c.ores[i], c.stone, rarity * rarity * rarity, 8, 3, 0, 31000);
+		add(ORE_SCATTER, c.ores[i], c.stone, rarity * rarity * rarity, 5, 3, -255, -1);
+		add(ORE_SCATTER, c.ores[i], c.stone, (rarity - 2) * (rarity - 2) * (rarity - 2),
+			9, 3, -31000, -256);
+	}
+
+	for (content_t c_blob : {c.dirt, c.gravel, c.clay, c.sand}) {
+		Ore *ore = add(ORE_BLOB, c_blob, c.stone, 16 * 16 * 16, 0, 5, -31000, 31000);
+		if (c_blob == c.clay || c_blob == c.sand)
+			ore->biomes = {BIOME_DESERT};
+		else if (c_blob == c.dirt)
+			ore->biomes = {BIOME_GRASSLAND, BIOME_FOREST};
+	}
+
+	for (size_t i = 0; i < 2; i++) {
+		auto *ore = static_cast<OreVein *>(add(ORE_VEIN, c.ores[i + 1], c.stone,
+			1, 0, 3, -31000, 31000));
+		ore->flags |= OREFLAG_USE_NOISE;
+		ore->np = np_vein;
+		ore->np.seed += i;
+		ore->nthresh = 1.6f;
+		ore->random_factor = 0;
+		ore->biomes = {i == 0 ? BIOME_TUNDRA : BIOME_DESERT};
+	}
+}
+
+// Grass, flowers, bushes and trees for every biome, most with noise
+void register_decorations(DecorationManager &decomgr, const Contents &c)
+{
+	const NoiseParams np_deco(0, 0.06, v3f(250, 250, 250), 2, 3, 0.66, 2.0);
+
+	const biome_t biomes[] = {BIOME_GRASSLAND, BIOME_FOREST, BIOME_DESERT,
+		BIOME_TUNDRA};
+	u32 count = 0;
+	for (biome_t biome : biomes) {
+		const content_t c_place_on = biome == BIOME_DESERT ? c.sand : c.grass;
+		for (int i = 0; i < 25; i++, count++) {
+			auto *deco = static_cast<DecoSimple *>(
+				DecorationManager::create(DECO_SIMPLE));
+			deco->c_place_on = {c_place_on};
+			deco->c_decos = {c.plants[count % c.plants.size()]};
+			deco->sidelen = i % 3 == 0 ? 80 : 16;
+			deco->y_min = 1;
+			deco->y_max = 31000;
+			deco->nspawnby = -1;
+			deco->deco_height = i < 5 ? 4 : 1;
+			deco->deco_height_max = i < 5 ? 6 : 0;
+			deco->deco_param2 = 0;
+			deco->deco_param2_max = 0;
+			deco->mapseed = 1337;
+			deco->biomes = {biome};
+			if (i % 4 == 0) {
+				deco->fill_ratio = 0.002f;
+			} else {
+				deco->flags |= DECO_USE_NOISE;
+				deco->np = np_deco;
+				deco->np.seed += count;
+			}
+			decomgr.add(deco);
+		}
+	}
+}
+
+class PlacementBench {
+public:
+	PlacementBench(s16 y) :
+		nmin(0, y, 0),
+		nmax(CHUNK_SIZE - 1, y + CHUNK_SIZE - 1, CHUNK_SIZE - 1),
+		map(&gamedef, getNodeBlockPos(nmin) - v3s16(1, 1, 1),
+			getNodeBlockPos(nmax) + v3s16(1, 1, 1)),
+		vm(&map),
+		oremgr(&gamedef),
+		decomgr(&gamedef)
+	{
+		c = register_nodes(gamedef.getWritableNodeDefManager());
+		register_ores(oremgr, c);
+		register_decorations(decomgr, c);
+
+		vm.initialEmerge(getNodeBlockPos(nmin) - v3s16(1, 1, 1),
+			getNodeBlockPos(nmax) + v3s16(1, 1, 1), false);
+		mg.vm = &vm;
+		mg.ndef = gamedef.getNodeDefManager();
+		mg.seed = 1337;
+		mg.csize = nmax - nmin + v3s16(1, 1, 1);
+		heightmap.resize(CHUNK_SIZE * CHUNK_SIZE);
+		biomemap.resize(CHUNK_SIZE * CHUNK_SIZE);
+		mg.heightmap = heightmap.data();
+		mg.biomemap = biomemap.data();
+
+		generateTerrain();
+		terrain.assign(vm.m_data, vm.m_data + vm.m_area.getVolume());
+	}
+
+	size_t placeOres()
+	{
+		resetTerrain();
+		return oremgr.placeAllOres(&mg, Mapgen::getBlockSeed(nmin, mg.seed),
+			nmin, nmax);
+	}
+
+	void placeDecorations()
+	{
+		resetTerrain();
+		decomgr.placeAllDecos(&mg, Mapgen::getBlockSeed(nmin, mg.seed),
+			nmin, nmax);
+	}
+
+private:
+	// Hills with stone, dirt and grass or sand, a sea and four biomes
+	void generateTerrain()
+	{
+		const NoiseParams np_height(0, 20, v3f(100, 100, 100), 82341, 4, 0.5, 2.0);
+		const NoiseParams np_heat(50, 50, v3f(120, 120, 120), 5349, 3, 0.5, 2.0);
+		const NoiseParams np_humidity(50, 50, v3f(120, 120, 120), 842, 3, 0.5, 2.0);
+		Noise noise_height(&np_height, mg.seed, CHUNK_SIZE, CHUNK_SIZE);
+		Noise noise_heat(&np_heat, mg.seed, CHUNK_SIZE, CHUNK_SIZE);
+		Noise noise_humidity(&np_humidity, mg.seed, CHUNK_SIZE, CHUNK_SIZE);
+		noise_height.noiseMap2D(nmin.X, nmin.Z);
+		noise_heat.noiseMap2D(nmin.X, nmin.Z);
+		noise_humidity.noiseMap2D(nmin.X, nmin.Z);
+
+		const s16 water_level = 1;
+		const v3s16 pmin = vm.m_area.MinEdge, pmax = vm.m_area.MaxEdge;
+		for (s16 z = pmin.Z; z <= pmax.Z; z++)
+		for (s16 x = pmin.X; x <= pmax.X; x++) {
+			const s16 zc = rangelim(z, nmin.Z, nmax.Z) - nmin.Z;
+			const s16 xc = rangelim(x, nmin.X, nmax.X) - nmin.X;
+			const size_t index = zc * CHUNK_SIZE + xc;
+			const s16 height = noise_height.result[index];
+			const float heat = noise_heat.result[index];
+			const bool desert = heat > 60;
+			for (s16 y = pmin.Y; y <= pmax.Y; y++) {
+				content_t content = CONTENT_AIR;
+				if (y < height - 3)
+					content = c.stone;
+				else if (y < height)
+					content = desert ? c.sand : c.dirt;
+				else if (y == height)
+					content = desert || height <= water_level ? c.sand : c.grass;
+				else if (y <= water_level)
+					content = c.water;
+				vm.m_data[vm.m_area.index(x, y, z)] = MapNode(content);
+			}
+
+			biomemap[index] = desert ? BIOME_DESERT : heat < 25 ? BIOME_TUNDRA :
+				noise_humidity.result[index] > 50 ? BIOME_FOREST : BIOME_GRASSLAND;
+		}
+
+		mg.updateHeightmap(nmin, nmax);
+	}
+
+	void resetTerrain()
+	{
+		std::copy(terrain.begin(), terrain.end(), vm.m_data);
+	}
+
+	const v3s16 nmin, nmax;
+	DummyGameDef gamedef;
+	DummyMap map;
+	MMVManip vm;
+	Mapgen mg;
+	OreManager oremgr;
+	DecorationManager decomgr;
+	Contents c;
+	std::vector<s16> heightmap;
+	std::vector<biome_t> biomemap;
+	std::vector<MapNode> terrain;
+};
+
+}
+
+// Catch reports the time per mapchunk. Restoring the terrain before every
+// run is included, it takes a small fraction of that.
+void benchPlaceOres(Catch::Benchmark::Chronometer &meter, s16 y)
+{
+	PlacementBench bench(y);
+	meter.measure([&] {
+		return bench.placeOres();
+	});
+}
+
+void benchPlaceDecorations(Catch::Benchmark::Chronometer &meter, s16 y)
+{
+	PlacementBench bench(y);
+	meter.measure([&] {
+		bench.placeDecorations();
+	});
+}
+
+#define BENCH_PLACEMENT(_name, _y) \
+	BENCHMARK_ADVANCED("placeAllOres_" #_name)(Catch::Benchmark::Chronometer meter) \
+	{ benchPlaceOres(meter, _y); }; \
+	BENCHMARK_ADVANCED("placeAllDecos_" #_name)(Catch::Benchmark::Chronometer meter) \
+	{ benchPlaceDecorations(meter, _y); };
+
+TEST_CASE("benchmark_mapgen_placement")
+{
+	// 27 ores and 100 decorations
+	BENCH_PLACEMENT(surface, -32)
+	BENCH_PLACEMENT(underground, -512)
+}
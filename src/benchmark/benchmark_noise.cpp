@@ -0,0 +1,60 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#include "catch.h"
+#include "noise.h"
+
+namespace {
+
+// Size of a mapchunk with the default chunksize of 5, with the overgeneration
+// of one node below and above that most mapgens use for 3D noise
+constexpr u32 CHUNK_SIZE = 80;
+
+// Similar to the 3D and 2D terrain noises of mapgen v7
+const NoiseParams np_3d(0, 1, v3f(100, 100, 100), 5934, 5, 0.63, 2.0);
+const NoiseParams np_2d(4, 70, v3f(600, 600, 600), 5934, 7, 0.6, 2.0);
+
+}
+
+// Catch reports the time per chunk, so the number of points per second is
+// 80x82x80 (3D) or 80x80 (2D) divided by that.
+void benchNoiseMap3D(Catch::Benchmark::Chronometer &meter, NoiseSimd simd)
+{
+	if (!setNoiseSimd(simd))
+		return;
+	Noise noise(&np_3d, 1337, CHUNK_SIZE, CHUNK_SIZE + 2, CHUNK_SIZE);
+	int i = 0;
+	meter.measure([&] {
+		// a new chunk every time
+		return noise.noiseMap3D(CHUNK_SIZE * i++, -1, 0)[0];
+	});
+}
+
+void benchNoiseMap2D(Catch::Benchmark::Chronometer &meter, NoiseSimd simd)
+{
+	if (!setNoiseSimd(simd))
+		return;
+	Noise noise(&np_2d, 1337, CHUNK_SIZE, CHUNK_SIZE);
+	int i = 0;
+	meter.measure([&] {
+		return noise.noiseMap2D(CHUNK_SIZE * i++, 0)[0];
+	});
+}
+
+#define BENCH_NOISE(_name, _simd) \
+	BENCHMARK_ADVANCED("noiseMap3D_80x82x80_" #_name)(Catch::Benchmark::Chronometer meter) \
+	{ benchNoiseMap3D(meter, _simd); }; \
+	BENCHMARK_ADVANCED("noiseMap2D_80x80_" #_name)(Catch::Benchmark::Chronometer meter) \
+	{ benchNoiseMap2D(meter, _simd); };
+
+TEST_CASE("benchmark_noise")
+{
+	const NoiseSimd orig_simd = getNoiseSimd();
+
+	BENCH_NOISE(scalar, NoiseSimd::None)
+	BENCH_NOISE(sse2, NoiseSimd::SSE2)
+	BENCH_NOISE(avx2, NoiseSimd::AVX2)
+
+	setNoiseSimd(orig_simd);
+}
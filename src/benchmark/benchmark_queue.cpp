@@ -0,0 +1,57 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#include "catch.h"
+#include "util/container.h"
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr u32 ITEMS_PER_PRODUCER = 10000;
+
+}
+
+// All threads but one push, the remaining one pops everything
+template <typename Queue, u32 Threads>
+void benchQueueContention(Catch::Benchmark::Chronometer &meter)
+{
+	constexpr u32 producers = Threads - 1;
+	Queue queue;
+
+	meter.measure([&] {
+		std::vector<std::thread> threads;
+		for (u32 p = 0; p < producers; p++) {
+			threads.emplace_back([&queue] {
+				for (u32 i = 0; i < ITEMS_PER_PRODUCER; i++)
+					queue.push_back(i);
+			});
+		}
+		u64 sum = 0;
+		for (u32 n = 0; n < producers * ITEMS_PER_PRODUCER; n++)
+			sum += queue.pop_frontNoEx();
+		for (auto &thread : threads)
+			thread.join();
+		return sum;
+	});
+	REQUIRE(queue.empty());
+}
+
+#define BENCH_CONTENTION(_queue, _threads) \
+	BENCHMARK_ADVANCED(#_queue "_" #_threads "_threads")(Catch::Benchmark::Chronometer meter) \
+	{ benchQueueContention<_queue<u32>, _threads>(meter); };
+
+TEST_CASE("benchmark_queue")
+{
+	BENCH_CONTENTION(MutexedQueue, 2)
+	BENCH_CONTENTION(MPSCQueue, 2)
+	BENCH_CONTENTION(MutexedQueue, 4)
+	BENCH_CONTENTION(MPSCQueue, 4)
+	BENCH_CONTENTION(MutexedQueue, 8)
+	BENCH_CONTENTION(MPSCQueue, 8)
+	BENCH_CONTENTION(MutexedQueue, 16)
+	BENCH_CONTENTION(MPSCQueue, 16)
+	BENCH_CONTENTION(MutexedQueue, 32)
+	BENCH_CONTENTION(MPSCQueue, 32)
+}
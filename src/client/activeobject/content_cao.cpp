@@ -1563,18 +1563,22 @@ void GenericCAO::processMessage(const std::string &data)
 			updateNametag();
 			updateMarker();
 		}
-	} else if (cmd == AO_CMD_UPDATE_POSITION) {
+	} else if (cmd == AO_CMD_UPDATE_POSITION || cmd == AO_CMD_UPDATE_POSITION_COMPACT) {
 		// Not sent by the server if this object is an attachment.
 		// We might however get here if the server notices the object being detached before the client.
-		m_position = readV3F32(is);
-		m_velocity = readV3F32(is);
-		m_acceleration = readV3F32(is);
-		m_rotation = readV3F32(is);
-
-		m_rotation = wrapDegrees_0_360_v3f(m_rotation);
-		bool do_interpolate = readU8(is);
-		bool is_end_position = readU8(is);
-		float update_interval = readF32(is);
+		AOPositionUpdate update;
+		if (cmd == AO_CMD_UPDATE_POSITION_COMPACT)
+			update.deSerializeCompact(is);
+		else
+			update.deSerialize(is);
+		m_position = update.position;
+		m_velocity = update.velocity;
+		m_acceleration = update.acceleration;
+
+		m_rotation = wrapDegrees_0_360_v3f(update.rotation);
+		bool do_interpolate = update.do_interpolate;
+		bool is_end_position = update.is_end_position;
+		float update_interval = update.update_interval;
 
 		if(getParent() != NULL) // Just in case
 			return;
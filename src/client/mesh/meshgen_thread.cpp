@@ -321,17 +321,7 @@ void MeshUpdateManager::putResult(const MeshUpdateResult &result)
 
 bool MeshUpdateManager::getNextResult(MeshUpdateResult &r)
 {
-	if (!m_queue_out_urgent.empty()) {
-		r = m_queue_out_urgent.pop_frontNoEx();
-		return true;
-	}
-
-	if (!m_queue_out.empty()) {
-		r = m_queue_out.pop_frontNoEx();
-		return true;
-	}
-
-	return false;
+	return m_queue_out_urgent.try_pop_front(r) || m_queue_out.try_pop_front(r);
 }
 
 void MeshUpdateManager::deferUpdate()
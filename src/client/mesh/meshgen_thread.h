@@ -134,8 +134,9 @@ class MeshUpdateManager
 
 
 	MeshUpdateQueue m_queue_in;
-	MutexedQueue<MeshUpdateResult> m_queue_out;
-	MutexedQueue<MeshUpdateResult> m_queue_out_urgent;
+	// filled by the workers, drained by the main thread
+	MPSCQueue<MeshUpdateResult> m_queue_out;
+	MPSCQueue<MeshUpdateResult> m_queue_out_urgent;
 
 	std::vector<std::unique_ptr<MeshUpdateWorkerThread>> m_workers;
 };
@@ -3,6 +3,7 @@
 // Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
 
 #include "collision.h"
+#include <algorithm>
 #include <cmath>
 #include "irr_aabb3d.h"
 #include "mapblock.h"
@@ -23,7 +24,7 @@
 #warning "-ffast-math is known to cause bugs in collision code, do not use!"
 #endif
 
-bool g_collision_problems_encountered = false;
+std::atomic<bool> g_collision_problems_encountered(false);
 
 namespace {
 
@@ -217,6 +218,82 @@ bool wouldCollideWithCeiling(
 	return false;
 }
 
+// Collision box of a full cube, relative to the node position
+static const aabb3f CUBE_BOX(-BS / 2, -BS / 2, -BS / 2, BS / 2, BS / 2, BS / 2);
+
+const BlockCollisionBoxes::Node *BlockCollisionBoxes::find(u16 index) const
+{
+	auto it = std::lower_bound(nodes.begin(), nodes.end(), index,
+		[] (const Node &node, u16 index) { return node.index < index; });
+	if (it == nodes.end() || it->index != index)
+		return nullptr;
+	return &*it;
+}
+
+std::unique_ptr<BlockCollisionBoxes> BlockCollisionBoxes::build(MapBlock *block,
+		const NodeDefManager *nodedef)
+{
+	auto ret = std::make_unique<BlockCollisionBoxes>();
+	thread_local std::vector<aabb3f> nodeboxes;
+
+	const MapNode *data = block->getData();
+	const v3s16 pos_relative = block->getPosRelative();
+	u16 i = 0;
+	v3s16 relp;
+	for (relp.Z = 0; relp.Z < MAP_BLOCKSIZE; relp.Z++)
+	for (relp.Y = 0; relp.Y < MAP_BLOCKSIZE; relp.Y++)
+	for (relp.X = 0; relp.X < MAP_BLOCKSIZE; relp.X++, i++) {
+		const MapNode n = data[i];
+		Node node{i, NODE_BOXES, 0, (u32)ret->boxes.size()};
+
+		if (n.getContent() == CONTENT_IGNORE) {
+			node.kind = NODE_IGNORE;
+			ret->nodes.push_back(node);
+			continue;
+		}
+
+		const ContentFeatures &f = nodedef->get(n);
+		if (!f.walkable)
+			continue;
+		if (f.drawtype == NDT_NODEBOX && f.node_box.type == NODEBOX_CONNECTED) {
+			node.kind = NODE_UNCACHED;
+			ret->nodes.push_back(node);
+			continue;
+		}
+
+		// Negative bouncy may have a meaning, but we need +value here.
+		const int bouncy = abs(itemgroup_get(f.groups, "bouncy"));
+		if (bouncy > U8_MAX) {
+			// doesn't fit, let the uncached path deal with it
+			node.kind = NODE_UNCACHED;
+			ret->nodes.push_back(node);
+			continue;
+		}
+		node.bouncy = bouncy;
+
+		nodeboxes.clear();
+		n.getCollisionBoxes(nodedef, &nodeboxes);
+		if (node.bouncy == 0 && nodeboxes.size() == 1 && nodeboxes[0] == CUBE_BOX) {
+			ret->cubes.set(i);
+			continue;
+		}
+		if (nodeboxes.empty())
+			continue;
+
+		const v3f posf = intToFloat(pos_relative + relp, BS);
+		for (auto box : nodeboxes) {
+			box.MinEdge += posf;
+			box.MaxEdge += posf;
+			ret->boxes.push_back(box);
+		}
+		ret->nodes.push_back(node);
+	}
+
+	ret->nodes.shrink_to_fit();
+	ret->boxes.shrink_to_fit();
+	return ret;
+}
+
 static bool add_area_node_boxes(const v3s16 min, const v3s16 max, IGameDef *gamedef,
 		Environment *env, std::vector<NearbyCollisionInfo> &cinfo)
 {
@@ -230,6 +307,7 @@ static bool add_area_node_boxes(const v3s16 min, const v3s16 max, IGameDef *game
 
 	v3s16 last_bp(S16_MAX);
 	MapBlock *last_block = nullptr;
+	const BlockCollisionBoxes *last_boxes = nullptr;
 
 	// Note: as the area used here is usually small, iterating entire blocks
 	// would actually be slower by factor of 10.
@@ -242,6 +320,10 @@ static bool add_area_node_boxes(const v3s16 min, const v3s16 max, IGameDef *game
 		getNodeBlockPosWithOffset(p, bp, relp);
 		if (bp != last_bp) {
 			last_block = map->getBlockNoCreateNoEx(bp);
+			last_boxes = nullptr;
+			if (last_block && map->use_collision_cache &&
+					(air_walkable || !last_block->isAir()))
+				last_boxes = last_block->getCollisionBoxes();
 			last_bp = bp;
 		}
 		MapBlock *const block = last_block;
@@ -267,6 +349,37 @@ static bool add_area_node_boxes(const v3s16 min, const v3s16 max, IGameDef *game
 			continue;
 		}
 
+		if (last_boxes) {
+			const u16 i = relp.Z * MAP_BLOCKSIZE * MAP_BLOCKSIZE +
+				relp.Y * MAP_BLOCKSIZE + relp.X;
+			if (last_boxes->cubes[i]) {
+				any_position_valid = true;
+				aabb3f box = CUBE_BOX;
+				v3f posf = intToFloat(p, BS);
+				box.MinEdge += posf;
+				box.MaxEdge += posf;
+				cinfo.emplace_back(false, 0, p, box);
+				continue;
+			}
+			const auto *node = last_boxes->find(i);
+			if (!node) {
+				any_position_valid = true;
+				continue;
+			}
+			if (node->kind == BlockCollisionBoxes::NODE_IGNORE) {
+				// Collide with loaded CONTENT_IGNORE nodes
+				cinfo.emplace_back(true, 0, p, getNodeBox(p, BS));
+				continue;
+			}
+			any_position_valid = true;
+			if (node->kind == BlockCollisionBoxes::NODE_BOXES) {
+				const u32 end = last_boxes->boxesEnd(node);
+				for (u32 k = node->first_box; k < end; k++)
+					cinfo.emplace_back(false, node->bouncy, p, last_boxes->boxes[k]);
+				continue;
+			}
+		}
+
 		const MapNode n = block->getNodeNoCheck(relp);
 
 		if (n.getContent() != CONTENT_IGNORE) {
@@ -380,7 +493,7 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 		v3f accel_f, ActiveObject *self,
 		bool collide_with_objects)
 {
-	static bool time_notification_done = false;
+	static std::atomic<bool> time_notification_done(false);
 
 	ScopeProfiler sp(g_profiler, PROFILER_NAME("collisionMoveSimple()"), SPT_AVG, PRECISION_MICRO);
 
@@ -394,8 +507,7 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 		Calculate new velocity
 	*/
 	if (dtime > DTIME_LIMIT) {
-		if (!time_notification_done) {
-			time_notification_done = true;
+		if (!time_notification_done.exchange(true)) {
 			warningstream << "collisionMoveSimple: maximum step interval exceeded,"
 					" lost movement details!"<<std::endl;
 		}
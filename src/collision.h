@@ -5,12 +5,18 @@
 #pragma once
 
 #include "irrlichttypes_bloated.h"
+#include "constants.h"
+#include <atomic>
+#include <bitset>
+#include <memory>
 #include <vector>
 
 class Map;
+class MapBlock;
 class IGameDef;
 class Environment;
 class ActiveObject;
+class NodeDefManager;
 
 enum CollisionType : u8
 {
@@ -49,11 +55,57 @@ struct collisionMoveResult
 	std::vector<CollisionInfo> collisions;
 };
 
+/// Collision boxes of all nodes of a MapBlock, in world coordinates.
+/// Built on demand by MapBlock::getCollisionBoxes() and dropped whenever
+/// the content or param2 of a node of the block changes.
+/// Only nodes that can be collided with take up space.
+struct BlockCollisionBoxes
+{
+	enum NodeKind : u8 {
+		// CONTENT_IGNORE, collides like an unloaded node
+		NODE_IGNORE,
+		// the boxes from first_box to the first_box of the next node
+		NODE_BOXES,
+		// the boxes depend on the neighbors or the node doesn't fit into
+		// Node, so they are not cached
+		NODE_UNCACHED,
+	};
+
+	struct Node {
+		// indexed like MapBlock::getData()
+		u16 index;
+		u8 kind;
+		u8 bouncy;
+		u32 first_box;
+	};
+
+	static constexpr u32 nodecount = MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE;
+
+	// Full cubes without bounciness, the box follows from the position
+	std::bitset<nodecount> cubes;
+	// All other nodes with something to collide with, sorted by index
+	std::vector<Node> nodes;
+	std::vector<aabb3f> boxes;
+
+	/// @return the node, or nullptr if it's a cube or there's nothing there
+	const Node *find(u16 index) const;
+	u32 boxesEnd(const Node *node) const
+	{
+		return node + 1 == nodes.data() + nodes.size() ?
+			boxes.size() : node[1].first_box;
+	}
+
+	static std::unique_ptr<BlockCollisionBoxes> build(MapBlock *block,
+		const NodeDefManager *nodedef);
+};
+
 /// Status if any problems were ever encountered during collision detection.
 /// @warning For unit test use only.
-extern bool g_collision_problems_encountered;
+extern std::atomic<bool> g_collision_problems_encountered;
 
 /// @param self (optional) ActiveObject to ignore in the collision detection.
+/// Can be called from several threads at once as long as neither the map nor
+/// the active objects are modified meanwhile.
 collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 		const aabb3f &box_0,
 		f32 stepheight, f32 dtime,
@@ -0,0 +1,347 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#include "database-async.h"
+
+#include <algorithm>
+#include <chrono>
+#include "threading/mutex_auto_lock.h"
+#include "threading/thread.h"
+#include "debug.h"
+#include "log.h"
+#include "irrlicht_changes/printing.h"
+
+// Longest wait between attempts to commit after failures, in seconds
+static constexpr u32 MAX_RETRY_DELAY = 60;
+
+class MapDatabaseAsyncThread : public Thread
+{
+public:
+	MapDatabaseAsyncThread(MapDatabaseAsync *db) :
+		Thread("MapDatabaseIO"), m_db(db)
+	{}
+
+protected:
+	void *run()
+	{
+		BEGIN_DEBUG_EXCEPTION_HANDLER
+
+		while (m_db->commitQueued())
+			;
+
+		END_DEBUG_EXCEPTION_HANDLER
+
+		return nullptr;
+	}
+
+private:
+	MapDatabaseAsync *m_db;
+};
+
+MapDatabaseAsync::MapDatabaseAsync(MapDatabase *db, size_t max_queued_bytes) :
+	m_db(db),
+	m_max_queued_bytes(max_queued_bytes)
+{
+	sanity_check(db);
+	m_thread = std::make_unique<MapDatabaseAsyncThread>(this);
+	m_thread->start();
+}
+
+MapDatabaseAsync::~MapDatabaseAsync()
+{
+	{
+		MutexAutoLock lock(m_mutex);
+		// an unfinished save is still better than none
+		if (m_in_save)
+			enqueue(m_open, true);
+		m_in_save = false;
+		m_stop = true;
+	}
+	m_thread->stop();
+	m_cv_queued.notify_all();
+	m_cv_done.notify_all();
+	m_thread->wait();
+}
+
+void MapDatabaseAsync::beginSave()
+{
+	MutexAutoLock lock(m_mutex);
+	m_in_save = true;
+}
+
+void MapDatabaseAsync::endSave()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	enqueue(m_open, true);
+	m_in_save = false;
+	m_cv_queued.notify_one();
+	waitQueue(lock);
+}
+
+void MapDatabaseAsync::abortSave()
+{
+	MutexAutoLock lock(m_mutex);
+	m_open.clear();
+	m_in_save = false;
+}
+
+void MapDatabaseAsync::verifyDatabase()
+{
+	MutexAutoLock lock(m_db_mutex);
+	m_db->verifyDatabase();
+}
+
+bool MapDatabaseAsync::saveBlock(const v3s16 &pos, std::string_view data)
+{
+	write(pos, std::string(data));
+	return true;
+}
+
+bool MapDatabaseAsync::loadPending(const v3s16 &pos, std::string *block)
+{
+	// newest first
+	for (const WriteMap *map : {&m_open, &m_queued, &m_writing}) {
+		auto it = map->find(pos);
+		if (it == map->end())
+			continue;
+		if (it->second)
+			*block = *it->second;
+		else
+			block->clear();
+		return true;
+	}
+	return false;
+}
+
+void MapDatabaseAsync::loadBlock(const v3s16 &pos, std::string *block)
+{
+	{
+		MutexAutoLock lock(m_mutex);
+		if (loadPending(pos, block))
+			return;
+	}
+
+	MutexAutoLock lock(m_db_mutex);
+	m_db->loadBlock(pos, block);
+}
+
+void MapDatabaseAsync::loadBlocks(const std::vector<v3s16> &pos, const LoadCallback &cb)
+{
+	std::vector<v3s16> remaining;
+	std::vector<std::pair<v3s16, std::string>> pending;
+	{
+		MutexAutoLock lock(m_mutex);
+		std::string data;
+		for (const v3s16 &p : pos) {
+			if (loadPending(p, &data))
+				pending.emplace_back(p, std::move(data));
+			else
+				remaining.push_back(p);
+		}
+	}
+
+	// don't call back while locked
+	for (auto &it : pending)
+		cb(it.first, it.second);
+	if (remaining.empty())
+		return;
+
+	MutexAutoLock lock(m_db_mutex);
+	m_db->loadBlocks(remaining, cb);
+}
+
+// Answers from the pending writes or else from a handle of the backend
+class MapDatabaseAsync::ReadHandle : public MapDatabaseReadHandle
+{
+public:
+	ReadHandle(MapDatabaseAsync *db, std::unique_ptr<MapDatabaseReadHandle> handle) :
+		m_db(db), m_handle(std::move(handle))
+	{}
+
+	bool loadBlock(const v3s16 &pos, std::string *block)
+	{
+		{
+			MutexAutoLock lock(m_db->m_mutex);
+			if (m_db->loadPending(pos, block))
+				return true;
+		}
+		return m_handle->loadBlock(pos, block);
+	}
+
+	void loadBlocks(const std::vector<v3s16> &pos,
+		const MapDatabase::LoadCallback &cb, std::vector<v3s16> &unavailable)
+	{
+		std::vector<v3s16> remaining;
+		std::vector<std::pair<v3s16, std::string>> pending;
+		{
+			MutexAutoLock lock(m_db->m_mutex);
+			std::string data;
+			for (const v3s16 &p : pos) {
+				if (m_db->loadPending(p, &data))
+					pending.emplace_back(p, std::move(data));
+				else
+					remaining.push_back(p);
+			}
+		}
+
+		for (auto &it : pending)
+			cb(it.first, it.second);
+		if (!remaining.empty())
+			m_handle->loadBlocks(remaining, cb, unavailable);
+	}
+
+private:
+	MapDatabaseAsync *m_db;
+	std::unique_ptr<MapDatabaseReadHandle> m_handle;
+};
+
+std::unique_ptr<MapDatabaseReadHandle> MapDatabaseAsync::createReadHandle()
+{
+	std::unique_ptr<MapDatabaseReadHandle> handle;
+	{
+		MutexAutoLock lock(m_db_mutex);
+		handle = m_db->createReadHandle();
+	}
+	if (!handle)
+		return nullptr;
+	return std::make_unique<ReadHandle>(this, std::move(handle));
+}
+
+bool MapDatabaseAsync::deleteBlock(const v3s16 &pos)
+{
+	write(pos, std::nullopt);
+	return true;
+}
+
+void MapDatabaseAsync::listAllLoadableBlocks(std::vector<v3s16> &dst)
+{
+	flush();
+	MutexAutoLock lock(m_db_mutex);
+	m_db->listAllLoadableBlocks(dst);
+}
+
+void MapDatabaseAsync::flush()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_cv_done.wait(lock, [&] {
+		return m_stop || (m_queued.empty() && m_writing.empty());
+	});
+}
+
+void MapDatabaseAsync::write(const v3s16 &pos, std::optional<std::string> &&data)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (m_in_save) {
+		m_open[pos] = std::move(data);
+		return;
+	}
+
+	// not part of a save, so it counts as one on its own
+	WriteMap single;
+	single.emplace(pos, std::move(data));
+	enqueue(single, true);
+	m_cv_queued.notify_one();
+	waitQueue(lock);
+}
+
+void MapDatabaseAsync::enqueue(WriteMap &src, bool overwrite)
+{
+	for (auto &it : src) {
+		auto res = m_queued.try_emplace(it.first);
+		auto &dst = res.first->second;
+		if (!res.second) {
+			if (!overwrite)
+				continue;
+			m_queued_bytes -= dst ? dst->size() : 0;
+		}
+		dst = std::move(it.second);
+		m_queued_bytes += dst ? dst->size() : 0;
+	}
+	src.clear();
+}
+
+void MapDatabaseAsync::waitQueue(std::unique_lock<std::mutex> &lock)
+{
+	m_cv_done.wait(lock, [&] {
+		return m_stop || m_queued_bytes <= m_max_queued_bytes;
+	});
+}
+
+bool MapDatabaseAsync::commitQueued()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cv_queued.wait(lock, [&] { return m_stop || !m_queued.empty(); });
+		if (m_queued.empty())
+			return false;
+		// Everything that is queued consists of complete saves, so it can
+		// go into a single transaction.
+		m_writing.swap(m_queued);
+		m_queued_bytes = 0;
+	}
+	m_cv_done.notify_all();
+
+	const bool ok = commitWriting();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (ok) {
+		m_writing.clear();
+		m_retry_delay = 0;
+	} else if (m_stop) {
+		errorstream << "MapDatabaseAsync: giving up on writing "
+			<< m_writing.size() << " blocks" << std::endl;
+		m_writing.clear();
+	} else {
+		// newer writes take precedence
+		enqueue(m_writing, false);
+		// retry later, waiting longer after every failure
+		m_retry_delay = std::min(std::max(m_retry_delay * 2, 1U), MAX_RETRY_DELAY);
+		errorstream << "MapDatabaseAsync: retrying in " << m_retry_delay
+			<< " s" << std::endl;
+		m_cv_queued.wait_for(lock, std::chrono::seconds(m_retry_delay),
+			[&] { return m_stop; });
+	}
+	lock.unlock();
+	m_cv_done.notify_all();
+	return true;
+}
+
+bool MapDatabaseAsync::commitWriting()
+{
+	// The backend is locked for every call on its own, so that loads can
+	// happen in between.
+	bool in_save = false;
+	try {
+		{
+			MutexAutoLock lock(m_db_mutex);
+			m_db->beginSave();
+			in_save = true;
+		}
+		for (auto &it : m_writing) {
+			MutexAutoLock lock(m_db_mutex);
+			const bool ok = it.second ? m_db->saveBlock(it.first, *it.second) :
+				m_db->deleteBlock(it.first);
+			if (!ok) {
+				errorstream << "MapDatabaseAsync: failed to write block "
+					<< it.first << ", discarding " << m_writing.size()
+					<< " writes" << std::endl;
+				m_db->abortSave();
+				return false;
+			}
+		}
+		{
+			MutexAutoLock lock(m_db_mutex);
+			m_db->endSave();
+			in_save = false;
+		}
+	} catch (std::exception &e) {
+		errorstream << "MapDatabaseAsync: " << e.what() << std::endl;
+		if (in_save) {
+			MutexAutoLock lock(m_db_mutex);
+			m_db->abortSave();
+		}
+		return false;
+	}
+	return true;
+}
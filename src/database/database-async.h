@@ -0,0 +1,109 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include "database.h"
+#include "util/basic_macros.h"
+
+class MapDatabaseAsyncThread;
+
+/**
+ * Wraps another MapDatabase so that writes happen on a dedicated thread.
+ *
+ * Saves and deletions are queued and committed by the I/O thread in large
+ * transactions, using beginSave() and endSave() of the backend. Repeated
+ * saves of the same block are only written once, and loads of blocks with
+ * pending writes are answered from memory.
+ *
+ * Everything written between a beginSave() and endSave() of the caller is
+ * committed in the same transaction. For backends with transactions, the
+ * database therefore always reflects the state after some endSave() call,
+ * even after a crash. If any write of a transaction fails, it is rolled
+ * back and retried as a whole later.
+ *
+ * All methods are thread-safe.
+ */
+class MapDatabaseAsync : public MapDatabase
+{
+	friend class MapDatabaseAsyncThread;
+public:
+	/// @param db backend, ownership is taken
+	/// @param max_queued_bytes amount of queued data at which writers block
+	MapDatabaseAsync(MapDatabase *db, size_t max_queued_bytes);
+	~MapDatabaseAsync();
+
+	DISABLE_CLASS_COPY(MapDatabaseAsync)
+
+	void beginSave() override;
+	void endSave() override;
+	void abortSave() override;
+
+	bool initialized() const override { return m_db->initialized(); }
+	void verifyDatabase() override;
+
+	bool saveBlock(const v3s16 &pos, std::string_view data) override;
+	void loadBlock(const v3s16 &pos, std::string *block) override;
+	bool deleteBlock(const v3s16 &pos) override;
+	void loadBlocks(const std::vector<v3s16> &pos, const LoadCallback &cb) override;
+
+	/// @note only supported if the backend supports it
+	std::unique_ptr<MapDatabaseReadHandle> createReadHandle() override;
+
+	/// @note does not include writes of a save that has not ended yet
+	void listAllLoadableBlocks(std::vector<v3s16> &dst) override;
+
+	/// Waits until all queued writes have been committed.
+	void flush();
+
+private:
+	class ReadHandle;
+
+	// Block data, or nullopt for a deletion
+	typedef std::unordered_map<v3s16, std::optional<std::string>> WriteMap;
+
+	// Looks for a pending write, m_mutex must be locked
+	bool loadPending(const v3s16 &pos, std::string *block);
+	void write(const v3s16 &pos, std::optional<std::string> &&data);
+	// Moves writes into m_queued, which must be locked
+	void enqueue(WriteMap &src, bool overwrite);
+	// Blocks while too much data is queued
+	void waitQueue(std::unique_lock<std::mutex> &lock);
+
+	// Called by the I/O thread, returns false if it should give up
+	bool commitQueued();
+	// Writes m_writing to the backend in one transaction, which is
+	// discarded if any write fails
+	bool commitWriting();
+
+	std::unique_ptr<MapDatabase> m_db;
+	// The backend is not thread-safe, so calls to it are serialized
+	std::mutex m_db_mutex;
+
+	std::unique_ptr<MapDatabaseAsyncThread> m_thread;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv_queued;
+	std::condition_variable m_cv_done;
+	bool m_stop = false;
+	bool m_in_save = false;
+
+	// Writes of the save in progress (between beginSave() and endSave())
+	WriteMap m_open;
+	// Finished saves waiting for the I/O thread
+	WriteMap m_queued;
+	size_t m_queued_bytes = 0;
+	// Writes being committed by the I/O thread, it only reads this
+	// while unlocked
+	WriteMap m_writing;
+	// Seconds to wait before the next attempt after a failed commit
+	u32 m_retry_delay = 0;
+
+	const size_t m_max_queued_bytes;
+};
@@ -18,6 +18,7 @@
 #include "util/string.h"
 
 #include "leveldb/db.h"
+#include <algorithm>
 
 
 #define ENSURE_STATUS_OK(s) \
@@ -61,6 +62,57 @@ void Database_LevelDB::loadBlock(const v3s16 &pos, std::string *block)
 		block->clear();
 }
 
+void Database_LevelDB::loadBlocks(const std::vector<v3s16> &pos, const LoadCallback &cb)
+{
+	// LevelDB has no multi-get, but reading from one snapshot in key order
+	// keeps the lookups consistent and local.
+	std::vector<std::pair<std::string, v3s16>> keys;
+	keys.reserve(pos.size());
+	for (const v3s16 &p : pos)
+		keys.emplace_back(i64tos(getBlockAsInteger(p)), p);
+	std::sort(keys.begin(), keys.end(), [] (const auto &a, const auto &b) {
+		return a.first < b.first;
+	});
+
+	leveldb::ReadOptions options;
+	options.snapshot = m_database->GetSnapshot();
+	std::string data;
+	for (const auto &it : keys) {
+		leveldb::Status status = m_database->Get(options, it.first, &data);
+		if (!status.ok())
+			data.clear();
+		cb(it.second, data);
+	}
+	m_database->ReleaseSnapshot(options.snapshot);
+}
+
+// LevelDB reads are thread-safe and writes are visible right away
+class Database_LevelDB::ReadHandle : public MapDatabaseReadHandle
+{
+public:
+	ReadHandle(Database_LevelDB *db) : m_db(db) {}
+
+	bool loadBlock(const v3s16 &pos, std::string *block)
+	{
+		m_db->loadBlock(pos, block);
+		return true;
+	}
+
+	void loadBlocks(const std::vector<v3s16> &pos,
+		const MapDatabase::LoadCallback &cb, std::vector<v3s16> &unavailable)
+	{
+		m_db->loadBlocks(pos, cb);
+	}
+
+private:
+	Database_LevelDB *m_db;
+};
+
+std::unique_ptr<MapDatabaseReadHandle> Database_LevelDB::createReadHandle()
+{
+	return std::make_unique<ReadHandle>(this);
+}
+
 bool Database_LevelDB::deleteBlock(const v3s16 &pos)
 {
 	leveldb::Status status = m_database->Delete(leveldb::WriteOptions(),
@@ -22,12 +22,17 @@ class Database_LevelDB : public MapDatabase
 	bool saveBlock(const v3s16 &pos, std::string_view data);
 	void loadBlock(const v3s16 &pos, std::string *block);
 	bool deleteBlock(const v3s16 &pos);
+	void loadBlocks(const std::vector<v3s16> &pos, const LoadCallback &cb);
 	void listAllLoadableBlocks(std::vector<v3s16> &dst);
 
+	std::unique_ptr<MapDatabaseReadHandle> createReadHandle();
+
 	void beginSave() {}
 	void endSave() {}
 
 private:
+	class ReadHandle;
+
 	std::unique_ptr<leveldb::DB> m_database;
 };
 
@@ -0,0 +1,515 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#ifndef _WIN32
+
+#include "database-mmap.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "debug.h"
+#include "exceptions.h"
+#include "filesys.h"
+#include "log.h"
+#include "threading/mutex_auto_lock.h"
+#include "threading/thread.h"
+#include "util/serialize.h"
+
+/*
+	Segment file format:
+
+	u8[8] magic
+	Records until the end of the file:
+		u32 data size, or DELETED for a deleted block
+		s64 block position, see getBlockAsInteger()
+		u32 CRC-32 of the two fields above and the data
+		u8[] data
+*/
+
+namespace {
+
+constexpr char SEGMENT_MAGIC[8] = {'L', 'T', 'M', 'A', 'P', 'S', 'E', 'G'};
+constexpr size_t SEGMENT_HEADER_SIZE = sizeof(SEGMENT_MAGIC);
+constexpr size_t RECORD_HEADER_SIZE = 16;
+constexpr u32 DELETED = U32_MAX;
+
+// Sealed segments with less live data than this are compacted
+constexpr float COMPACT_LIVE_RATIO = 0.5f;
+// Records copied per locking of the database during compaction
+constexpr int COMPACT_BATCH = 256;
+
+inline size_t recordLength(u32 size)
+{
+	return RECORD_HEADER_SIZE + (size == DELETED ? 0 : size);
+}
+
+struct Record {
+	u32 size;
+	s64 pos;
+	const u8 *data;
+};
+
+// Returns the length of the record at offset, or 0 if there is no valid one
+size_t parseRecord(const u8 *base, size_t end, size_t offset, Record &rec)
+{
+	if (end - offset < RECORD_HEADER_SIZE)
+		return 0;
+	const u8 *p = base + offset;
+	rec.size = readU32(p);
+	rec.pos = readS64(p + 4);
+	rec.data = p + RECORD_HEADER_SIZE;
+	const size_t len = recordLength(rec.size);
+	if (end - offset < len)
+		return 0;
+	uLong crc = crc32(0, p, 12);
+	crc = crc32(crc, rec.data, len - RECORD_HEADER_SIZE);
+	if (crc != readU32(p + 12))
+		return 0;
+	return len;
+}
+
+bool writeAll(int fd, const char *data, size_t size, size_t offset)
+{
+	while (size > 0) {
+		ssize_t n = pwrite(fd, data, size, offset);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		data += n;
+		size -= n;
+		offset += n;
+	}
+	return true;
+}
+
+void syncFile(int fd)
+{
+#ifdef __linux__
+	int ret = fdatasync(fd);
+#else
+	int ret = fsync(fd);
+#endif
+	if (ret != 0)
+		throw DatabaseException(std::string("MapDatabaseMmap: sync failed: ")
+			+ strerror(errno));
+}
+
+}
+
+class MapDatabaseMmapThread : public Thread
+{
+public:
+	MapDatabaseMmapThread(MapDatabaseMmap *db) :
+		Thread("MapDatabaseCompact"), m_db(db)
+	{}
+
+protected:
+	void *run()
+	{
+		BEGIN_DEBUG_EXCEPTION_HANDLER
+
+		while (m_db->waitCompaction()) {
+			try {
+				while (m_db->compact())
+					;
+			} catch (DatabaseException &e) {
+				errorstream << e.what() << std::endl;
+			}
+		}
+
+		END_DEBUG_EXCEPTION_HANDLER
+
+		return nullptr;
+	}
+
+private:
+	MapDatabaseMmap *m_db;
+};
+
+MapDatabaseMmap::MapDatabaseMmap(const std::string &savedir, size_t segment_size) :
+	m_dir(savedir + DIR_DELIM + "map.segments"),
+	m_segment_size(segment_size)
+{
+	if (!fs::CreateAllDirs(m_dir))
+		throw DatabaseException("MapDatabaseMmap: failed to create " + m_dir);
+
+	std::vector<u32> ids;
+	for (const auto &node : fs::GetDirListing(m_dir)) {
+		if (node.dir || !str_starts_with(node.name, "seg-"))
+			continue;
+		// anything else is not ours
+		u32 id = strtoul(node.name.c_str() + 4, nullptr, 10);
+		if (id > 0 && segmentPath(id) == m_dir + DIR_DELIM + node.name)
+			ids.push_back(id);
+	}
+	std::sort(ids.begin(), ids.end());
+
+	try {
+		for (size_t i = 0; i < ids.size(); i++)
+			loadSegment(ids[i], i + 1 == ids.size());
+		if (m_segments.empty() ||
+				m_segments.rbegin()->second.size >= m_segment_size)
+			createSegment(0);
+		else
+			m_active = m_segments.rbegin()->first;
+	} catch (...) {
+		for (auto &it : m_segments)
+			closeSegment(it.second);
+		throw;
+	}
+
+	verbosestream << "MapDatabaseMmap: " << m_index.size() << " entries in "
+		<< m_segments.size() << " segments" << std::endl;
+
+	m_thread = std::make_unique<MapDatabaseMmapThread>(this);
+	m_thread->start();
+}
+
+MapDatabaseMmap::~MapDatabaseMmap()
+{
+	{
+		MutexAutoLock lock(m_mutex);
+		m_stop = true;
+	}
+	m_thread->stop();
+	m_cv.notify_all();
+	m_thread->wait();
+
+	try {
+		endSave();
+	} catch (DatabaseException &e) {
+		errorstream << e.what() << std::endl;
+	}
+	for (auto &it : m_segments)
+		closeSegment(it.second);
+}
+
+std::string MapDatabaseMmap::segmentPath(u32 id) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "seg-%06u.dat", id);
+	return m_dir + DIR_DELIM + name;
+}
+
+void MapDatabaseMmap::loadSegment(u32 id, bool last)
+{
+	const std::string path = segmentPath(id);
+	Segment seg;
+	seg.fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+	if (seg.fd < 0)
+		throw DatabaseException("MapDatabaseMmap: failed to open " + path
+			+ ": " + strerror(errno));
+
+	struct stat st;
+	if (fstat(seg.fd, &st) != 0 || st.st_size < (off_t)SEGMENT_HEADER_SIZE) {
+		// crashed while creating it
+		warningstream << "MapDatabaseMmap: removing incomplete " << path << std::endl;
+		close(seg.fd);
+		unlink(path.c_str());
+		return;
+	}
+	const size_t file_size = st.st_size;
+	mapSegment(seg, last ? std::max(file_size, m_segment_size) : file_size);
+	if (memcmp(seg.map, SEGMENT_MAGIC, SEGMENT_HEADER_SIZE) != 0) {
+		closeSegment(seg);
+		throw DatabaseException("MapDatabaseMmap: " + path + " is not a segment");
+	}
+
+	Segment &dst = m_segments[id] = seg;
+	size_t offset = SEGMENT_HEADER_SIZE;
+	Record rec;
+	while (size_t len = parseRecord(dst.map, file_size, offset, rec)) {
+		dst.size = offset + len;
+		indexRecord(rec.pos, id, offset, rec.size);
+		offset += len;
+	}
+	dst.size = offset;
+
+	if (offset < file_size) {
+		if (last) {
+			warningstream << "MapDatabaseMmap: discarding " << (file_size - offset)
+				<< " bytes of incomplete writes in " << path << std::endl;
+			if (ftruncate(dst.fd, offset) != 0)
+				throw DatabaseException("MapDatabaseMmap: failed to truncate "
+					+ path + ": " + strerror(errno));
+		} else {
+			// keep it for manual recovery, nothing is written to old segments
+			errorstream << "MapDatabaseMmap: " << path << " is corrupted at offset "
+				<< offset << ", ignoring the rest" << std::endl;
+		}
+	}
+}
+
+void MapDatabaseMmap::createSegment(size_t min_size)
+{
+	if (!m_segments.empty()) {
+		// the old one is sealed, so it's synced now rather than in endSave()
+		syncFile(m_segments.at(m_active).fd);
+		m_dirty = false;
+	}
+
+	const u32 id = m_segments.empty() ? 1 : m_segments.rbegin()->first + 1;
+	const std::string path = segmentPath(id);
+	Segment seg;
+	seg.fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (seg.fd < 0)
+		throw DatabaseException("MapDatabaseMmap: failed to create " + path
+			+ ": " + strerror(errno));
+	if (!writeAll(seg.fd, SEGMENT_MAGIC, SEGMENT_HEADER_SIZE, 0)) {
+		close(seg.fd);
+		unlink(path.c_str());
+		throw DatabaseException("MapDatabaseMmap: failed to write " + path
+			+ ": " + strerror(errno));
+	}
+	seg.size = SEGMENT_HEADER_SIZE;
+	mapSegment(seg, std::max(m_segment_size, SEGMENT_HEADER_SIZE + min_size));
+
+	m_segments[id] = seg;
+	m_active = id;
+	m_dir_dirty = true;
+}
+
+void MapDatabaseMmap::mapSegment(Segment &seg, size_t length)
+{
+	// Pages beyond the end of the file become readable as it grows, so the
+	// active segment is mapped only once.
+	void *map = mmap(nullptr, length, PROT_READ, MAP_SHARED, seg.fd, 0);
+	if (map == MAP_FAILED) {
+		int err = errno;
+		close(seg.fd);
+		seg.fd = -1;
+		throw DatabaseException(std::string("MapDatabaseMmap: mmap failed: ")
+			+ strerror(err));
+	}
+	seg.map = static_cast<const u8 *>(map);
+	seg.map_size = length;
+}
+
+void MapDatabaseMmap::closeSegment(Segment &seg)
+{
+	if (seg.map)
+		munmap(const_cast<u8 *>(seg.map), seg.map_size);
+	if (seg.fd >= 0)
+		close(seg.fd);
+	seg.map = nullptr;
+	seg.fd = -1;
+}
+
+void MapDatabaseMmap::indexRecord(s64 pos, u32 segment, u32 offset, u32 size)
+{
+	auto res = m_index.try_emplace(pos);
+	Location &loc = res.first->second;
+	if (!res.second)
+		m_segments.at(loc.segment).live -= recordLength(loc.size);
+	loc = {segment, offset, size};
+	m_segments.at(segment).live += recordLength(size);
+}
+
+bool MapDatabaseMmap::append(s64 pos, const u8 *data, u32 size)
+{
+	const size_t len = recordLength(size);
+	if (len > U32_MAX - SEGMENT_HEADER_SIZE) {
+		warningstream << "MapDatabaseMmap: block data is too large" << std::endl;
+		return false;
+	}
+
+	Segment *seg = &m_segments.at(m_active);
+	if (seg->size + len > seg->map_size) {
+		createSegment(len);
+		seg = &m_segments.at(m_active);
+	}
+
+	m_buf.resize(len);
+	u8 *p = reinterpret_cast<u8 *>(&m_buf[0]);
+	writeU32(p, size);
+	writeS64(p + 4, pos);
+	if (len > RECORD_HEADER_SIZE)
+		memcpy(p + RECORD_HEADER_SIZE, data, len - RECORD_HEADER_SIZE);
+	uLong crc = crc32(0, p, 12);
+	crc = crc32(crc, p + RECORD_HEADER_SIZE, len - RECORD_HEADER_SIZE);
+	writeU32(p + 12, crc);
+
+	// A failed write leaves garbage behind the end, which the next one
+	// overwrites.
+	if (!writeAll(seg->fd, m_buf.data(), len, seg->size)) {
+		warningstream << "MapDatabaseMmap: write failed: " << strerror(errno)
+			<< std::endl;
+		return false;
+	}
+
+	const u32 offset = seg->size;
+	seg->size += len;
+	indexRecord(pos, m_active, offset, size);
+	m_dirty = true;
+	return true;
+}
+
+void MapDatabaseMmap::endSave()
+{
+	{
+		MutexAutoLock lock(m_mutex);
+		if (m_dirty)
+			syncFile(m_segments.at(m_active).fd);
+		m_dirty = false;
+		if (m_dir_dirty) {
+			int fd = open(m_dir.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd >= 0) {
+				fsync(fd);
+				close(fd);
+			}
+			m_dir_dirty = false;
+		}
+		m_compact_requested = true;
+	}
+	m_cv.notify_one();
+}
+
+bool MapDatabaseMmap::saveBlock(const v3s16 &pos, std::string_view data)
+{
+	MutexAutoLock lock(m_mutex);
+	return append(getBlockAsInteger(pos),
+		reinterpret_cast<const u8 *>(data.data()), data.size());
+}
+
+void MapDatabaseMmap::loadBlock(const v3s16 &pos, std::string *block)
+{
+	MutexAutoLock lock(m_mutex);
+	auto it = m_index.find(getBlockAsInteger(pos));
+	if (it == m_index.end() || it->second.size == DELETED) {
+		block->clear();
+		return;
+	}
+	const Location &loc = it->second;
+	const u8 *data = m_segments.at(loc.segment).map + loc.offset + RECORD_HEADER_SIZE;
+	block->assign(reinterpret_cast<const char *>(data), loc.size);
+}
+
+void MapDatabaseMmap::loadBlocks(const std::vector<v3s16> &pos, const LoadCallback &cb)
+{
+	std::vector<std::string> results(pos.size());
+	for (size_t i = 0; i < pos.size(); i++)
+		loadBlock(pos[i], &results[i]);
+	for (size_t i = 0; i < pos.size(); i++)
+		cb(pos[i], results[i]);
+}
+
+bool MapDatabaseMmap::deleteBlock(const v3s16 &pos)
+{
+	MutexAutoLock lock(m_mutex);
+	const s64 key = getBlockAsInteger(pos);
+	auto it = m_index.find(key);
+	if (it == m_index.end() || it->second.size == DELETED)
+		return true;
+	return append(key, nullptr, DELETED);
+}
+
+void MapDatabaseMmap::listAllLoadableBlocks(std::vector<v3s16> &dst)
+{
+	MutexAutoLock lock(m_mutex);
+	dst.reserve(dst.size() + m_index.size());
+	for (const auto &it : m_index) {
+		if (it.second.size != DELETED)
+			dst.push_back(getIntegerAsBlock(it.first));
+	}
+}
+
+bool MapDatabaseMmap::compact()
+{
+	// Only one compaction at a time, the victim must not go away meanwhile
+	MutexAutoLock compact_lock(m_compact_mutex);
+	u32 victim = 0;
+	float best = COMPACT_LIVE_RATIO;
+	{
+		MutexAutoLock lock(m_mutex);
+		for (const auto &it : m_segments) {
+			const Segment &seg = it.second;
+			if (it.first == m_active)
+				continue;
+			float ratio = (float)seg.live / std::max<size_t>(seg.size, 1);
+			if (ratio < best) {
+				best = ratio;
+				victim = it.first;
+			}
+		}
+	}
+	if (victim == 0)
+		return false;
+	return compactSegment(victim);
+}
+
+bool MapDatabaseMmap::compactSegment(u32 victim)
+{
+	size_t offset = SEGMENT_HEADER_SIZE;
+	// Only compactions remove segments, so this stays valid.
+	bool oldest;
+	{
+		MutexAutoLock lock(m_mutex);
+		oldest = m_segments.begin()->first == victim;
+	}
+
+	// Copy in batches so that loads are not blocked for long.
+	// The victim is sealed, so its content doesn't change meanwhile.
+	for (;;) {
+		MutexAutoLock lock(m_mutex);
+		if (m_stop)
+			return false;
+		Segment &seg = m_segments.at(victim);
+		for (int n = 0; n < COMPACT_BATCH && offset < seg.size; n++) {
+			Record rec;
+			size_t len = parseRecord(seg.map, seg.size, offset, rec);
+			sanity_check(len > 0);
+			auto it = m_index.find(rec.pos);
+			if (it != m_index.end() && it->second.segment == victim &&
+					it->second.offset == offset) {
+				if (rec.size == DELETED && oldest) {
+					// no older record left that it could hide
+					m_index.erase(it);
+					seg.live -= len;
+				} else if (!append(rec.pos, rec.data, rec.size)) {
+					return false;
+				}
+			}
+			offset += len;
+		}
+		if (offset >= seg.size)
+			break;
+	}
+
+	MutexAutoLock lock(m_mutex);
+	// the copies must be on disk before the originals are gone
+	syncFile(m_segments.at(m_active).fd);
+	m_dirty = false;
+	Segment &seg = m_segments.at(victim);
+	closeSegment(seg);
+	const std::string path = segmentPath(victim);
+	if (unlink(path.c_str()) != 0) {
+		errorstream << "MapDatabaseMmap: failed to delete " << path << ": "
+			<< strerror(errno) << std::endl;
+	}
+	verbosestream << "MapDatabaseMmap: compacted " << path << std::endl;
+	m_segments.erase(victim);
+	m_dir_dirty = true;
+	return true;
+}
+
+bool MapDatabaseMmap::waitCompaction()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	// also check regularly, in case nobody calls endSave()
+	m_cv.wait_for(lock, std::chrono::seconds(30),
+		[&] { return m_stop || m_compact_requested; });
+	m_compact_requested = false;
+	return !m_stop;
+}
+
+#endif
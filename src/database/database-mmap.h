@@ -0,0 +1,125 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#pragma once
+
+#ifndef _WIN32
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "database.h"
+#include "util/basic_macros.h"
+
+class MapDatabaseMmapThread;
+
+/**
+ * Map database made of append-only segment files that are memory-mapped
+ * for reading.
+ *
+ * Every save appends a record to the newest segment and an in-memory index
+ * points to the latest record of each block, so loading is a lookup and a
+ * copy out of the page cache. The index is rebuilt from the segments on
+ * startup, a record that was cut off by a crash is discarded.
+ *
+ * Segments that consist mostly of outdated records are compacted by a
+ * background thread: the records that are still current are copied to the
+ * newest segment and the old file is deleted.
+ *
+ * All methods are thread-safe.
+ */
+class MapDatabaseMmap : public MapDatabase
+{
+	friend class MapDatabaseMmapThread;
+public:
+	// Every segment is mapped as a whole, so keep them small where address
+	// space is scarce
+	static constexpr size_t DEFAULT_SEGMENT_SIZE =
+		(sizeof(void *) >= 8 ? 64 : 16) * 1024 * 1024;
+
+	/// @param segment_size size at which a new segment is started
+	MapDatabaseMmap(const std::string &savedir,
+		size_t segment_size = DEFAULT_SEGMENT_SIZE);
+	~MapDatabaseMmap();
+
+	DISABLE_CLASS_COPY(MapDatabaseMmap)
+
+	void beginSave() override {}
+	/// Makes the writes so far durable
+	void endSave() override;
+
+	bool saveBlock(const v3s16 &pos, std::string_view data) override;
+	void loadBlock(const v3s16 &pos, std::string *block) override;
+	bool deleteBlock(const v3s16 &pos) override;
+	void loadBlocks(const std::vector<v3s16> &pos, const LoadCallback &cb) override;
+
+	void listAllLoadableBlocks(std::vector<v3s16> &dst) override;
+
+	/// Compacts one segment, if there is one with enough garbage.
+	/// This normally happens in the background, a call made meanwhile waits
+	/// for the background one to finish.
+	/// @return true if a segment was compacted
+	bool compact();
+
+private:
+	struct Segment {
+		int fd = -1;
+		// read-only mapping, it may extend beyond the end of the file
+		const u8 *map = nullptr;
+		size_t map_size = 0;
+		// end of the last record
+		size_t size = 0;
+		// bytes taken by records that are current
+		size_t live = 0;
+	};
+
+	// Where the current record of a block is
+	struct Location {
+		u32 segment;
+		u32 offset;
+		// data size, or DELETED for a deletion
+		u32 size;
+	};
+
+	std::string segmentPath(u32 id) const;
+	// Opens an existing segment and adds its records to the index
+	void loadSegment(u32 id, bool last);
+	// Starts a new active segment, big enough for at least min_size bytes
+	void createSegment(size_t min_size);
+	void mapSegment(Segment &seg, size_t length);
+	void closeSegment(Segment &seg);
+	// Updates the index for a record that was written or read
+	void indexRecord(s64 pos, u32 segment, u32 offset, u32 size);
+	// Writes a record, m_mutex must be locked
+	bool append(s64 pos, const u8 *data, u32 size);
+	// Copies a segment to the active one and deletes it
+	bool compactSegment(u32 victim);
+	// Waits until compaction should run, returns false on shutdown
+	bool waitCompaction();
+
+	const std::string m_dir;
+	const size_t m_segment_size;
+
+	std::mutex m_mutex;
+	// held for a whole compact(), locked before m_mutex
+	std::mutex m_compact_mutex;
+	std::condition_variable m_cv;
+	bool m_stop = false;
+	bool m_compact_requested = false;
+
+	// ordered by age, the last one is the active segment
+	std::map<u32, Segment> m_segments;
+	u32 m_active = 0;
+	std::unordered_map<s64, Location> m_index;
+	// unsynced writes to the active segment or the directory
+	bool m_dirty = false;
+	bool m_dir_dirty = false;
+	std::string m_buf;
+
+	std::unique_ptr<MapDatabaseMmapThread> m_thread;
+};
+
+#endif
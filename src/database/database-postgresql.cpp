@@ -20,7 +20,10 @@
 #include "settings.h"
 #include "remoteplayer.h"
 #include "server/player_sao.h"
+#include "util/string.h"
 #include <cstdlib>
+#include <cstring>
+#include <unordered_set>
 
 Database_PostgreSQL::Database_PostgreSQL(const std::string &connect_string,
 	const char *type) :
@@ -159,6 +162,41 @@ MapDatabasePostgreSQL::MapDatabasePostgreSQL(const std::string &connect_string):
 	connectToDatabase();
 }
 
+void MapDatabasePostgreSQL::beginSave()
+{
+	Database_PostgreSQL::beginSave();
+	std::lock_guard<std::mutex> lock(m_uncommitted_mutex);
+	m_in_save = true;
+}
+
+void MapDatabasePostgreSQL::endSave()
+{
+	Database_PostgreSQL::endSave();
+	std::lock_guard<std::mutex> lock(m_uncommitted_mutex);
+	m_in_save = false;
+	m_uncommitted.clear();
+}
+
+void MapDatabasePostgreSQL::abortSave()
+{
+	try {
+		rollback();
+	} catch (DatabaseException &e) {
+		// the connection is lost, the server ends the transaction with it
+		errorstream << e.what() << std::endl;
+	}
+	std::lock_guard<std::mutex> lock(m_uncommitted_mutex);
+	m_in_save = false;
+	m_uncommitted.clear();
+}
+
+void MapDatabasePostgreSQL::markUncommitted(const v3s16 &pos)
+{
+	std::lock_guard<std::mutex> lock(m_uncommitted_mutex);
+	if (m_in_save)
+		m_uncommitted.insert(pos);
+}
+
 
 void MapDatabasePostgreSQL::createDatabase()
 {
@@ -202,6 +240,14 @@ void MapDatabasePostgreSQL::initStatements()
 				"UPDATE SET data = $4::bytea");
 	}
 
+	// multi-argument unnest() needs 9.4
+	if (getPGVersion() >= 90400) {
+		prepareStatement("read_blocks",
+			"SELECT posX, posY, posZ, data FROM blocks "
+				"JOIN unnest($1::int4[], $2::int4[], $3::int4[]) AS p(x, y, z) "
+				"ON posX = p.x AND posY = p.y AND posZ = p.z");
+	}
+
 	prepareStatement("delete_block", "DELETE FROM blocks WHERE "
 		"posX = $1::int4 AND posY = $2::int4 AND posZ = $3::int4");
 
@@ -238,6 +284,7 @@ bool MapDatabasePostgreSQL::saveBlock(const v3s16 &pos, std::string_view data)
 	} else {
 		execPrepared("write_block", ARRLEN(args), args, argLen, argFmt);
 	}
+	markUncommitted(pos);
 	return true;
 }
 
@@ -279,10 +326,63 @@ bool MapDatabasePostgreSQL::deleteBlock(const v3s16 &pos)
 	const int argFmt[] = { 1, 1, 1 };
 
 	execPrepared("delete_block", ARRLEN(args), args, argLen, argFmt);
+	markUncommitted(pos);
 
 	return true;
 }
 
+void MapDatabasePostgreSQL::loadBlocks(const std::vector<v3s16> &pos,
+	const LoadCallback &cb)
+{
+	if (getPGVersion() < 90400) {
+		MapDatabase::loadBlocks(pos, cb);
+		return;
+	}
+
+	verifyDatabase();
+
+	// Positions are passed as array literals: {x1,x2,...}
+	std::string coords[3];
+	for (const v3s16 &p : pos) {
+		const s16 c[3] = {p.X, p.Y, p.Z};
+		for (int i = 0; i < 3; i++) {
+			coords[i].append(coords[i].empty() ? "{" : ",");
+			coords[i].append(itos(c[i]));
+		}
+	}
+	for (auto &it : coords)
+		it.append(it.empty() ? "{}" : "}");
+
+	const char *args[] = { coords[0].c_str(), coords[1].c_str(), coords[2].c_str() };
+
+	// results are in binary format
+	PGresult *results = execPrepared("read_blocks", ARRLEN(args), args, false);
+
+	auto to_int = [&] (int row, int col) -> s16 {
+		u32 v;
+		memcpy(&v, PQgetvalue(results, row, col), sizeof(v));
+		return (s32)ntohl(v);
+	};
+
+	std::unordered_set<v3s16> found;
+	std::string data;
+	const int numrows = PQntuples(results);
+	for (int row = 0; row < numrows; ++row) {
+		v3s16 p(to_int(row, 0), to_int(row, 1), to_int(row, 2));
+		data = pg_to_string(results, row, 3);
+		found.insert(p);
+		cb(p, data);
+	}
+
+	PQclear(results);
+
+	data.clear();
+	for (const v3s16 &p : pos) {
+		if (found.count(p) == 0)
+			cb(p, data);
+	}
+}
+
 void MapDatabasePostgreSQL::listAllLoadableBlocks(std::vector<v3s16> &dst)
 {
 	verifyDatabase();
@@ -298,6 +398,49 @@ void MapDatabasePostgreSQL::listAllLoadableBlocks(std::vector<v3s16> &dst)
 	PQclear(results);
 }
 
+// Reads through a connection of its own. Blocks written in the open
+// transaction are left to the database, since the connection can't see them.
+class MapDatabasePostgreSQL::ReadHandle : public MapDatabaseReadHandle
+{
+public:
+	ReadHandle(MapDatabasePostgreSQL *db) :
+		m_db(db), m_conn(db->getConnectString())
+	{}
+
+	bool loadBlock(const v3s16 &pos, std::string *block)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_db->m_uncommitted_mutex);
+			if (m_db->m_uncommitted.count(pos))
+				return false;
+		}
+		m_conn.loadBlock(pos, block);
+		return true;
+	}
+
+	void loadBlocks(const std::vector<v3s16> &pos,
+		const MapDatabase::LoadCallback &cb, std::vector<v3s16> &unavailable)
+	{
+		std::vector<v3s16> readable;
+		{
+			std::lock_guard<std::mutex> lock(m_db->m_uncommitted_mutex);
+			for (const v3s16 &p : pos)
+				(m_db->m_uncommitted.count(p) ? unavailable : readable).push_back(p);
+		}
+		if (!readable.empty())
+			m_conn.loadBlocks(readable, cb);
+	}
+
+private:
+	MapDatabasePostgreSQL *m_db;
+	MapDatabasePostgreSQL m_conn;
+};
+
+std::unique_ptr<MapDatabaseReadHandle> MapDatabasePostgreSQL::createReadHandle()
+{
+	return std::make_unique<ReadHandle>(this);
+}
+
 /*
  * Player Database
  */
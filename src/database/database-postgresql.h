@@ -4,7 +4,10 @@
 
 #pragma once
 
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_set>
 #include <libpq-fe.h>
 #include "database.h"
 #include "util/basic_macros.h"
@@ -84,6 +87,7 @@ class Database_PostgreSQL : public Database
 	}
 
 	int getPGVersion() const { return m_pgversion; }
+	const std::string &getConnectString() const { return m_connect_string; }
 
 private:
 	// Database connectivity checks
@@ -113,13 +117,30 @@ class MapDatabasePostgreSQL : private Database_PostgreSQL, public MapDatabase
 	bool saveBlock(const v3s16 &pos, std::string_view data);
 	void loadBlock(const v3s16 &pos, std::string *block);
 	bool deleteBlock(const v3s16 &pos);
+	void loadBlocks(const std::vector<v3s16> &pos, const LoadCallback &cb);
 	void listAllLoadableBlocks(std::vector<v3s16> &dst);
 
-	PARENT_CLASS_FUNCS
+	/// Opens another connection to the database
+	std::unique_ptr<MapDatabaseReadHandle> createReadHandle();
+
+	void beginSave();
+	void endSave();
+	void abortSave();
+	void verifyDatabase() { Database_PostgreSQL::verifyDatabase(); }
 
 protected:
 	virtual void createDatabase();
 	virtual void initStatements();
+
+private:
+	class ReadHandle;
+
+	void markUncommitted(const v3s16 &pos);
+
+	// Written in the open transaction, which other connections can't see yet
+	std::mutex m_uncommitted_mutex;
+	bool m_in_save = false;
+	std::unordered_set<v3s16> m_uncommitted;
 };
 
 class PlayerDatabasePostgreSQL : private Database_PostgreSQL, public PlayerDatabase
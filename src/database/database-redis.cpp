@@ -88,6 +88,17 @@ void Database_Redis::endSave()
 	freeReplyObject(reply);
 }
 
+void Database_Redis::abortSave()
+{
+	redisReply *reply = static_cast<redisReply *>(redisCommand(ctx, "DISCARD"));
+	if (!reply) {
+		errorstream << "Redis command 'DISCARD' failed: " << ctx->errstr
+			<< std::endl;
+		return;
+	}
+	freeReplyObject(reply);
+}
+
 bool Database_Redis::saveBlock(const v3s16 &pos, std::string_view data)
 {
 	std::string tmp = i64tos(getBlockAsInteger(pos));
@@ -172,6 +183,55 @@ bool Database_Redis::deleteBlock(const v3s16 &pos)
 	return true;
 }
 
+void Database_Redis::loadBlocks(const std::vector<v3s16> &pos, const LoadCallback &cb)
+{
+	if (pos.empty())
+		return;
+
+	// HMGET hash field...
+	std::vector<std::string> keys;
+	keys.reserve(pos.size());
+	for (const v3s16 &p : pos)
+		keys.push_back(i64tos(getBlockAsInteger(p)));
+	std::vector<const char *> argv;
+	std::vector<size_t> argvlen;
+	argv.reserve(keys.size() + 2);
+	argvlen.reserve(keys.size() + 2);
+	argv.push_back("HMGET");
+	argvlen.push_back(5);
+	argv.push_back(hash.c_str());
+	argvlen.push_back(hash.size());
+	for (const std::string &key : keys) {
+		argv.push_back(key.c_str());
+		argvlen.push_back(key.size());
+	}
+
+	redisReply *reply = static_cast<redisReply *>(redisCommandArgv(ctx,
+		argv.size(), argv.data(), argvlen.data()));
+	if (!reply) {
+		throw DatabaseException(std::string(
+			"Redis command 'HMGET %s ...' failed: ") + ctx->errstr);
+	}
+	if (reply->type != REDIS_REPLY_ARRAY || reply->elements != pos.size()) {
+		std::string errstr = reply->type == REDIS_REPLY_ERROR ?
+			std::string(reply->str, reply->len) : "invalid reply";
+		freeReplyObject(reply);
+		throw DatabaseException(std::string(
+			"Redis command 'HMGET %s ...' errored: ") + errstr);
+	}
+
+	std::string data;
+	for (size_t i = 0; i < pos.size(); i++) {
+		const redisReply *elem = reply->element[i];
+		if (elem->type == REDIS_REPLY_STRING)
+			data.assign(elem->str, elem->len);
+		else
+			data.clear();
+		cb(pos[i], data);
+	}
+	freeReplyObject(reply);
+}
+
 void Database_Redis::listAllLoadableBlocks(std::vector<v3s16> &dst)
 {
 	redisReply *reply = static_cast<redisReply *>(redisCommand(ctx, "HKEYS %s", hash.c_str()));
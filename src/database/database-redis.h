@@ -22,10 +22,12 @@ class Database_Redis : public MapDatabase
 
 	void beginSave();
 	void endSave();
+	void abortSave();
 
 	bool saveBlock(const v3s16 &pos, std::string_view data);
 	void loadBlock(const v3s16 &pos, std::string *block);
 	bool deleteBlock(const v3s16 &pos);
+	void loadBlocks(const std::vector<v3s16> &pos, const LoadCallback &cb);
 	void listAllLoadableBlocks(std::vector<v3s16> &dst);
 
 private:
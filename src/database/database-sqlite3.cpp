@@ -13,7 +13,9 @@
 #include "remoteplayer.h"
 #include "irrlicht_changes/printing.h"
 #include "server/player_sao.h"
+#include "threading/mutex_auto_lock.h"
 
+#include <algorithm>
 #include <cassert>
 
 // When to print messages when the database is being held locked by another process
@@ -106,11 +108,23 @@ void Database_SQLite3::endSave()
 	sqlite3_reset(m_stmt_end);
 }
 
+void Database_SQLite3::rollback()
+{
+	// some errors already roll back the transaction on their own
+	if (!m_database || sqlite3_get_autocommit(m_database))
+		return;
+	if (sqlite3_step(m_stmt_rollback) != SQLITE_DONE) {
+		errorstream << "Failed to roll back SQLite3 transaction: "
+			<< sqlite3_errmsg(m_database) << std::endl;
+	}
+	sqlite3_reset(m_stmt_rollback);
+}
+
 void Database_SQLite3::openDatabase()
 {
 	if (m_database) return;
 
-	std::string dbp = m_savedir + DIR_DELIM + m_dbname + ".sqlite";
+	std::string dbp = getDatabasePath();
 
 	// Open the database connection
 
@@ -143,6 +157,13 @@ void Database_SQLite3::openDatabase()
 		"Failed to set SQLite3 synchronous mode");
 	SQLOK(sqlite3_exec(m_database, "PRAGMA foreign_keys = ON", NULL, NULL, NULL),
 		"Failed to enable SQLite3 foreign key support");
+
+	configureDatabase();
+}
+
+std::string Database_SQLite3::getDatabasePath() const
+{
+	return m_savedir + DIR_DELIM + m_dbname + ".sqlite";
 }
 
 void Database_SQLite3::verifyDatabase()
@@ -153,6 +174,7 @@ void Database_SQLite3::verifyDatabase()
 
 	PREPARE_STATEMENT(begin, "BEGIN;");
 	PREPARE_STATEMENT(end, "COMMIT;");
+	PREPARE_STATEMENT(rollback, "ROLLBACK;");
 
 	initStatements();
 
@@ -200,6 +222,7 @@ Database_SQLite3::~Database_SQLite3()
 {
 	FINALIZE_STATEMENT(begin)
 	FINALIZE_STATEMENT(end)
+	FINALIZE_STATEMENT(rollback)
 
 	SQLOK_ERRSTREAM(sqlite3_close(m_database), "Failed to close database");
 }
@@ -208,20 +231,101 @@ Database_SQLite3::~Database_SQLite3()
  * Map database
  */
 
-MapDatabaseSQLite3::MapDatabaseSQLite3(const std::string &savedir):
+MapDatabaseSQLite3::MapDatabaseSQLite3(const std::string &savedir,
+		bool high_throughput, u32 cache_size):
 	Database_SQLite3(savedir, "map"),
-	MapDatabase()
+	MapDatabase(),
+	m_high_throughput(high_throughput),
+	m_cache_size(cache_size)
 {
 }
 
 MapDatabaseSQLite3::~MapDatabaseSQLite3()
 {
 	FINALIZE_STATEMENT(read)
+	FINALIZE_STATEMENT(read_many)
 	FINALIZE_STATEMENT(write)
 	FINALIZE_STATEMENT(list)
 	FINALIZE_STATEMENT(delete)
 }
 
+MapDatabaseSQLite3::ReadConnection::~ReadConnection()
+{
+	if (stmt_read)
+		sqlite3_finalize(stmt_read);
+	if (stmt_read_many)
+		sqlite3_finalize(stmt_read_many);
+	if (db && sqlite3_close(db) != SQLITE_OK) {
+		errorstream << "Failed to close database read connection: "
+			<< sqlite3_errmsg(db) << std::endl;
+	}
+}
+
+void MapDatabaseSQLite3::configureDatabase()
+{
+	if (m_high_throughput) {
+		// Readers and the writer don't block each other in WAL mode.
+		// This setting is stored in the database file.
+		SQLOK(sqlite3_exec(m_database, "PRAGMA journal_mode = WAL", NULL, NULL, NULL),
+			"Failed to enable SQLite3 WAL mode");
+	} else {
+		// Leave WAL mode again if it was enabled before, so that the
+		// -wal and -shm files go away. Nothing happens if it wasn't.
+		SQLOK_ERRSTREAM(sqlite3_exec(m_database, "PRAGMA journal_mode = DELETE",
+			NULL, NULL, NULL), "Failed to disable SQLite3 WAL mode");
+	}
+	tuneConnection(m_database);
+}
+
+void MapDatabaseSQLite3::tuneConnection(sqlite3 *db)
+{
+	if (m_cache_size > 0) {
+		// negative means KiB instead of pages
+		std::string query_str = "PRAGMA cache_size = -" + itos(m_cache_size);
+		SQLOK(sqlite3_exec(db, query_str.c_str(), NULL, NULL, NULL),
+			"Failed to set SQLite3 cache size");
+	}
+	if (m_high_throughput) {
+		std::string query_str = "PRAGMA mmap_size = " + std::to_string(MMAP_SIZE);
+		SQLOK(sqlite3_exec(db, query_str.c_str(), NULL, NULL, NULL),
+			"Failed to set SQLite3 mmap size");
+	}
+}
+
+std::unique_ptr<MapDatabaseSQLite3::ReadConnection> MapDatabaseSQLite3::openReadConnection()
+{
+	auto conn = std::make_unique<ReadConnection>();
+
+	// Opened writable, since a read-only connection can't always set up the
+	// shared memory of WAL mode. query_only makes sure it only reads.
+	auto flags = SQLITE_OPEN_READWRITE;
+#ifdef SQLITE_OPEN_EXRESCODE
+	flags |= SQLITE_OPEN_EXRESCODE;
+#endif
+	// like SQLOK, but with the error of this connection
+	auto check = [&] (int s, const std::string &m) {
+		if (s != SQLITE_OK)
+			throw DatabaseException(m + ": " + sqlite3_errmsg(conn->db));
+	};
+
+	const std::string dbp = getDatabasePath();
+	check(sqlite3_open_v2(dbp.c_str(), &conn->db, flags, NULL),
+		"Failed to open SQLite3 database file " + dbp);
+	check(sqlite3_busy_handler(conn->db, Database_SQLite3::busyHandler,
+		conn->busy_handler_data), "Failed to set SQLite3 busy handler");
+	check(sqlite3_exec(conn->db, "PRAGMA query_only = ON", NULL, NULL, NULL),
+		"Failed to make SQLite3 read connection read-only");
+	tuneConnection(conn->db);
+
+	check(sqlite3_prepare_v2(conn->db, m_query_read.c_str(), -1,
+		&conn->stmt_read, NULL),
+		"Failed to prepare query \"" + m_query_read + "\"");
+	check(sqlite3_prepare_v2(conn->db, m_query_read_many.c_str(), -1,
+		&conn->stmt_read_many, NULL),
+		"Failed to prepare query \"" + m_query_read_many + "\"");
+	return conn;
+}
+
 
 void MapDatabaseSQLite3::createDatabase()
 {
@@ -254,17 +358,40 @@ void MapDatabaseSQLite3::initStatements()
 	infostream << "MapDatabaseSQLite3: split column format = "
 		<< (m_new_format ? "yes" : "no") << std::endl;
 
+	std::string &read = m_query_read;
 	if (m_new_format) {
-		PREPARE_STATEMENT(read, "SELECT `data` FROM `blocks` WHERE `x` = ? AND `y` = ? AND `z` = ? LIMIT 1");
+		read = "SELECT `data` FROM `blocks` WHERE `x` = ? AND `y` = ? AND `z` = ? LIMIT 1";
 		PREPARE_STATEMENT(write, "REPLACE INTO `blocks` (`x`, `y`, `z`, `data`) VALUES (?, ?, ?, ?)");
 		PREPARE_STATEMENT(delete, "DELETE FROM `blocks` WHERE `x` = ? AND `y` = ? AND `z` = ?");
 		PREPARE_STATEMENT(list, "SELECT `x`, `y`, `z` FROM `blocks`");
 	} else {
-		PREPARE_STATEMENT(read, "SELECT `data` FROM `blocks` WHERE `pos` = ? LIMIT 1");
+		read = "SELECT `data` FROM `blocks` WHERE `pos` = ? LIMIT 1";
 		PREPARE_STATEMENT(write, "REPLACE INTO `blocks` (`pos`, `data`) VALUES (?, ?)");
 		PREPARE_STATEMENT(delete, "DELETE FROM `blocks` WHERE `pos` = ?");
 		PREPARE_STATEMENT(list, "SELECT `pos` FROM `blocks`");
 	}
+	PREPARE_STATEMENT(read, read.c_str());
+
+	// Bulk read of READ_MANY_COUNT positions
+	std::string &read_many = m_query_read_many;
+	if (m_new_format) {
+		// (x, y, z) IN (...) would need SQLite 3.15, this is optimized just as well
+		read_many = "SELECT `x`, `y`, `z`, `data` FROM `blocks` WHERE ";
+		for (int i = 0; i < READ_MANY_COUNT; i++) {
+			if (i)
+				read_many += " OR ";
+			read_many += "`x` = ? AND `y` = ? AND `z` = ?";
+		}
+	} else {
+		read_many = "SELECT `pos`, `data` FROM `blocks` WHERE `pos` IN (";
+		for (int i = 0; i < READ_MANY_COUNT; i++)
+			read_many += i ? ", ?" : "?";
+		read_many += ")";
+	}
+	PREPARE_STATEMENT(read_many, read_many.c_str());
+
+	if (m_high_throughput)
+		m_read = openReadConnection();
 }
 
 inline int MapDatabaseSQLite3::bindPos(sqlite3_stmt *stmt, v3s16 pos, int index)
@@ -280,9 +407,51 @@ inline int MapDatabaseSQLite3::bindPos(sqlite3_stmt *stmt, v3s16 pos, int index)
 	}
 }
 
+void MapDatabaseSQLite3::beginSave()
+{
+	MutexAutoLock lock(m_mutex);
+	Database_SQLite3::beginSave();
+	m_in_save = true;
+}
+
+void MapDatabaseSQLite3::endSave()
+{
+	MutexAutoLock lock(m_mutex);
+	Database_SQLite3::endSave();
+	m_in_save = false;
+	m_uncommitted.clear();
+}
+
+void MapDatabaseSQLite3::abortSave()
+{
+	MutexAutoLock lock(m_mutex);
+	rollback();
+	m_in_save = false;
+	m_uncommitted.clear();
+}
+
+inline void MapDatabaseSQLite3::markUncommitted(const v3s16 &pos)
+{
+	if (m_in_save && m_high_throughput)
+		m_uncommitted.insert(pos);
+}
+
+inline bool MapDatabaseSQLite3::canUseReadConnection(const v3s16 &pos) const
+{
+	return m_high_throughput && m_uncommitted.find(pos) == m_uncommitted.end();
+}
+
+void MapDatabaseSQLite3::splitByReadConnection(const std::vector<v3s16> &pos,
+	std::vector<v3s16> &readable, std::vector<v3s16> &uncommitted) const
+{
+	for (const v3s16 &p : pos)
+		(canUseReadConnection(p) ? readable : uncommitted).push_back(p);
+}
+
 bool MapDatabaseSQLite3::deleteBlock(const v3s16 &pos)
 {
 	verifyDatabase();
+	MutexAutoLock lock(m_mutex);
 
 	bindPos(m_stmt_delete, pos);
 
@@ -293,18 +462,21 @@ bool MapDatabaseSQLite3::deleteBlock(const v3s16 &pos)
 		warningstream << "deleteBlock: Failed to delete block "
 			<< pos << ": " << sqlite3_errmsg(m_database) << std::endl;
 	}
+	markUncommitted(pos);
 	return good;
 }
 
 bool MapDatabaseSQLite3::saveBlock(const v3s16 &pos, std::string_view data)
 {
 	verifyDatabase();
+	MutexAutoLock lock(m_mutex);
 
 	int col = bindPos(m_stmt_write, pos);
 	blob_to_sqlite(m_stmt_write, col, data);
 
 	SQLRES(sqlite3_step(m_stmt_write), SQLITE_DONE, "Failed to save block")
 	sqlite3_reset(m_stmt_write);
+	markUncommitted(pos);
 
 	return true;
 }
@@ -312,25 +484,161 @@ bool MapDatabaseSQLite3::saveBlock(const v3s16 &pos, std::string_view data)
 void MapDatabaseSQLite3::loadBlock(const v3s16 &pos, std::string *block)
 {
 	verifyDatabase();
+	{
+		MutexAutoLock lock(m_mutex);
+		if (!canUseReadConnection(pos)) {
+			readBlock(m_stmt_read, pos, block);
+			return;
+		}
+	}
 
-	bindPos(m_stmt_read, pos);
+	MutexAutoLock lock(m_read_mutex);
+	readBlock(m_read->stmt_read, pos, block);
+}
 
-	if (sqlite3_step(m_stmt_read) != SQLITE_ROW) {
+void MapDatabaseSQLite3::loadBlocks(const std::vector<v3s16> &pos, const LoadCallback &cb)
+{
+	verifyDatabase();
+	const std::vector<v3s16> *remaining = &pos;
+	std::vector<v3s16> split;
+	{
+		MutexAutoLock lock(m_mutex);
+		if (!m_high_throughput) {
+			readBlocks(m_stmt_read_many, pos, cb);
+			return;
+		}
+		if (!m_uncommitted.empty()) {
+			std::vector<v3s16> uncommitted;
+			splitByReadConnection(pos, split, uncommitted);
+			if (!uncommitted.empty())
+				readBlocks(m_stmt_read_many, uncommitted, cb);
+			remaining = &split;
+		}
+	}
+	if (remaining->empty())
+		return;
+
+	MutexAutoLock lock(m_read_mutex);
+	readBlocks(m_read->stmt_read_many, *remaining, cb);
+}
+
+/*
+ * Read handle
+ */
+
+// Reads through a connection of its own. Blocks written in the open
+// transaction are left to the database, since the connection can't see them.
+class MapDatabaseSQLite3::ReadHandle : public MapDatabaseReadHandle
+{
+public:
+	ReadHandle(MapDatabaseSQLite3 *db) :
+		m_db(db), m_conn(db->openReadConnection())
+	{}
+
+	bool loadBlock(const v3s16 &pos, std::string *block)
+	{
+		{
+			MutexAutoLock lock(m_db->m_mutex);
+			if (!m_db->canUseReadConnection(pos))
+				return false;
+		}
+		m_db->readBlock(m_conn->stmt_read, pos, block);
+		return true;
+	}
+
+	void loadBlocks(const std::vector<v3s16> &pos,
+		const MapDatabase::LoadCallback &cb, std::vector<v3s16> &unavailable)
+	{
+		std::vector<v3s16> readable;
+		{
+			MutexAutoLock lock(m_db->m_mutex);
+			m_db->splitByReadConnection(pos, readable, unavailable);
+		}
+		if (!readable.empty())
+			m_db->readBlocks(m_conn->stmt_read_many, readable, cb);
+	}
+
+private:
+	MapDatabaseSQLite3 *m_db;
+	std::unique_ptr<ReadConnection> m_conn;
+};
+
+std::unique_ptr<MapDatabaseReadHandle> MapDatabaseSQLite3::createReadHandle()
+{
+	verifyDatabase();
+	// without WAL mode readers would wait for the writer anyway
+	if (!m_high_throughput)
+		return nullptr;
+	return std::make_unique<ReadHandle>(this);
+}
+
+void MapDatabaseSQLite3::readBlock(sqlite3_stmt *stmt, const v3s16 &pos, std::string *block)
+{
+	bindPos(stmt, pos);
+
+	if (sqlite3_step(stmt) != SQLITE_ROW) {
 		block->clear();
-		sqlite3_reset(m_stmt_read);
+		sqlite3_reset(stmt);
 		return;
 	}
 
-	auto data = sqlite_to_blob(m_stmt_read, 0);
+	auto data = sqlite_to_blob(stmt, 0);
 	block->assign(data);
 
 	// We should never get more than 1 row, so ok to reset
-	sqlite3_reset(m_stmt_read);
+	sqlite3_reset(stmt);
+}
+
+void MapDatabaseSQLite3::readBlocks(sqlite3_stmt *stmt, const std::vector<v3s16> &pos,
+	const LoadCallback &cb)
+{
+	std::string data;
+	bool found[READ_MANY_COUNT];
+	for (size_t start = 0; start < pos.size(); start += READ_MANY_COUNT) {
+		const size_t count = std::min<size_t>(pos.size() - start, READ_MANY_COUNT);
+		const v3s16 *batch = &pos[start];
+
+		// unused parameters are filled with duplicates
+		int col = 1;
+		for (int i = 0; i < READ_MANY_COUNT; i++)
+			col = bindPos(stmt, batch[std::min<size_t>(i, count - 1)], col);
+
+		std::fill(found, found + count, false);
+		while (sqlite3_step(stmt) == SQLITE_ROW) {
+			v3s16 p;
+			int data_col;
+			if (m_new_format) {
+				p.X = sqlite_to_int(stmt, 0);
+				p.Y = sqlite_to_int(stmt, 1);
+				p.Z = sqlite_to_int(stmt, 2);
+				data_col = 3;
+			} else {
+				p = getIntegerAsBlock(sqlite_to_int64(stmt, 0));
+				data_col = 1;
+			}
+			for (size_t i = 0; i < count; i++) {
+				if (batch[i] == p && !found[i]) {
+					found[i] = true;
+					data.assign(sqlite_to_blob(stmt, data_col));
+					cb(p, data);
+					break;
+				}
+			}
+		}
+		sqlite3_reset(stmt);
+
+		data.clear();
+		for (size_t i = 0; i < count; i++) {
+			if (!found[i])
+				cb(batch[i], data);
+		}
+	}
 }
 
 void MapDatabaseSQLite3::listAllLoadableBlocks(std::vector<v3s16> &dst)
 {
 	verifyDatabase();
+	MutexAutoLock lock(m_mutex);
 
 	v3s16 p;
 	while (sqlite3_step(m_stmt_list) == SQLITE_ROW) {
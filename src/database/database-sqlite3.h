@@ -5,7 +5,10 @@
 #pragma once
 
 #include <cstring>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_set>
 #include "database.h"
 #include "exceptions.h"
 
@@ -21,6 +24,8 @@ class Database_SQLite3 : public Database
 
 	void beginSave() override;
 	void endSave() override;
+	// Rolls back the open transaction, if any
+	void rollback();
 
 	bool initialized() const override { return m_initialized; }
 
@@ -141,6 +146,14 @@ class Database_SQLite3 : public Database
 	// Should prepare the necessary statements.
 	virtual void initStatements() = 0;
 
+	// Called after opening the database, for additional PRAGMAs.
+	virtual void configureDatabase() {}
+
+	// Path of the database file
+	std::string getDatabasePath() const;
+
+	static int busyHandler(void *data, int count);
+
 	sqlite3 *m_database = nullptr;
 
 private:
@@ -154,10 +167,9 @@ class Database_SQLite3 : public Database
 
 	sqlite3_stmt *m_stmt_begin = nullptr;
 	sqlite3_stmt *m_stmt_end = nullptr;
+	sqlite3_stmt *m_stmt_rollback = nullptr;
 
 	u64 m_busy_handler_data[2];
-
-	static int busyHandler(void *data, int count);
 };
 
 // Not sure why why we have to do this. can't C++ figure it out on its own?
@@ -169,31 +181,92 @@ class Database_SQLite3 : public Database
 class MapDatabaseSQLite3 : private Database_SQLite3, public MapDatabase
 {
 public:
-	MapDatabaseSQLite3(const std::string &savedir);
+	/// @param high_throughput use WAL, memory-mapped I/O and a second
+	///        connection for loads, so that they don't wait for writes
+	/// @param cache_size page cache size in KiB, 0 for the SQLite default
+	/// @note thread-safe once verifyDatabase() was called
+	MapDatabaseSQLite3(const std::string &savedir, bool high_throughput = false,
+		u32 cache_size = 0);
 	virtual ~MapDatabaseSQLite3();
 
 	bool saveBlock(const v3s16 &pos, std::string_view data);
 	void loadBlock(const v3s16 &pos, std::string *block);
 	bool deleteBlock(const v3s16 &pos);
+	void loadBlocks(const std::vector<v3s16> &pos, const LoadCallback &cb);
 	void listAllLoadableBlocks(std::vector<v3s16> &dst);
 
-	PARENT_CLASS_FUNCS
+	/// @note only supported in high-throughput mode
+	std::unique_ptr<MapDatabaseReadHandle> createReadHandle();
+
+	void beginSave();
+	void endSave();
+	void abortSave();
+	void verifyDatabase() { Database_SQLite3::verifyDatabase(); }
 
 protected:
 	virtual void createDatabase();
 	virtual void initStatements();
+	virtual void configureDatabase();
 
 private:
+	class ReadHandle;
+
+	// Connection that only reads (high-throughput mode only)
+	struct ReadConnection {
+		sqlite3 *db = nullptr;
+		sqlite3_stmt *stmt_read = nullptr;
+		sqlite3_stmt *stmt_read_many = nullptr;
+		u64 busy_handler_data[2];
+
+		~ReadConnection();
+	};
+
+	// Number of positions per query in loadBlocks()
+	static constexpr int READ_MANY_COUNT = 32;
+	// Size of the memory mapping in high-throughput mode
+	static constexpr u64 MMAP_SIZE = 256 * 1024 * 1024;
+
 	/// @brief Bind block position into statement at column index
 	/// @return index of next column after position
 	int bindPos(sqlite3_stmt *stmt, v3s16 pos, int index = 1);
 
+	// Sets the per-connection PRAGMAs
+	void tuneConnection(sqlite3 *db);
+	std::unique_ptr<ReadConnection> openReadConnection();
+
+	void readBlock(sqlite3_stmt *stmt, const v3s16 &pos, std::string *block);
+	void readBlocks(sqlite3_stmt *stmt, const std::vector<v3s16> &pos,
+		const LoadCallback &cb);
+	// Whether a load can use a read connection, m_mutex must be locked
+	bool canUseReadConnection(const v3s16 &pos) const;
+	// Splits positions by canUseReadConnection(), m_mutex must be locked
+	void splitByReadConnection(const std::vector<v3s16> &pos,
+		std::vector<v3s16> &readable, std::vector<v3s16> &uncommitted) const;
+	void markUncommitted(const v3s16 &pos);
+
+	const bool m_high_throughput;
+	const u32 m_cache_size;
 	bool m_new_format = false;
 
+	// Protects the main connection and the members below
+	std::mutex m_mutex;
+	bool m_in_save = false;
+	// Written in the open transaction, which read connections can't see yet
+	std::unordered_set<v3s16> m_uncommitted;
+
 	sqlite3_stmt *m_stmt_read = nullptr;
+	sqlite3_stmt *m_stmt_read_many = nullptr;
 	sqlite3_stmt *m_stmt_write = nullptr;
 	sqlite3_stmt *m_stmt_list = nullptr;
 	sqlite3_stmt *m_stmt_delete = nullptr;
+
+	// Queries of read connections
+	std::string m_query_read;
+	std::string m_query_read_many;
+
+	// Read connection used by loads (high-throughput mode only)
+	std::mutex m_read_mutex;
+	std::unique_ptr<ReadConnection> m_read;
 };
 
 class PlayerDatabaseSQLite3 : private Database_SQLite3, public PlayerDatabase
@@ -27,3 +27,27 @@ v3s16 MapDatabase::getIntegerAsBlock(s64 i)
 	         (s16)(((i >> 12) & 0xFFF) - 0x800),
 	         (s16)(((i >> 24) & 0xFFF) - 0x800) };
 }
+
+
+void MapDatabase::loadBlocks(const std::vector<v3s16> &pos, const LoadCallback &cb)
+{
+	std::string data;
+	for (const v3s16 &p : pos) {
+		data.clear();
+		loadBlock(p, &data);
+		cb(p, data);
+	}
+}
+
+void MapDatabaseReadHandle::loadBlocks(const std::vector<v3s16> &pos,
+	const MapDatabase::LoadCallback &cb, std::vector<v3s16> &unavailable)
+{
+	std::string data;
+	for (const v3s16 &p : pos) {
+		data.clear();
+		if (loadBlock(p, &data))
+			cb(p, data);
+		else
+			unavailable.push_back(p);
+	}
+}
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -24,6 +26,8 @@ class Database
 	virtual void verifyDatabase() {};
 };
 
+class MapDatabaseReadHandle;
+
 class MapDatabase : public Database
 {
 public:
@@ -33,10 +37,47 @@ class MapDatabase : public Database
 	virtual void loadBlock(const v3s16 &pos, std::string *block) = 0;
 	virtual bool deleteBlock(const v3s16 &pos) = 0;
 
+	/// Ends a save and discards its writes if the backend has transactions,
+	/// otherwise the same as endSave(). Must not throw.
+	virtual void abortSave() { endSave(); }
+
+	/// Called once for every requested position, with empty data if the
+	/// block doesn't exist. The data may be moved out.
+	typedef std::function<void(const v3s16 &pos, std::string &data)> LoadCallback;
+
+	/// Loads several blocks, with fewer queries than calling loadBlock() for
+	/// each if the backend supports it. Callbacks happen in no particular order.
+	/// @param pos positions, without duplicates
+	virtual void loadBlocks(const std::vector<v3s16> &pos, const LoadCallback &cb);
+
 	static s64 getBlockAsInteger(const v3s16 &pos);
 	static v3s16 getIntegerAsBlock(s64 i);
 
 	virtual void listAllLoadableBlocks(std::vector<v3s16> &dst) = 0;
+
+	/// Opens a handle for reading blocks on another thread, concurrently
+	/// with other handles and the database itself. It must not outlive
+	/// the database.
+	/// @return nullptr if the backend does not support this
+	virtual std::unique_ptr<MapDatabaseReadHandle> createReadHandle() { return nullptr; }
+};
+
+/// See MapDatabase::createReadHandle(). Not thread-safe itself.
+class MapDatabaseReadHandle
+{
+public:
+	virtual ~MapDatabaseReadHandle() = default;
+
+	/// Blocks written in a transaction that is still open may not be
+	/// readable through a handle, these have to be loaded from the database.
+	/// @return false if this is the case for the block
+	virtual bool loadBlock(const v3s16 &pos, std::string *block) = 0;
+
+	/// Like MapDatabase::loadBlocks()
+	/// @param unavailable receives the positions that have to be loaded
+	///        from the database, see loadBlock()
+	virtual void loadBlocks(const std::vector<v3s16> &pos,
+		const MapDatabase::LoadCallback &cb, std::vector<v3s16> &unavailable);
 };
 
 class PlayerSAO;
@@ -34,6 +34,7 @@ class DummyMap : public Map
 				for (size_t i = 0; i < MapBlock::nodecount; i++)
 					block->getData()[i] = n;
 				block->expireIsAirCache();
+				block->expireCollisionBoxes();
 			}
 		}
 	}
@@ -6,6 +6,8 @@
 
 #include "emerge_internal.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 #include "util/container.h"
@@ -23,13 +25,23 @@
 #include "mapgen/mg_decoration.h"
 #include "mapgen/mg_schematic.h"
 #include "nodedef.h"
+#include "noise.h"
 #include "profiler.h"
 #include "scripting_server.h"
 #include "scripting_emerge.h"
 #include "server.h"
 #include "settings.h"
+#include "threading/workerpool.h"
 #include "voxel.h"
 
+// Distance of blocks when there are no players
+static constexpr u32 NO_INTEREST_DISTANCE = U16_MAX;
+// How many queue latencies the percentiles are computed from
+static constexpr size_t LATENCY_SAMPLE_COUNT = 1024;
+static constexpr float LATENCY_QUANTILES[] = {0.5f, 0.9f, 0.99f};
+// Memory for 2D noise per thread, which holds a few dozen mapchunk columns
+static constexpr size_t NOISE_CACHE_SIZE = 8 * 1024 * 1024;
+
 EmergeParams::~EmergeParams()
 {
 	infostream << "EmergeParams: destroying " << this << std::endl;
@@ -39,6 +51,8 @@ EmergeParams::~EmergeParams()
 	delete oremgr;
 	delete decomgr;
 	delete schemmgr;
+	delete noise_cache;
+	delete chunk_pool;
 }
 
 EmergeParams::EmergeParams(EmergeManager *parent, const BiomeGen *biomegen,
@@ -51,9 +65,17 @@ EmergeParams::EmergeParams(EmergeManager *parent, const BiomeGen *biomegen,
 	gen_notify_on_deco_ids(&parent->gen_notify_on_deco_ids),
 	gen_notify_on_custom(&parent->gen_notify_on_custom),
 	biomemgr(biomemgr->clone()), oremgr(oremgr->clone()),
-	decomgr(decomgr->clone()), schemmgr(schemmgr->clone())
-{
+	decomgr(decomgr->clone()), schemmgr(schemmgr->clone()),
+	noise_cache(new NoiseCache2D(NOISE_CACHE_SIZE)),
+	chunk_pool(nullptr)
+{
+	// the emerge thread takes part in the work too
+	if (parent->mapgen_chunk_threads > 1) {
+		chunk_pool = new WorkerPool("MapgenChunk",
+			parent->mapgen_chunk_threads - 1);
+	}
 	this->biomegen = biomegen->clone(this->biomemgr);
+	this->biomegen->noise_cache = noise_cache;
 }
 
 ////
@@ -77,6 +99,7 @@ EmergeManager::EmergeManager(Server *server, MetricsBackend *mb)
 	// EmergeThreads should be the ServerThread.
 
 	enable_mapgen_debug_info = g_settings->getBool("enable_mapgen_debug_info");
+	mapgen_chunk_threads = rangelim(g_settings->getU16("mapgen_chunk_threads"), 0, 64);
 
 	static_assert(ARRLEN(emergeActionStrs) == ARRLEN(m_completed_emerge_counter),
 		"enum size mismatches");
@@ -88,6 +111,24 @@ EmergeManager::EmergeManager(Server *server, MetricsBackend *mb)
 			{{"status", emergeActionStrs[i]}}
 		);
 	}
+	static_assert(ARRLEN(LATENCY_QUANTILES) == ARRLEN(m_queue_latency_gauge),
+		"array size mismatches");
+	for (u32 i = 0; i < ARRLEN(m_queue_latency_gauge); i++) {
+		m_queue_latency_gauge[i] = mb->addGauge(
+			"minetest_emerge_queue_latency_seconds",
+			"Time recently started emerges spent in the queue",
+			{{"quantile", ftos(LATENCY_QUANTILES[i])}}
+		);
+	}
+	m_latency_samples.reserve(LATENCY_SAMPLE_COUNT);
+	m_noise_cache_hit_counter = mb->addCounter(
+		"minetest_emerge_noise_cache_lookups",
+		"Number of 2D mapgen noise maps looked up in the cache",
+		{{"result", "hit"}});
+	m_noise_cache_miss_counter = mb->addCounter(
+		"minetest_emerge_noise_cache_lookups",
+		"Number of 2D mapgen noise maps looked up in the cache",
+		{{"result", "miss"}});
 
 	s16 nthreads = 1;
 	g_settings->getS16NoEx("num_emerge_threads", nthreads);
@@ -110,6 +151,9 @@ EmergeManager::EmergeManager(Server *server, MetricsBackend *mb)
 	m_qlimit_generate = rangelim(m_qlimit_generate, 1, 1000000);
 	m_qlimit_total = std::max(m_qlimit_total, std::max(m_qlimit_diskonly, m_qlimit_generate));
 
+	// blocks are only sent up to this distance, leave some room for movement
+	m_cancel_distance = std::max<s16>(g_settings->getS16("max_block_send_distance"), 1) + 2;
+
 	for (s16 i = 0; i < nthreads; i++)
 		m_threads.push_back(new EmergeThread(server, i));
 
@@ -291,8 +335,9 @@ bool EmergeManager::enqueueBlockEmergeEx(
 		if (entry_already_exists)
 			return true;
 
-		thread = getOptimalThread();
-		thread->pushBlock(blockpos);
+		const u32 priority = getInterestDistance(blockpos);
+		thread = getOptimalThread(priority);
+		thread->pushBlock({priority, m_queue_seq++, blockpos});
 	}
 
 	thread->signal();
@@ -313,6 +358,62 @@ bool EmergeManager::isBlockInQueue(v3s16 pos)
 	return m_blocks_enqueued.find(pos) != m_blocks_enqueued.end();
 }
 
+void EmergeManager::updateInterest(const std::vector<v3s16> &positions)
+{
+	size_t cancelled = 0;
+	std::vector<u64> latencies;
+	{
+		MutexAutoLock queuelock(m_queue_mutex);
+		m_interest = positions;
+
+		const u64 now = porting::getTimeUs();
+		for (EmergeThread *thread : m_threads) {
+			std::set<EmergeQueueEntry> queue;
+			for (const EmergeQueueEntry &entry : thread->m_block_queue) {
+				auto it = m_blocks_enqueued.find(entry.pos);
+				if (it == m_blocks_enqueued.end())
+					continue;
+				const BlockEmergeData &bedata = it->second;
+				const u32 distance = getInterestDistance(entry.pos);
+
+				// Nobody else waits for blocks that only a player wanted
+				if (bedata.peer_requested != PEER_ID_INEXISTENT &&
+						bedata.callbacks.empty() &&
+						!(bedata.flags & BLOCK_EMERGE_FORCE_QUEUE) &&
+						distance > m_cancel_distance) {
+					BlockEmergeData unused;
+					popBlockEmergeData(entry.pos, &unused);
+					cancelled++;
+					continue;
+				}
+
+				// Blocks come one step closer for every second waited,
+				// so that far requests are not postponed forever.
+				const u32 waited = (now - bedata.queued_at) / 1000000;
+				const u32 priority = distance > waited ? distance - waited : 0;
+				queue.insert({priority, entry.seq, entry.pos});
+			}
+			thread->m_block_queue = std::move(queue);
+		}
+
+		latencies = m_latency_samples;
+	}
+
+	for (size_t i = 0; i < cancelled; i++)
+		reportCompletedEmerge(EMERGE_CANCELLED);
+	if (cancelled > 0)
+		EMERGE_DBG_OUT("cancelled " << cancelled << " blocks far from players");
+
+	if (latencies.empty())
+		return;
+	std::sort(latencies.begin(), latencies.end());
+	for (size_t i = 0; i < ARRLEN(m_queue_latency_gauge); i++) {
+		size_t index = std::min<size_t>(latencies.size() * LATENCY_QUANTILES[i],
+			latencies.size() - 1);
+		m_queue_latency_gauge[i]->set(latencies[index] / 1.0e6);
+	}
+}
+
 
 //
 // Mapgen-related helper functions
@@ -388,6 +489,7 @@ bool EmergeManager::pushBlockEmergeData(
 	} else {
 		bedata.flags = flags;
 		bedata.peer_requested = peer_requested;
+		bedata.queued_at = porting::getTimeUs();
 
 		count_peer++;
 	}
@@ -419,17 +521,24 @@ bool EmergeManager::popBlockEmergeData(v3s16 pos, BlockEmergeData *bedata)
 }
 
 
-EmergeThread *EmergeManager::getOptimalThread()
+EmergeThread *EmergeManager::getOptimalThread(u32 priority)
 {
 	size_t nthreads = m_threads.size();
 
 	FATAL_ERROR_IF(nthreads == 0, "No emerge threads!");
 
+	// Pick the thread with the fewest blocks that would be processed first
+	const EmergeQueueEntry after{priority + 1, 0, v3s16()};
+	auto items_ahead = [&] (size_t i) {
+		const auto &queue = m_threads[i]->m_block_queue;
+		return std::distance(queue.begin(), queue.lower_bound(after));
+	};
+
 	size_t index = 0;
-	size_t nitems_lowest = m_threads[0]->m_block_queue.size();
+	auto nitems_lowest = items_ahead(0);
 
-	for (size_t i = 1; i < nthreads; i++) {
-		size_t nitems = m_threads[i]->m_block_queue.size();
+	for (size_t i = 1; i < nthreads && nitems_lowest > 0; i++) {
+		auto nitems = items_ahead(i);
 		if (nitems < nitems_lowest) {
 			index = i;
 			nitems_lowest = nitems;
@@ -439,12 +548,32 @@ EmergeThread *EmergeManager::getOptimalThread()
 	return m_threads[index];
 }
 
+u32 EmergeManager::getInterestDistance(v3s16 pos) const
+{
+	s32 min_dist_sq = S32_MAX;
+	for (v3s16 p : m_interest) {
+		v3s32 d(pos.X - p.X, pos.Y - p.Y, pos.Z - p.Z);
+		min_dist_sq = std::min(min_dist_sq, d.X * d.X + d.Y * d.Y + d.Z * d.Z);
+	}
+	if (min_dist_sq == S32_MAX)
+		return NO_INTEREST_DISTANCE;
+	return std::min<u32>(std::sqrt((float)min_dist_sq), NO_INTEREST_DISTANCE);
+}
+
 void EmergeManager::reportCompletedEmerge(EmergeAction action)
 {
 	assert((size_t)action < ARRLEN(m_completed_emerge_counter));
 	m_completed_emerge_counter[(int)action]->increment();
 }
 
+void EmergeManager::reportNoiseCache(u64 hits, u64 misses)
+{
+	if (hits > 0)
+		m_noise_cache_hit_counter->increment(hits);
+	if (misses > 0)
+		m_noise_cache_miss_counter->increment(misses);
+}
+
 
 ////
 //// EmergeThread
@@ -469,9 +598,9 @@ void EmergeThread::signal()
 }
 
 
-bool EmergeThread::pushBlock(v3s16 pos)
+bool EmergeThread::pushBlock(const EmergeQueueEntry &entry)
 {
-	m_block_queue.push(pos);
+	m_block_queue.insert(entry);
 	return true;
 }
 
@@ -484,8 +613,8 @@ void EmergeThread::cancelPendingItems()
 		BlockEmergeData bedata;
 		v3s16 pos;
 
-		pos = m_block_queue.front();
-		m_block_queue.pop();
+		pos = m_block_queue.begin()->pos;
+		m_block_queue.erase(m_block_queue.begin());
 
 		m_emerge->popBlockEmergeData(pos, &bedata);
 
@@ -518,15 +647,79 @@ bool EmergeThread::popBlockEmerge(v3s16 *pos, BlockEmergeData *bedata)
 	if (m_block_queue.empty())
 		return false;
 
-	*pos = m_block_queue.front();
-	m_block_queue.pop();
+	*pos = m_block_queue.begin()->pos;
+	m_block_queue.erase(m_block_queue.begin());
 
-	m_emerge->popBlockEmergeData(*pos, bedata);
+	if (!m_emerge->popBlockEmergeData(*pos, bedata))
+		return true;
+
+	// Remember how long the block waited
+	auto &samples = m_emerge->m_latency_samples;
+	const u64 latency = porting::getTimeUs() - bedata->queued_at;
+	if (samples.size() < LATENCY_SAMPLE_COUNT) {
+		samples.push_back(latency);
+	} else {
+		samples[m_emerge->m_latency_next] = latency;
+		m_emerge->m_latency_next = (m_emerge->m_latency_next + 1) % LATENCY_SAMPLE_COUNT;
+	}
 
 	return true;
 }
 
 
+void EmergeThread::loadBlockData(v3s16 pos, std::string &data)
+{
+	// Number of blocks to read at once
+	constexpr size_t PREFETCH_COUNT = 32;
+
+	auto &db = *m_emerge->m_db;
+	auto it = m_prefetched.find(pos);
+	if (it != m_prefetched.end() && db.write_counter != m_prefetch_write_counter) {
+		// The block may have been saved since
+		m_prefetched.clear();
+		it = m_prefetched.end();
+	}
+
+	if (it == m_prefetched.end()) {
+		std::vector<v3s16> batch{pos};
+		{
+			MutexAutoLock queuelock(m_emerge->m_queue_mutex);
+			for (const EmergeQueueEntry &entry : m_block_queue) {
+				if (batch.size() >= PREFETCH_COUNT)
+					break;
+				batch.push_back(entry.pos);
+			}
+		}
+
+		m_prefetched.clear();
+		auto cb = [&] (const v3s16 &p, std::string &d) {
+			m_prefetched[p] = std::move(d);
+		};
+		const u32 counter = db.write_counter;
+		// Without the lock if possible. Nothing can be read while a write
+		// is in progress, as it may or may not be visible yet.
+		if (m_db_handle && counter % 2 == 0) {
+			std::vector<v3s16> unavailable;
+			m_db_handle->loadBlocks(batch, cb, unavailable);
+			m_prefetch_write_counter = counter;
+			if (!unavailable.empty()) {
+				MutexAutoLock dblock(db.mutex);
+				db.loadBlocks(unavailable, cb);
+			}
+		} else {
+			MutexAutoLock dblock(db.mutex);
+			db.loadBlocks(batch, cb);
+			m_prefetch_write_counter = db.write_counter;
+		}
+		it = m_prefetched.find(pos);
+		assert(it != m_prefetched.end());
+	}
+
+	data = std::move(it->second);
+	m_prefetched.erase(it);
+}
+
+
 EmergeAction EmergeThread::getBlockOrStartGen(const v3s16 pos, bool allow_gen,
 	 const std::string *from_db, MapBlock **block, BlockMakeData *bmdata)
 {
@@ -570,6 +763,18 @@ EmergeAction EmergeThread::getBlockOrStartGen(const v3s16 pos, bool allow_gen,
 }
 
 
+void EmergeThread::reportNoiseCache()
+{
+	const NoiseCache2D *cache = m_mapgen->m_emerge->noise_cache;
+	if (!cache)
+		return;
+
+	m_emerge->reportNoiseCache(cache->getHits() - m_noise_cache_hits,
+		cache->getMisses() - m_noise_cache_misses);
+	m_noise_cache_hits = cache->getHits();
+	m_noise_cache_misses = cache->getMisses();
+}
+
 MapBlock *EmergeThread::finishGen(v3s16 pos, BlockMakeData *bmdata,
 	std::map<v3s16, MapBlock *> *modified_blocks)
 {
@@ -672,6 +877,14 @@ void *EmergeThread::run()
 		stop(); // do not enter main loop
 	}
 
+	try {
+		MutexAutoLock dblock(m_emerge->m_db->mutex);
+		m_db_handle = m_emerge->m_db->createReadHandle();
+	} catch (DatabaseException &e) {
+		warningstream << m_name << ": database can't be read concurrently: "
+			<< e.what() << std::endl;
+	}
+
 	try {
 	while (!stopRequested()) {
 		BlockEmergeData bedata;
@@ -698,13 +911,11 @@ void *EmergeThread::run()
 
 		/* Try to load it */
 		if (action == EMERGE_FROM_DISK) {
-			auto &m_db = *m_emerge->m_db;
 			{
 				ScopeProfiler sp(g_profiler, "EmergeThread: load block - async (sum)");
-				MutexAutoLock dblock(m_db.mutex);
 				// Note: this can throw an exception, but there isn't really
 				// a good, safe way to handle it.
-				m_db.loadBlock(pos, databuf);
+				loadBlockData(pos, databuf);
 			}
 			// actually load it, then decide again
 			action = getBlockOrStartGen(pos, allow_gen, &databuf, &block, &bmdata);
@@ -722,6 +933,7 @@ void *EmergeThread::run()
 
 				m_mapgen->makeChunk(&bmdata);
 			}
+			reportNoiseCache();
 
 			{
 				ScopeProfiler sp(g_profiler,
@@ -785,6 +997,7 @@ void *EmergeThread::run()
 	}
 
 	cancelPendingItems();
+	m_db_handle.reset();
 
 	END_DEBUG_EXCEPTION_HANDLER
 	return NULL;
@@ -28,6 +28,8 @@ class BiomeManager;
 class OreManager;
 class DecorationManager;
 class SchematicManager;
+class NoiseCache2D;
+class WorkerPool;
 class Server;
 class ModApiMapgen;
 struct MapDatabaseAccessor;
@@ -79,6 +81,8 @@ struct BlockEmergeData {
 	u16 peer_requested;
 	u16 flags;
 	EmergeCallbackList callbacks;
+	// porting::getTimeUs() when the block was queued
+	u64 queued_at;
 };
 
 class EmergeParams {
@@ -101,6 +105,11 @@ class EmergeParams {
 	DecorationManager *decomgr;
 	SchematicManager *schemmgr;
 
+	// 2D noise of the mapgen, also used by biomegen
+	NoiseCache2D *noise_cache;
+	// Threads that help generating a mapchunk, null if disabled
+	WorkerPool *chunk_pool;
+
 	inline GenerateNotifier createNotifier() const {
 		return GenerateNotifier(gen_notify_on, gen_notify_on_deco_ids,
 			gen_notify_on_custom);
@@ -122,6 +131,8 @@ class EmergeManager {
 public:
 	const NodeDefManager *ndef;
 	bool enable_mapgen_debug_info;
+	// Threads per mapchunk, see EmergeParams::chunk_pool
+	u16 mapgen_chunk_threads;
 
 	// Generation Notify
 	u32 gen_notify_on = 0;
@@ -183,6 +194,14 @@ class EmergeManager {
 	size_t getQueueSize();
 	bool isBlockInQueue(v3s16 pos);
 
+	/**
+	 * Sets the block positions of the players. Queued blocks are processed
+	 * in order of their distance to the nearest player, blocks requested by
+	 * players that are far from everyone are cancelled.
+	 * Also updates the queue latency metrics.
+	 */
+	void updateInterest(const std::vector<v3s16> &positions);
+
 	Mapgen *getCurrentMapgen();
 
 	// Mapgen helpers methods
@@ -202,6 +221,18 @@ class EmergeManager {
 	std::mutex m_queue_mutex;
 	std::map<v3s16, BlockEmergeData> m_blocks_enqueued;
 	std::unordered_map<u16, u32> m_peer_queue_count;
+	// for ordering blocks of the same priority
+	u64 m_queue_seq = 0;
+
+	// Block positions of the players (protected by m_queue_mutex)
+	std::vector<v3s16> m_interest;
+	// Player requests farther than this from all players are cancelled [blocks]
+	u32 m_cancel_distance;
+
+	// Time recently started emerges spent in the queue [us]
+	// (protected by m_queue_mutex)
+	std::vector<u64> m_latency_samples;
+	size_t m_latency_next = 0;
 
 	u32 m_qlimit_total;
 	u32 m_qlimit_diskonly;
@@ -209,6 +240,9 @@ class EmergeManager {
 
 	// Emerge metrics
 	MetricCounterPtr m_completed_emerge_counter[5];
+	MetricGaugePtr m_queue_latency_gauge[3];
+	MetricCounterPtr m_noise_cache_hit_counter;
+	MetricCounterPtr m_noise_cache_miss_counter;
 
 	// Managers of various map generation-related components
 	// Note that each Mapgen gets a copy(!) of these to work with
@@ -219,7 +253,9 @@ class EmergeManager {
 	SchematicManager *schemmgr;
 
 	// Requires m_queue_mutex held
-	EmergeThread *getOptimalThread();
+	EmergeThread *getOptimalThread(u32 priority);
+	// Requires m_queue_mutex held
+	u32 getInterestDistance(v3s16 pos) const;
 
 	bool pushBlockEmergeData(
 		v3s16 pos,
@@ -232,6 +268,7 @@ class EmergeManager {
 	bool popBlockEmergeData(v3s16 pos, BlockEmergeData *bedata);
 
 	void reportCompletedEmerge(EmergeAction action);
+	void reportNoiseCache(u64 hits, u64 misses);
 
 	friend class EmergeThread;
 };
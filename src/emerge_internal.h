@@ -10,8 +10,12 @@
 
 #include "emerge.h"
 
-#include <queue>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <unordered_map>
 
+#include "database/database.h"
 #include "util/thread.h"
 #include "threading/event.h"
 
@@ -22,6 +26,19 @@ class Mapgen;
 class EmergeManager;
 class EmergeScripting;
 
+// Entry of an emerge thread's queue
+struct EmergeQueueEntry {
+	// lower is processed first
+	u32 priority;
+	u64 seq;
+	v3s16 pos;
+
+	bool operator<(const EmergeQueueEntry &other) const
+	{
+		return std::tie(priority, seq) < std::tie(other.priority, other.seq);
+	}
+};
+
 class EmergeThread : public Thread {
 public:
 	bool enable_mapgen_debug_info;
@@ -34,7 +51,7 @@ class EmergeThread : public Thread {
 	void signal();
 
 	// Requires queue mutex held
-	bool pushBlock(v3s16 pos);
+	bool pushBlock(const EmergeQueueEntry &entry);
 
 	void cancelPendingItems();
 
@@ -58,12 +75,26 @@ class EmergeThread : public Thread {
 	UniqueQueue<v3s16> *m_trans_liquid; //< non-null only when generating a mapblock
 
 	Event m_queue_event;
-	std::queue<v3s16> m_block_queue;
+	std::set<EmergeQueueEntry> m_block_queue;
+
+	// Data of queued blocks that was read from the database ahead of time
+	std::unordered_map<v3s16, std::string> m_prefetched;
+	// MapDatabaseAccessor::write_counter at the time of the prefetch
+	u32 m_prefetch_write_counter = 0;
+	// For loads without the database lock, if supported
+	std::unique_ptr<MapDatabaseReadHandle> m_db_handle;
+	// Noise cache statistics that were reported to the manager
+	u64 m_noise_cache_hits = 0;
+	u64 m_noise_cache_misses = 0;
 
 	bool initScripting();
 
 	bool popBlockEmerge(v3s16 *pos, BlockEmergeData *bedata);
 
+	/// Reads a block from the database. The following blocks in the queue
+	/// are read along with it, since they are usually close by.
+	void loadBlockData(v3s16 pos, std::string &data);
+
 	/**
 	 * Try to get a block from memory and decide what to do.
 	 *
@@ -78,6 +109,9 @@ class EmergeThread : public Thread {
 	EmergeAction getBlockOrStartGen(v3s16 pos, bool allow_gen,
 		const std::string *from_db,  MapBlock **block, BlockMakeData *data);
 
+	// Reports the noise cache lookups of the last mapgen run
+	void reportNoiseCache();
+
 	MapBlock *finishGen(v3s16 pos, BlockMakeData *bmdata,
 		std::map<v3s16, MapBlock *> *modified_blocks);
 
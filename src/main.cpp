@@ -373,6 +373,10 @@ static void set_allowed_options(OptionList *allowed_options)
 		_("Migrate from current auth backend to another" SERVER_ONLY))));
 	allowed_options->insert(std::make_pair("migrate-mod-storage", ValueSpec(VALUETYPE_STRING,
 		_("Migrate from current mod storage backend to another" SERVER_ONLY))));
+	allowed_options->insert(std::make_pair("pregen", ValueSpec(VALUETYPE_STRING,
+		_("Generate the map within the given radius around the spawn point and exit" SERVER_ONLY))));
+	allowed_options->insert(std::make_pair("pregen-y", ValueSpec(VALUETYPE_STRING,
+		_("Height range of --pregen as <min>,<max> (default: -64,256)" SERVER_ONLY))));
 	allowed_options->insert(std::make_pair("terminal", ValueSpec(VALUETYPE_FLAG,
 			_("Enable ncurses interactive terminal" SERVER_ONLY))));
 	allowed_options->insert(std::make_pair("recompress", ValueSpec(VALUETYPE_FLAG,
@@ -1096,6 +1100,10 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 	if (cmd_args.getFlag("recompress"))
 		return recompress_map_database(game_params, cmd_args);
 
+	// Map pregeneration
+	if (cmd_args.exists("pregen"))
+		return Server::pregenerateMap(game_params, cmd_args);
+
 	// Bind address
 	std::string bind_str = g_settings->get("bind_address");
 	Address bind_addr(0, 0, 0, 0, game_params.socket_port);
@@ -1208,7 +1216,7 @@ static bool migrate_map_database(const GameParams &game_params, const Settings &
 	if (!world_mt.exists("backend")) {
 		errorstream << "Please specify your current backend in world.mt:"
 			<< std::endl
-			<< "	backend = {sqlite3|leveldb|redis|dummy|postgresql}"
+			<< "	backend = {sqlite3|leveldb|redis|dummy|postgresql|mmap}"
 			<< std::endl;
 		return false;
 	}
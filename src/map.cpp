@@ -57,21 +57,19 @@ void Map::dispatchEvent(const MapEditEvent &event)
 
 MapSector * Map::getSectorNoGenerateNoLock(v2s16 p)
 {
-	if(m_sector_cache != NULL && p == m_sector_cache_p){
-		MapSector * sector = m_sector_cache;
+	MapSector *sector = m_sector_cache.load(std::memory_order_relaxed);
+	if (sector && p == sector->getPos())
 		return sector;
-	}
 
 	auto n = m_sectors.find(p);
 
 	if (n == m_sectors.end())
 		return NULL;
 
-	MapSector *sector = n->second;
+	sector = n->second;
 
 	// Cache the last result
-	m_sector_cache_p = p;
-	m_sector_cache = sector;
+	m_sector_cache.store(sector, std::memory_order_relaxed);
 
 	return sector;
 }
@@ -516,6 +514,7 @@ bool Map::setNodeMetadata(v3s16 p, NodeMetadata *meta)
 		return false;
 	}
 	block->m_node_metadata.set(p_rel, meta);
+	block->touchNetworkData();
 	return true;
 }
 
@@ -531,6 +530,7 @@ void Map::removeNodeMetadata(v3s16 p)
 		return;
 	}
 	block->m_node_metadata.remove(p_rel);
+	block->touchNetworkData();
 }
 
 NodeTimer Map::getNodeTimer(v3s16 p)
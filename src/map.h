@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <iostream>
 #include <set>
 #include <map>
@@ -277,6 +278,10 @@ class Map /*: public NodeContainer*/
 	}
 	bool isBlockOccluded(v3s16 pos_relative, v3s16 cam_pos_nodes, bool simple_check = false);
 
+	// Whether collision detection uses the collision boxes cached by the
+	// blocks (see MapBlock::getCollisionBoxes()). For comparison only.
+	bool use_collision_cache = true;
+
 protected:
 	IGameDef *m_gamedef;
 
@@ -285,8 +290,9 @@ class Map /*: public NodeContainer*/
 	std::unordered_map<v2s16, MapSector*> m_sectors;
 
 	// Be sure to set this to NULL when the cached sector is deleted
-	MapSector *m_sector_cache = nullptr;
-	v2s16 m_sector_cache_p;
+	// Atomic so that several threads may read the map at once as long as
+	// nobody modifies it meanwhile.
+	std::atomic<MapSector *> m_sector_cache{nullptr};
 
 	// This stores the properties of the nodes on the map.
 	const NodeDefManager *m_nodedef;
@@ -4,8 +4,10 @@
 
 #include "mapblock.h"
 
+#include <atomic>
 #include <sstream>
 #include "map.h"
+#include "collision.h"
 #include "light.h"
 #include "nodedef.h"
 #include "nodemetadata.h"
@@ -99,11 +101,18 @@ static const char *modified_reason_strings[] = {
 	MapBlock
 */
 
+u64 MapBlock::nextModificationStamp()
+{
+	static std::atomic<u64> counter(0);
+	return ++counter;
+}
+
 MapBlock::MapBlock(v3s16 pos, IGameDef *gamedef):
 		m_pos(pos),
 		m_pos_relative(pos * MAP_BLOCKSIZE),
 		data(new MapNode[nodecount]),
-		m_gamedef(gamedef)
+		m_gamedef(gamedef),
+		m_modification_stamp(nextModificationStamp())
 {
 	reallocate();
 	assert(m_modified > MOD_STATE_CLEAN);
@@ -118,6 +127,8 @@ MapBlock::~MapBlock()
 	}
 #endif
 
+	expireCollisionBoxes();
+
 	delete[] data;
 	porting::TrackFreedMemory(sizeof(MapNode) * nodecount);
 }
@@ -225,13 +236,32 @@ void MapBlock::copyFrom(const VoxelManipulator &src)
 	// Copy from VoxelManipulator to data
 	src.copyTo(data, data_area, v3s16(0,0,0),
 			getPosRelative(), data_size);
+
+	expireCollisionBoxes();
+	touchNetworkData();
 }
 
-void MapBlock::actuallyUpdateIsAir()
+const BlockCollisionBoxes *MapBlock::getCollisionBoxes()
 {
-	// Running this function un-expires m_is_air
-	m_is_air_expired = false;
+	BlockCollisionBoxes *boxes = m_collision_boxes.load(std::memory_order_acquire);
+	if (boxes)
+		return boxes;
+
+	auto built = BlockCollisionBoxes::build(this, m_gamedef->ndef());
+	// Another thread may have been faster
+	if (!m_collision_boxes.compare_exchange_strong(boxes, built.get(),
+			std::memory_order_acq_rel))
+		return boxes;
+	return built.release();
+}
+
+void MapBlock::deleteCollisionBoxes()
+{
+	delete m_collision_boxes.exchange(nullptr);
+}
 
+void MapBlock::actuallyUpdateIsAir()
+{
 	bool only_air = true;
 	for (u32 i = 0; i < nodecount; i++) {
 		MapNode &n = data[i];
@@ -243,6 +273,8 @@ void MapBlock::actuallyUpdateIsAir()
 
 	// Set member variable
 	m_is_air = only_air;
+	// Running this function un-expires m_is_air
+	m_is_air_expired = false;
 }
 
 void MapBlock::expireIsAirCache()
@@ -343,12 +375,25 @@ static void correctBlockNodeIds(const NameIdMapping *nimap, MapNode *nodes,
 }
 
 void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int compression_level)
+{
+	serializeImpl(os_compressed, version, disk, compression_level, false);
+}
+
+void MapBlock::serializeUncompressed(std::ostream &os, u8 version, bool disk)
+{
+	if (version < 29)
+		throw VersionMismatchException("ERROR: MapBlock format is compressed per part");
+	serializeImpl(os, version, disk, 0, true);
+}
+
+void MapBlock::serializeImpl(std::ostream &os_compressed, u8 version, bool disk,
+	int compression_level, bool uncompressed)
 {
 	if (!ser_ver_supported_write(version))
 		throw VersionMismatchException("ERROR: MapBlock format not supported");
 
 	std::ostringstream os_raw(std::ios_base::binary);
-	std::ostream &os = version >= 29 ? os_raw : os_compressed;
+	std::ostream &os = (version >= 29 && !uncompressed) ? os_raw : os_compressed;
 
 	// First byte
 	u8 flags = 0;
@@ -445,7 +490,7 @@ void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int
 		}
 	}
 
-	if (version >= 29) {
+	if (version >= 29 && !uncompressed) {
 		// now compress the whole thing
 		compress(os_raw.str(), os_compressed, version, compression_level);
 	}
@@ -464,6 +509,8 @@ void MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 	TRACESTREAM(<<"MapBlock::deSerialize "<<getPos()<<std::endl);
 
 	m_is_air_expired = true;
+	touchNetworkData();
+	expireCollisionBoxes();
 
 	if(version <= 21)
 	{
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <string>
 #include <vector>
 #include "irr_v3d.h"
 #include "mapnode.h"
@@ -21,6 +23,7 @@ class NodeMetadataList;
 class IGameDef;
 class MapBlockMesh;
 class VoxelManipulator;
+struct BlockCollisionBoxes;
 
 #define BLOCK_TIMESTAMP_UNDEFINED 0xffffffff
 
@@ -77,6 +80,8 @@ class MapBlock
 	{
 		for (u32 i = 0; i < nodecount; i++)
 			data[i] = MapNode(CONTENT_IGNORE);
+		expireCollisionBoxes();
+		touchNetworkData();
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_REALLOCATE);
 	}
 
@@ -120,6 +125,21 @@ class MapBlock
 		m_modified_reason = 0;
 	}
 
+	// Changes whenever something changes that is sent to clients. Unique
+	// across all blocks, so it can be used to tell whether a copy serialized
+	// for the network is outdated.
+	inline u64 getModificationStamp() const
+	{
+		return m_modification_stamp;
+	}
+
+	// To be called on changes of nodes, metadata or flags that are sent to
+	// clients. Changes of objects, timers or timestamps don't need this.
+	inline void touchNetworkData()
+	{
+		m_modification_stamp = nextModificationStamp();
+	}
+
 	////
 	//// Flags
 	////
@@ -133,6 +153,7 @@ class MapBlock
 	inline void setIsUnderground(bool a_is_underground)
 	{
 		is_underground = a_is_underground;
+		touchNetworkData();
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_IS_UNDERGROUND);
 	}
 
@@ -140,6 +161,7 @@ class MapBlock
 	{
 		if (newflags != m_lighting_complete) {
 			m_lighting_complete = newflags;
+			touchNetworkData();
 			raiseModified(MOD_STATE_WRITE_AT_UNLOAD, MOD_REASON_SET_LIGHTING_COMPLETE);
 		}
 	}
@@ -182,6 +204,7 @@ class MapBlock
 	inline void setGenerated(bool b)
 	{
 		if (b != m_generated) {
+			touchNetworkData();
 			raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_GENERATED);
 			m_generated = b;
 		}
@@ -255,8 +278,7 @@ class MapBlock
 		if (!isValidPosition(x, y, z))
 			throw InvalidPositionException();
 
-		data[z * zstride + y * ystride + x] = n;
-		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE);
+		setNodeNoCheck(x, y, z, n);
 	}
 
 	inline void setNode(v3s16 p, MapNode n)
@@ -280,7 +302,12 @@ class MapBlock
 
 	inline void setNodeNoCheck(s16 x, s16 y, s16 z, MapNode n)
 	{
-		data[z * zstride + y * ystride + x] = n;
+		MapNode &old = data[z * zstride + y * ystride + x];
+		// light changes don't affect collisions
+		if (old.getContent() != n.getContent() || old.getParam2() != n.getParam2())
+			expireCollisionBoxes();
+		old = n;
+		touchNetworkData();
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE);
 	}
 
@@ -310,6 +337,18 @@ class MapBlock
 		return m_is_air;
 	}
 
+	// Collision boxes of all nodes, built on first use. Can be called from
+	// several threads at once as long as the block isn't modified meanwhile.
+	const BlockCollisionBoxes *getCollisionBoxes();
+
+	// Drops the above. setNode(), copyFrom() and deSerialize() take care of
+	// this, code that writes to getData() directly has to call it.
+	inline void expireCollisionBoxes()
+	{
+		if (m_collision_boxes.load(std::memory_order_relaxed))
+			deleteCollisionBoxes();
+	}
+
 	bool onObjectsActivation();
 	bool saveStaticObject(u16 id, const StaticObject &obj, u32 reason);
 
@@ -416,11 +455,15 @@ class MapBlock
 	// Set disk to true for on-disk format, false for over-the-network format
 	// Precondition: version >= SER_FMT_VER_LOWEST_WRITE
 	void serialize(std::ostream &result, u8 version, bool disk, int compression_level);
+	// Same as serialize() minus the final compression step, which can then be
+	// done with compress() on another thread.
+	// Precondition: version >= 29
+	void serializeUncompressed(std::ostream &os, u8 version, bool disk);
 	// If disk == true: In addition to doing other things, will add
 	// unknown blocks from id-name mapping to wndef
 	void deSerialize(std::istream &is, u8 version, bool disk);
 
-	void serializeNetworkSpecific(std::ostream &os);
+	static void serializeNetworkSpecific(std::ostream &os);
 	void deSerializeNetworkSpecific(std::istream &is);
 
 	bool storeActiveObject(u16 id);
@@ -439,6 +482,11 @@ class MapBlock
 
 	void deSerialize_pre22(std::istream &is, u8 version, bool disk);
 
+	void serializeImpl(std::ostream &os_compressed, u8 version, bool disk,
+		int compression_level, bool uncompressed);
+
+	static u64 nextModificationStamp();
+
 	/*
 	 * PLEASE NOTE: When adding something here be mindful of position and size
 	 * of member variables! This is also the reason for the weird public-private
@@ -503,8 +551,13 @@ class MapBlock
 
 private:
 	// Whether day and night lighting differs
-	bool m_is_air = false;
-	bool m_is_air_expired = true;
+	// Atomic since isAir() may be called from several threads at once
+	std::atomic<bool> m_is_air{false};
+	std::atomic<bool> m_is_air_expired{true};
+
+	// see getCollisionBoxes()
+	std::atomic<BlockCollisionBoxes *> m_collision_boxes{nullptr};
+	void deleteCollisionBoxes();
 
 	/*
 		- On the server, this is used for telling whether the
@@ -513,6 +566,8 @@ class MapBlock
 	*/
 	u16 m_modified = MOD_STATE_CLEAN;
 	u32 m_modified_reason = 0;
+	// see getModificationStamp()
+	u64 m_modification_stamp = 0;
 
 	/*
 		When block is removed from active blocks, this is set to gametime.
@@ -56,18 +56,27 @@ CavesNoiseIntersection::~CavesNoiseIntersection()
 
 
 void CavesNoiseIntersection::generateCaves(MMVManip *vm,
-	v3s16 nmin, v3s16 nmax, biome_t *biomemap)
+	v3s16 nmin, v3s16 nmax, biome_t *biomemap, WorkerPool *pool)
 {
 	assert(vm);
 	assert(biomemap);
 
-	noise_cave1->noiseMap3D(nmin.X, nmin.Y - 1, nmin.Z);
-	noise_cave2->noiseMap3D(nmin.X, nmin.Y - 1, nmin.Z);
+	Mapgen::noiseMaps3D(pool, {noise_cave1, noise_cave2},
+		nmin.X, nmin.Y - 1, nmin.Z);
 
+	Mapgen::forEachSliceZ(pool, nmin.Z, nmax.Z, [&] (s16 z_min, s16 z_max) {
+		generateCavesSlice(vm, nmin, nmax, biomemap, z_min, z_max);
+	});
+}
+
+
+void CavesNoiseIntersection::generateCavesSlice(MMVManip *vm,
+	v3s16 nmin, v3s16 nmax, biome_t *biomemap, s16 z_min, s16 z_max)
+{
 	const v3s32 &em = vm->m_area.getExtent();
-	u32 index2d = 0;  // Biomemap index
+	u32 index2d = (z_min - nmin.Z) * m_csize.X;  // Biomemap index
 
-	for (s16 z = nmin.Z; z <= nmax.Z; z++)
+	for (s16 z = z_min; z <= z_max; z++)
 	for (s16 x = nmin.X; x <= nmax.X; x++, index2d++) {
 		bool column_is_open = false;  // Is column open to overground
 		bool is_under_river = false;  // Is column under river water
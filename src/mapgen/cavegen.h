@@ -12,6 +12,7 @@ typedef u16 biome_t;  // copy from mg_biome.h to avoid an unnecessary include
 class GenerateNotifier;
 
 class BiomeGen;
+class WorkerPool;
 
 /*
 	CavesNoiseIntersection is a cave digging algorithm that carves smooth,
@@ -33,9 +34,15 @@ class CavesNoiseIntersection
 		NoiseParams *np_cave2, s32 seed, float cave_width);
 	~CavesNoiseIntersection();
 
-	void generateCaves(MMVManip *vm, v3s16 nmin, v3s16 nmax, biome_t *biomemap);
+	// The work is split among the threads of the pool if there is one
+	void generateCaves(MMVManip *vm, v3s16 nmin, v3s16 nmax, biome_t *biomemap,
+		WorkerPool *pool = nullptr);
 
 private:
+	// Part of generateCaves() for the columns of a slice
+	void generateCavesSlice(MMVManip *vm, v3s16 nmin, v3s16 nmax,
+		biome_t *biomemap, s16 z_min, s16 z_max);
+
 	const NodeDefManager *m_ndef;
 	BiomeManager *m_bmgr;
 
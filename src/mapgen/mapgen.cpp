@@ -4,6 +4,7 @@
 // Copyright (C) 2013-2018 kwolekr, Ryan Kwolek <kwolekr@minetest.net>
 // Copyright (C) 2015-2018 paramat
 
+#include <algorithm>
 #include <cmath>
 #include "mapgen.h"
 #include "voxel.h"
@@ -19,6 +20,7 @@
 #include "porting.h"
 #include "profiler.h"
 #include "settings.h"
+#include "threading/workerpool.h"
 #include "treegen.h"
 #include "serialization.h"
 #include "util/serialize.h"
@@ -560,6 +562,53 @@ void Mapgen::spreadLight(const v3s16 &nmin, const v3s16 &nmax)
 }
 
 
+float *Mapgen::noiseMap2D(Noise *noise, float x, float y)
+{
+	if (m_emerge && m_emerge->noise_cache)
+		return m_emerge->noise_cache->noiseMap2D(noise, x, y);
+	return noise->noiseMap2D(x, y);
+}
+
+
+WorkerPool *Mapgen::getChunkPool() const
+{
+	return m_emerge ? m_emerge->chunk_pool : nullptr;
+}
+
+
+void Mapgen::forEachSliceZ(WorkerPool *pool, s16 z_min, s16 z_max,
+	const std::function<void(s16, s16)> &fn)
+{
+	const s32 rows = (s32)z_max - z_min + 1;
+	if (!pool || pool->getConcurrency() == 1 || rows <= 1) {
+		fn(z_min, z_max);
+		return;
+	}
+
+	// More slices than threads, in case some are slower than others
+	const s32 slices = std::min<s32>(rows, pool->getConcurrency() * 2);
+	pool->parallelFor(slices, [&] (size_t i) {
+		fn(z_min + rows * (s32)i / slices,
+			z_min + rows * ((s32)i + 1) / slices - 1);
+	});
+}
+
+
+void Mapgen::noiseMaps3D(WorkerPool *pool, const std::vector<Noise *> &noises,
+	float x, float y, float z)
+{
+	if (!pool || noises.size() == 1) {
+		for (Noise *noise : noises)
+			noise->noiseMap3D(x, y, z);
+		return;
+	}
+
+	pool->parallelFor(noises.size(), [&] (size_t i) {
+		noises[i]->noiseMap3D(x, y, z);
+	});
+}
+
+
 ////
 //// MapgenBasic
 ////
@@ -629,12 +678,21 @@ void MapgenBasic::generateBiomes()
 	assert(biomegen);
 	assert(biomemap);
 
-	const v3s32 &em = vm->m_area.getExtent();
-	u32 index = 0;
+	noiseMap2D(noise_filler_depth, node_min.X, node_min.Z);
+
+	forEachSliceZ(getChunkPool(), node_min.Z, node_max.Z,
+		[this] (s16 z_min, s16 z_max) {
+			generateBiomesSlice(z_min, z_max);
+		});
+}
 
-	noise_filler_depth->noiseMap2D(node_min.X, node_min.Z);
 
-	for (s16 z = node_min.Z; z <= node_max.Z; z++)
+void MapgenBasic::generateBiomesSlice(s16 z_min, s16 z_max)
+{
+	const v3s32 &em = vm->m_area.getExtent();
+	u32 index = (z_min - node_min.Z) * csize.X;
+
+	for (s16 z = z_min; z <= z_max; z++)
 	for (s16 x = node_min.X; x <= node_max.X; x++, index++) {
 		Biome *biome = NULL;
 		biome_t water_biome_index = 0;
@@ -774,10 +832,19 @@ void MapgenBasic::dustTopNodes()
 	if (node_max.Y < water_level)
 		return;
 
+	forEachSliceZ(getChunkPool(), node_min.Z, node_max.Z,
+		[this] (s16 z_min, s16 z_max) {
+			dustTopNodesSlice(z_min, z_max);
+		});
+}
+
+
+void MapgenBasic::dustTopNodesSlice(s16 z_min, s16 z_max)
+{
 	const v3s32 &em = vm->m_area.getExtent();
-	u32 index = 0;
+	u32 index = (z_min - node_min.Z) * csize.X;
 
-	for (s16 z = node_min.Z; z <= node_max.Z; z++)
+	for (s16 z = z_min; z <= z_max; z++)
 	for (s16 x = node_min.X; x <= node_max.X; x++, index++) {
 		Biome *biome = (Biome *)m_bmgr->getRaw(biomemap[index]);
 
@@ -843,7 +910,7 @@ void MapgenBasic::generateCavesNoiseIntersection(s16 max_stone_y)
 	CavesNoiseIntersection caves_noise(ndef, m_bmgr, biomegen, csize,
 		&np_cave1, &np_cave2, seed, cave_width);
 
-	caves_noise.generateCaves(vm, node_min, node_max, biomemap);
+	caves_noise.generateCaves(vm, node_min, node_max, biomemap, getChunkPool());
 }
 
 
@@ -956,6 +1023,54 @@ void MapgenBasic::generateDungeons(s16 max_stone_y)
 }
 
 
+////
+//// PlacementFilter
+////
+
+void PlacementFilter::update(const s16 *heightmap, const biome_t *biomemap,
+	size_t size)
+{
+	height_min = S16_MIN;
+	height_max = S16_MAX;
+	if (heightmap && size > 0) {
+		const auto range = std::minmax_element(heightmap, heightmap + size);
+		height_min = *range.first;
+		height_max = *range.second;
+	}
+
+	m_biomes.clear();
+	m_num_biomes = 0;
+	if (!biomemap)
+		return;
+	for (size_t i = 0; i != size; i++) {
+		const biome_t id = biomemap[i];
+		if (id >= m_biomes.size())
+			m_biomes.resize(id + 1, false);
+		if (!m_biomes[id]) {
+			m_biomes[id] = true;
+			m_num_biomes++;
+		}
+	}
+}
+
+
+PlacementFilter::BiomeOverlap PlacementFilter::biomeOverlap(
+	const std::unordered_set<biome_t> &biomes) const
+{
+	if (m_num_biomes == 0 || biomes.empty())
+		return BIOMES_ALL;
+
+	size_t found = 0;
+	for (biome_t id : biomes) {
+		if (id < m_biomes.size() && m_biomes[id])
+			found++;
+	}
+	if (found == 0)
+		return BIOMES_NONE;
+	return found == m_num_biomes ? BIOMES_ALL : BIOMES_SOME;
+}
+
+
 ////
 //// GenerateNotifier
 ////
@@ -10,7 +10,10 @@
 #include "nodedef.h"
 #include "util/string.h"
 #include "util/container.h"
+#include <functional>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #define MAPGEN_DEFAULT MAPGEN_V7
 #define MAPGEN_DEFAULT_NAME "v7"
@@ -43,6 +46,7 @@ class VoxelManipulator;
 struct BlockMakeData;
 class VoxelArea;
 class Map;
+class WorkerPool;
 
 enum MapgenObject {
 	MGOBJ_VMANIP,
@@ -141,6 +145,36 @@ struct MapgenParams {
 };
 
 
+/*
+	Summary of the height and biome maps of the area that ores and decorations
+	are placed in. Ores and decorations that cannot occur anywhere in it are
+	skipped as a whole, which doesn't change the result as each one uses its
+	own random number generator.
+*/
+class PlacementFilter {
+public:
+	enum BiomeOverlap {
+		BIOMES_NONE, // none of the biomes occur
+		BIOMES_SOME,
+		BIOMES_ALL,  // only the biomes occur, or there is no biome map
+	};
+
+	// Range of the heightmap, covers everything without one
+	s16 height_min = S16_MIN;
+	s16 height_max = S16_MAX;
+
+	// The maps have one entry for each column of the area, or are NULL
+	void update(const s16 *heightmap, const biome_t *biomemap, size_t size);
+
+	BiomeOverlap biomeOverlap(const std::unordered_set<biome_t> &biomes) const;
+
+private:
+	// m_biomes[id] is whether the biome occurs
+	std::vector<bool> m_biomes;
+	size_t m_num_biomes = 0;
+};
+
+
 /*
 	Generic interface for map generators.  All mapgens must inherit this class.
 	If a feature exposed by a public member pointer is not supported by a
@@ -226,6 +260,28 @@ class Mapgen {
 	 */
 	void spreadLight(const v3s16 &nmin, const v3s16 &nmax);
 
+	/**
+	 * Same as noise->noiseMap2D(x, y), but takes the result from the noise
+	 * cache of the emerge thread if possible.
+	 */
+	float *noiseMap2D(Noise *noise, float x, float y);
+
+	/// @return threads that help generating a chunk, if enabled
+	WorkerPool *getChunkPool() const;
+
+	/**
+	 * Calls fn(z_min, z_max) for slices along Z that together cover
+	 * [z_min, z_max], split among the threads of the pool if there is one.
+	 * fn must only access the map columns within its slice.
+	 */
+	static void forEachSliceZ(WorkerPool *pool, s16 z_min, s16 z_max,
+		const std::function<void(s16, s16)> &fn);
+
+	/// Calculates the noise maps at the same position, each one by a thread
+	/// of the pool if there is one.
+	static void noiseMaps3D(WorkerPool *pool, const std::vector<Noise *> &noises,
+		float x, float y, float z);
+
 	virtual void makeChunk(BlockMakeData *data) {}
 	virtual int getGroundLevelAtPoint(v2s16 p) { return 0; }
 
@@ -291,6 +347,10 @@ class MapgenBasic : public Mapgen {
 	virtual void generateDungeons(s16 max_stone_y);
 
 protected:
+	// Parts of generateBiomes() and dustTopNodes() for the columns of a slice
+	void generateBiomesSlice(s16 z_min, s16 z_max);
+	void dustTopNodesSlice(s16 z_min, s16 z_max);
+
 	BiomeManager *m_bmgr;
 
 	Noise *noise_filler_depth;
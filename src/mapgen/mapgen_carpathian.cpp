@@ -429,20 +429,20 @@ int MapgenCarpathian::generateTerrain()
 	MapNode mn_water(c_water_source);
 
 	// Calculate noise for terrain generation
-	noise_height1->noiseMap2D(node_min.X, node_min.Z);
-	noise_height2->noiseMap2D(node_min.X, node_min.Z);
-	noise_height3->noiseMap2D(node_min.X, node_min.Z);
-	noise_height4->noiseMap2D(node_min.X, node_min.Z);
-	noise_hills_terrain->noiseMap2D(node_min.X, node_min.Z);
-	noise_ridge_terrain->noiseMap2D(node_min.X, node_min.Z);
-	noise_step_terrain->noiseMap2D(node_min.X, node_min.Z);
-	noise_hills->noiseMap2D(node_min.X, node_min.Z);
-	noise_ridge_mnt->noiseMap2D(node_min.X, node_min.Z);
-	noise_step_mnt->noiseMap2D(node_min.X, node_min.Z);
+	noiseMap2D(noise_height1, node_min.X, node_min.Z);
+	noiseMap2D(noise_height2, node_min.X, node_min.Z);
+	noiseMap2D(noise_height3, node_min.X, node_min.Z);
+	noiseMap2D(noise_height4, node_min.X, node_min.Z);
+	noiseMap2D(noise_hills_terrain, node_min.X, node_min.Z);
+	noiseMap2D(noise_ridge_terrain, node_min.X, node_min.Z);
+	noiseMap2D(noise_step_terrain, node_min.X, node_min.Z);
+	noiseMap2D(noise_hills, node_min.X, node_min.Z);
+	noiseMap2D(noise_ridge_mnt, node_min.X, node_min.Z);
+	noiseMap2D(noise_step_mnt, node_min.X, node_min.Z);
 	noise_mnt_var->noiseMap3D(node_min.X, node_min.Y - 1, node_min.Z);
 
 	if (spflags & MGCARPATHIAN_RIVERS)
-		noise_rivers->noiseMap2D(node_min.X, node_min.Z);
+		noiseMap2D(noise_rivers, node_min.X, node_min.Z);
 
 	//// Place nodes
 	const v3s32 &em = vm->m_area.getExtent();
@@ -272,8 +272,8 @@ int MapgenV5::generateBaseTerrain()
 	u32 index2d = 0;
 	int stone_surface_max_y = -MAX_MAP_GENERATION_LIMIT;
 
-	noise_factor->noiseMap2D(node_min.X, node_min.Z);
-	noise_height->noiseMap2D(node_min.X, node_min.Z);
+	noiseMap2D(noise_factor, node_min.X, node_min.Z);
+	noiseMap2D(noise_height, node_min.X, node_min.Z);
 	noise_ground->noiseMap3D(node_min.X, node_min.Y - 1, node_min.Z);
 
 	for (s16 z=node_min.Z; z<=node_max.Z; z++) {
@@ -472,16 +472,19 @@ int MapgenV7::generateTerrain()
 	MapNode n_water(c_water_source);
 
 	//// Calculate noise for terrain generation
-	noise_terrain_persist->noiseMap2D(node_min.X, node_min.Z);
+	noiseMap2D(noise_terrain_persist, node_min.X, node_min.Z);
 	float *persistmap = noise_terrain_persist->result;
 
 	noise_terrain_base->noiseMap2D(node_min.X, node_min.Z, persistmap);
 	noise_terrain_alt->noiseMap2D(node_min.X, node_min.Z, persistmap);
-	noise_height_select->noiseMap2D(node_min.X, node_min.Z);
+	noiseMap2D(noise_height_select, node_min.X, node_min.Z);
+
+	// Calculated together below
+	std::vector<Noise *> noises_3d;
 
 	if (spflags & MGV7_MOUNTAINS) {
-		noise_mount_height->noiseMap2D(node_min.X, node_min.Z);
-		noise_mountain->noiseMap3D(node_min.X, node_min.Y - 1, node_min.Z);
+		noiseMap2D(noise_mount_height, node_min.X, node_min.Z);
+		noises_3d.push_back(noise_mountain);
 	}
 
 	//// Floatlands
@@ -497,7 +500,7 @@ int MapgenV7::generateTerrain()
 			node_max.Y >= floatland_ymin && node_min.Y <= floatland_ymax) {
 		gen_floatlands = true;
 		// Calculate noise for floatland generation
-		noise_floatland->noiseMap3D(node_min.X, node_min.Y - 1, node_min.Z);
+		noises_3d.push_back(noise_floatland);
 
 		// Cache floatland noise offset values, for floatland tapering
 		for (s16 y = node_min.Y - 1; y <= node_max.Y + 1; y++, cache_index++) {
@@ -518,10 +521,12 @@ int MapgenV7::generateTerrain()
 	bool gen_rivers = (spflags & MGV7_RIDGES) && node_max.Y >= water_level - 16 &&
 		!gen_floatlands;
 	if (gen_rivers) {
-		noise_ridge->noiseMap3D(node_min.X, node_min.Y - 1, node_min.Z);
-		noise_ridge_uwater->noiseMap2D(node_min.X, node_min.Z);
+		noises_3d.push_back(noise_ridge);
+		noiseMap2D(noise_ridge_uwater, node_min.X, node_min.Z);
 	}
 
+	noiseMaps3D(getChunkPool(), noises_3d, node_min.X, node_min.Y - 1, node_min.Z);
+
 	//// Place nodes
 	const v3s32 &em = vm->m_area.getExtent();
 	s16 stone_surface_max_y = -MAX_MAP_GENERATION_LIMIT;
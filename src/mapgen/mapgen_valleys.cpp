@@ -336,11 +336,11 @@ int MapgenValleys::generateTerrain()
 	MapNode n_stone(c_stone);
 	MapNode n_water(c_water_source);
 
-	noise_inter_valley_slope->noiseMap2D(node_min.X, node_min.Z);
-	noise_rivers->noiseMap2D(node_min.X, node_min.Z);
-	noise_terrain_height->noiseMap2D(node_min.X, node_min.Z);
-	noise_valley_depth->noiseMap2D(node_min.X, node_min.Z);
-	noise_valley_profile->noiseMap2D(node_min.X, node_min.Z);
+	noiseMap2D(noise_inter_valley_slope, node_min.X, node_min.Z);
+	noiseMap2D(noise_rivers, node_min.X, node_min.Z);
+	noiseMap2D(noise_terrain_height, node_min.X, node_min.Z);
+	noiseMap2D(noise_valley_depth, node_min.X, node_min.Z);
+	noiseMap2D(noise_valley_profile, node_min.X, node_min.Z);
 
 	noise_inter_valley_fill->noiseMap3D(node_min.X, node_min.Y - 1, node_min.Z);
 
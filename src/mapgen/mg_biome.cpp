@@ -78,6 +78,15 @@ BiomeManager *BiomeManager::clone() const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+float *BiomeGen::noiseMap2D(Noise *noise, float x, float y)
+{
+	if (noise_cache)
+		return noise_cache->noiseMap2D(noise, x, y);
+	return noise->noiseMap2D(x, y);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void BiomeParamsOriginal::readParams(const Settings *settings)
 {
 	settings->getNoiseParams("mg_biome_np_heat",           np_heat);
@@ -185,10 +194,10 @@ void BiomeGenOriginal::calcBiomeNoise(v3s16 pmin)
 {
 	m_pmin = pmin;
 
-	noise_heat->noiseMap2D(pmin.X, pmin.Z);
-	noise_humidity->noiseMap2D(pmin.X, pmin.Z);
-	noise_heat_blend->noiseMap2D(pmin.X, pmin.Z);
-	noise_humidity_blend->noiseMap2D(pmin.X, pmin.Z);
+	noiseMap2D(noise_heat, pmin.X, pmin.Z);
+	noiseMap2D(noise_humidity, pmin.X, pmin.Z);
+	noiseMap2D(noise_heat_blend, pmin.X, pmin.Z);
+	noiseMap2D(noise_humidity_blend, pmin.X, pmin.Z);
 
 	for (s32 i = 0; i < m_csize.X * m_csize.Z; i++) {
 		noise_heat->result[i]     += noise_heat_blend->result[i];
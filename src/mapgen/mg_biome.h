@@ -130,7 +130,13 @@ class BiomeGen {
 	// Result of calcBiomes bulk computation.
 	biome_t *biomemap = nullptr;
 
+	// Used for 2D noise maps if set, not owned
+	NoiseCache2D *noise_cache = nullptr;
+
 protected:
+	// Same as noise->noiseMap2D(x, y), but uses noise_cache if set
+	float *noiseMap2D(Noise *noise, float x, float y);
+
 	BiomeManager *m_bmgr = nullptr;
 	v3s16 m_pmin;
 	v3s16 m_csize;
@@ -39,12 +39,16 @@ DecorationManager::DecorationManager(IGameDef *gamedef) :
 void DecorationManager::placeAllDecos(Mapgen *mg, u32 blockseed,
 	v3s16 nmin, v3s16 nmax)
 {
+	PlacementFilter filter;
+	filter.update(mg->heightmap, mg->biomemap,
+		(nmax.X - nmin.X + 1) * (nmax.Z - nmin.Z + 1));
+
 	for (size_t i = 0; i != m_objects.size(); i++) {
 		Decoration *deco = (Decoration *)m_objects[i];
 		if (!deco)
 			continue;
 
-		deco->placeDeco(mg, blockseed, nmin, nmax);
+		deco->placeDeco(mg, blockseed, nmin, nmax, filter);
 		blockseed++;
 	}
 }
@@ -124,12 +128,32 @@ bool Decoration::canPlaceDecoration(MMVManip *vm, v3s16 p)
 }
 
 
-void Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
+void Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax,
+	const PlacementFilter &filter)
 {
 	// Skip if y ranges do not overlap
 	if (nmax.Y < y_min || y_max < nmin.Y)
 		return;
 
+	// Skip if the heightmap is out of range everywhere
+	const bool on_heightmap = mg->heightmap &&
+		!(flags & (DECO_ALL_FLOORS | DECO_ALL_CEILINGS | DECO_LIQUID_SURFACE));
+	if (on_heightmap && (filter.height_max < std::max(y_min, nmin.Y) ||
+			filter.height_min > std::min(y_max, nmax.Y)))
+		return;
+
+	const biome_t *biomemap = mg->biomemap;
+	switch (filter.biomeOverlap(biomes)) {
+	case PlacementFilter::BIOMES_NONE:
+		return;
+	case PlacementFilter::BIOMES_ALL:
+		// every column passes, don't check them one by one
+		biomemap = nullptr;
+		break;
+	default:
+		break;
+	}
+
 	PcgRandom ps(blockseed + 53);
 	int carea_size = nmax.X - nmin.X + 1;
 
@@ -140,6 +164,15 @@ void Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 
 	int area = sidelen * sidelen;
 
+	// Noise at the center of every part, all at once
+	const u32 nparts = carea_size / sidelen;
+	std::vector<float> part_noise;
+	if (flags & DECO_USE_NOISE) {
+		part_noise.resize(nparts * nparts);
+		NoiseFractal2DGrid(&np, nmin.X + sidelen / 2, nmin.Z + sidelen / 2,
+			sidelen, sidelen, nparts, nparts, mapseed, part_noise.data());
+	}
+
 	for (s16 z0 = 0; z0 < carea_size; z0 += sidelen)
 	for (s16 x0 = 0; x0 < carea_size; x0 += sidelen) {
 		v2s16 p2d_min(nmin.X + x0, nmin.Z + z0);
@@ -148,7 +181,7 @@ void Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 		bool cover = false;
 		// Amount of decorations
 		float nval = (flags & DECO_USE_NOISE) ?
-			NoiseFractal2D(&np, p2d_min.X + sidelen / 2, p2d_min.Y + sidelen / 2, mapseed) :
+			part_noise[(z0 / sidelen) * nparts + x0 / sidelen] :
 			fill_ratio;
 		u32 deco_count = 0;
 
@@ -188,8 +221,8 @@ void Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 					(flags & DECO_ALL_CEILINGS)) {
 				// All-surfaces decorations
 				// Check biome of column
-				if (mg->biomemap && !biomes.empty()) {
-					auto iter = biomes.find(mg->biomemap[mapindex]);
+				if (biomemap && !biomes.empty()) {
+					auto iter = biomes.find(biomemap[mapindex]);
 					if (iter == biomes.end())
 						continue;
 				}
@@ -238,8 +271,8 @@ void Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 				if (y < y_min || y > y_max || y < nmin.Y || y > nmax.Y)
 					continue;
 
-				if (mg->biomemap && !biomes.empty()) {
-					auto iter = biomes.find(mg->biomemap[mapindex]);
+				if (biomemap && !biomes.empty()) {
+					auto iter = biomes.find(biomemap[mapindex]);
 					if (iter == biomes.end())
 						continue;
 				}
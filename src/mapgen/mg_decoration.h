@@ -15,6 +15,7 @@ typedef u16 biome_t;  // copy from mg_biome.h to avoid an unnecessary include
 class Mapgen;
 class MMVManip;
 class PcgRandom;
+class PlacementFilter;
 class Schematic;
 namespace treegen { struct TreeDef; }
 
@@ -44,7 +45,8 @@ class Decoration : public ObjDef, public NodeResolver {
 	virtual void resolveNodeNames();
 
 	bool canPlaceDecoration(MMVManip *vm, v3s16 p);
-	void placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax);
+	void placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax,
+		const PlacementFilter &filter);
 
 	virtual size_t generate(MMVManip *vm, PcgRandom *pr, v3s16 p, bool ceiling) = 0;
 
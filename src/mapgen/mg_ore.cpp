@@ -34,12 +34,16 @@ size_t OreManager::placeAllOres(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nma
 {
 	size_t nplaced = 0;
 
+	PlacementFilter filter;
+	filter.update(nullptr, mg->biomemap,
+		(nmax.X - nmin.X + 1) * (nmax.Z - nmin.Z + 1));
+
 	for (size_t i = 0; i != m_objects.size(); i++) {
 		Ore *ore = (Ore *)m_objects[i];
 		if (!ore)
 			continue;
 
-		nplaced += ore->placeOre(mg, blockseed, nmin, nmax);
+		nplaced += ore->placeOre(mg, blockseed, nmin, nmax, filter);
 		blockseed++;
 	}
 
@@ -81,11 +85,24 @@ void Ore::resolveNodeNames()
 }
 
 
-size_t Ore::placeOre(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
+size_t Ore::placeOre(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax,
+	const PlacementFilter &filter)
 {
 	if (nmin.Y > y_max || nmax.Y < y_min)
 		return 0;
 
+	biome_t *biomemap = mg->biomemap;
+	switch (filter.biomeOverlap(biomes)) {
+	case PlacementFilter::BIOMES_NONE:
+		return 0;
+	case PlacementFilter::BIOMES_ALL:
+		// every column passes, don't check them one by one
+		biomemap = nullptr;
+		break;
+	default:
+		break;
+	}
+
 	int actual_ymin = MYMAX(nmin.Y, y_min);
 	int actual_ymax = MYMIN(nmax.Y, y_max);
 	if (clust_size >= actual_ymax - actual_ymin + 1)
@@ -93,7 +110,7 @@ size_t Ore::placeOre(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 
 	nmin.Y = actual_ymin;
 	nmax.Y = actual_ymax;
-	generate(mg->vm, mg->seed, blockseed, nmin, nmax, mg->biomemap);
+	generate(mg->vm, mg->seed, blockseed, nmin, nmax, biomemap);
 
 	return 1;
 }
@@ -149,10 +166,7 @@ void OreScatter::generate(MMVManip *vm, int mapseed, u32 blockseed,
 		int y0 = pr.range(nmin.Y, nmax.Y - csize + 1);
 		int z0 = pr.range(nmin.Z, nmax.Z - csize + 1);
 
-		if ((flags & OREFLAG_USE_NOISE) &&
-			(NoiseFractal3D(&np, x0, y0, z0, mapseed) < nthresh))
-			continue;
-
+		// Biome first, it is cheaper than the noise
 		if (biomemap && !biomes.empty()) {
 			u32 index = sizex * (z0 - nmin.Z) + (x0 - nmin.X);
 			auto it = biomes.find(biomemap[index]);
@@ -160,6 +174,10 @@ void OreScatter::generate(MMVManip *vm, int mapseed, u32 blockseed,
 				continue;
 		}
 
+		if ((flags & OREFLAG_USE_NOISE) &&
+			(NoiseFractal3D(&np, x0, y0, z0, mapseed) < nthresh))
+			continue;
+
 		for (u32 z1 = 0; z1 != csize; z1++)
 		for (u32 y1 = 0; y1 != csize; y1++)
 		for (u32 x1 = 0; x1 != csize; x1++) {
@@ -457,24 +475,30 @@ void OreVein::generate(MMVManip *vm, int mapseed, u32 blockseed,
 		sizey_prev = sizey;
 	}
 
+	// Columns in one of the biomes, rather than a lookup for every node
+	std::vector<bool> in_biomes;
+	if (biomemap && !biomes.empty()) {
+		const size_t columns = sizex * (nmax.Z - nmin.Z + 1);
+		in_biomes.resize(columns);
+		for (size_t i = 0; i != columns; i++)
+			in_biomes[i] = biomes.count(biomemap[i]) != 0;
+	}
+
 	bool noise_generated = false;
 	size_t index = 0;
 	for (int z = nmin.Z; z <= nmax.Z; z++)
 	for (int y = nmin.Y; y <= nmax.Y; y++)
 	for (int x = nmin.X; x <= nmax.X; x++, index++) {
+		if (!in_biomes.empty() &&
+				!in_biomes[sizex * (z - nmin.Z) + (x - nmin.X)])
+			continue;
+
 		u32 i = vm->m_area.index(x, y, z);
 		if (!vm->m_area.contains(i))
 			continue;
 		if (!CONTAINS(c_wherein, vm->m_data[i].getContent()))
 			continue;
 
-		if (biomemap && !biomes.empty()) {
-			u32 bmapidx = sizex * (z - nmin.Z) + (x - nmin.X);
-			auto it = biomes.find(biomemap[bmapidx]);
-			if (it == biomes.end())
-				continue;
-		}
-
 		// Same lazy generation optimization as in OreBlob
 		if (!noise_generated) {
 			noise_generated = true;
@@ -15,6 +15,7 @@ typedef u16 biome_t;  // copy from mg_biome.h to avoid an unnecessary include
 class Noise;
 class Mapgen;
 class MMVManip;
+class PlacementFilter;
 
 /////////////////// Ore generation flags
 
@@ -58,7 +59,8 @@ class Ore : public ObjDef, public NodeResolver {
 
 	virtual void resolveNodeNames();
 
-	size_t placeOre(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax);
+	size_t placeOre(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax,
+		const PlacementFilter &filter);
 	virtual void generate(MMVManip *vm, int mapseed, u32 blockseed,
 		v3s16 nmin, v3s16 nmax, biome_t *biomemap) = 0;
 
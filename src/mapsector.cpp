@@ -30,19 +30,20 @@ void MapSector::deleteBlocks()
 
 MapBlock *MapSector::getBlockBuffered(s16 y)
 {
-	MapBlock *block;
+	MapBlock *block = m_block_cache.load(std::memory_order_relaxed);
 
-	if (m_block_cache && y == m_block_cache_y) {
-		return m_block_cache;
+	if (block && y == block->getPos().Y) {
+		return block;
 	}
 
 	// If block doesn't exist, return NULL
 	auto it = m_blocks.find(y);
-	block = it != m_blocks.end() ? it->second.get() : nullptr;
+	if (it == m_blocks.end())
+		return nullptr;
+	block = it->second.get();
 
 	// Cache the last result
-	m_block_cache_y = y;
-	m_block_cache = block;
+	m_block_cache.store(block, std::memory_order_relaxed);
 
 	return block;
 }
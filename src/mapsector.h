@@ -7,6 +7,7 @@
 #include "irrlichttypes.h"
 #include "irr_v2d.h"
 #include "mapblock.h"
+#include <atomic>
 #include <ostream>
 #include <memory>
 #include <map>
@@ -74,8 +75,9 @@ class MapSector
 
 	// Last-used block is cached here for quicker access.
 	// Be sure to set this to nullptr when the cached block is deleted
-	MapBlock *m_block_cache = nullptr;
-	s16 m_block_cache_y;
+	// Atomic so that several threads may look up blocks at once as long as
+	// nobody modifies the sector meanwhile.
+	std::atomic<MapBlock *> m_block_cache{nullptr};
 
 	/*
 		Private methods
@@ -8,11 +8,12 @@
 #include "networkprotocol.h" // session_t
 
 class NetworkPacket;
-class PeerHandler;
 
 namespace con
 {
 
+class PeerHandler;
+
 enum rtt_stat_type {
 	MIN_RTT,
 	MAX_RTT,
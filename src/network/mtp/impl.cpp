@@ -163,13 +163,19 @@ SharedBuffer<u8> makeReliablePacket(const SharedBuffer<u8> &data, u16 seqnum)
 	ReliablePacketBuffer
 */
 
+// Ring capacity that is kept when the buffer becomes empty
+static constexpr size_t RELIABLE_RING_KEEP_SIZE = 256;
+
 void ReliablePacketBuffer::print()
 {
 	MutexAutoLock listlock(m_list_mutex);
 	LOG(dout_con<<"Dump of ReliablePacketBuffer:" << std::endl);
 	unsigned int index = 0;
-	for (BufferedPacketPtr &packet : m_list) {
-		LOG(dout_con<<index<< ":" << packet->getSeqnum() << std::endl);
+	for (u32 i = 0; m_count > 0 && i <= (u16)(m_last - m_first); i++) {
+		const Slot &slot = getSlotNoLock(m_first + i);
+		if (!slot.packet)
+			continue;
+		LOG(dout_con<<index<< ":" << slot.packet->getSeqnum() << std::endl);
 		index++;
 	}
 }
@@ -177,69 +183,126 @@ void ReliablePacketBuffer::print()
 bool ReliablePacketBuffer::empty()
 {
 	MutexAutoLock listlock(m_list_mutex);
-	return m_list.empty();
+	return m_count == 0;
 }
 
 u32 ReliablePacketBuffer::size()
 {
 	MutexAutoLock listlock(m_list_mutex);
-	return m_list.size();
+	return m_count;
+}
+
+ReliablePacketBuffer::Slot *ReliablePacketBuffer::getSlotNoLock(
+		const QueueEntry &e, bool check_resend)
+{
+	if (m_count == 0)
+		return nullptr;
+	Slot &slot = getSlotNoLock(e.seqnum);
+	if (!slot.packet || slot.serial != e.serial)
+		return nullptr;
+	if (check_resend && slot.packet->resend_count != e.resend_count)
+		return nullptr;
+	return &slot;
+}
+
+void ReliablePacketBuffer::reserveNoLock(u32 span)
+{
+	if (span <= m_slots.size())
+		return;
+
+	size_t capacity = std::max<size_t>(m_slots.size(), 64);
+	while (capacity < span)
+		capacity *= 2;
+
+	std::vector<Slot> old(capacity);
+	old.swap(m_slots);
+	for (Slot &slot : old) {
+		if (slot.packet)
+			getSlotNoLock(slot.packet->getSeqnum()) = std::move(slot);
+	}
+}
+
+BufferedPacketPtr ReliablePacketBuffer::removeNoLock(u16 seqnum)
+{
+	Slot &slot = getSlotNoLock(seqnum);
+	BufferedPacketPtr p = std::move(slot.packet);
+	p->time = m_clock - slot.sent;
+	p->totaltime = m_clock - slot.inserted;
+	slot = Slot();
+
+	if (--m_count == 0) {
+		m_inserted.clear();
+		m_sent.clear();
+		// don't keep the memory of a burst around
+		if (m_slots.size() > RELIABLE_RING_KEEP_SIZE)
+			std::vector<Slot>().swap(m_slots);
+		return p;
+	}
+
+	// Every slot is skipped at most once per packet, so this is O(1)
+	// on average.
+	while (!getSlotNoLock(m_first).packet)
+		m_first++;
+	while (!getSlotNoLock(m_last).packet)
+		m_last--;
+	popOutdatedNoLock();
+	return p;
 }
 
-ReliablePacketBuffer::FindResult ReliablePacketBuffer::findPacketNoLock(u16 seqnum)
+void ReliablePacketBuffer::popOutdatedNoLock()
 {
-	for (auto it = m_list.begin(); it != m_list.end(); ++it) {
-		if ((*it)->getSeqnum() == seqnum)
-			return it;
+	// Packets are mostly acked in order, so this catches most entries.
+	// The rest is handled by compactQueuesNoLock().
+	while (!m_inserted.empty() && !getSlotNoLock(m_inserted.front(), false))
+		m_inserted.pop_front();
+	while (!m_sent.empty() && !getSlotNoLock(m_sent.front(), true))
+		m_sent.pop_front();
+}
+
+void ReliablePacketBuffer::compactQueuesNoLock()
+{
+	for (auto *queue : {&m_inserted, &m_sent}) {
+		if (queue->size() < 2 * m_count + 64)
+			continue;
+		const bool check_resend = queue == &m_sent;
+		std::deque<QueueEntry> valid;
+		for (const QueueEntry &e : *queue) {
+			if (getSlotNoLock(e, check_resend))
+				valid.push_back(e);
+		}
+		queue->swap(valid);
 	}
-	return m_list.end();
 }
 
 bool ReliablePacketBuffer::getFirstSeqnum(u16& result)
 {
 	MutexAutoLock listlock(m_list_mutex);
-	if (m_list.empty())
+	if (m_count == 0)
 		return false;
-	result = m_list.front()->getSeqnum();
+	result = m_first;
 	return true;
 }
 
 BufferedPacketPtr ReliablePacketBuffer::popFirst()
 {
 	MutexAutoLock listlock(m_list_mutex);
-	if (m_list.empty())
+	if (m_count == 0)
 		throw NotFoundException("Buffer is empty");
 
-	BufferedPacketPtr p(m_list.front());
-	m_list.pop_front();
-
-	if (m_list.empty()) {
-		m_oldest_non_answered_ack = 0;
-	} else {
-		m_oldest_non_answered_ack = m_list.front()->getSeqnum();
-	}
-	return p;
+	return removeNoLock(m_first);
 }
 
 BufferedPacketPtr ReliablePacketBuffer::popSeqnum(u16 seqnum)
 {
 	MutexAutoLock listlock(m_list_mutex);
-	auto r = findPacketNoLock(seqnum);
-	if (r == m_list.end()) {
+	if (m_count == 0 || !getSlotNoLock(seqnum).packet ||
+			getSlotNoLock(seqnum).packet->getSeqnum() != seqnum) {
 		LOG(dout_con<<"Sequence number: " << seqnum
 				<< " not found in reliable buffer"<<std::endl);
 		throw NotFoundException("seqnum not found in buffer");
 	}
 
-	BufferedPacketPtr p(*r);
-	m_list.erase(r);
-
-	if (m_list.empty()) {
-		m_oldest_non_answered_ack = 0;
-	} else {
-		m_oldest_non_answered_ack = m_list.front()->getSeqnum();
-	}
-	return p;
+	return removeNoLock(seqnum);
 }
 
 void ReliablePacketBuffer::insert(BufferedPacketPtr &p_ptr, u16 next_expected)
@@ -271,45 +334,25 @@ void ReliablePacketBuffer::insert(BufferedPacketPtr &p_ptr, u16 next_expected)
 		return;
 	}
 
-	sanity_check(m_list.size() <= SEQNUM_MAX); // FIXME: Handle the error?
-
-	// Find the right place for the packet and insert it there
-	// If list is empty, just add it
-	if (m_list.empty()) {
-		m_list.push_back(p_ptr);
-		m_oldest_non_answered_ack = seqnum;
-		// Done.
-		return;
-	}
-
-	// Otherwise find the right place
-	auto it = m_list.begin();
-	// Find the first packet in the list which has a higher seqnum
-	u16 s = (*it)->getSeqnum();
-
-	/* case seqnum is smaller then next_expected seqnum */
-	/* this is true e.g. on wrap around */
-	if (seqnum < next_expected) {
-		while(((s < seqnum) || (s >= next_expected)) && (it != m_list.end())) {
-			++it;
-			if (it != m_list.end())
-				s = (*it)->getSeqnum();
-		}
-	}
-	/* non wrap around case (at least for incoming and next_expected */
-	else
-	{
-		while(((s < seqnum) && (s >= next_expected)) && (it != m_list.end())) {
-			++it;
-			if (it != m_list.end())
-				s = (*it)->getSeqnum();
-		}
-	}
-
-	if (s == seqnum) {
-		/* nothing to do this seems to be a resent packet */
+	if (m_count == 0) {
+		m_first = m_last = seqnum;
+	} else {
+		// Order relative to next_expected, this handles the wrap around
+		const u16 rel = seqnum - next_expected;
+		const u16 first = rel < (u16)(m_first - next_expected) ? seqnum : m_first;
+		const u16 last = rel > (u16)(m_last - next_expected) ? seqnum : m_last;
+		reserveNoLock((u16)(last - first) + 1);
+		m_first = first;
+		m_last = last;
+	}
+	if (m_slots.empty())
+		reserveNoLock(1);
+
+	Slot &slot = getSlotNoLock(seqnum);
+	if (slot.packet) {
+		/* this seems to be a resent packet */
 		/* for paranoia reason data should be compared */
-		auto &i = *it;
+		auto &i = slot.packet;
 		if (
 			(i->getSeqnum() != seqnum) ||
 			(i->size() != p.size()) ||
@@ -334,40 +377,45 @@ void ReliablePacketBuffer::insert(BufferedPacketPtr &p_ptr, u16 next_expected)
 			warningstream << buf << std::flush;
 			throw IncomingDataCorruption("duplicated packet isn't same as original one");
 		}
-	}
-	/* insert or push back */
-	else if (it != m_list.end()) {
-		m_list.insert(it, p_ptr);
-	} else {
-		m_list.push_back(p_ptr);
+		return;
 	}
 
-	/* update last packet number */
-	m_oldest_non_answered_ack = m_list.front()->getSeqnum();
+	slot.packet = p_ptr;
+	slot.serial = m_next_serial++;
+	slot.inserted = m_clock - p.totaltime;
+	slot.sent = m_clock - p.time;
+	m_count++;
+
+	compactQueuesNoLock();
+	m_inserted.push_back({slot.inserted, slot.serial, p.resend_count, seqnum});
+	m_sent.push_back({slot.sent, slot.serial, p.resend_count, seqnum});
 }
 
 void ReliablePacketBuffer::fixPeerId(session_t new_id)
 {
 	MutexAutoLock listlock(m_list_mutex);
-	for (auto &packet : m_list)
-		packet->setSenderPeerId(new_id);
+	for (u32 i = 0; m_count > 0 && i <= (u16)(m_last - m_first); i++) {
+		Slot &slot = getSlotNoLock(m_first + i);
+		if (slot.packet)
+			slot.packet->setSenderPeerId(new_id);
+	}
 }
 
 void ReliablePacketBuffer::incrementTimeouts(float dtime)
 {
 	MutexAutoLock listlock(m_list_mutex);
-	for (auto &packet : m_list) {
-		packet->time += dtime;
-		packet->totaltime += dtime;
-	}
+	m_clock += dtime;
 }
 
 u32 ReliablePacketBuffer::getTimedOuts(float timeout)
 {
 	MutexAutoLock listlock(m_list_mutex);
+	// Only look at the packets that are old enough
 	u32 count = 0;
-	for (auto &packet : m_list) {
-		if (packet->totaltime >= timeout)
+	for (const QueueEntry &e : m_inserted) {
+		if (m_clock - e.time < timeout)
+			break;
+		if (getSlotNoLock(e, false))
 			count++;
 	}
 	return count;
@@ -378,21 +426,44 @@ std::vector<ConstSharedPtr<BufferedPacket>>
 {
 	MutexAutoLock listlock(m_list_mutex);
 	std::vector<ConstSharedPtr<BufferedPacket>> timed_outs;
-	for (auto &packet : m_list) {
-		// resend time scales exponentially with each cycle
-		const float pkt_timeout = timeout * powf(RESEND_SCALE_BASE, packet->resend_count);
 
-		if (packet->time < pkt_timeout)
+	// Only the packets at the front have been waiting for at least timeout.
+	// The ones that are not due yet because of their resend count go back
+	// to the front in the same order.
+	std::vector<QueueEntry> keep;
+	while (!m_sent.empty() && timed_outs.size() < max_packets) {
+		const QueueEntry e = m_sent.front();
+		if (m_clock - e.time < timeout)
+			break;
+		m_sent.pop_front();
+
+		Slot *slot = getSlotNoLock(e, true);
+		if (!slot)
 			continue;
 
+		// resend time scales exponentially with each cycle
+		const float pkt_timeout = timeout * powf(RESEND_SCALE_BASE, e.resend_count);
+		if (m_clock - slot->sent < pkt_timeout) {
+			keep.push_back(e);
+			continue;
+		}
+
 		// caller will resend packet so reset time and increase counter
+		BufferedPacketPtr &packet = slot->packet;
+		slot->sent = m_clock;
 		packet->time = 0.0f;
+		packet->totaltime = m_clock - slot->inserted;
 		packet->resend_count++;
 
 		timed_outs.emplace_back(packet);
+	}
 
-		if (timed_outs.size() >= max_packets)
-			break;
+	for (auto it = keep.rbegin(); it != keep.rend(); ++it)
+		m_sent.push_front(*it);
+	for (const auto &packet : timed_outs) {
+		const Slot &slot = getSlotNoLock(packet->getSeqnum());
+		m_sent.push_back({slot.sent, slot.serial, packet->resend_count,
+			packet->getSeqnum()});
 	}
 	return timed_outs;
 }
@@ -272,7 +272,7 @@ class Connection final : public IConnection
 
 	UDPSocket m_udpSocket;
 	// Command queue: user -> SendThread
-	MutexedQueue<ConnectionCommandPtr> m_command_queue;
+	MPSCQueue<ConnectionCommandPtr> m_command_queue;
 
 	void putEvent(ConnectionEventPtr e);
 
@@ -284,7 +284,7 @@ class Connection final : public IConnection
 	}
 private:
 	// Event queue: ReceiveThread -> user
-	MutexedQueue<ConnectionEventPtr> m_event_queue;
+	MPSCQueue<ConnectionEventPtr> m_event_queue;
 
 	session_t m_peer_id = 0;
 	u32 m_protocol_id;
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "network/mtp/impl.h"
+#include <deque>
 
 // Constant that differentiates the protocol from random data and other protocols
 #define PROTOCOL_ID 0x4f457403
@@ -278,13 +279,54 @@ class ReliablePacketBuffer
 
 
 private:
-	typedef std::list<BufferedPacketPtr>::iterator FindResult;
-
-	FindResult findPacketNoLock(u16 seqnum);
-
-	std::list<BufferedPacketPtr> m_list;
-
-	u16 m_oldest_non_answered_ack;
+	/*
+		Packets are stored in a ring indexed by seqnum, which grows so that
+		it can hold all seqnums between the first and the last packet.
+		The times of a packet are relative to m_clock, so that advancing
+		them is O(1). They are written to the packet when it leaves.
+	*/
+	struct Slot {
+		BufferedPacketPtr packet;
+		// unique per insertion, to recognize outdated entries in queues
+		u32 serial = 0;
+		double inserted = 0;
+		double sent = 0;
+	};
+
+	// Refers to a slot in the order of insertion or last send
+	struct QueueEntry {
+		double time;
+		u32 serial;
+		unsigned int resend_count;
+		u16 seqnum;
+	};
+
+	Slot &getSlotNoLock(u16 seqnum)
+	{
+		return m_slots[seqnum & (m_slots.size() - 1)];
+	}
+	// Returns the slot that a queue entry refers to, or nullptr if outdated
+	Slot *getSlotNoLock(const QueueEntry &e, bool check_resend);
+	// Grows the ring to hold at least span seqnums
+	void reserveNoLock(u32 span);
+	BufferedPacketPtr removeNoLock(u16 seqnum);
+	// Drops outdated queue entries at the front of the queues
+	void popOutdatedNoLock();
+	// Drops outdated queue entries once they make up most of the queue
+	void compactQueuesNoLock();
+
+	std::vector<Slot> m_slots;
+	// Seqnums of the first and last packet, valid if m_count > 0
+	u16 m_first = 0;
+	u16 m_last = 0;
+	u32 m_count = 0;
+	u32 m_next_serial = 0;
+
+	double m_clock = 0;
+	// Ordered by insertion time, used to find packets that are too old
+	std::deque<QueueEntry> m_inserted;
+	// Ordered by time of the last send, used to find packets to resend
+	std::deque<QueueEntry> m_sent;
 
 	std::mutex m_list_mutex;
 };
@@ -371,6 +413,9 @@ struct ConnectionCommand
 // accept from peers vs. what we use for sending.
 #define MAX_RELIABLE_WINDOW_SIZE 0x8000
 #define MAX_RELIABLE_WINDOW_SIZE_SEND 2048
+// Future packets further ahead are dropped without an ack rather than buffered,
+// the sender resends them. This bounds the memory a peer can make us allocate.
+#define MAX_RELIABLE_WINDOW_SIZE_RECV (2 * MAX_RELIABLE_WINDOW_SIZE_SEND)
 /* starting value for window size */
 #define START_RELIABLE_WINDOW_SIZE 64
 /* minimum value for window size */
@@ -123,6 +123,8 @@ void *ConnectionSendThread::run()
 		/* send queued packets */
 		sendPackets(dtime, calculate_quota());
 
+		flushSends();
+
 		END_DEBUG_EXCEPTION_HANDLER
 	}
 
@@ -299,16 +301,43 @@ void ConnectionSendThread::resendReliable(Channel &channel, const BufferedPacket
 void ConnectionSendThread::rawSend(const BufferedPacket *p)
 {
 	assert(p);
-	try {
-		m_connection->m_udpSocket.Send(p->address, p->data, p->size());
-		//LOG(dout_con << m_connection->getDesc()
-		//	<< " rawSend: " << p->size()
-		//	<< " bytes sent" << std::endl);
-	} catch (SendFailedException &e) {
+	m_send_addresses.push_back(p->address);
+	m_send_data.insert(m_send_data.end(), p->data, p->data + p->size());
+	m_send_sizes.push_back(p->size());
+
+	if (m_send_sizes.size() >= SEND_BATCH)
+		flushSends();
+}
+
+void ConnectionSendThread::flushSends()
+{
+	const int count = m_send_sizes.size();
+	if (count == 0)
+		return;
+
+	const u8 *data[SEND_BATCH];
+	size_t offset = 0;
+	for (int i = 0; i < count; i++) {
+		data[i] = &m_send_data[offset];
+		offset += m_send_sizes[i];
+	}
+
+	int done = 0;
+	while (done < count) {
+		done += m_connection->m_udpSocket.SendMany(&m_send_addresses[done],
+			&data[done], &m_send_sizes[done], count - done);
+		if (done == count)
+			break;
+		// skip the packet that failed
 		LOG(derr_con << m_connection->getDesc()
-			<< "SendFailedException: " << e.what() << " to "
-			<< p->address.serializeString() << std::endl);
+			<< "Failed to send packet to "
+			<< m_send_addresses[done].serializeString() << std::endl);
+		done++;
 	}
+
+	m_send_addresses.clear();
+	m_send_data.clear();
+	m_send_sizes.clear();
 }
 
 void ConnectionSendThread::sendAsPacketReliable(BufferedPacketPtr &p, Channel *channel)
@@ -509,6 +538,7 @@ void ConnectionSendThread::serve(Address bind_address)
 {
 	LOG(dout_con << m_connection->getDesc()
 		<< "UDP serving at port " << bind_address.serializeString() << std::endl);
+	flushSends();
 	try {
 		m_connection->m_udpSocket.Bind(bind_address);
 		m_connection->SetPeerID(PEER_ID_SERVER);
@@ -536,6 +566,7 @@ void ConnectionSendThread::connect(Address address)
 	else
 		bind_addr.setAddress(static_cast<u32>(0));
 
+	flushSends();
 	m_connection->m_udpSocket.Bind(bind_addr);
 
 	// Send a dummy packet to server with peer_id = PEER_ID_INEXISTENT
@@ -824,8 +855,33 @@ void ConnectionSendThread::sendAsPacket(session_t peer_id, u8 channelnum,
 	m_outgoing_queue.push(packet);
 }
 
+ConnectionReceiveWorker::ConnectionReceiveWorker(ConnectionReceiveThread *parent) :
+	Thread("ConnectionRecvW"),
+	queue(ConnectionReceiveThread::MAX_WORKER_QUEUE),
+	m_parent(parent)
+{
+}
+
+void *ConnectionReceiveWorker::run()
+{
+	while (!stopRequested()) {
+		BEGIN_DEBUG_EXCEPTION_HANDLER
+
+		// times out regularly to notice when to stop
+		IncomingPacket pkt = queue.pop_frontNoEx(100);
+		if (pkt.peer_id != PEER_ID_INEXISTENT)
+			m_parent->processIncoming(pkt);
+
+		END_DEBUG_EXCEPTION_HANDLER
+	}
+	return nullptr;
+}
+
 ConnectionReceiveThread::ConnectionReceiveThread() :
-	Thread("ConnectionReceive")
+	Thread("ConnectionReceive"),
+	m_worker_count(g_settings->getU16("network_receive_threads")),
+	m_workers(m_worker_count),
+	m_packetdata(RECEIVE_BATCH * PACKET_MAXSIZE)
 {
 }
 
@@ -840,14 +896,6 @@ void *ConnectionReceiveThread::run()
 	ThreadIdentifier);
 	PROFILE(ThreadIdentifier << "ConnectionReceive: [" << m_connection->getDesc() << "]");
 
-	// use IPv6 minimum allowed MTU as receive buffer size as this is
-	// theoretical reliable upper boundary of a udp packet for all IPv6 enabled
-	// infrastructure
-	const unsigned int packet_maxsize = 1500;
-	SharedBuffer<u8> packetdata(packet_maxsize);
-
-	bool packet_queued = true;
-
 #ifdef DEBUG_CONNECTION_KBPS
 	u64 curtime = porting::getTimeMs();
 	u64 lasttime = curtime;
@@ -866,7 +914,7 @@ void *ConnectionReceiveThread::run()
 #endif
 
 		/* receive packets */
-		receive(packetdata, packet_queued);
+		receive();
 
 #ifdef DEBUG_CONNECTION_KBPS
 		debug_print_timer += dtime;
@@ -921,186 +969,196 @@ void *ConnectionReceiveThread::run()
 		END_DEBUG_EXCEPTION_HANDLER
 	}
 
+	for (auto &worker : m_workers) {
+		if (worker)
+			worker->stop();
+	}
+	for (auto &worker : m_workers) {
+		if (worker)
+			worker->wait();
+	}
+
 	PROFILE(g_profiler->remove(ThreadIdentifier.str()));
 	return NULL;
 }
 
 // Receive packets from the network and buffers and create ConnectionEvents
-void ConnectionReceiveThread::receive(SharedBuffer<u8> &packetdata,
-		bool &packet_queued)
+void ConnectionReceiveThread::receive()
 {
-	try {
-		// First, see if there any buffered packets we can process now
-		if (packet_queued) {
-			session_t peer_id;
-			SharedBuffer<u8> resultdata;
-			while (true) {
-				try {
-					if (!getFromBuffers(peer_id, resultdata))
-						break;
-
-					m_connection->putEvent(ConnectionEvent::dataReceived(peer_id, resultdata));
-				}
-				catch (ProcessedSilentlyException &e) {
-					/* try reading again */
-				}
-			}
-			packet_queued = false;
-		}
-
-		// Call Receive() to wait for incoming data
-		Address sender;
-		s32 received_size = m_connection->m_udpSocket.Receive(sender,
-			*packetdata, packetdata.getSize());
-		if (received_size < 0)
-			return;
+	int count = m_connection->m_udpSocket.ReceiveMany(m_senders, *m_packetdata,
+		PACKET_MAXSIZE, m_sizes, RECEIVE_BATCH);
+	for (int i = 0; i < count; i++)
+		handleDatagram(m_senders[i], &m_packetdata[i * PACKET_MAXSIZE], m_sizes[i]);
+}
 
-		if ((received_size < BASE_HEADER_SIZE) ||
-				(readU32(&packetdata[0]) != m_connection->GetProtocolID())) {
-			LOG(derr_con << m_connection->getDesc()
-				<< "Receive(): Invalid incoming packet, "
-				<< "size: " << received_size
-				<< ", protocol: "
-				<< ((received_size >= 4) ? readU32(&packetdata[0]) : -1)
-				<< std::endl);
-			return;
-		}
+void ConnectionReceiveThread::handleDatagram(const Address &sender,
+		const u8 *packetdata, s32 received_size)
+{
+	if ((received_size < BASE_HEADER_SIZE) ||
+			(readU32(&packetdata[0]) != m_connection->GetProtocolID())) {
+		LOG(derr_con << m_connection->getDesc()
+			<< "Receive(): Invalid incoming packet, "
+			<< "size: " << received_size
+			<< ", protocol: "
+			<< ((received_size >= 4) ? readU32(&packetdata[0]) : -1)
+			<< std::endl);
+		return;
+	}
 
-		session_t peer_id = readPeerId(*packetdata);
-		u8 channelnum = readChannel(*packetdata);
+	session_t peer_id = readPeerId(packetdata);
+	u8 channelnum = readChannel(packetdata);
 
-		if (channelnum >= CHANNEL_COUNT) {
-			LOG(derr_con << m_connection->getDesc()
-				<< "Receive(): Invalid channel " << (int)channelnum << std::endl);
-			return;
-		}
+	if (channelnum >= CHANNEL_COUNT) {
+		LOG(derr_con << m_connection->getDesc()
+			<< "Receive(): Invalid channel " << (int)channelnum << std::endl);
+		return;
+	}
 
-		const bool knew_peer_id = peer_id != PEER_ID_INEXISTENT;
-
-		if (!m_connection->ConnectedToServer()) {
-			// Try to identify peer by sender address
-			if (peer_id == PEER_ID_INEXISTENT) {
-				peer_id = m_connection->lookupPeer(sender);
-				if (peer_id != PEER_ID_INEXISTENT) {
-					/* During join it can happen that the CONTROLTYPE_SET_PEER_ID
-					 * packet is lost. Since resends are not active at this stage
-					 * we need to remind the peer manually. */
-					m_connection->doResendOne(peer_id);
-				}
+	const bool knew_peer_id = peer_id != PEER_ID_INEXISTENT;
+	const bool is_client = m_connection->ConnectedToServer();
+
+	if (!is_client) {
+		// Try to identify peer by sender address
+		if (peer_id == PEER_ID_INEXISTENT) {
+			peer_id = m_connection->lookupPeer(sender);
+			if (peer_id != PEER_ID_INEXISTENT) {
+				/* During join it can happen that the CONTROLTYPE_SET_PEER_ID
+				 * packet is lost. Since resends are not active at this stage
+				 * we need to remind the peer manually. */
+				m_connection->doResendOne(peer_id);
 			}
+		}
 
-			// Someone new is trying to talk to us. Add them.
-			if (peer_id == PEER_ID_INEXISTENT) {
-				auto &l = m_new_peer_ratelimit;
-				l.tick();
-				if (++l.counter > MAX_NEW_PEERS_PER_SEC) {
-					if (!l.logged) {
-						warningstream << m_connection->getDesc()
-							<< "Receive(): More than " << MAX_NEW_PEERS_PER_SEC
-							<< " new clients within 1s. Throttling." << std::endl;
-					}
-					l.logged = true;
-					// We simply drop the packet, the client can try again.
-				} else {
-					peer_id = m_connection->createPeer(sender, 0);
+		// Someone new is trying to talk to us. Add them.
+		if (peer_id == PEER_ID_INEXISTENT) {
+			auto &l = m_new_peer_ratelimit;
+			l.tick();
+			if (++l.counter > MAX_NEW_PEERS_PER_SEC) {
+				if (!l.logged) {
+					warningstream << m_connection->getDesc()
+						<< "Receive(): More than " << MAX_NEW_PEERS_PER_SEC
+						<< " new clients within 1s. Throttling." << std::endl;
 				}
+				l.logged = true;
+				// We simply drop the packet, the client can try again.
+			} else {
+				peer_id = m_connection->createPeer(sender, 0);
 			}
 		}
+	}
 
-		PeerHelper peer = m_connection->getPeerNoEx(peer_id);
-		if (!peer) {
-			LOG(dout_con << m_connection->getDesc()
-				<< " got packet from unknown peer_id: "
-				<< peer_id << " Ignoring." << std::endl);
-			return;
-		}
-
-		// Validate peer address
+	PeerHelper peer = m_connection->getPeerNoEx(peer_id);
+	if (!peer) {
+		LOG(dout_con << m_connection->getDesc()
+			<< " got packet from unknown peer_id: "
+			<< peer_id << " Ignoring." << std::endl);
+		return;
+	}
 
-		if (sender != peer->getAddress()) {
-			LOG(derr_con << m_connection->getDesc()
-				<< " Peer " << peer_id << " sending from different address."
-				" Ignoring." << std::endl);
-			return;
-		}
+	// Validate peer address
 
-		if (knew_peer_id) {
-			peer->SetFullyOpen();
-			// Setup phase has a fixed timeout
-			peer->ResetTimeout();
-		} else if (!peer->isHalfOpen()) {
-			// If the peer talks to us without a peer ID when it has done so
-			// before something is definitely fishy.
-			LOG(derr_con << m_connection->getDesc()
-				<< " Peer " << peer_id << " sending without peer id?!"
-				" Ignoring." << std::endl);
-			return;
-		}
+	if (sender != peer->getAddress()) {
+		LOG(derr_con << m_connection->getDesc()
+			<< " Peer " << peer_id << " sending from different address."
+			" Ignoring." << std::endl);
+		return;
+	}
 
-		auto *udpPeer = dynamic_cast<UDPPeer *>(&peer);
-		if (!udpPeer) {
-			LOG(derr_con << m_connection->getDesc()
-				<< "Receive(): peer_id=" << peer_id << " isn't an UDPPeer?!"
-				" Ignoring." << std::endl);
-			return;
-		}
-		Channel *channel = &udpPeer->channels[channelnum];
+	if (knew_peer_id) {
+		peer->SetFullyOpen();
+		// Setup phase has a fixed timeout
+		peer->ResetTimeout();
+	} else if (!peer->isHalfOpen()) {
+		// If the peer talks to us without a peer ID when it has done so
+		// before something is definitely fishy.
+		LOG(derr_con << m_connection->getDesc()
+			<< " Peer " << peer_id << " sending without peer id?!"
+			" Ignoring." << std::endl);
+		return;
+	}
 
-		channel->UpdateBytesReceived(received_size);
+	auto *udpPeer = dynamic_cast<UDPPeer *>(&peer);
+	if (!udpPeer) {
+		LOG(derr_con << m_connection->getDesc()
+			<< "Receive(): peer_id=" << peer_id << " isn't an UDPPeer?!"
+			" Ignoring." << std::endl);
+		return;
+	}
+	udpPeer->channels[channelnum].UpdateBytesReceived(received_size);
+
+	// Make a new SharedBuffer from the data without the base headers
+	IncomingPacket pkt;
+	pkt.peer_id = peer_id;
+	pkt.channelnum = channelnum;
+	pkt.sender = sender;
+	pkt.data = SharedBuffer<u8>(&packetdata[BASE_HEADER_SIZE],
+		received_size - BASE_HEADER_SIZE);
+
+	// A client only has one peer, so there is nothing to parallelize
+	if (m_worker_count == 0 || is_client) {
+		processIncoming(pkt);
+		return;
+	}
 
-		// Throw the received packet to channel->processPacket()
+	auto &worker = m_workers[peer_id % m_worker_count];
+	if (!worker) {
+		worker = std::make_unique<ConnectionReceiveWorker>(this);
+		worker->start();
+	}
+	if (!worker->queue.try_push_back(std::move(pkt))) {
+		// like a full socket buffer, reliable packets will be resent
+		LOG(derr_con << m_connection->getDesc()
+			<< "Receive(): worker overloaded, dropping packet" << std::endl);
+	}
+}
 
-		// Make a new SharedBuffer from the data without the base headers
-		SharedBuffer<u8> strippeddata(received_size - BASE_HEADER_SIZE);
-		memcpy(*strippeddata, &packetdata[BASE_HEADER_SIZE],
-			strippeddata.getSize());
+void ConnectionReceiveThread::processIncoming(const IncomingPacket &pkt)
+{
+	// The peer may have gone away since the packet was queued
+	PeerHelper peer = m_connection->getPeerNoEx(pkt.peer_id);
+	if (!peer || peer->getAddress() != pkt.sender)
+		return;
+	auto *udpPeer = dynamic_cast<UDPPeer *>(&peer);
+	if (!udpPeer)
+		return;
+	Channel *channel = &udpPeer->channels[pkt.channelnum];
 
+	try {
 		try {
 			// Process it (the result is some data with no headers made by us)
 			SharedBuffer<u8> resultdata = processPacket
-				(channel, strippeddata, peer_id, channelnum, false);
+				(channel, pkt.data, pkt.peer_id, pkt.channelnum, false);
 
 			LOG(dout_con << m_connection->getDesc()
-				<< " ProcessPacket from peer_id: " << peer_id
-				<< ", channel: " << (u32)channelnum << ", returned "
+				<< " ProcessPacket from peer_id: " << pkt.peer_id
+				<< ", channel: " << (u32)pkt.channelnum << ", returned "
 				<< resultdata.getSize() << " bytes" << std::endl);
 
-			m_connection->putEvent(ConnectionEvent::dataReceived(peer_id, resultdata));
+			m_connection->putEvent(ConnectionEvent::dataReceived(pkt.peer_id, resultdata));
 		}
 		catch (ProcessedSilentlyException &e) {
 		}
 		catch (ProcessedQueued &e) {
-			// we set it to true anyway (see below)
 		}
 
 		/* Every time we receive a packet it can happen that a previously
-		 * buffered packet is now ready to process. */
-		packet_queued = true;
-	}
-	catch (InvalidIncomingDataException &e) {
-	}
-}
-
-bool ConnectionReceiveThread::getFromBuffers(session_t &peer_id, SharedBuffer<u8> &dst)
-{
-	std::vector<session_t> peerids = m_connection->getPeerIDs();
-
-	for (session_t peerid : peerids) {
-		PeerHelper peer = m_connection->getPeerNoEx(peerid);
-		if (!peer)
-			continue;
-
-		UDPPeer *p = dynamic_cast<UDPPeer *>(&peer);
-		if (!p)
-			continue;
-
-		for (Channel &channel : p->channels) {
-			if (checkIncomingBuffers(&channel, peer_id, dst)) {
-				return true;
+		 * buffered packet of the same channel is now ready to process. */
+		session_t peer_id;
+		SharedBuffer<u8> resultdata;
+		while (true) {
+			try {
+				if (!checkIncomingBuffers(channel, peer_id, resultdata))
+					break;
+
+				m_connection->putEvent(ConnectionEvent::dataReceived(peer_id, resultdata));
+			}
+			catch (ProcessedSilentlyException &e) {
+				/* try reading again */
 			}
 		}
 	}
-	return false;
+	catch (InvalidIncomingDataException &e) {
+	}
 }
 
 bool ConnectionReceiveThread::checkIncomingBuffers(Channel *channel,
@@ -1333,7 +1391,7 @@ SharedBuffer<u8> ConnectionReceiveThread::handlePacketType_Reliable(Channel *cha
 
 	/* packet is within our receive window send ack */
 	if (seqnum_in_window(seqnum,
-		channel->readNextIncomingSeqNum(), MAX_RELIABLE_WINDOW_SIZE)) {
+		channel->readNextIncomingSeqNum(), MAX_RELIABLE_WINDOW_SIZE_RECV)) {
 		m_connection->sendAck(peer->id, channelnum, seqnum);
 	} else {
 		is_future_packet = seqnum_higher(seqnum, channel->readNextIncomingSeqNum());
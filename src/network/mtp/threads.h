@@ -10,6 +10,8 @@
 /********************************************/
 
 #include <cassert>
+#include <memory>
+#include <vector>
 #include "threading/thread.h"
 #include "network/mtp/internal.h"
 
@@ -60,7 +62,10 @@ class ConnectionSendThread : public Thread
 private:
 	void runTimeouts(float dtime, u32 peer_packet_quota);
 	void resendReliable(Channel &channel, const BufferedPacket *k, float resend_timeout);
+	// Queues a packet for sending, see flushSends()
 	void rawSend(const BufferedPacket *p);
+	// Sends the queued packets
+	void flushSends();
 	bool rawSendAsPacket(session_t peer_id, u8 channelnum,
 			const SharedBuffer<u8> &data, bool reliable);
 
@@ -94,11 +99,52 @@ class ConnectionSendThread : public Thread
 	unsigned int m_iteration_packets_avaialble;
 	unsigned int m_max_data_packets_per_iteration;
 	unsigned int m_max_packets_requeued = 256;
+
+	// Packets that are sent in a batch
+	static constexpr size_t SEND_BATCH = 64;
+	std::vector<Address> m_send_addresses;
+	std::vector<u8> m_send_data;
+	std::vector<int> m_send_sizes;
+};
+
+// A packet on its way from the receive thread to a worker
+struct IncomingPacket
+{
+	session_t peer_id = PEER_ID_INEXISTENT;
+	u8 channelnum = 0;
+	Address sender;
+	// without the base header
+	SharedBuffer<u8> data;
+};
+
+class ConnectionReceiveThread;
+
+// Processes the packets of a subset of the peers, see ConnectionReceiveThread
+class ConnectionReceiveWorker : public Thread
+{
+public:
+	ConnectionReceiveWorker(ConnectionReceiveThread *parent);
+
+	void *run();
+
+	// Only filled by the receive thread
+	SPSCRing<IncomingPacket> queue;
+
+private:
+	ConnectionReceiveThread *m_parent;
 };
 
+/*
+	Reads datagrams from the socket and validates them. Packets of known
+	peers are handed to workers, sharded by peer id, so that the packets of
+	each peer are processed in order while different peers are processed in
+	parallel. Without workers everything happens on this thread.
+*/
 class ConnectionReceiveThread : public Thread
 {
 public:
+	friend class ConnectionReceiveWorker;
+
 	ConnectionReceiveThread();
 
 	void *run();
@@ -110,12 +156,23 @@ class ConnectionReceiveThread : public Thread
 	}
 
 private:
-	void receive(SharedBuffer<u8> &packetdata, bool &packet_queued);
+	// Number of datagrams read from the socket at once
+	static constexpr int RECEIVE_BATCH = 32;
+	// use IPv6 minimum allowed MTU as receive buffer size as this is
+	// theoretical reliable upper boundary of a udp packet for all IPv6 enabled
+	// infrastructure
+	static constexpr int PACKET_MAXSIZE = 1500;
+	// Packets waiting for a worker beyond this are dropped
+	static constexpr size_t MAX_WORKER_QUEUE = 4096;
+
+	void receive();
+
+	// Validates a datagram and passes it on for processing
+	void handleDatagram(const Address &sender, const u8 *data, s32 size);
 
-	// Returns next data from a buffer if possible
-	// If found, returns true; if not, false.
-	// If found, sets peer_id and dst
-	bool getFromBuffers(session_t &peer_id, SharedBuffer<u8> &dst);
+	// Processes a packet and whatever buffered packets it makes ready.
+	// Only one thread may do this for a given peer at a time.
+	void processIncoming(const IncomingPacket &pkt);
 
 	bool checkIncomingBuffers(
 			Channel *channel, session_t &peer_id, SharedBuffer<u8> &dst);
@@ -172,5 +229,13 @@ class ConnectionReceiveThread : public Thread
 	Connection *m_connection = nullptr;
 
 	RateLimitHelper m_new_peer_ratelimit;
+
+	const u16 m_worker_count;
+	// started on demand
+	std::vector<std::unique_ptr<ConnectionReceiveWorker>> m_workers;
+
+	Buffer<u8> m_packetdata;
+	Address m_senders[RECEIVE_BATCH];
+	int m_sizes[RECEIVE_BATCH];
 };
 }
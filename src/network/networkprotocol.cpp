@@ -70,10 +70,13 @@
 	PROTOCOL_VERSION 1000
 		Add materials field in ContentFeatures
 		[bump for 1.3.0]
+	PROTOCOL_VERSION 1001
+		Add AO_CMD_UPDATE_POSITION_COMPACT
+		[bump for 1.4.0]
 */
 
 // Note: Also update core.protocol_versions in builtin when bumping
-const u16 LATEST_PROTOCOL_VERSION = 1000;
+const u16 LATEST_PROTOCOL_VERSION = 1001;
 
 // See also formspec [Version History] in doc/lua_api.md
 const u16 FORMSPEC_API_VERSION = 9;
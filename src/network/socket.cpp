@@ -205,6 +205,70 @@ void UDPSocket::Send(const Address &destination, const void *data, int size)
 		throw SendFailedException("Failed to send packet");
 }
 
+int UDPSocket::SendMany(const Address *destinations, const u8 *const *data,
+	const int *sizes, int count)
+{
+#ifdef __linux__
+	if (!INTERNET_SIMULATOR) {
+		// Limit for the arrays below
+		constexpr int MAX_COUNT = 64;
+		struct mmsghdr msgs[MAX_COUNT];
+		struct iovec iovecs[MAX_COUNT];
+		struct sockaddr_in6 addresses[MAX_COUNT];
+
+		int done = 0;
+		while (done < count) {
+			const int n = MYMIN(count - done, MAX_COUNT);
+			memset(msgs, 0, sizeof(msgs[0]) * n);
+			memset(addresses, 0, sizeof(addresses[0]) * n);
+			int valid = 0;
+			for (; valid < n; valid++) {
+				const Address &destination = destinations[done + valid];
+				if (destination.getFamily() != m_addr_family)
+					break;
+				iovecs[valid].iov_base = const_cast<u8 *>(data[done + valid]);
+				iovecs[valid].iov_len = sizes[done + valid];
+				auto &msg = msgs[valid].msg_hdr;
+				msg.msg_iov = &iovecs[valid];
+				msg.msg_iovlen = 1;
+				msg.msg_name = &addresses[valid];
+				if (m_addr_family == AF_INET6) {
+					auto &address = addresses[valid];
+					address.sin6_family = AF_INET6;
+					address.sin6_addr = destination.getAddress6();
+					address.sin6_port = htons(destination.getPort());
+					msg.msg_namelen = sizeof(struct sockaddr_in6);
+				} else {
+					auto &address = reinterpret_cast<sockaddr_in &>(addresses[valid]);
+					address.sin_family = AF_INET;
+					address.sin_addr = destination.getAddress();
+					address.sin_port = htons(destination.getPort());
+					msg.msg_namelen = sizeof(struct sockaddr_in);
+				}
+			}
+			if (valid == 0)
+				return done;
+
+			int sent = sendmmsg(m_handle, msgs, valid, 0);
+			if (sent <= 0)
+				return done;
+			done += sent;
+			if (sent < n)
+				return done;
+		}
+		return done;
+	}
+#endif
+	for (int i = 0; i < count; i++) {
+		try {
+			Send(destinations[i], data[i], sizes[i]);
+		} catch (SendFailedException &e) {
+			return i;
+		}
+	}
+	return count;
+}
+
 int UDPSocket::Receive(Address &sender, void *data, int size)
 {
 	// Return on timeout
@@ -251,6 +315,62 @@ int UDPSocket::Receive(Address &sender, void *data, int size)
 	return received;
 }
 
+int UDPSocket::ReceiveMany(Address *senders, u8 *data, int size, int *sizes, int count)
+{
+#ifdef __linux__
+	// Limit for the arrays below
+	constexpr int MAX_COUNT = 64;
+	count = MYMIN(count, MAX_COUNT);
+	size = MYMAX(size, 0);
+
+	assert(m_timeout_ms >= 0);
+	if (count <= 0 || !WaitData(m_timeout_ms))
+		return 0;
+
+	struct mmsghdr msgs[MAX_COUNT];
+	struct iovec iovecs[MAX_COUNT];
+	struct sockaddr_in6 addresses[MAX_COUNT];
+	memset(msgs, 0, sizeof(msgs[0]) * count);
+	for (int i = 0; i < count; i++) {
+		iovecs[i].iov_base = data + i * size;
+		iovecs[i].iov_len = size;
+		msgs[i].msg_hdr.msg_iov = &iovecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		// big enough for both address families
+		msgs[i].msg_hdr.msg_name = &addresses[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+	}
+
+	// WaitData() said there's something, so don't block for the rest
+	int received = recvmmsg(m_handle, msgs, count, MSG_DONTWAIT, nullptr);
+	if (received < 0)
+		return 0;
+
+	for (int i = 0; i < received; i++) {
+		sizes[i] = msgs[i].msg_len;
+		if (m_addr_family == AF_INET6) {
+			const auto &address = addresses[i];
+			const auto *bytes = reinterpret_cast<const IPv6AddressBytes*>
+				(address.sin6_addr.s6_addr);
+			senders[i] = Address(bytes, ntohs(address.sin6_port));
+		} else {
+			const auto &address = reinterpret_cast<const sockaddr_in &>(addresses[i]);
+			senders[i] = Address(ntohl(address.sin_addr.s_addr),
+				ntohs(address.sin_port));
+		}
+	}
+	return received;
+#else
+	if (count <= 0)
+		return 0;
+	int received = Receive(senders[0], data, size);
+	if (received < 0)
+		return 0;
+	sizes[0] = received;
+	return 1;
+#endif
+}
+
 void UDPSocket::setTimeoutMs(int timeout_ms)
 {
 	m_timeout_ms = timeout_ms;
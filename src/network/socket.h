@@ -24,8 +24,17 @@ class UDPSocket
 	void Bind(Address addr);
 
 	void Send(const Address &destination, const void *data, int size);
+	// Sends several packets with as few system calls as possible.
+	// Returns the number of packets sent, if that is less than count
+	// the next packet could not be sent.
+	int SendMany(const Address *destinations, const u8 *const *data,
+		const int *sizes, int count);
 	// Returns -1 if there is no data
 	int Receive(Address &sender, void *data, int size);
+	// Receives up to count packets with one system call if possible.
+	// Packet i is stored at data + i * size, its length in sizes[i].
+	// Returns the number of packets, 0 if there is no data
+	int ReceiveMany(Address *senders, u8 *data, int size, int *sizes, int count);
 	void setTimeoutMs(int timeout_ms);
 	// Returns true if there is data, false if timeout occurred
 	bool WaitData(int timeout_ms);
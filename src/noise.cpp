@@ -23,6 +23,8 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include "noise.h"
 #include <iostream>
@@ -32,6 +34,20 @@
 #include "util/string.h"
 #include "exceptions.h"
 
+#if defined(__x86_64__) || defined(_M_X64) || \
+		((defined(__i386__) || defined(_M_IX86)) && defined(__SSE2__))
+	#define NOISE_SIMD_X86 1
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define NOISE_TARGET_AVX2
+	#else
+		#define NOISE_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#else
+	#define NOISE_SIMD_X86 0
+#endif
+
 #define NOISE_MAGIC_X    1619
 #define NOISE_MAGIC_Y    31337
 #define NOISE_MAGIC_Z    52591
@@ -305,6 +321,321 @@ float contour(float v)
 }
 
 
+////////////////////////// [ Bulk noise kernels ] /////////////////////////////
+
+/*
+ * Row-wise building blocks of Noise::valueMap2D() and valueMap3D(), with
+ * SIMD variants selected at runtime. All variants perform the same float
+ * operations in the same order, so the results are identical.
+ */
+
+namespace {
+
+struct NoiseKernels {
+	NoiseSimd simd;
+	// out[i] = noise value of the lattice point x0 + i in a row with the
+	// given hash base, see hashBase()
+	void (*noiseRow)(float *out, size_t n, s32 x0, u32 base);
+	// out[i] = linearInterpolation(row[idx[i]], row[idx[i] + 1], t[i])
+	void (*lerpGather)(float *out, size_t n, const float *row,
+		const u32 *idx, const float *t);
+	// out[i] = linearInterpolation(a[i], b[i], t)
+	void (*lerpRows)(float *out, size_t n, const float *a, const float *b, float t);
+	// out[i] = linearInterpolation(linearInterpolation(a[i], b[i], t),
+	//	linearInterpolation(c[i], d[i], t), s)
+	void (*lerpRows2)(float *out, size_t n, const float *a, const float *b,
+		const float *c, const float *d, float t, float s);
+};
+
+// Part of the hash that is the same for a whole row, same as noise2d/noise3d
+inline u32 hashBase(s32 y, s32 z, s32 seed)
+{
+	return NOISE_MAGIC_Y * (u32)y + NOISE_MAGIC_Z * (u32)z + NOISE_MAGIC_SEED * (u32)seed;
+}
+
+inline float hashToNoise(u32 n)
+{
+	n &= 0x7fffffff;
+	n = (n >> 13) ^ n;
+	n = (n * (n * n * 60493 + 19990303) + 1376312589) & 0x7fffffff;
+	return 1.f - (float)(int)n / 0x40000000;
+}
+
+void noiseRowScalar(float *out, size_t n, s32 x0, u32 base)
+{
+	for (size_t i = 0; i < n; i++)
+		out[i] = hashToNoise(NOISE_MAGIC_X * ((u32)x0 + (u32)i) + base);
+}
+
+void lerpGatherScalar(float *out, size_t n, const float *row,
+	const u32 *idx, const float *t)
+{
+	for (size_t i = 0; i < n; i++)
+		out[i] = linearInterpolation(row[idx[i]], row[idx[i] + 1], t[i]);
+}
+
+void lerpRowsScalar(float *out, size_t n, const float *a, const float *b, float t)
+{
+	for (size_t i = 0; i < n; i++)
+		out[i] = linearInterpolation(a[i], b[i], t);
+}
+
+void lerpRows2Scalar(float *out, size_t n, const float *a, const float *b,
+	const float *c, const float *d, float t, float s)
+{
+	for (size_t i = 0; i < n; i++) {
+		out[i] = linearInterpolation(linearInterpolation(a[i], b[i], t),
+			linearInterpolation(c[i], d[i], t), s);
+	}
+}
+
+const NoiseKernels kernels_scalar = {
+	NoiseSimd::None,
+	noiseRowScalar,
+	lerpGatherScalar,
+	lerpRowsScalar,
+	lerpRows2Scalar,
+};
+
+#if NOISE_SIMD_X86
+
+/// SSE2
+
+// SSE2 has no 32-bit multiplication of the low halves
+inline __m128i mulloSSE2(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+		_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+inline __m128 lerpSSE2(__m128 v0, __m128 v1, __m128 t)
+{
+	return _mm_add_ps(v0, _mm_mul_ps(_mm_sub_ps(v1, v0), t));
+}
+
+void noiseRowSSE2(float *out, size_t n, s32 x0, u32 base)
+{
+	const __m128i mask = _mm_set1_epi32(0x7fffffff);
+	const __m128i c1 = _mm_set1_epi32(60493);
+	const __m128i c2 = _mm_set1_epi32(19990303);
+	const __m128i c3 = _mm_set1_epi32(1376312589);
+	const __m128i magic_x = _mm_set1_epi32(NOISE_MAGIC_X);
+	const __m128 scale = _mm_set1_ps(1.f / 0x40000000);
+	const __m128 one = _mm_set1_ps(1.f);
+
+	__m128i x = _mm_add_epi32(_mm_set1_epi32(x0), _mm_setr_epi32(0, 1, 2, 3));
+	const __m128i vbase = _mm_set1_epi32(base);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i h = _mm_and_si128(_mm_add_epi32(mulloSSE2(magic_x, x), vbase), mask);
+		h = _mm_xor_si128(_mm_srli_epi32(h, 13), h);
+		__m128i p = _mm_add_epi32(mulloSSE2(mulloSSE2(h, h), c1), c2);
+		h = _mm_and_si128(_mm_add_epi32(mulloSSE2(h, p), c3), mask);
+		// dividing by a power of two is exact, so multiplying is the same
+		_mm_storeu_ps(out + i, _mm_sub_ps(one, _mm_mul_ps(_mm_cvtepi32_ps(h), scale)));
+		x = _mm_add_epi32(x, _mm_set1_epi32(4));
+	}
+	noiseRowScalar(out + i, n - i, x0 + (s32)i, base);
+}
+
+void lerpGatherSSE2(float *out, size_t n, const float *row,
+	const u32 *idx, const float *t)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const u32 *ix = idx + i;
+		__m128 v0 = _mm_setr_ps(row[ix[0]], row[ix[1]], row[ix[2]], row[ix[3]]);
+		__m128 v1 = _mm_setr_ps(row[ix[0] + 1], row[ix[1] + 1],
+			row[ix[2] + 1], row[ix[3] + 1]);
+		_mm_storeu_ps(out + i, lerpSSE2(v0, v1, _mm_loadu_ps(t + i)));
+	}
+	lerpGatherScalar(out + i, n - i, row, idx + i, t + i);
+}
+
+void lerpRowsSSE2(float *out, size_t n, const float *a, const float *b, float t)
+{
+	const __m128 vt = _mm_set1_ps(t);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(out + i, lerpSSE2(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i), vt));
+	lerpRowsScalar(out + i, n - i, a + i, b + i, t);
+}
+
+void lerpRows2SSE2(float *out, size_t n, const float *a, const float *b,
+	const float *c, const float *d, float t, float s)
+{
+	const __m128 vt = _mm_set1_ps(t);
+	const __m128 vs = _mm_set1_ps(s);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 u = lerpSSE2(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i), vt);
+		__m128 v = lerpSSE2(_mm_loadu_ps(c + i), _mm_loadu_ps(d + i), vt);
+		_mm_storeu_ps(out + i, lerpSSE2(u, v, vs));
+	}
+	lerpRows2Scalar(out + i, n - i, a + i, b + i, c + i, d + i, t, s);
+}
+
+const NoiseKernels kernels_sse2 = {
+	NoiseSimd::SSE2,
+	noiseRowSSE2,
+	lerpGatherSSE2,
+	lerpRowsSSE2,
+	lerpRows2SSE2,
+};
+
+/// AVX2
+
+NOISE_TARGET_AVX2 inline __m256 lerpAVX2(__m256 v0, __m256 v1, __m256 t)
+{
+	return _mm256_add_ps(v0, _mm256_mul_ps(_mm256_sub_ps(v1, v0), t));
+}
+
+NOISE_TARGET_AVX2 void noiseRowAVX2(float *out, size_t n, s32 x0, u32 base)
+{
+	const __m256i mask = _mm256_set1_epi32(0x7fffffff);
+	const __m256i c1 = _mm256_set1_epi32(60493);
+	const __m256i c2 = _mm256_set1_epi32(19990303);
+	const __m256i c3 = _mm256_set1_epi32(1376312589);
+	const __m256i magic_x = _mm256_set1_epi32(NOISE_MAGIC_X);
+	const __m256 scale = _mm256_set1_ps(1.f / 0x40000000);
+	const __m256 one = _mm256_set1_ps(1.f);
+
+	__m256i x = _mm256_add_epi32(_mm256_set1_epi32(x0),
+		_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	const __m256i vbase = _mm256_set1_epi32(base);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i h = _mm256_and_si256(_mm256_add_epi32(
+			_mm256_mullo_epi32(magic_x, x), vbase), mask);
+		h = _mm256_xor_si256(_mm256_srli_epi32(h, 13), h);
+		__m256i p = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_mullo_epi32(h, h), c1), c2);
+		h = _mm256_and_si256(_mm256_add_epi32(_mm256_mullo_epi32(h, p), c3), mask);
+		_mm256_storeu_ps(out + i, _mm256_sub_ps(one,
+			_mm256_mul_ps(_mm256_cvtepi32_ps(h), scale)));
+		x = _mm256_add_epi32(x, _mm256_set1_epi32(8));
+	}
+	noiseRowScalar(out + i, n - i, x0 + (s32)i, base);
+}
+
+NOISE_TARGET_AVX2 void lerpGatherAVX2(float *out, size_t n, const float *row,
+	const u32 *idx, const float *t)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i ix = _mm256_loadu_si256((const __m256i *)(idx + i));
+		__m256 v0 = _mm256_i32gather_ps(row, ix, 4);
+		__m256 v1 = _mm256_i32gather_ps(row + 1, ix, 4);
+		_mm256_storeu_ps(out + i, lerpAVX2(v0, v1, _mm256_loadu_ps(t + i)));
+	}
+	lerpGatherScalar(out + i, n - i, row, idx + i, t + i);
+}
+
+NOISE_TARGET_AVX2 void lerpRowsAVX2(float *out, size_t n, const float *a,
+	const float *b, float t)
+{
+	const __m256 vt = _mm256_set1_ps(t);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(out + i, lerpAVX2(_mm256_loadu_ps(a + i),
+			_mm256_loadu_ps(b + i), vt));
+	}
+	lerpRowsScalar(out + i, n - i, a + i, b + i, t);
+}
+
+NOISE_TARGET_AVX2 void lerpRows2AVX2(float *out, size_t n, const float *a,
+	const float *b, const float *c, const float *d, float t, float s)
+{
+	const __m256 vt = _mm256_set1_ps(t);
+	const __m256 vs = _mm256_set1_ps(s);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 u = lerpAVX2(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), vt);
+		__m256 v = lerpAVX2(_mm256_loadu_ps(c + i), _mm256_loadu_ps(d + i), vt);
+		_mm256_storeu_ps(out + i, lerpAVX2(u, v, vs));
+	}
+	lerpRows2Scalar(out + i, n - i, a + i, b + i, c + i, d + i, t, s);
+}
+
+const NoiseKernels kernels_avx2 = {
+	NoiseSimd::AVX2,
+	noiseRowAVX2,
+	lerpGatherAVX2,
+	lerpRowsAVX2,
+	lerpRows2AVX2,
+};
+
+bool cpuSupportsAVX2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	// the OS must save the AVX registers
+	if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return info[1] & (1 << 5);
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // NOISE_SIMD_X86
+
+const NoiseKernels *getKernelsFor(NoiseSimd simd)
+{
+	switch (simd) {
+#if NOISE_SIMD_X86
+	case NoiseSimd::AVX2:
+		return cpuSupportsAVX2() ? &kernels_avx2 : nullptr;
+	case NoiseSimd::SSE2:
+		return &kernels_sse2;
+#endif
+	case NoiseSimd::None:
+		return &kernels_scalar;
+	default:
+		return nullptr;
+	}
+}
+
+// chosen on first use, by any thread
+std::atomic<const NoiseKernels *> g_kernels{nullptr};
+
+const NoiseKernels &getKernels()
+{
+	const NoiseKernels *kernels = g_kernels.load(std::memory_order_relaxed);
+	if (!kernels) {
+		for (NoiseSimd simd : {NoiseSimd::AVX2, NoiseSimd::SSE2, NoiseSimd::None}) {
+			if ((kernels = getKernelsFor(simd)))
+				break;
+		}
+		g_kernels.store(kernels, std::memory_order_relaxed);
+	}
+	return *kernels;
+}
+
+}
+
+NoiseSimd getNoiseSimd()
+{
+	return getKernels().simd;
+}
+
+bool setNoiseSimd(NoiseSimd simd)
+{
+	const NoiseKernels *kernels = getKernelsFor(simd);
+	if (!kernels)
+		return false;
+	g_kernels.store(kernels, std::memory_order_relaxed);
+	return true;
+}
+
+
 ///////////////////////// [ Fractal value noise ] ////////////////////////////
 
 
@@ -361,6 +692,86 @@ float NoiseFractal3D(const NoiseParams *np, float x, float y, float z, s32 seed)
 }
 
 
+void NoiseFractal2DGrid(const NoiseParams *np, float x, float y,
+	float step_x, float step_y, u32 sx, u32 sy, s32 seed, float *out)
+{
+	if (sx == 0 || sy == 0)
+		return;
+
+	const NoiseKernels &kernels = getKernels();
+	const bool eased = np->flags & (NOISE_FLAG_DEFAULTS | NOISE_FLAG_EASED);
+	const size_t count = (size_t)sx * sy;
+
+	// Same arithmetic as in NoiseFractal2D() and noise2d_value()
+	std::vector<float> px(sx), py(sy), wx(sx);
+	std::vector<u32> ix(sx);
+	for (u32 i = 0; i != sx; i++)
+		px[i] = (x + i * step_x) / np->spread.X;
+	for (u32 j = 0; j != sy; j++)
+		py[j] = (y + j * step_y) / np->spread.Y;
+	seed += np->seed;
+
+	std::fill(out, out + count, 0.0f);
+
+	float f = 1.0;
+	float g = 1.0;
+	std::vector<float> lattice;
+	for (size_t oct = 0; oct < np->octaves; oct++) {
+		const s32 oct_seed = seed + oct;
+		const s32 lx0 = myfloor(px[0] * f);
+		const s32 ly0 = myfloor(py[0] * f);
+		const size_t nlx = myfloor(px[sx - 1] * f) - lx0 + 2;
+		const size_t nly = myfloor(py[sy - 1] * f) - ly0 + 2;
+
+		// Sparse points in fine octaves are cheaper to hash one by one
+		if (nlx * nly > 4 * count) {
+			size_t index = 0;
+			for (u32 j = 0; j != sy; j++)
+			for (u32 i = 0; i != sx; i++, index++) {
+				float noiseval = noise2d_value(px[i] * f, py[j] * f, oct_seed, eased);
+				if (np->flags & NOISE_FLAG_ABSVALUE)
+					noiseval = std::fabs(noiseval);
+				out[index] += g * noiseval;
+			}
+		} else {
+			lattice.resize(nlx * nly);
+			for (size_t j = 0; j != nly; j++)
+				kernels.noiseRow(&lattice[j * nlx], nlx, lx0, hashBase(ly0 + j, 0, oct_seed));
+
+			// Lattice offsets and interpolation weights along X
+			for (u32 i = 0; i != sx; i++) {
+				const float vx = px[i] * f;
+				const s32 x0 = myfloor(vx);
+				ix[i] = x0 - lx0;
+				wx[i] = eased ? easeCurve(vx - (float)x0) : vx - (float)x0;
+			}
+
+			size_t index = 0;
+			for (u32 j = 0; j != sy; j++) {
+				const float vy = py[j] * f;
+				const s32 y0 = myfloor(vy);
+				const float wy = eased ? easeCurve(vy - (float)y0) : vy - (float)y0;
+				const float *row = &lattice[(y0 - ly0) * nlx];
+				for (u32 i = 0; i != sx; i++, index++) {
+					const float *l = &row[ix[i]];
+					float noiseval = biLinearInterpolation(l[0], l[1],
+						l[nlx], l[nlx + 1], wx[i], wy, false);
+					if (np->flags & NOISE_FLAG_ABSVALUE)
+						noiseval = std::fabs(noiseval);
+					out[index] += g * noiseval;
+				}
+			}
+		}
+
+		f *= np->lacunarity;
+		g *= np->persist;
+	}
+
+	for (size_t i = 0; i != count; i++)
+		out[i] = np->offset + out[i] * np->scale;
+}
+
+
 Noise::Noise(const NoiseParams *np_, s32 seed, u32 sx, u32 sy, u32 sz)
 {
 	np = *np_;
@@ -479,24 +890,41 @@ void Noise::resizeNoiseBuf(bool is3d)
 
 
 /*
- * NB:  This algorithm is not optimal in terms of space complexity.  The entire
- * integer lattice of noise points could be done as 2 lines instead, and for 3D,
- * 2 lines + 2 planes.
- * However, this would require the noise calls to be interposed with the
- * interpolation loops, which may trash the icache, leading to lower overall
- * performance.
- * Another optimization that could save half as many noise calls is to carry over
- * values from the previous noise lattice as midpoints in the new lattice for the
- * next octave.
+ * The noise values of the integer lattice are calculated first. They are then
+ * interpolated along X once for every lattice row, and these rows are in turn
+ * interpolated along Y (and Z). The operations per point are the same as with
+ * biLinearInterpolation() and triLinearInterpolation().
+ *
+ * NB: Another optimization that could save half as many noise calls is to carry
+ * over values from the previous noise lattice as midpoints in the new lattice
+ * for the next octave.
  */
-#define idx(x, y) ((y) * nlx + (x))
+void Noise::computeStepsX(float u, float step_x, bool eased)
+{
+	interp_buf.resize(sx);
+	index_buf.resize(sx);
+	u32 noisex = 0;
+	for (u32 i = 0; i != sx; i++) {
+		interp_buf[i] = eased ? easeCurve(u) : u;
+		index_buf[i] = noisex;
+
+		u += step_x;
+		if (u >= 1.0) {
+			u -= 1.0;
+			noisex++;
+		}
+	}
+}
+
+
 void Noise::valueMap2D(
 		float x, float y,
 		float step_x, float step_y,
 		s32 seed)
 {
-	float v00, v01, v10, v11, u, v, orig_u;
-	u32 index, i, j, noisex, noisey;
+	const NoiseKernels &kernels = getKernels();
+	float u, v;
+	u32 j, noisey;
 	u32 nlx, nly;
 	s32 x0, y0;
 
@@ -505,62 +933,49 @@ void Noise::valueMap2D(
 	y0 = std::floor(y);
 	u = x - (float)x0;
 	v = y - (float)y0;
-	orig_u = u;
 
 	//calculate noise point lattice
 	nlx = (u32)(u + sx * step_x) + 2;
 	nly = (u32)(v + sy * step_y) + 2;
-	index = 0;
 	for (j = 0; j != nly; j++)
-		for (i = 0; i != nlx; i++)
-			noise_buf[index++] = noise2d(x0 + i, y0 + j, seed);
+		kernels.noiseRow(&noise_buf[j * nlx], nlx, x0, hashBase(y0 + j, 0, seed));
 
 	//calculate interpolations
-	index  = 0;
+	computeStepsX(u, step_x, eased);
+	interp_buf.resize(3 * sx);
+	const float *weights = &interp_buf[0];
+	float *row0 = &interp_buf[sx];
+	float *row1 = &interp_buf[2 * sx];
+
 	noisey = 0;
+	kernels.lerpGather(row0, sx, &noise_buf[0], &index_buf[0], weights);
+	kernels.lerpGather(row1, sx, &noise_buf[nlx], &index_buf[0], weights);
 	for (j = 0; j != sy; j++) {
-		v00 = noise_buf[idx(0, noisey)];
-		v10 = noise_buf[idx(1, noisey)];
-		v01 = noise_buf[idx(0, noisey + 1)];
-		v11 = noise_buf[idx(1, noisey + 1)];
-
-		u = orig_u;
-		noisex = 0;
-		for (i = 0; i != sx; i++) {
-			value_buf[index++] =
-				biLinearInterpolation(v00, v10, v01, v11, u, v, eased);
-
-			u += step_x;
-			if (u >= 1.0) {
-				u -= 1.0;
-				noisex++;
-				v00 = v10;
-				v01 = v11;
-				v10 = noise_buf[idx(noisex + 1, noisey)];
-				v11 = noise_buf[idx(noisex + 1, noisey + 1)];
+		if (j != 0) {
+			v += step_y;
+			if (v >= 1.0) {
+				v -= 1.0;
+				noisey++;
+				std::swap(row0, row1);
+				kernels.lerpGather(row1, sx, &noise_buf[(noisey + 1) * nlx],
+					&index_buf[0], weights);
 			}
 		}
 
-		v += step_y;
-		if (v >= 1.0) {
-			v -= 1.0;
-			noisey++;
-		}
+		kernels.lerpRows(&value_buf[j * sx], sx, row0, row1,
+			eased ? easeCurve(v) : v);
 	}
 }
-#undef idx
 
 
-#define idx(x, y, z) ((z) * nly * nlx + (y) * nlx + (x))
 void Noise::valueMap3D(
 		float x, float y, float z,
 		float step_x, float step_y, float step_z,
 		s32 seed)
 {
-	float v000, v010, v100, v110;
-	float v001, v011, v101, v111;
-	float u, v, w, orig_u, orig_v;
-	u32 index, i, j, k, noisex, noisey, noisez;
+	const NoiseKernels &kernels = getKernels();
+	float u, v, w, orig_v;
+	u32 index, j, k, noisey, noisez;
 	u32 nlx, nly, nlz;
 	s32 x0, y0, z0;
 
@@ -572,7 +987,6 @@ void Noise::valueMap3D(
 	u = x - (float)x0;
 	v = y - (float)y0;
 	w = z - (float)z0;
-	orig_u = u;
 	orig_v = v;
 
 	//calculate noise point lattice
@@ -581,66 +995,58 @@ void Noise::valueMap3D(
 	nlz = (u32)(w + sz * step_z) + 2;
 	index = 0;
 	for (k = 0; k != nlz; k++)
-		for (j = 0; j != nly; j++)
-			for (i = 0; i != nlx; i++)
-				noise_buf[index++] = noise3d(x0 + i, y0 + j, z0 + k, seed);
+		for (j = 0; j != nly; j++, index += nlx)
+			kernels.noiseRow(&noise_buf[index], nlx, x0, hashBase(y0 + j, z0 + k, seed));
 
 	//calculate interpolations
-	index  = 0;
-	noisey = 0;
+	computeStepsX(u, step_x, eased);
+	// lattice rows interpolated along X, for two planes of the lattice
+	const size_t plane_size = (size_t)nly * sx;
+	interp_buf.resize(sx + 2 * plane_size);
+	const float *weights = &interp_buf[0];
+	float *plane0 = &interp_buf[sx];
+	float *plane1 = plane0 + plane_size;
+	auto fill_plane = [&] (float *plane, u32 lz) {
+		for (u32 ly = 0; ly != nly; ly++) {
+			kernels.lerpGather(&plane[ly * sx], sx,
+				&noise_buf[(lz * nly + ly) * nlx], &index_buf[0], weights);
+		}
+	};
+
 	noisez = 0;
+	fill_plane(plane0, 0);
+	fill_plane(plane1, 1);
+	index = 0;
 	for (k = 0; k != sz; k++) {
+		if (k != 0) {
+			w += step_z;
+			if (w >= 1.0) {
+				w -= 1.0;
+				noisez++;
+				std::swap(plane0, plane1);
+				fill_plane(plane1, noisez + 1);
+			}
+		}
+		const float ew = eased ? easeCurve(w) : w;
+
 		v = orig_v;
 		noisey = 0;
-		for (j = 0; j != sy; j++) {
-			v000 = noise_buf[idx(0, noisey,     noisez)];
-			v100 = noise_buf[idx(1, noisey,     noisez)];
-			v010 = noise_buf[idx(0, noisey + 1, noisez)];
-			v110 = noise_buf[idx(1, noisey + 1, noisez)];
-			v001 = noise_buf[idx(0, noisey,     noisez + 1)];
-			v101 = noise_buf[idx(1, noisey,     noisez + 1)];
-			v011 = noise_buf[idx(0, noisey + 1, noisez + 1)];
-			v111 = noise_buf[idx(1, noisey + 1, noisez + 1)];
-
-			u = orig_u;
-			noisex = 0;
-			for (i = 0; i != sx; i++) {
-				value_buf[index++] = triLinearInterpolation(
-					v000, v100, v010, v110,
-					v001, v101, v011, v111,
-					u, v, w,
-					eased);
-
-				u += step_x;
-				if (u >= 1.0) {
-					u -= 1.0;
-					noisex++;
-					v000 = v100;
-					v010 = v110;
-					v100 = noise_buf[idx(noisex + 1, noisey,     noisez)];
-					v110 = noise_buf[idx(noisex + 1, noisey + 1, noisez)];
-					v001 = v101;
-					v011 = v111;
-					v101 = noise_buf[idx(noisex + 1, noisey,     noisez + 1)];
-					v111 = noise_buf[idx(noisex + 1, noisey + 1, noisez + 1)];
+		for (j = 0; j != sy; j++, index += sx) {
+			if (j != 0) {
+				v += step_y;
+				if (v >= 1.0) {
+					v -= 1.0;
+					noisey++;
 				}
 			}
 
-			v += step_y;
-			if (v >= 1.0) {
-				v -= 1.0;
-				noisey++;
-			}
-		}
-
-		w += step_z;
-		if (w >= 1.0) {
-			w -= 1.0;
-			noisez++;
+			kernels.lerpRows2(&value_buf[index], sx,
+				&plane0[noisey * sx], &plane0[(noisey + 1) * sx],
+				&plane1[noisey * sx], &plane1[(noisey + 1) * sx],
+				eased ? easeCurve(v) : v, ew);
 		}
 	}
 }
-#undef idx
 
 
 float *Noise::noiseMap2D(float x, float y, float *persistence_map)
@@ -745,3 +1151,98 @@ void Noise::updateResults(float g, float *gmap,
 		}
 	}
 }
+
+
+///////////////////////// [ Noise cache ] ////////////////////////////
+
+
+// Floats are compared by their bits, which also tells -0 from 0
+static inline u32 float_bits(float f)
+{
+	u32 bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return bits;
+}
+
+bool NoiseCache2D::Key::operator==(const Key &other) const
+{
+	const NoiseParams &a = np, &b = other.np;
+	return float_bits(x) == float_bits(other.x) &&
+		float_bits(y) == float_bits(other.y) &&
+		seed == other.seed && sx == other.sx && sy == other.sy &&
+		float_bits(a.offset) == float_bits(b.offset) &&
+		float_bits(a.scale) == float_bits(b.scale) &&
+		float_bits(a.spread.X) == float_bits(b.spread.X) &&
+		float_bits(a.spread.Y) == float_bits(b.spread.Y) &&
+		float_bits(a.spread.Z) == float_bits(b.spread.Z) &&
+		a.seed == b.seed && a.octaves == b.octaves &&
+		float_bits(a.persist) == float_bits(b.persist) &&
+		float_bits(a.lacunarity) == float_bits(b.lacunarity) &&
+		a.flags == b.flags;
+}
+
+size_t NoiseCache2D::KeyHash::operator()(const Key &key) const
+{
+	const NoiseParams &np = key.np;
+	const u32 fields[] = {
+		float_bits(key.x), float_bits(key.y), (u32)key.seed, key.sx, key.sy,
+		float_bits(np.offset), float_bits(np.scale), float_bits(np.spread.X),
+		float_bits(np.spread.Y), float_bits(np.spread.Z), (u32)np.seed,
+		np.octaves, float_bits(np.persist), float_bits(np.lacunarity), np.flags,
+	};
+	size_t seed = 0;
+	for (u32 field : fields)
+		seed ^= std::hash<u32>{}(field) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	return seed;
+}
+
+NoiseCache2D::NoiseCache2D(size_t max_bytes) :
+	m_max_bytes(max_bytes)
+{
+}
+
+float *NoiseCache2D::noiseMap2D(Noise *noise, float x, float y)
+{
+	const Key key{noise->np, noise->seed, x, y, noise->sx, noise->sy};
+	const size_t count = (size_t)noise->sx * noise->sy;
+
+	auto it = m_entries.find(key);
+	if (it != m_entries.end()) {
+		m_hits++;
+		m_lru.splice(m_lru.begin(), m_lru, it->second);
+		const std::vector<float> &data = it->second->data;
+		memcpy(noise->result, data.data(), count * sizeof(float));
+		return noise->result;
+	}
+
+	m_misses++;
+	noise->noiseMap2D(x, y);
+
+	const size_t bytes = count * sizeof(float);
+	if (bytes > m_max_bytes)
+		return noise->result;
+
+	m_lru.push_front(Entry{key, std::vector<float>(noise->result,
+		noise->result + count)});
+	m_entries.emplace(key, m_lru.begin());
+	m_bytes += bytes;
+	evict();
+	return noise->result;
+}
+
+void NoiseCache2D::clear()
+{
+	m_entries.clear();
+	m_lru.clear();
+	m_bytes = 0;
+}
+
+void NoiseCache2D::evict()
+{
+	while (m_bytes > m_max_bytes) {
+		const Entry &entry = m_lru.back();
+		m_bytes -= entry.data.size() * sizeof(float);
+		m_entries.erase(entry.key);
+		m_lru.pop_back();
+	}
+}
@@ -25,8 +25,12 @@
 
 #pragma once
 
+#include <list>
+#include <unordered_map>
+#include <vector>
 #include "irr_v3d.h"
 #include "exceptions.h"
+#include "util/basic_macros.h"
 #include "util/string.h"
 
 #if defined(RANDOM_MIN)
@@ -194,16 +198,100 @@ class Noise {
 	}
 
 private:
+	// Scratch space of valueMap2D() and valueMap3D()
+	std::vector<float> interp_buf;
+	std::vector<u32> index_buf;
+
 	void allocBuffers();
 	void resizeNoiseBuf(bool is3d);
+	// Interpolation weights and lattice indices along X
+	void computeStepsX(float u, float step_x, bool eased);
 	void updateResults(float g, float *gmap, const float *persistence_map,
 			size_t bufsize);
 
 };
 
+// Instruction sets the bulk functions of Noise can use
+enum class NoiseSimd : u8 {
+	None,
+	SSE2,
+	AVX2,
+};
+
+/// @return the instruction set in use, the best one the CPU supports by default
+NoiseSimd getNoiseSimd();
+/// Selects the instruction set, for tests and benchmarks. Not thread-safe.
+/// All of them produce the same results.
+/// @return false if the CPU doesn't support it
+bool setNoiseSimd(NoiseSimd simd);
+
+/**
+ * Bounded cache of 2D noise maps, for areas that are generated more than once.
+ * Mapchunks that are stacked on top of each other need the same 2D noise.
+ *
+ * Entries are identified by the noise parameters, seed, origin and size,
+ * the least recently used ones are dropped when the size limit is reached.
+ * Not thread-safe, every thread is meant to use its own cache.
+ */
+class NoiseCache2D {
+public:
+	/// @param max_bytes limit of the memory used by cached results
+	NoiseCache2D(size_t max_bytes);
+
+	DISABLE_CLASS_COPY(NoiseCache2D)
+
+	/// Same as noise->noiseMap2D(x, y), but takes the result from the cache
+	/// if possible. Either way, the result is in noise->result.
+	float *noiseMap2D(Noise *noise, float x, float y);
+
+	void clear();
+
+	size_t getSize() const { return m_bytes; }
+	u64 getHits() const { return m_hits; }
+	u64 getMisses() const { return m_misses; }
+
+private:
+	struct Key {
+		NoiseParams np;
+		s32 seed;
+		float x, y;
+		u32 sx, sy;
+
+		bool operator==(const Key &other) const;
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key &key) const;
+	};
+
+	struct Entry {
+		Key key;
+		std::vector<float> data;
+	};
+
+	void evict();
+
+	const size_t m_max_bytes;
+	size_t m_bytes = 0;
+	u64 m_hits = 0;
+	u64 m_misses = 0;
+	// most recently used first
+	std::list<Entry> m_lru;
+	std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> m_entries;
+};
+
 float NoiseFractal2D(const NoiseParams *np, float x, float y, s32 seed);
 float NoiseFractal3D(const NoiseParams *np, float x, float y, float z, s32 seed);
 
+/**
+ * Writes NoiseFractal2D() at the points (x + i * step_x, y + j * step_y) of a
+ * sx by sy grid to out[j * sx + i]. The values are exactly the same, unlike
+ * those of Noise::noiseMap2D(), but every lattice point is only hashed once.
+ * The steps must not be negative.
+ */
+void NoiseFractal2DGrid(const NoiseParams *np, float x, float y,
+	float step_x, float step_y, u32 sx, u32 sy, s32 seed, float *out);
+
 inline float NoiseFractal2D_PO(NoiseParams *np, float x, float xoff,
 	float y, float yoff, s32 seed)
 {
@@ -151,9 +151,7 @@ bool AsyncEngine::getJob(LuaJobInfo *job)
 /******************************************************************************/
 void AsyncEngine::putJobResult(LuaJobInfo &&result)
 {
-	resultQueueMutex.lock();
-	resultQueue.emplace_back(std::move(result));
-	resultQueueMutex.unlock();
+	resultQueue.push_back(std::move(result));
 }
 
 /******************************************************************************/
@@ -171,11 +169,12 @@ void AsyncEngine::stepJobResults(lua_State *L)
 
 	ScriptApiBase *script = ModApiBase::getScriptApiBase(L);
 
-	MutexAutoLock autolock(resultQueueMutex);
-	while (!resultQueue.empty()) {
-		LuaJobInfo j = std::move(resultQueue.front());
-		resultQueue.pop_front();
+	// Only handle what is there now, the workers may keep adding results
+	std::vector<LuaJobInfo> results;
+	for (LuaJobInfo j; resultQueue.try_pop_front(j);)
+		results.emplace_back(std::move(j));
 
+	for (auto &j : results) {
 		lua_getfield(L, -1, "async_event_handler");
 		if (lua_isnil(L, -1))
 			FATAL_ERROR("Async event handler does not exist!");
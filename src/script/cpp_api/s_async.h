@@ -15,6 +15,7 @@
 #include "common/c_packer.h"
 #include "cpp_api/s_base.h"
 #include "cpp_api/s_security.h"
+#include "util/container.h"
 
 // Forward declarations
 class AsyncEngine;
@@ -195,10 +196,8 @@ class AsyncEngine {
 	// Job queue
 	std::deque<LuaJobInfo> jobQueue;
 
-	// Mutex to protect result queue
-	std::mutex resultQueueMutex;
-	// Result queue
-	std::deque<LuaJobInfo> resultQueue;
+	// Result queue, filled by the workers
+	MPSCQueue<LuaJobInfo> resultQueue;
 
 	// List of current worker threads
 	std::vector<AsyncWorkerThread*> workerThreads;
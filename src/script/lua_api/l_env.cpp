@@ -710,6 +710,43 @@ int ModApiEnv::l_get_objects_inside_radius(lua_State *L)
 	return 1;
 }
 
+// get_objects_inside_radius_multi(centers, radius)
+int ModApiEnv::l_get_objects_inside_radius_multi(lua_State *L)
+{
+	GET_ENV_PTR;
+	ScriptApiBase *script = getScriptApiBase(L);
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	std::vector<v3f> centers;
+	const size_t count = lua_objlen(L, 1);
+	centers.reserve(count);
+	for (size_t i = 1; i <= count; i++) {
+		lua_rawgeti(L, 1, i);
+		centers.push_back(checkFloatPos(L, -1));
+		lua_pop(L, 1);
+	}
+	float radius = readParam<float>(L, 2) * BS;
+
+	server::ActiveObjectMgr::BatchQueryResult result;
+	env->getObjectsInsideRadii(centers, radius, result);
+
+	lua_createtable(L, count, 0);
+	for (size_t q = 0; q < count; q++) {
+		lua_createtable(L, result.offsets[q + 1] - result.offsets[q], 0);
+		int i = 0;
+		for (u32 j = result.offsets[q]; j < result.offsets[q + 1]; j++) {
+			ServerActiveObject *obj = result.objects[j];
+			if (obj->isGone())
+				continue;
+			// Insert object reference into table
+			script->objectrefGetOrCreate(L, obj);
+			lua_rawseti(L, -2, ++i);
+		}
+		lua_rawseti(L, -2, q + 1);
+	}
+	return 1;
+}
+
 // get_objects_in_area(pos, minp, maxp)
 int ModApiEnv::l_get_objects_in_area(lua_State *L)
 {
@@ -1404,6 +1441,7 @@ void ModApiEnv::Initialize(lua_State *L, int top)
 	API_FCT(get_player_by_name);
 	API_FCT(get_objects_in_area);
 	API_FCT(get_objects_inside_radius);
+	API_FCT(get_objects_inside_radius_multi);
 	API_FCT(set_timeofday);
 	API_FCT(get_timeofday);
 	API_FCT(get_gametime);
@@ -139,6 +139,9 @@ class ModApiEnv : public ModApiEnvBase {
 	// get_objects_inside_radius(pos, radius)
 	static int l_get_objects_inside_radius(lua_State *L);
 
+	// get_objects_inside_radius_multi(centers, radius)
+	static int l_get_objects_inside_radius_multi(lua_State *L);
+
 	// get_objects_in_area(pos, minp, maxp)
 	static int l_get_objects_in_area(lua_State *L);
 
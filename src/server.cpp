@@ -3,6 +3,7 @@
 // Copyright (C) 2010-2013 celeron55, Perttu Ahola <celeron55@gmail.com>
 
 #include "server.h"
+#include <atomic>
 #include <iostream>
 #include <queue>
 #include <algorithm>
@@ -53,6 +54,8 @@
 #include "remoteplayer.h"
 #include "server/player_sao.h"
 #include "server/serverinventorymgr.h"
+#include "server/serializedblockcache.h"
+#include "threading/workerpool.h"
 #include "translation.h"
 #include "database/database-sqlite3.h"
 #if USE_POSTGRESQL
@@ -65,6 +68,11 @@
 #include "gettext.h"
 #include "util/tracy_wrapper.h"
 
+// Mapchunks queued at once by Server::pregenerateMap()
+static constexpr u32 PREGEN_MAX_QUEUED = 128;
+// Seconds after which pregenerated blocks are unloaded
+static constexpr float PREGEN_UNLOAD_TIMEOUT = 5.0f;
+
 class ClientNotFoundException : public BaseException
 {
 public:
@@ -327,6 +335,14 @@ Server::Server(
 
 	m_lag_gauge->set(g_settings->getFloat("dedicated_server_step"));
 
+	m_block_cache = std::make_unique<SerializedBlockCache>(
+		(size_t)g_settings->getU32("block_send_cache_size") * 1024 * 1024);
+	{
+		u16 threads = rangelim(g_settings->getU16("block_send_threads"), 1, 64);
+		// the server thread takes part in the work too
+		m_block_send_pool = std::make_unique<WorkerPool>("BlockSend", threads - 1);
+	}
+
 	m_path_mod_data = porting::path_user + DIR_DELIM "mod_data";
 	if (!fs::CreateDir(m_path_mod_data))
 		throw ServerError("Failed to create mod data dir");
@@ -855,9 +871,15 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 		EnvAutoLock envlock(this);
 		ScopeProfiler sp(g_profiler, "Server: send SAO messages");
 
+		struct BufferedMessage {
+			ActiveObjectMessage aom;
+			// AO_CMD_UPDATE_POSITION_COMPACT form of a position update,
+			// empty if there is none
+			std::string compact;
+		};
 		// Key = object id
 		// Value = data sent by object
-		std::unordered_map<u16, std::vector<ActiveObjectMessage>*> buffered_messages;
+		std::unordered_map<u16, std::vector<BufferedMessage>*> buffered_messages;
 
 		// Get active object messages from environment
 		ActiveObjectMessage aom(0);
@@ -870,15 +892,16 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 			else
 				count_unreliable++;
 
-			std::vector<ActiveObjectMessage>* message_list = nullptr;
+			std::vector<BufferedMessage>* message_list = nullptr;
 			auto n = buffered_messages.find(aom.id);
 			if (n == buffered_messages.end()) {
-				message_list = new std::vector<ActiveObjectMessage>;
+				message_list = new std::vector<BufferedMessage>;
 				buffered_messages[aom.id] = message_list;
 			} else {
 				message_list = n->second;
 			}
-			message_list->push_back(std::move(aom));
+			std::string compact = AOPositionUpdate::compactCommand(aom.datastring);
+			message_list->push_back({std::move(aom), std::move(compact)});
 		}
 
 		m_aom_buffer_counter[0]->increment(count_reliable);
@@ -894,6 +917,7 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 				unreliable_data.clear();
 				RemoteClient *client = client_it.second;
 				PlayerSAO *player = getPlayerSAO(client->peer_id);
+				const bool use_compact = client->net_proto_version >= 1001;
 				// Go through all objects in message buffer
 				for (const auto &buffered_message : buffered_messages) {
 					// If object does not exist or is not known by client, skip it
@@ -903,9 +927,10 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 						continue;
 
 					// Get message list of object
-					std::vector<ActiveObjectMessage>* list = buffered_message.second;
+					std::vector<BufferedMessage>* list = buffered_message.second;
 					// Go through every message
-					for (const ActiveObjectMessage &aom : *list) {
+					for (const BufferedMessage &msg : *list) {
+						const ActiveObjectMessage &aom = msg.aom;
 						// Send position updates to players who do not see the attachment
 						if (aom.datastring[0] == AO_CMD_UPDATE_POSITION) {
 							if (sao->getId() == player->getId())
@@ -926,7 +951,10 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 						// u16 id
 						// std::string data
 						buffer.append(idbuf, sizeof(idbuf));
-						buffer.append(serializeString16(aom.datastring));
+						if (use_compact && !msg.compact.empty())
+							buffer.append(serializeString16(msg.compact));
+						else
+							buffer.append(serializeString16(aom.datastring));
 					}
 				}
 				/*
@@ -1000,6 +1028,7 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 
 				if (MapBlock *block = m_env->getMap().getBlockNoCreateNoEx(
 						getNodeBlockPos(event->p))) {
+					block->touchNetworkData();
 					block->raiseModified(MOD_STATE_WRITE_NEEDED,
 						MOD_REASON_REPORT_META_CHANGE);
 				}
@@ -1054,6 +1083,28 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 		}
 	}
 
+	/*
+		Prioritize the emerge queue by the current player positions
+	*/
+	{
+		float &counter = m_emerge_interest_timer;
+		counter -= dtime;
+		if (counter <= 0.0f) {
+			counter = 0.5f;
+
+			std::vector<v3s16> positions;
+			{
+				EnvAutoLock lock(this);
+				for (RemotePlayer *player : m_env->getPlayers()) {
+					if (PlayerSAO *sao = player->getPlayerSAO())
+						positions.push_back(getNodeBlockPos(
+							floatToInt(sao->getBasePosition(), BS)));
+				}
+			}
+			m_emerge->updateInterest(positions);
+		}
+	}
+
 	// Save map, players and auth stuff
 	{
 		float &counter = m_savemap_timer;
@@ -2427,103 +2478,180 @@ void Server::sendMetadataChanged(const std::unordered_set<v3s16> &positions, flo
 	}
 }
 
-void Server::SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
-		u16 net_proto_version, SerializedBlockCache *cache)
+static int get_net_compression_level()
 {
-	thread_local const int net_compression_level = rangelim(g_settings->getS16("map_compression_level_net"), -1, 9);
-	std::string s, *sptr = nullptr;
+	thread_local const int level = rangelim(g_settings->getS16("map_compression_level_net"), -1, 9);
+	return level;
+}
 
-	if (cache) {
-		auto it = cache->find({block->getPos(), ver});
-		if (it != cache->end())
-			sptr = &it->second;
-	}
+// Second half of the network serialization, see MapBlock::serializeUncompressed()
+static std::string compress_block_for_net(const std::string &raw, u8 ver, int level)
+{
+	std::ostringstream os(std::ios_base::binary);
+	compress(raw, os, ver, level);
+	MapBlock::serializeNetworkSpecific(os);
+	return os.str();
+}
+
+std::shared_ptr<const std::string> Server::getSerializedBlock(MapBlock *block, u8 ver)
+{
+	const u64 stamp = block->getModificationStamp();
+	auto data = m_block_cache->get(block->getPos(), ver, stamp);
+	if (data)
+		return data;
 
 	// Serialize the block in the right format
-	if (!sptr) {
-		std::ostringstream os(std::ios_base::binary);
-		block->serialize(os, ver, false, net_compression_level);
-		block->serializeNetworkSpecific(os);
-		s = os.str();
-		sptr = &s;
-	}
+	std::ostringstream os(std::ios_base::binary);
+	block->serialize(os, ver, false, get_net_compression_level());
+	block->serializeNetworkSpecific(os);
+	data = std::make_shared<const std::string>(os.str());
 
-	NetworkPacket pkt(TOCLIENT_BLOCKDATA, 2 + 2 + 2 + sptr->size(), peer_id);
-	pkt << block->getPos();
-	pkt.putRawString(*sptr);
+	m_block_cache->put(block->getPos(), ver, stamp, data);
+	return data;
+}
+
+void Server::SendBlockData(session_t peer_id, v3s16 pos, const std::string &data)
+{
+	NetworkPacket pkt(TOCLIENT_BLOCKDATA, 2 + 2 + 2 + data.size(), peer_id);
+	pkt << pos;
+	pkt.putRawString(data);
 	Send(&pkt);
+}
 
-	// Store away in cache
-	if (cache && sptr == &s)
-		(*cache)[{block->getPos(), ver}] = std::move(s);
+void Server::SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
+		u16 net_proto_version)
+{
+	auto data = getSerializedBlock(block, ver);
+	SendBlockData(peer_id, block->getPos(), *data);
 }
 
 void Server::SendBlocks(float dtime)
 {
-	EnvAutoLock envlock(this);
+	// Block that still needs to be compressed
+	struct CompressJob {
+		v3s16 pos;
+		u8 ver;
+		u64 stamp;
+		std::string raw;
+		std::shared_ptr<const std::string> result;
+	};
 
-	std::vector<PrioritySortedBlockTransfer> queue;
+	struct PendingSend {
+		session_t peer_id;
+		v3s16 pos;
+		std::shared_ptr<const std::string> data; // if nullptr, see job
+		size_t job;
+	};
 
-	u32 total_sending = 0, unique_clients = 0;
+	std::vector<CompressJob> jobs;
+	std::vector<PendingSend> sends;
 
 	{
-		ScopeProfiler sp2(g_profiler, "Server::SendBlocks(): Collect list");
+		EnvAutoLock envlock(this);
 
-		std::vector<session_t> clients = m_clients.getClientIDs();
+		std::vector<PrioritySortedBlockTransfer> queue;
 
-		ClientInterface::AutoLock clientlock(m_clients);
-		for (const session_t client_id : clients) {
-			RemoteClient *client = m_clients.lockedGetClientNoEx(client_id, CS_Active);
+		u32 total_sending = 0;
 
-			if (!client)
-				continue;
+		{
+			ScopeProfiler sp2(g_profiler, "Server::SendBlocks(): Collect list");
+
+			std::vector<session_t> clients = m_clients.getClientIDs();
+
+			ClientInterface::AutoLock clientlock(m_clients);
+			for (const session_t client_id : clients) {
+				RemoteClient *client = m_clients.lockedGetClientNoEx(client_id, CS_Active);
 
-			total_sending += client->getSendingCount();
-			const auto old_count = queue.size();
-			client->GetNextBlocks(m_env, m_emerge.get(), dtime, queue);
-			unique_clients += queue.size() > old_count ? 1 : 0;
+				if (!client)
+					continue;
+
+				total_sending += client->getSendingCount();
+				client->GetNextBlocks(m_env, m_emerge.get(), dtime, queue);
+			}
 		}
-	}
 
-	// Sort.
-	// Lowest priority number comes first.
-	// Lowest is most important.
-	std::sort(queue.begin(), queue.end());
+		// Sort.
+		// Lowest priority number comes first.
+		// Lowest is most important.
+		std::sort(queue.begin(), queue.end());
 
-	ClientInterface::AutoLock clientlock(m_clients);
+		ClientInterface::AutoLock clientlock(m_clients);
 
-	// Maximal total count calculation
-	// The per-client block sends is halved with the maximal online users
-	u32 max_blocks_to_send = (m_env->getPlayerCount() + g_settings->getU32("max_users")) *
-		g_settings->getU32("max_simultaneous_block_sends_per_client") / 4 + 1;
+		// Maximal total count calculation
+		// The per-client block sends is halved with the maximal online users
+		u32 max_blocks_to_send = (m_env->getPlayerCount() + g_settings->getU32("max_users")) *
+			g_settings->getU32("max_simultaneous_block_sends_per_client") / 4 + 1;
 
-	ScopeProfiler sp(g_profiler, "Server::SendBlocks(): Send to clients");
-	Map &map = m_env->getMap();
+		ScopeProfiler sp(g_profiler, "Server::SendBlocks(): Prepare blocks");
+		Map &map = m_env->getMap();
 
-	SerializedBlockCache cache, *cache_ptr = nullptr;
-	if (unique_clients > 1) {
-		// caching is pointless with a single client
-		cache_ptr = &cache;
-	}
+		// (pos, version) -> index into jobs
+		std::map<std::pair<v3s16, u8>, size_t> job_index;
 
-	for (const PrioritySortedBlockTransfer &block_to_send : queue) {
-		if (total_sending >= max_blocks_to_send)
-			break;
+		for (const PrioritySortedBlockTransfer &block_to_send : queue) {
+			if (total_sending >= max_blocks_to_send)
+				break;
 
-		MapBlock *block = map.getBlockNoCreateNoEx(block_to_send.pos);
-		if (!block)
-			continue;
+			MapBlock *block = map.getBlockNoCreateNoEx(block_to_send.pos);
+			if (!block)
+				continue;
 
-		RemoteClient *client = m_clients.lockedGetClientNoEx(block_to_send.peer_id,
-				CS_Active);
-		if (!client)
-			continue;
+			RemoteClient *client = m_clients.lockedGetClientNoEx(block_to_send.peer_id,
+					CS_Active);
+			if (!client)
+				continue;
+
+			const u8 ver = client->serialization_version;
+			PendingSend send{block_to_send.peer_id, block_to_send.pos, nullptr, 0};
+			send.data = m_block_cache->get(block_to_send.pos, ver,
+				block->getModificationStamp());
+			if (!send.data) {
+				auto it = job_index.find({block_to_send.pos, ver});
+				if (it != job_index.end()) {
+					send.job = it->second;
+				} else if (ver >= 29) {
+					// Take a snapshot now, compression is done without the lock
+					std::ostringstream os(std::ios_base::binary);
+					block->serializeUncompressed(os, ver, false);
+					send.job = jobs.size();
+					job_index[{block_to_send.pos, ver}] = jobs.size();
+					jobs.push_back({block_to_send.pos, ver,
+						block->getModificationStamp(), os.str(), nullptr});
+				} else {
+					// older formats are compressed piecewise
+					send.data = getSerializedBlock(block, ver);
+				}
+			}
+			sends.push_back(std::move(send));
 
-		SendBlockNoLock(block_to_send.peer_id, block, client->serialization_version,
-				client->net_proto_version, cache_ptr);
+			client->SentBlock(block_to_send.pos);
+			total_sending++;
+		}
+	}
 
-		client->SentBlock(block_to_send.pos);
-		total_sending++;
+	if (!jobs.empty()) {
+		ScopeProfiler sp(g_profiler, "Server::SendBlocks(): Compress blocks");
+		const int level = get_net_compression_level();
+		m_block_send_pool->parallelFor(jobs.size(), [&] (size_t i) {
+			CompressJob &job = jobs[i];
+			job.result = std::make_shared<const std::string>(
+				compress_block_for_net(job.raw, job.ver, level));
+		});
+		for (CompressJob &job : jobs)
+			m_block_cache->put(job.pos, job.ver, job.stamp, job.result);
+	}
+
+	{
+		u32 hits, misses;
+		m_block_cache->takeStats(hits, misses);
+		g_profiler->avg("Server::SendBlocks(): block cache hits", hits);
+		g_profiler->avg("Server::SendBlocks(): block cache misses", misses);
+	}
+
+	ScopeProfiler sp(g_profiler, "Server::SendBlocks(): Send to clients");
+	for (const PendingSend &send : sends) {
+		const auto &data = send.data ? send.data : jobs[send.job].result;
+		SendBlockData(send.peer_id, send.pos, *data);
 	}
 }
 
@@ -4336,6 +4464,205 @@ bool Server::migrateModStorageDatabase(const GameParams &game_params, const Sett
 	return succeeded;
 }
 
+namespace {
+	// Progress of Server::pregenerateMap(), updated by the emerge threads
+	struct PregenState {
+		std::atomic<u32> done{0};
+		std::atomic<u32> generated{0};
+		std::atomic<u32> errored{0};
+	};
+}
+
+static void pregen_callback(v3s16 blockpos, EmergeAction action, void *param)
+{
+	auto *state = reinterpret_cast<PregenState *>(param);
+	if (action == EMERGE_GENERATED)
+		state->generated++;
+	else if (action == EMERGE_ERRORED)
+		state->errored++;
+	state->done++;
+}
+
+// Mapchunks to pregenerate, in rings of growing distance to the center
+static std::vector<v3s16> pregen_chunks(v3s16 center, s32 radius, s32 ymin, s32 ymax,
+	s16 chunksize)
+{
+	const s32 chunk_nodes = chunksize * MAP_BLOCKSIZE;
+	const s32 rings = (radius + chunk_nodes - 1) / chunk_nodes;
+	const v3s16 center_chunk = EmergeManager::getContainingChunk(
+		getNodeBlockPos(center), chunksize);
+	const s16 chunk_ymin = EmergeManager::getContainingChunk(
+		v3s16(0, getNodeBlockPos(v3s16(0, ymin, 0)).Y, 0), chunksize).Y;
+	const s16 chunk_ymax = EmergeManager::getContainingChunk(
+		v3s16(0, getNodeBlockPos(v3s16(0, ymax, 0)).Y, 0), chunksize).Y;
+
+	std::vector<v3s16> chunks;
+	auto add_column = [&] (s32 dx, s32 dz) {
+		for (s32 y = chunk_ymin; y <= chunk_ymax; y += chunksize) {
+			const v3s32 pos(center_chunk.X + dx * chunksize, y,
+				center_chunk.Z + dz * chunksize);
+			if (std::abs(pos.X) > MAX_MAP_GENERATION_LIMIT / MAP_BLOCKSIZE ||
+					std::abs(pos.Z) > MAX_MAP_GENERATION_LIMIT / MAP_BLOCKSIZE)
+				return;
+			const v3s16 blockpos(pos.X, pos.Y, pos.Z);
+			if (!blockpos_over_max_limit(blockpos))
+				chunks.push_back(blockpos);
+		}
+	};
+
+	add_column(0, 0);
+	for (s32 d = 1; d <= rings; d++) {
+		for (s32 i = -d; i <= d; i++) {
+			add_column(i, -d);
+			add_column(i, d);
+		}
+		for (s32 i = -d + 1; i <= d - 1; i++) {
+			add_column(-d, i);
+			add_column(d, i);
+		}
+	}
+	return chunks;
+}
+
+// Whether str is a node coordinate, optionally negative
+static bool is_pregen_coord(std::string_view str)
+{
+	if (!str.empty() && str[0] == '-')
+		str.remove_prefix(1);
+	// longer numbers would overflow, they are far out of the map anyway
+	return is_number(str) && str.size() <= 9;
+}
+
+bool Server::pregenerateMap(const GameParams &game_params, const Settings &cmd_args)
+{
+	const std::string radius_str = cmd_args.get("pregen");
+	if (!is_number(radius_str) || radius_str.size() > 9) {
+		errorstream << "Invalid --pregen, expected a radius in nodes" << std::endl;
+		return false;
+	}
+	const s32 radius = mystoi(radius_str, 0, MAX_MAP_GENERATION_LIMIT);
+
+	s32 ymin = -64, ymax = 256;
+	if (cmd_args.exists("pregen-y")) {
+		const auto range = str_split(cmd_args.get("pregen-y"), ',');
+		if (range.size() != 2 || !is_pregen_coord(range[0]) ||
+				!is_pregen_coord(range[1])) {
+			errorstream << "Invalid --pregen-y, expected <min>,<max>" << std::endl;
+			return false;
+		}
+		ymin = mystoi(range[0], -MAX_MAP_GENERATION_LIMIT, MAX_MAP_GENERATION_LIMIT);
+		ymax = mystoi(range[1], -MAX_MAP_GENERATION_LIMIT, MAX_MAP_GENERATION_LIMIT);
+	}
+	if (ymin > ymax) {
+		errorstream << "Invalid --pregen-y, minimum is above maximum" << std::endl;
+		return false;
+	}
+
+	// Nothing else is running, use every core unless configured otherwise
+	g_settings->setDefault("num_emerge_threads",
+		itos(Thread::getNumberOfProcessors()));
+
+	PregenState state;
+	try {
+		Server server(game_params.world_path, game_params.game_spec, false,
+			Address(), false);
+		server.init();
+
+		ServerMap &map = server.m_env->getServerMap();
+		std::optional<v3f> spawn;
+		const v3s16 center = g_settings->getV3FNoEx("static_spawnpoint", spawn) &&
+			spawn.has_value() ? floatToInt(*spawn * BS, BS) : v3s16(0, 0, 0);
+		const s16 chunksize = map.getMapgenParams()->chunksize;
+		const std::vector<v3s16> chunks = pregen_chunks(center, radius, ymin, ymax,
+			chunksize);
+		const u32 chunk_volume = chunksize * chunksize * chunksize;
+
+		actionstream << "Pregenerating " << chunks.size() << " mapchunks within "
+			<< radius << " nodes of " << center << " from Y " << ymin << " to "
+			<< ymax << std::endl;
+
+		EmergeManager *emerge = server.m_emerge.get();
+		emerge->startThreads();
+
+		bool &kill = *porting::signal_handler_killstatus();
+		const u64 start_time = porting::getTimeMs();
+		u64 last_update_time = start_time;
+		size_t next = 0;
+		while (state.done < chunks.size()) {
+			if (kill)
+				break;
+			const std::string async_err = server.m_async_fatal_error.get();
+			if (!async_err.empty())
+				throw ServerError("AsyncErr: " + async_err);
+
+			// Keep enough queued to keep all emerge threads busy, in order
+			while (next < chunks.size() && next - state.done < PREGEN_MAX_QUEUED) {
+				if (!emerge->enqueueBlockEmergeEx(chunks[next], PEER_ID_INEXISTENT,
+						BLOCK_EMERGE_ALLOW_GEN | BLOCK_EMERGE_FORCE_QUEUE,
+						pregen_callback, &state))
+					pregen_callback(chunks[next], EMERGE_ERRORED, &state);
+				next++;
+			}
+			sleep_ms(100);
+
+			const u64 now = porting::getTimeMs();
+			if (now - last_update_time < 1000)
+				continue;
+			{
+				EnvAutoLock envlock(&server);
+
+				std::map<v3s16, MapBlock *> modified_blocks;
+				map.transformLiquids(modified_blocks, server.m_env);
+
+				// Everything finished so far is saved in one transaction,
+				// then blocks that were not used lately are dropped
+				map.save(MOD_STATE_WRITE_NEEDED);
+				map.timerUpdate((now - last_update_time) / 1000.0f,
+					PREGEN_UNLOAD_TIMEOUT, -1);
+
+				// there are no clients to send the changes to
+				while (!server.m_unsent_map_edit_queue.empty()) {
+					delete server.m_unsent_map_edit_queue.front();
+					server.m_unsent_map_edit_queue.pop();
+				}
+			}
+			last_update_time = now;
+
+			// Chunks that existed already take next to no time, so the rate
+			// is that of the generated ones
+			const u32 done = state.done, generated = state.generated;
+			const float elapsed = (now - start_time) / 1000.0f;
+			std::cerr << " Pregenerated " << done << " of " << chunks.size()
+				<< " mapchunks, " << (u32)(generated * chunk_volume / elapsed)
+				<< " blocks/s, ETA "
+				<< (generated ? duration_to_string(
+					(chunks.size() - done) * elapsed / generated) : "-")
+				<< "   \r" << std::flush;
+		}
+		std::cerr << std::endl;
+
+		// The server saves the remaining blocks when it is destroyed
+		if (kill) {
+			actionstream << "Pregeneration interrupted after " << state.done
+				<< " of " << chunks.size() << " mapchunks" << std::endl;
+			return false;
+		}
+	} catch (const ModError &e) {
+		errorstream << "ModError: " << e.what() << std::endl;
+		return false;
+	} catch (const BaseException &e) {
+		errorstream << "Pregeneration failed: " << e.what() << std::endl;
+		return false;
+	}
+
+	actionstream << "Pregenerated " << state.generated << " mapchunks, "
+		<< (state.done - state.generated - state.errored) << " existed already";
+	if (state.errored > 0)
+		actionstream << ", " << state.errored << " failed";
+	actionstream << std::endl;
+	return state.errored == 0;
+}
+
 u16 Server::getProtocolVersionMin()
 {
 	u16 min_proto = g_settings->getU16("protocol_version_min");
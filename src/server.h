@@ -51,6 +51,8 @@ struct PlayerHPChangeReason;
 class IRollbackManager;
 struct RollbackAction;
 class EmergeManager;
+class SerializedBlockCache;
+class WorkerPool;
 class ServerScripting;
 class ServerEnvironment;
 struct SoundSpec;
@@ -440,6 +442,11 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	static bool migrateModStorageDatabase(const GameParams &game_params,
 			const Settings &cmd_args);
 
+	// Generates the mapchunks around the spawn point without clients,
+	// see --pregen
+	static bool pregenerateMap(const GameParams &game_params,
+			const Settings &cmd_args);
+
 	static u16 getProtocolVersionMin();
 	static u16 getProtocolVersionMax();
 
@@ -503,15 +510,6 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 		std::unordered_set<session_t> waiting_players;
 	};
 
-	// The standard library does not implement std::hash for pairs so we have this:
-	struct SBCHash {
-		size_t operator() (const std::pair<v3s16, u16> &p) const {
-			return std::hash<v3s16>()(p.first) ^ p.second;
-		}
-	};
-
-	typedef std::unordered_map<std::pair<v3s16, u16>, std::string, SBCHash> SerializedBlockCache;
-
 	void init();
 
 	void SendMovement(session_t peer_id);
@@ -562,9 +560,13 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 			float far_d_nodes = 100);
 
 	// Environment and Connection must be locked when called
-	// `cache` may only be very short lived! (invalidation not handeled)
 	void SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
-		u16 net_proto_version, SerializedBlockCache *cache = nullptr);
+		u16 net_proto_version);
+	void SendBlockData(session_t peer_id, v3s16 pos, const std::string &data);
+
+	// Returns the block serialized for the network, using m_block_cache
+	// Environment must be locked when called
+	std::shared_ptr<const std::string> getSerializedBlock(MapBlock *block, u8 ver);
 
 	// Sends blocks to clients (locks env and con on its own)
 	void SendBlocks(float dtime);
@@ -657,6 +659,7 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	float m_liquid_transform_every = 1.0f;
 	float m_masterserver_timer = 0.0f;
 	float m_emergethread_trigger_timer = 0.0f;
+	float m_emerge_interest_timer = 0.0f;
 	float m_savemap_timer = 0.0f;
 	IntervalLimiter m_map_timer_and_unload_interval;
 	IntervalLimiter m_max_lag_decrease;
@@ -676,6 +679,11 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	// Emerge manager
 	std::unique_ptr<EmergeManager> m_emerge;
 
+	// Blocks serialized for the network (only used by the server thread)
+	std::unique_ptr<SerializedBlockCache> m_block_cache;
+	// Compresses blocks to be sent
+	std::unique_ptr<WorkerPool> m_block_send_pool;
+
 	// Item definition manager
 	IWritableItemDefManager *m_itemdef;
 
@@ -2,14 +2,24 @@
 // SPDX-License-Identifier: LGPL-2.1-or-later
 // Copyright (C) 2010-2018 nerzhul, Loic BLOT <loic.blot@unix-experience.fr>
 
+#include <algorithm>
 #include <log.h>
 #include "mapblock.h"
 #include "profiler.h"
 #include "activeobjectmgr.h"
+#include "threading/workerpool.h"
 
 namespace server
 {
 
+// Edge length of the interest grid cells
+static constexpr f32 INTEREST_CELL_SIZE = 2 * MAP_BLOCKSIZE * BS;
+
+ActiveObjectMgr::ActiveObjectMgr() :
+	m_interest_grid(INTEREST_CELL_SIZE)
+{
+}
+
 ActiveObjectMgr::~ActiveObjectMgr()
 {
 	if (!m_active_objects.empty()) {
@@ -46,6 +56,27 @@ void ActiveObjectMgr::step(
 	g_profiler->avg("ActiveObjectMgr: SAO count [#]", count);
 }
 
+// Number of objects handed to a worker at once
+static constexpr size_t PREPARE_STEP_CHUNK_SIZE = 16;
+
+void ActiveObjectMgr::prepareStep(float dtime, WorkerPool *pool)
+{
+	m_prepare_objects.clear();
+	for (auto &ao_it : m_active_objects.iter()) {
+		if (ao_it.second && !ao_it.second->isGone())
+			m_prepare_objects.push_back(ao_it.second.get());
+	}
+
+	const size_t count = m_prepare_objects.size();
+	const size_t num_chunks = (count + PREPARE_STEP_CHUNK_SIZE - 1) / PREPARE_STEP_CHUNK_SIZE;
+	pool->parallelFor(num_chunks, [&] (size_t chunk) {
+		const size_t first = chunk * PREPARE_STEP_CHUNK_SIZE;
+		const size_t last = std::min(count, first + PREPARE_STEP_CHUNK_SIZE);
+		for (size_t i = first; i < last; i++)
+			m_prepare_objects[i]->prepareStep(dtime);
+	});
+}
+
 bool ActiveObjectMgr::registerObject(std::unique_ptr<ServerActiveObject> obj)
 {
 	assert(obj); // Pre-condition
@@ -77,6 +108,10 @@ bool ActiveObjectMgr::registerObject(std::unique_ptr<ServerActiveObject> obj)
 	}
 
 	auto obj_id = obj->getId();
+	if (obj->getType() == ACTIVEOBJECT_TYPE_PLAYER)
+		m_player_ids.insert(obj_id);
+	else
+		m_interest_grid.addObject(obj_id, pos);
 	m_active_objects.put(obj_id, std::move(obj));
 	m_spatial_index.insert(pos.toArray(), obj_id);
 
@@ -103,6 +138,9 @@ void ActiveObjectMgr::removeObject(u16 id)
 				<< "id=" << id << " not found" << std::endl;
 	} else {
 		m_spatial_index.remove(id);
+		m_interest_grid.removeObject(id);
+		m_interest_grid.removeSubscriber(id);
+		m_player_ids.erase(id);
 	}
 }
 
@@ -121,8 +159,10 @@ void ActiveObjectMgr::updateObjectPos(u16 id, v3f pos)
 	// HACK defensively only update if we already know the object,
 	// otherwise we're still waiting to be inserted into the index
 	// (or have already been removed).
-	if (m_active_objects.get(id))
+	if (m_active_objects.get(id)) {
 		m_spatial_index.update(pos.toArray(), id);
+		m_interest_grid.updateObject(id, pos);
+	}
 }
 
 void ActiveObjectMgr::getObjectsInsideRadius(v3f pos, float radius,
@@ -155,6 +195,62 @@ void ActiveObjectMgr::getObjectsInArea(const aabb3f &box,
 	});
 }
 
+template <typename F>
+void ActiveObjectMgr::batchQuery(BatchQueryResult &result, const F &include_obj)
+{
+	const size_t count = result.mins.size();
+	result.hits.clear();
+	m_spatial_index.batchRangeQuery(result.mins.data(), result.maxs.data(), count,
+			[&](size_t q, auto pos, u16 id) {
+		auto obj = m_active_objects.get(id).get();
+		if (obj && include_obj(q, v3f(pos), obj))
+			result.hits.emplace_back(q, obj);
+	});
+
+	// The hits of the queries are interleaved, sort them by counting
+	result.offsets.assign(count + 1, 0);
+	for (const auto &hit : result.hits)
+		result.offsets[hit.first + 1]++;
+	for (size_t q = 0; q < count; q++)
+		result.offsets[q + 1] += result.offsets[q];
+	result.objects.resize(result.hits.size());
+	for (const auto &hit : result.hits)
+		result.objects[result.offsets[hit.first]++] = hit.second;
+	// The offsets now point to the end of each query, shift them back
+	for (size_t q = count; q > 0; q--)
+		result.offsets[q] = result.offsets[q - 1];
+	result.offsets[0] = 0;
+}
+
+void ActiveObjectMgr::getObjectsInAreas(const std::vector<aabb3f> &boxes,
+		BatchQueryResult &result)
+{
+	result.mins.clear();
+	result.maxs.clear();
+	for (const aabb3f &box : boxes) {
+		result.mins.push_back(box.MinEdge.toArray());
+		result.maxs.push_back(box.MaxEdge.toArray());
+	}
+	batchQuery(result, [](size_t q, v3f pos, ServerActiveObject *obj) {
+		return true;
+	});
+}
+
+void ActiveObjectMgr::getObjectsInsideRadii(const std::vector<v3f> &centers,
+		float radius, BatchQueryResult &result)
+{
+	result.mins.clear();
+	result.maxs.clear();
+	for (v3f center : centers) {
+		result.mins.push_back((center - v3f(radius)).toArray());
+		result.maxs.push_back((center + v3f(radius)).toArray());
+	}
+	const float r_squared = radius * radius;
+	batchQuery(result, [&](size_t q, v3f pos, ServerActiveObject *obj) {
+		return pos.getDistanceFromSQ(centers[q]) <= r_squared;
+	});
+}
+
 void ActiveObjectMgr::getAddedActiveObjectsAroundPos(
 		v3f player_pos, const std::string &player_name,
 		f32 radius, f32 player_radius,
@@ -170,34 +266,61 @@ void ActiveObjectMgr::getAddedActiveObjectsAroundPos(
 		- add remaining objects to added_objects
 	*/
 	for (auto &ao_it : m_active_objects.iter()) {
-		u16 id = ao_it.first;
+		if (isAddedActiveObject(ao_it.second.get(), player_pos, player_name,
+				radius, player_radius, current_objects))
+			added_objects.push_back(ao_it.first);
+	}
+}
 
-		// Get object
-		ServerActiveObject *object = ao_it.second.get();
-		if (!object)
-			continue;
+void ActiveObjectMgr::getAddedActiveObjectsForObserver(u16 observer_id,
+		v3f player_pos, const std::string &player_name,
+		f32 radius, f32 player_radius,
+		const std::set<u16> &current_objects,
+		std::vector<u16> &added_objects)
+{
+	m_interest_grid.updateSubscriber(observer_id, player_pos, radius);
+	const auto *nearby = m_interest_grid.getObjects(observer_id);
+	assert(nearby);
 
-		if (object->isGone())
-			continue;
+	const size_t first = added_objects.size();
+	const auto check = [&] (u16 id) {
+		if (isAddedActiveObject(getActiveObject(id), player_pos, player_name,
+				radius, player_radius, current_objects))
+			added_objects.push_back(id);
+	};
+	for (u16 id : *nearby)
+		check(id);
+	for (u16 id : m_player_ids)
+		check(id);
 
-		f32 distance_f = object->getBasePosition().getDistanceFrom(player_pos);
-		if (object->getType() == ACTIVEOBJECT_TYPE_PLAYER) {
-			// Discard if too far
-			if (distance_f > player_radius && player_radius != 0)
-				continue;
-		} else if (distance_f > radius)
-			continue;
+	// Same order as getAddedActiveObjectsAroundPos()
+	std::sort(added_objects.begin() + first, added_objects.end());
+}
 
-		if (!object->isEffectivelyObservedBy(player_name))
-			continue;
+bool ActiveObjectMgr::isAddedActiveObject(ServerActiveObject *object,
+		v3f player_pos, const std::string &player_name,
+		f32 radius, f32 player_radius,
+		const std::set<u16> &current_objects)
+{
+	if (!object)
+		return false;
 
-		// Discard if already on current_objects
-		auto n = current_objects.find(id);
-		if (n != current_objects.end())
-			continue;
-		// Add to added_objects
-		added_objects.push_back(id);
-	}
+	if (object->isGone())
+		return false;
+
+	f32 distance_f = object->getBasePosition().getDistanceFrom(player_pos);
+	if (object->getType() == ACTIVEOBJECT_TYPE_PLAYER) {
+		// Discard if too far
+		if (distance_f > player_radius && player_radius != 0)
+			return false;
+	} else if (distance_f > radius)
+		return false;
+
+	if (!object->isEffectivelyObservedBy(player_name))
+		return false;
+
+	// Discard if already on current_objects
+	return current_objects.find(object->getId()) == current_objects.end();
 }
 
 } // namespace server
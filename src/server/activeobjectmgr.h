@@ -4,23 +4,31 @@
 
 #pragma once
 
+#include <array>
 #include <functional>
 #include <vector>
 #include "../activeobjectmgr.h"
+#include "interestgrid.h"
 #include "serveractiveobject.h"
 #include "util/k_d_tree.h"
 
+class WorkerPool;
+
 namespace server
 {
 class ActiveObjectMgr final : public ::ActiveObjectMgr<ServerActiveObject>
 {
 public:
+	ActiveObjectMgr();
 	~ActiveObjectMgr() override;
 
 	// If cb returns true, the obj will be deleted
 	void clearIf(const std::function<bool(ServerActiveObject *, u16)> &cb);
 	void step(float dtime,
 			const std::function<void(ServerActiveObject *)> &f) override;
+	// Calls ServerActiveObject::prepareStep() of all objects, spread
+	// over the threads of the pool
+	void prepareStep(float dtime, WorkerPool *pool);
 	bool registerObject(std::unique_ptr<ServerActiveObject> obj) override;
 	void removeObject(u16 id) override;
 
@@ -34,13 +42,53 @@ class ActiveObjectMgr final : public ::ActiveObjectMgr<ServerActiveObject>
 	void getObjectsInArea(const aabb3f &box,
 			std::vector<ServerActiveObject *> &result,
 			std::function<bool(ServerActiveObject *obj)> include_obj_cb);
+	// Result of a batched query, can be reused to avoid allocations.
+	// The objects found by query i are objects[offsets[i]] up to
+	// objects[offsets[i + 1]], exclusive.
+	struct BatchQueryResult {
+		std::vector<ServerActiveObject *> objects;
+		std::vector<u32> offsets;
+
+		size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+
+		// scratch space
+		std::vector<std::array<f32, 3>> mins, maxs;
+		std::vector<std::pair<u32, ServerActiveObject *>> hits;
+	};
+	// Runs several queries with a single pass over the spatial index
+	void getObjectsInAreas(const std::vector<aabb3f> &boxes,
+			BatchQueryResult &result);
+	void getObjectsInsideRadii(const std::vector<v3f> &centers, float radius,
+			BatchQueryResult &result);
 	void getAddedActiveObjectsAroundPos(
 			v3f player_pos, const std::string &player_name,
 			f32 radius, f32 player_radius,
 			const std::set<u16> &current_objects,
 			std::vector<u16> &added_objects);
+	// Same result as getAddedActiveObjectsAroundPos(), but only looks at the
+	// objects near the observer according to the interest grid.
+	// The observer subscribes to the grid with the given radius.
+	void getAddedActiveObjectsForObserver(u16 observer_id,
+			v3f player_pos, const std::string &player_name,
+			f32 radius, f32 player_radius,
+			const std::set<u16> &current_objects,
+			std::vector<u16> &added_objects);
 
 private:
+	// Runs the queries in result.mins and result.maxs, objects are
+	// passed to include_obj(query, pos, obj)
+	template <typename F>
+	void batchQuery(BatchQueryResult &result, const F &include_obj);
+	bool isAddedActiveObject(ServerActiveObject *object,
+			v3f player_pos, const std::string &player_name,
+			f32 radius, f32 player_radius,
+			const std::set<u16> &current_objects);
+
 	k_d_tree::DynamicKdTrees<3, f32, u16> m_spatial_index;
+	// Non-player objects, players are few and may have an unlimited range
+	InterestGrid m_interest_grid;
+	std::set<u16> m_player_ids;
+	// cached allocation for prepareStep()
+	std::vector<ServerActiveObject *> m_prepare_objects;
 };
 } // namespace server
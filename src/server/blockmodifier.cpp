@@ -9,6 +9,7 @@
 #include "mapblock.h"
 #include "nodedef.h"
 #include "gamedef.h"
+#include "noise.h" // PcgRandom
 
 /*
 	ABMs
@@ -40,10 +41,22 @@ ABMHandler::ABMHandler(std::vector<ABMWithState> &abms,
 	float dtime_s, ServerEnvironment *env,
 	bool use_timers):
 	m_env(env)
+{
+	init(abms, dtime_s, env->getGameDef()->ndef(), use_timers);
+}
+
+ABMHandler::ABMHandler(std::vector<ABMWithState> &abms,
+	float dtime_s, const NodeDefManager *ndef,
+	bool use_timers)
+{
+	init(abms, dtime_s, ndef, use_timers);
+}
+
+void ABMHandler::init(std::vector<ABMWithState> &abms, float dtime_s,
+	const NodeDefManager *ndef, bool use_timers)
 {
 	if (dtime_s < 0.001f)
 		return;
-	const NodeDefManager *ndef = env->getGameDef()->ndef();
 	for (ABMWithState &abmws : abms) {
 		ActiveBlockModifier *abm = abmws.abm;
 		float trigger_interval = abm->getTriggerInterval();
@@ -107,6 +120,72 @@ ABMHandler::~ABMHandler()
 		delete aabms;
 }
 
+/*
+	Checks the required and without neighbors of an ABM.
+	`get_outside` is used for positions outside of the block.
+*/
+template <typename F>
+static bool check_neighbors(const ActiveABM &aabm, MapBlock *block, v3s16 p0,
+	F &&get_outside)
+{
+	const bool check_required_neighbors = !aabm.required_neighbors.empty();
+	const bool check_without_neighbors = !aabm.without_neighbors.empty();
+	if (!check_required_neighbors && !check_without_neighbors)
+		return true;
+
+	v3s16 p1;
+	bool have_required = false;
+	for(p1.X = p0.X-1; p1.X <= p0.X+1; p1.X++)
+	for(p1.Y = p0.Y-1; p1.Y <= p0.Y+1; p1.Y++)
+	for(p1.Z = p0.Z-1; p1.Z <= p0.Z+1; p1.Z++)
+	{
+		if (p1 == p0)
+			continue;
+		content_t c;
+		if (block->isValidPosition(p1)) {
+			// if the neighbor is found on the same map block
+			// get it straight from there
+			c = block->getNodeNoCheck(p1).getContent();
+		} else {
+			c = get_outside(p1);
+		}
+		if (check_required_neighbors && !have_required) {
+			if (CONTAINS(aabm.required_neighbors, c)) {
+				if (!check_without_neighbors)
+					return true;
+				have_required = true;
+			}
+		}
+		if (check_without_neighbors) {
+			if (CONTAINS(aabm.without_neighbors, c))
+				return false;
+		}
+	}
+	return have_required || !check_required_neighbors;
+}
+
+// Caches content types of a block as they are encountered
+static void cache_content(MapBlock *block, content_t c, bool &want_contents_cached)
+{
+	if (!want_contents_cached || CONTAINS(block->contents, c))
+		return;
+	if (block->contents.size() >= CONTENT_TYPE_CACHE_MAX) {
+		// Too many different nodes... don't try to cache
+		want_contents_cached = false;
+		block->do_not_cache_contents = true;
+		decltype(block->contents) empty;
+		std::swap(block->contents, empty);
+	} else {
+		block->contents.push_back(c);
+	}
+}
+
+// index into ABMBlockScan::neighbors
+static inline int neighbor_index(v3s16 d)
+{
+	return (d.Z + 1) * 9 + (d.Y + 1) * 3 + (d.X + 1);
+}
+
 u32 ABMHandler::countObjects(MapBlock *block, ServerMap *map, u32 &wider)
 {
 	wider = 0;
@@ -130,27 +209,30 @@ u32 ABMHandler::countObjects(MapBlock *block, ServerMap *map, u32 &wider)
 	return active_object_count;
 }
 
+bool ABMHandler::checkContentCache(MapBlock *block) const
+{
+	// Check the content type cache first
+	// to see whether there are any ABMs
+	// to be run at all for this block.
+	if (block->contents.empty())
+		return true;
+	assert(!block->do_not_cache_contents); // invariant
+	for (content_t c : block->contents) {
+		if (c < m_aabms.size() && m_aabms[c])
+			return true;
+	}
+	return false;
+}
+
 void ABMHandler::apply(MapBlock *block, int &blocks_scanned, int &abms_run, int &blocks_cached)
 {
 	if (m_aabms.empty())
 		return;
 
-	// Check the content type cache first
-	// to see whether there are any ABMs
-	// to be run at all for this block.
-	if (!block->contents.empty()) {
-		assert(!block->do_not_cache_contents); // invariant
+	if (!block->contents.empty())
 		blocks_cached++;
-		bool run_abms = false;
-		for (content_t c : block->contents) {
-			if (c < m_aabms.size() && m_aabms[c]) {
-				run_abms = true;
-				break;
-			}
-		}
-		if (!run_abms)
-			return;
-	}
+	if (!checkContentCache(block))
+		return;
 	blocks_scanned++;
 
 	ServerMap *map = &m_env->getServerMap();
@@ -161,6 +243,11 @@ void ABMHandler::apply(MapBlock *block, int &blocks_scanned, int &abms_run, int
 
 	bool want_contents_cached = block->contents.empty() && !block->do_not_cache_contents;
 
+	const auto get_outside = [&] (v3s16 p1) -> content_t {
+		// otherwise consult the map
+		return map->getNode(p1 + block->getPosRelative()).getContent();
+	};
+
 	v3s16 p0;
 	for(p0.Z=0; p0.Z<MAP_BLOCKSIZE; p0.Z++)
 	for(p0.Y=0; p0.Y<MAP_BLOCKSIZE; p0.Y++)
@@ -170,17 +257,7 @@ void ABMHandler::apply(MapBlock *block, int &blocks_scanned, int &abms_run, int
 		content_t c = n.getContent();
 
 		// Cache content types as we go
-		if (want_contents_cached && !CONTAINS(block->contents, c)) {
-			if (block->contents.size() >= CONTENT_TYPE_CACHE_MAX) {
-				// Too many different nodes... don't try to cache
-				want_contents_cached = false;
-				block->do_not_cache_contents = true;
-				decltype(block->contents) empty;
-				std::swap(block->contents, empty);
-			} else {
-				block->contents.push_back(c);
-			}
-		}
+		cache_content(block, c, want_contents_cached);
 
 		if (c >= m_aabms.size() || !m_aabms[c])
 			continue;
@@ -193,49 +270,8 @@ void ABMHandler::apply(MapBlock *block, int &blocks_scanned, int &abms_run, int
 			if (myrand() % aabm.chance != 0)
 				continue;
 
-			// Check neighbors
-			const bool check_required_neighbors = !aabm.required_neighbors.empty();
-			const bool check_without_neighbors = !aabm.without_neighbors.empty();
-			if (check_required_neighbors || check_without_neighbors) {
-				v3s16 p1;
-				bool have_required = false;
-				for(p1.X = p0.X-1; p1.X <= p0.X+1; p1.X++)
-				for(p1.Y = p0.Y-1; p1.Y <= p0.Y+1; p1.Y++)
-				for(p1.Z = p0.Z-1; p1.Z <= p0.Z+1; p1.Z++)
-				{
-					if (p1 == p0)
-						continue;
-					content_t c;
-					if (block->isValidPosition(p1)) {
-						// if the neighbor is found on the same map block
-						// get it straight from there
-						const MapNode &n = block->getNodeNoCheck(p1);
-						c = n.getContent();
-					} else {
-						// otherwise consult the map
-						MapNode n = map->getNode(p1 + block->getPosRelative());
-						c = n.getContent();
-					}
-					if (check_required_neighbors && !have_required) {
-						if (CONTAINS(aabm.required_neighbors, c)) {
-							if (!check_without_neighbors)
-								goto neighbor_found;
-							have_required = true;
-						}
-					}
-					if (check_without_neighbors) {
-						if (CONTAINS(aabm.without_neighbors, c))
-							goto neighbor_invalid;
-					}
-				}
-				if (have_required || !check_required_neighbors)
-					goto neighbor_found;
-				// No required neighbor found
-neighbor_invalid:
+			if (!check_neighbors(aabm, block, p0, get_outside))
 				continue;
-			}
-
-neighbor_found:
 
 			abms_run++;
 			// Call all the trigger variations
@@ -260,6 +296,122 @@ void ABMHandler::apply(MapBlock *block, int &blocks_scanned, int &abms_run, int
 	}
 }
 
+void ABMHandler::prepareScan(Map *map, MapBlock *block, ABMBlockScan &job,
+	u64 seed) const
+{
+	job.block = block;
+	job.seed = seed;
+	job.cached = false;
+	job.scanned = false;
+	job.candidates.clear();
+
+	v3s16 d;
+	for (d.Z = -1; d.Z <= 1; d.Z++)
+	for (d.Y = -1; d.Y <= 1; d.Y++)
+	for (d.X = -1; d.X <= 1; d.X++) {
+		job.neighbors[neighbor_index(d)] = d == v3s16(0, 0, 0) ? block :
+			map->getBlockNoCreateNoEx(block->getPos() + d);
+	}
+}
+
+void ABMHandler::scan(ABMBlockScan &job) const
+{
+	MapBlock *block = job.block;
+	if (m_aabms.empty())
+		return;
+
+	job.cached = !block->contents.empty();
+	if (!checkContentCache(block))
+		return;
+	job.scanned = true;
+
+	bool want_contents_cached = block->contents.empty() && !block->do_not_cache_contents;
+
+	// Same as Map::getNode() but restricted to the prepared neighborhood
+	const auto get_outside = [&] (v3s16 p1) -> content_t {
+		v3s16 d(
+			p1.X < 0 ? -1 : (p1.X >= MAP_BLOCKSIZE ? 1 : 0),
+			p1.Y < 0 ? -1 : (p1.Y >= MAP_BLOCKSIZE ? 1 : 0),
+			p1.Z < 0 ? -1 : (p1.Z >= MAP_BLOCKSIZE ? 1 : 0)
+		);
+		MapBlock *block2 = job.neighbors[neighbor_index(d)];
+		if (!block2)
+			return CONTENT_IGNORE;
+		return block2->getNodeNoCheck(p1 - d * MAP_BLOCKSIZE).getContent();
+	};
+
+	// myrand() is not thread-safe
+	PcgRandom rand(job.seed);
+
+	const s16 y_base = block->getPosRelative().Y;
+	v3s16 p0;
+	for(p0.Z=0; p0.Z<MAP_BLOCKSIZE; p0.Z++)
+	for(p0.Y=0; p0.Y<MAP_BLOCKSIZE; p0.Y++)
+	for(p0.X=0; p0.X<MAP_BLOCKSIZE; p0.X++)
+	{
+		content_t c = block->getNodeNoCheck(p0).getContent();
+
+		cache_content(block, c, want_contents_cached);
+
+		if (c >= m_aabms.size() || !m_aabms[c])
+			continue;
+
+		const s16 y = p0.Y + y_base;
+		const auto &aabms = *m_aabms[c];
+		for (size_t i = 0; i < aabms.size(); i++) {
+			const ActiveABM &aabm = aabms[i];
+			if (y < aabm.min_y || y > aabm.max_y)
+				continue;
+
+			if (rand.next() % aabm.chance != 0)
+				continue;
+
+			if (!check_neighbors(aabm, block, p0, get_outside))
+				continue;
+
+			job.candidates.push_back({p0, c, static_cast<u16>(i)});
+		}
+	}
+}
+
+void ABMHandler::dispatch(ABMBlockScan &job, int &abms_run)
+{
+	MapBlock *block = job.block;
+	if (job.candidates.empty() || block->isOrphan())
+		return;
+
+	ServerMap *map = &m_env->getServerMap();
+
+	u32 active_object_count_wider;
+	u32 active_object_count = countObjects(block, map, active_object_count_wider);
+	m_env->m_added_objects = 0;
+
+	for (const ABMCandidate &cand : job.candidates) {
+		// Skip if an earlier trigger has modified the node
+		MapNode n = block->getNodeNoCheck(cand.p0);
+		if (n.getContent() != cand.c)
+			continue;
+
+		ActiveABM &aabm = (*m_aabms[cand.c])[cand.index];
+		v3s16 p = cand.p0 + block->getPosRelative();
+
+		abms_run++;
+		// Call all the trigger variations
+		aabm.abm->trigger(m_env, p, n);
+		aabm.abm->trigger(m_env, p, n,
+			active_object_count, active_object_count_wider);
+
+		if (block->isOrphan())
+			return;
+
+		// Count surrounding objects again if the abms added any
+		if (m_env->m_added_objects > 0) {
+			active_object_count = countObjects(block, map, active_object_count_wider);
+			m_env->m_added_objects = 0;
+		}
+	}
+}
+
 /*
 	LBMs
 */
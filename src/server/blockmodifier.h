@@ -15,8 +15,10 @@
 
 class ServerEnvironment;
 class ServerMap;
+class Map;
 class MapBlock;
 class IGameDef;
+class NodeDefManager;
 
 /*
 	ABMs
@@ -62,9 +64,34 @@ struct ABMWithState
 
 struct ActiveABM; // hidden
 
+// A node that passed the chance and neighbor checks of an ABM
+struct ABMCandidate
+{
+	v3s16 p0; // block-relative position
+	content_t c; // content at the time of the scan
+	u16 index; // index into the ABM list of this content
+};
+
+/*
+	State for scanning a single block for ABM triggers.
+	Filled by ABMHandler::prepareScan() and ABMHandler::scan(),
+	consumed by ABMHandler::dispatch().
+*/
+struct ABMBlockScan
+{
+	MapBlock *block = nullptr;
+	// 3x3x3 neighborhood of the block (Z-major order), may contain nullptr
+	MapBlock *neighbors[27] = {};
+	// seed for the trigger chance rolls
+	u64 seed = 0;
+	bool cached = false;
+	bool scanned = false;
+	std::vector<ABMCandidate> candidates;
+};
+
 class ABMHandler
 {
-	ServerEnvironment *m_env;
+	ServerEnvironment *m_env = nullptr;
 	// vector index = content_t
 	std::vector<std::vector<ActiveABM>*> m_aabms;
 
@@ -72,15 +99,44 @@ class ABMHandler
 	ABMHandler(std::vector<ABMWithState> &abms,
 		float dtime_s, ServerEnvironment *env,
 		bool use_timers);
+	// Variant without environment, only prepareScan() and scan() may be used.
+	ABMHandler(std::vector<ABMWithState> &abms,
+		float dtime_s, const NodeDefManager *ndef,
+		bool use_timers);
 	~ABMHandler();
 
+	DISABLE_CLASS_COPY(ABMHandler)
+
+	bool empty() const { return m_aabms.empty(); }
+
 	// Find out how many objects the given block and its neighbors contain.
 	// Returns the number of objects in the block, and also in 'wider' the
 	// number of objects in the block and all its neighbors. The latter
 	// may be an estimate if any neighbors are unloaded.
 	static u32 countObjects(MapBlock *block, ServerMap * map, u32 &wider);
 
+	// Scans the block and runs triggers right away
 	void apply(MapBlock *block, int &blocks_scanned, int &abms_run, int &blocks_cached);
+
+	/*
+		Split variant of apply() for parallel processing:
+		prepareScan() and dispatch() must be called from the thread owning
+		the map, scan() may run on any thread while the map is not modified.
+		Triggers are not run in between, so neighbor checks are done against
+		the state at the beginning of the interval.
+	*/
+	void prepareScan(Map *map, MapBlock *block, ABMBlockScan &job, u64 seed) const;
+	// Only touches the blocks referenced by `job`
+	void scan(ABMBlockScan &job) const;
+	void dispatch(ABMBlockScan &job, int &abms_run);
+
+private:
+	void init(std::vector<ABMWithState> &abms, float dtime_s,
+		const NodeDefManager *ndef, bool use_timers);
+
+	// Updates the content type cache of the block.
+	// @return false if no ABMs can run in this block
+	bool checkContentCache(MapBlock *block) const;
 };
 
 /*
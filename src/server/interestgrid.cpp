@@ -0,0 +1,176 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#include "interestgrid.h"
+#include <algorithm>
+#include <cmath>
+#include "irrlichttypes.h"
+
+namespace server
+{
+
+template <typename T>
+static void erase_value(std::vector<T> &v, T value)
+{
+	auto it = std::find(v.begin(), v.end(), value);
+	if (it != v.end()) {
+		*it = v.back();
+		v.pop_back();
+	}
+}
+
+InterestGrid::InterestGrid(f32 cell_size) :
+	m_cell_size(cell_size)
+{
+}
+
+v3s16 InterestGrid::getCellPos(v3f pos) const
+{
+	const auto cell = [this] (f32 v) {
+		// keep clear of the limits so that loops over cells terminate
+		f32 c = std::floor(v / m_cell_size);
+		return (s16)core::clamp<f32>(c, S16_MIN + 1, S16_MAX - 1);
+	};
+	return v3s16(cell(pos.X), cell(pos.Y), cell(pos.Z));
+}
+
+void InterestGrid::addObject(u16 id, v3f pos)
+{
+	if (m_objects.count(id)) {
+		updateObject(id, pos);
+		return;
+	}
+	const v3s16 cell_pos = getCellPos(pos);
+	m_objects[id] = cell_pos;
+	Cell &cell = m_cells[cell_pos];
+	cell.objects.push_back(id);
+	for (u16 sub_id : cell.subscribers)
+		m_subscribers[sub_id].objects.insert(id);
+}
+
+void InterestGrid::updateObject(u16 id, v3f pos)
+{
+	auto it = m_objects.find(id);
+	if (it == m_objects.end())
+		return;
+	const v3s16 old_pos = it->second;
+	const v3s16 new_pos = getCellPos(pos);
+	if (new_pos == old_pos)
+		return;
+	it->second = new_pos;
+
+	{
+		Cell &cell = m_cells[old_pos];
+		erase_value(cell.objects, id);
+		for (u16 sub_id : cell.subscribers) {
+			Subscriber &sub = m_subscribers[sub_id];
+			if (!sub.covers(new_pos))
+				sub.objects.erase(id);
+		}
+	}
+	releaseCell(old_pos);
+
+	Cell &cell = m_cells[new_pos];
+	cell.objects.push_back(id);
+	for (u16 sub_id : cell.subscribers)
+		m_subscribers[sub_id].objects.insert(id);
+}
+
+void InterestGrid::removeObject(u16 id)
+{
+	auto it = m_objects.find(id);
+	if (it == m_objects.end())
+		return;
+	const v3s16 cell_pos = it->second;
+	m_objects.erase(it);
+
+	Cell &cell = m_cells[cell_pos];
+	erase_value(cell.objects, id);
+	for (u16 sub_id : cell.subscribers)
+		m_subscribers[sub_id].objects.erase(id);
+	releaseCell(cell_pos);
+}
+
+void InterestGrid::updateSubscriber(u16 id, v3f pos, f32 radius)
+{
+	const v3s16 new_min = getCellPos(pos - v3f(radius));
+	const v3s16 new_max = getCellPos(pos + v3f(radius));
+
+	auto res = m_subscribers.try_emplace(id);
+	Subscriber &sub = res.first->second;
+	if (res.second) {
+		// empty area
+		sub.min = v3s16(0, 0, 0);
+		sub.max = v3s16(-1, -1, -1);
+	} else if (sub.min == new_min && sub.max == new_max) {
+		return;
+	}
+
+	const v3s16 old_min = sub.min, old_max = sub.max;
+	sub.min = new_min;
+	sub.max = new_max;
+
+	v3s16 p;
+	for (p.Z = old_min.Z; p.Z <= old_max.Z; p.Z++)
+	for (p.Y = old_min.Y; p.Y <= old_max.Y; p.Y++)
+	for (p.X = old_min.X; p.X <= old_max.X; p.X++) {
+		if (!sub.covers(p))
+			unsubscribe(id, sub, p);
+	}
+	for (p.Z = new_min.Z; p.Z <= new_max.Z; p.Z++)
+	for (p.Y = new_min.Y; p.Y <= new_max.Y; p.Y++)
+	for (p.X = new_min.X; p.X <= new_max.X; p.X++) {
+		if (!covers(old_min, old_max, p))
+			subscribe(id, sub, p);
+	}
+}
+
+void InterestGrid::removeSubscriber(u16 id)
+{
+	auto it = m_subscribers.find(id);
+	if (it == m_subscribers.end())
+		return;
+	Subscriber &sub = it->second;
+	v3s16 p;
+	for (p.Z = sub.min.Z; p.Z <= sub.max.Z; p.Z++)
+	for (p.Y = sub.min.Y; p.Y <= sub.max.Y; p.Y++)
+	for (p.X = sub.min.X; p.X <= sub.max.X; p.X++)
+		unsubscribe(id, sub, p);
+	m_subscribers.erase(it);
+}
+
+const std::unordered_set<u16> *InterestGrid::getObjects(u16 subscriber) const
+{
+	auto it = m_subscribers.find(subscriber);
+	return it == m_subscribers.end() ? nullptr : &it->second.objects;
+}
+
+void InterestGrid::subscribe(u16 id, Subscriber &sub, v3s16 cell_pos)
+{
+	Cell &cell = m_cells[cell_pos];
+	cell.subscribers.push_back(id);
+	sub.objects.insert(cell.objects.begin(), cell.objects.end());
+}
+
+void InterestGrid::unsubscribe(u16 id, Subscriber &sub, v3s16 cell_pos)
+{
+	auto it = m_cells.find(cell_pos);
+	if (it == m_cells.end())
+		return;
+	Cell &cell = it->second;
+	erase_value(cell.subscribers, id);
+	for (u16 obj_id : cell.objects)
+		sub.objects.erase(obj_id);
+	releaseCell(cell_pos);
+}
+
+void InterestGrid::releaseCell(v3s16 cell_pos)
+{
+	auto it = m_cells.find(cell_pos);
+	if (it != m_cells.end() && it->second.objects.empty() &&
+			it->second.subscribers.empty())
+		m_cells.erase(it);
+}
+
+} // namespace server
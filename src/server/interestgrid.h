@@ -0,0 +1,80 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "irr_v3d.h"
+
+namespace server
+{
+
+/*
+	Keeps track of which objects are near which subscribers (players).
+
+	Space is divided into cubic cells. Every cell knows the objects inside it
+	and the subscribers whose area covers it, and every subscriber has the set
+	of objects in the cells it covers. The sets are updated incrementally when
+	an object or a subscriber moves to a different cell, so looking up the
+	objects near a subscriber does not depend on the total number of objects.
+
+	The set is conservative: it contains everything within the radius that was
+	given to updateSubscriber(), but also objects in the corners of the
+	covered cells. Callers still need to check the exact distance.
+*/
+class InterestGrid
+{
+public:
+	InterestGrid(f32 cell_size);
+
+	void addObject(u16 id, v3f pos);
+	void updateObject(u16 id, v3f pos);
+	void removeObject(u16 id);
+
+	// Covers the cells within radius of pos, adds the subscriber if needed
+	void updateSubscriber(u16 id, v3f pos, f32 radius);
+	void removeSubscriber(u16 id);
+
+	// Objects near the subscriber, nullptr if it is not known
+	const std::unordered_set<u16> *getObjects(u16 subscriber) const;
+
+	size_t getCellCount() const { return m_cells.size(); }
+
+private:
+	struct Cell {
+		std::vector<u16> objects;
+		std::vector<u16> subscribers;
+	};
+
+	struct Subscriber {
+		// covered cells, inclusive
+		v3s16 min, max;
+		std::unordered_set<u16> objects;
+
+		bool covers(v3s16 cell) const { return InterestGrid::covers(min, max, cell); }
+	};
+
+	static bool covers(v3s16 min, v3s16 max, v3s16 cell)
+	{
+		return cell.X >= min.X && cell.X <= max.X &&
+			cell.Y >= min.Y && cell.Y <= max.Y &&
+			cell.Z >= min.Z && cell.Z <= max.Z;
+	}
+
+	v3s16 getCellPos(v3f pos) const;
+	void subscribe(u16 id, Subscriber &sub, v3s16 cell);
+	void unsubscribe(u16 id, Subscriber &sub, v3s16 cell);
+	// Drops the cell if nothing refers to it anymore
+	void releaseCell(v3s16 cell);
+
+	const f32 m_cell_size;
+	std::unordered_map<v3s16, Cell> m_cells;
+	// cell of every object
+	std::unordered_map<u16, v3s16> m_objects;
+	std::unordered_map<u16, Subscriber> m_subscribers;
+};
+
+} // namespace server
@@ -117,6 +117,32 @@ void LuaEntitySAO::dispatchScriptDeactivate(bool removal)
 		m_env->getScriptIface()->luaentity_Deactivate(m_id, removal);
 }
 
+void LuaEntitySAO::prepareStep(float dtime)
+{
+	PreparedMove &move = m_prepared_move;
+	move.valid = false;
+	if (!m_prop.physical || getParent())
+		return;
+
+	move.dtime = dtime;
+	move.box = m_prop.collisionbox;
+	move.box.MinEdge *= BS;
+	move.box.MaxEdge *= BS;
+	move.stepheight = m_prop.stepheight;
+	move.collide_with_objects = m_prop.collideWithObjects;
+	move.pos = getBasePosition();
+	move.velocity = m_velocity;
+	move.acceleration = m_acceleration;
+
+	move.new_pos = move.pos;
+	move.new_velocity = move.velocity;
+	move.result = collisionMoveSimple(m_env, m_env->getGameDef(),
+			move.box, move.stepheight, dtime,
+			&move.new_pos, &move.new_velocity, move.acceleration,
+			this, move.collide_with_objects);
+	move.valid = true;
+}
+
 void LuaEntitySAO::step(float dtime, bool send_recommended)
 {
 	if (!m_properties_sent) {
@@ -143,6 +169,9 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 	m_last_sent_position_timer += dtime;
 
 	collisionMoveResult moveresult, *moveresult_p = nullptr;
+	// A prepared move is only good for the step right after
+	const bool prepared = m_prepared_move.valid;
+	m_prepared_move.valid = false;
 
 	// Each frame, parent position is copied if the object is attached, otherwise it's calculated normally
 	// If the object gets detached this comes into effect automatically from the last known origin
@@ -158,10 +187,22 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 			v3f p_pos = getBasePosition();
 			v3f p_velocity = m_velocity;
 			v3f p_acceleration = m_acceleration;
-			moveresult = collisionMoveSimple(m_env, m_env->getGameDef(),
-					box, m_prop.stepheight, dtime,
-					&p_pos, &p_velocity, p_acceleration,
-					this, m_prop.collideWithObjects);
+			PreparedMove &move = m_prepared_move;
+			if (prepared && move.dtime == dtime && move.box == box &&
+					move.stepheight == m_prop.stepheight &&
+					move.collide_with_objects == m_prop.collideWithObjects &&
+					move.pos == p_pos && move.velocity == p_velocity &&
+					move.acceleration == p_acceleration) {
+				moveresult = std::move(move.result);
+				p_pos = move.new_pos;
+				p_velocity = move.new_velocity;
+			} else {
+				// Not prepared, or changed by a script since
+				moveresult = collisionMoveSimple(m_env, m_env->getGameDef(),
+						box, m_prop.stepheight, dtime,
+						&p_pos, &p_velocity, p_acceleration,
+						this, m_prop.collideWithObjects);
+			}
 			moveresult_p = &moveresult;
 
 			// Apply results
@@ -212,10 +253,18 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 		} else if(m_last_sent_position_timer > 0.2){
 			minchange = 0.05*BS;
 		}
-		float move_d = getBasePosition().getDistanceFrom(m_last_sent_position);
+		// Clients keep moving the object along the last sent velocity and
+		// acceleration, unless it collides. Only send if neither matches.
+		const float t = m_last_sent_position_timer;
+		float move_d = getClientPositionError();
 		move_d += m_last_sent_move_precision;
-		float vel_d = m_velocity.getDistanceFrom(m_last_sent_velocity);
-		if (move_d > minchange || vel_d > minchange ||
+		float vel_d = std::min(m_velocity.getDistanceFrom(m_last_sent_velocity),
+				m_velocity.getDistanceFrom(
+				m_last_sent_velocity + m_last_sent_acceleration * t));
+		// Moving objects are resent now and then, the update is unreliable.
+		// Acceleration alone doesn't count, idle mobs usually have gravity.
+		const bool refresh = t > 2.0f && m_velocity != v3f();
+		if (move_d > minchange || vel_d > minchange || refresh ||
 				std::fabs(m_rotation.X - m_last_sent_rotation.X) > 1.0f ||
 				std::fabs(m_rotation.Y - m_last_sent_rotation.Y) > 1.0f ||
 				std::fabs(m_rotation.Z - m_last_sent_rotation.Z) > 1.0f) {
@@ -503,12 +552,11 @@ void LuaEntitySAO::sendPosition(bool do_interpolate, bool is_movement_end)
 	// Send attachment updates instantly to the client prior updating position
 	sendOutdatedData();
 
-	m_last_sent_move_precision = getBasePosition().getDistanceFrom(
-			m_last_sent_position);
+	m_last_sent_move_precision = getClientPositionError();
 	m_last_sent_position_timer = 0;
 	m_last_sent_position = getBasePosition();
 	m_last_sent_velocity = m_velocity;
-	//m_last_sent_acceleration = m_acceleration;
+	m_last_sent_acceleration = m_acceleration;
 	m_last_sent_rotation = m_rotation;
 
 	float update_interval = m_env->getSendRecommendedInterval();
@@ -526,6 +574,16 @@ void LuaEntitySAO::sendPosition(bool do_interpolate, bool is_movement_end)
 	m_messages_out.emplace(getId(), false, str);
 }
 
+float LuaEntitySAO::getClientPositionError() const
+{
+	const float t = m_last_sent_position_timer;
+	const v3f extrapolated = m_last_sent_position + m_last_sent_velocity * t +
+			m_last_sent_acceleration * (0.5f * t * t);
+	const v3f pos = getBasePosition();
+	return std::min(pos.getDistanceFrom(m_last_sent_position),
+			pos.getDistanceFrom(extrapolated));
+}
+
 bool LuaEntitySAO::getCollisionBox(aabb3f *toset) const
 {
 	if (m_prop.physical)
@@ -6,6 +6,7 @@
 #pragma once
 
 #include "unit_sao.h"
+#include "collision.h"
 
 class LuaEntitySAO : public UnitSAO
 {
@@ -26,6 +27,7 @@ class LuaEntitySAO : public UnitSAO
 	ActiveObjectType getSendType() const { return ACTIVEOBJECT_TYPE_GENERIC; }
 	virtual void addedToEnvironment(u32 dtime_s);
 	void step(float dtime, bool send_recommended);
+	void prepareStep(float dtime);
 	std::string getClientInitializationData(u16 protocol_version);
 
 	bool isStaticAllowed() const { return m_prop.static_save; }
@@ -78,6 +80,9 @@ class LuaEntitySAO : public UnitSAO
 private:
 	std::string getPropertyPacket();
 	void sendPosition(bool do_interpolate, bool is_movement_end);
+	// Distance to where clients have the object since the last update,
+	// either extrapolated or stopped by a collision
+	float getClientPositionError() const;
 	std::string generateSetTextureModCommand() const;
 	static std::string generateSetSpriteCommand(v2s16 p, u16 num_frames,
 			f32 framelength, bool select_horiz_by_yawpitch);
@@ -89,8 +94,23 @@ class LuaEntitySAO : public UnitSAO
 	v3f m_velocity;
 	v3f m_acceleration;
 
+	// Movement calculated by prepareStep(). It is only used if the inputs
+	// are still the same when step() is called.
+	struct PreparedMove {
+		bool valid = false;
+		float dtime;
+		aabb3f box;
+		f32 stepheight;
+		bool collide_with_objects;
+		v3f pos, velocity, acceleration;
+
+		v3f new_pos, new_velocity;
+		collisionMoveResult result;
+	} m_prepared_move;
+
 	v3f m_last_sent_position;
 	v3f m_last_sent_velocity;
+	v3f m_last_sent_acceleration;
 	v3f m_last_sent_rotation;
 	float m_last_sent_position_timer = 0.0f;
 	float m_last_sent_move_precision = 0.0f;
@@ -0,0 +1,65 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#include "serializedblockcache.h"
+
+SerializedBlockCache::Data SerializedBlockCache::get(v3s16 pos, u8 version, u64 stamp)
+{
+	auto it = m_entries.find({pos, version});
+	if (it == m_entries.end()) {
+		m_misses++;
+		return nullptr;
+	}
+	if (it->second.stamp != stamp) {
+		// outdated, don't keep it around
+		erase(it);
+		m_misses++;
+		return nullptr;
+	}
+
+	m_lru.splice(m_lru.begin(), m_lru, it->second.lru_it);
+	m_hits++;
+	return it->second.data;
+}
+
+void SerializedBlockCache::put(v3s16 pos, u8 version, u64 stamp, Data data)
+{
+	if (!data || data->size() > m_max_size)
+		return;
+
+	Key key{pos, version};
+	auto it = m_entries.find(key);
+	if (it != m_entries.end())
+		erase(it);
+
+	m_lru.push_front(key);
+	m_size += data->size();
+	m_entries.emplace(key, Entry{stamp, std::move(data), m_lru.begin()});
+
+	while (m_size > m_max_size) {
+		auto victim = m_entries.find(m_lru.back());
+		erase(victim);
+	}
+}
+
+void SerializedBlockCache::clear()
+{
+	m_entries.clear();
+	m_lru.clear();
+	m_size = 0;
+}
+
+void SerializedBlockCache::takeStats(u32 &hits, u32 &misses)
+{
+	hits = m_hits;
+	misses = m_misses;
+	m_hits = m_misses = 0;
+}
+
+void SerializedBlockCache::erase(std::unordered_map<Key, Entry, KeyHash>::iterator it)
+{
+	m_size -= it->second.data->size();
+	m_lru.erase(it->second.lru_it);
+	m_entries.erase(it);
+}
@@ -0,0 +1,79 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#pragma once
+
+#include "irr_v3d.h"
+#include "util/basic_macros.h"
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+/*
+	Size-bounded cache of map blocks serialized for the network.
+
+	Entries are keyed by block position and serialization version and are
+	only returned if the modification stamp of the block still matches
+	(see MapBlock::getModificationStamp()). The least recently used entries
+	are evicted first.
+
+	Not thread-safe.
+*/
+class SerializedBlockCache
+{
+public:
+	typedef std::shared_ptr<const std::string> Data;
+
+	/// @param max_size maximum total size of cached data in bytes
+	SerializedBlockCache(size_t max_size) : m_max_size(max_size) {}
+
+	DISABLE_CLASS_COPY(SerializedBlockCache)
+
+	/// @return cached data or nullptr
+	Data get(v3s16 pos, u8 version, u64 stamp);
+
+	void put(v3s16 pos, u8 version, u64 stamp, Data data);
+
+	void clear();
+
+	size_t getSize() const { return m_size; }
+	size_t getEntryCount() const { return m_entries.size(); }
+
+	// Statistics since the last call
+	void takeStats(u32 &hits, u32 &misses);
+
+private:
+	struct Key {
+		v3s16 pos;
+		u8 version;
+
+		bool operator==(const Key &other) const
+		{
+			return pos == other.pos && version == other.version;
+		}
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key &k) const
+		{
+			return std::hash<v3s16>()(k.pos) ^ k.version;
+		}
+	};
+
+	struct Entry {
+		u64 stamp;
+		Data data;
+		std::list<Key>::iterator lru_it;
+	};
+
+	void erase(std::unordered_map<Key, Entry, KeyHash>::iterator it);
+
+	const size_t m_max_size;
+	size_t m_size = 0;
+	u32 m_hits = 0, m_misses = 0;
+	std::unordered_map<Key, Entry, KeyHash> m_entries;
+	// front = most recently used
+	std::list<Key> m_lru;
+};
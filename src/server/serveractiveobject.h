@@ -95,6 +95,15 @@ class ServerActiveObject : public ActiveObject
 	*/
 	virtual void step(float dtime, bool send_recommended){}
 
+	/*
+		Optionally called before step() for all objects at once, on
+		several threads. Expensive calculations that only read the map and
+		other objects can be done here and their results used in step().
+		Neither the map nor any object is modified in the meantime, so
+		nothing but the object itself may be written to.
+	*/
+	virtual void prepareStep(float dtime){}
+
 	/*
 		The return value of this is passed to the client-side object
 		when it is created
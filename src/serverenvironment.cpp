@@ -3,6 +3,7 @@
 // Copyright (C) 2010-2017 celeron55, Perttu Ahola <celeron55@gmail.com>
 
 #include <algorithm>
+#include <iterator>
 #include <stack>
 #include <utility>
 #include "serverenvironment.h"
@@ -24,6 +25,7 @@
 #include "util/basic_macros.h"
 #include "util/pointedthing.h"
 #include "threading/mutex_auto_lock.h"
+#include "threading/workerpool.h"
 #include "filesys.h"
 #include "gameparams.h"
 #include "database/database-dummy.h"
@@ -51,17 +53,10 @@ static constexpr u32 BLOCK_RESAVE_TIMESTAMP_DIFF = 60; // in units of game time
 	ActiveBlockList
 */
 
-static void fillRadiusBlock(v3s16 p0, s16 r, std::set<v3s16> &list)
+static inline bool isInRadius(v3s16 p, v3s16 p0, s16 r)
 {
-	v3s16 p;
-	for(p.X=p0.X-r; p.X<=p0.X+r; p.X++)
-	for(p.Y=p0.Y-r; p.Y<=p0.Y+r; p.Y++)
-	for(p.Z=p0.Z-r; p.Z<=p0.Z+r; p.Z++) {
-		// limit to a sphere
-		if (p.getDistanceFrom(p0) <= r) {
-			list.insert(p);
-		}
-	}
+	// limit to a sphere
+	return p.getDistanceFrom(p0) <= r;
 }
 
 static void fillViewConeBlock(v3s16 p0,
@@ -69,7 +64,7 @@ static void fillViewConeBlock(v3s16 p0,
 	const v3f camera_pos,
 	const v3f camera_dir,
 	const float camera_fov,
-	std::set<v3s16> &list)
+	std::unordered_set<v3s16> &list)
 {
 	v3s16 p;
 	const s16 r_nodes = r * BS * MAP_BLOCKSIZE;
@@ -82,6 +77,30 @@ static void fillViewConeBlock(v3s16 p0,
 	}
 }
 
+void ActiveBlockList::refSphere(v3s16 pos, s16 range,
+	v3s16 except_pos, s16 except_range, bool add)
+{
+	v3s16 p;
+	for (p.X = pos.X - range; p.X <= pos.X + range; p.X++)
+	for (p.Y = pos.Y - range; p.Y <= pos.Y + range; p.Y++)
+	for (p.Z = pos.Z - range; p.Z <= pos.Z + range; p.Z++) {
+		if (!isInRadius(p, pos, range) || isInRadius(p, except_pos, except_range))
+			continue;
+
+		if (add) {
+			if (m_player_refs[p]++ == 0)
+				m_dirty.push_back(p);
+		} else {
+			auto it = m_player_refs.find(p);
+			assert(it != m_player_refs.end());
+			if (--it->second == 0) {
+				m_player_refs.erase(it);
+				m_dirty.push_back(p);
+			}
+		}
+	}
+}
+
 void ActiveBlockList::update(std::vector<PlayerSAO*> &active_players,
 	s16 active_block_range,
 	s16 active_object_range,
@@ -90,13 +109,30 @@ void ActiveBlockList::update(std::vector<PlayerSAO*> &active_players,
 	std::set<v3s16> &extra_blocks_added)
 {
 	/*
-		Create the new list
+		Update the reference counts of blocks around players
 	*/
-	std::set<v3s16> newlist = m_forceloaded_list;
-	std::set<v3s16> extralist;
+	for (auto &it : m_players)
+		it.second.seen = false;
+
+	std::unordered_set<v3s16> extralist;
 	for (const PlayerSAO *playersao : active_players) {
 		v3s16 pos = getNodeBlockPos(floatToInt(playersao->getBasePosition(), BS));
-		fillRadiusBlock(pos, active_block_range, newlist);
+
+		auto it = m_players.find(playersao->getId());
+		if (it == m_players.end()) {
+			refSphere(pos, active_block_range, pos, -1, true);
+			m_players[playersao->getId()] = {pos, active_block_range, true};
+		} else {
+			PlayerState &state = it->second;
+			if (state.pos != pos || state.range != active_block_range) {
+				// Only the difference of the two spheres changes
+				refSphere(pos, active_block_range, state.pos, state.range, true);
+				refSphere(state.pos, state.range, pos, active_block_range, false);
+				state.pos = pos;
+				state.range = active_block_range;
+			}
+			state.seen = true;
+		}
 
 		s16 player_ao_range = std::min(active_object_range, playersao->getWantedRange());
 		// only do this if this would add blocks
@@ -115,51 +151,81 @@ void ActiveBlockList::update(std::vector<PlayerSAO*> &active_players,
 		}
 	}
 
-	m_abm_list = newlist;
-
-	// 1. Find out which blocks on the new list are not on the old list
-	std::set_difference(newlist.begin(), newlist.end(), m_list.begin(), m_list.end(),
-			std::inserter(blocks_added, blocks_added.end()));
+	// Drop players that have left
+	for (auto it = m_players.begin(); it != m_players.end(); ) {
+		if (it->second.seen) {
+			++it;
+			continue;
+		}
+		refSphere(it->second.pos, it->second.range, it->second.pos, -1, false);
+		it = m_players.erase(it);
+	}
 
-	// 2. remove duplicate blocks from the extra list
-	for (v3s16 p : newlist) {
-		extralist.erase(p);
+	// The forceloaded list is modified from outside, so compare it
+	if (m_forceloaded_list != m_forceloaded_prev) {
+		std::set_symmetric_difference(
+				m_forceloaded_list.begin(), m_forceloaded_list.end(),
+				m_forceloaded_prev.begin(), m_forceloaded_prev.end(),
+				std::back_inserter(m_dirty));
+		m_forceloaded_prev = m_forceloaded_list;
 	}
 
-	// 3. Find out which blocks on the extra list are not on the old list
-	std::set_difference(extralist.begin(), extralist.end(), m_list.begin(), m_list.end(),
-			std::inserter(extra_blocks_added, extra_blocks_added.end()));
+	// The view cone changes without any movement
+	m_dirty.insert(m_dirty.end(), m_extra_list.begin(), m_extra_list.end());
+	m_dirty.insert(m_dirty.end(), extralist.begin(), extralist.end());
 
-	// 4. make sure newlist has all new block
-	newlist.insert(extralist.begin(), extralist.end());
+	/*
+		Re-evaluate all blocks that may have changed, collecting changes
+	*/
+	SORT_AND_UNIQUE(m_dirty);
+	for (v3s16 p : m_dirty) {
+		const bool want_abm = m_player_refs.count(p) > 0 ||
+			m_forceloaded_list.count(p) > 0;
+		const bool want = want_abm || extralist.count(p) > 0;
+
+		if (want_abm)
+			m_abm_list.insert(p);
+		else
+			m_abm_list.erase(p);
 
-	// 5. Find out which blocks on the old list are not on the new + extra list
-	std::set_difference(m_list.begin(), m_list.end(), newlist.begin(), newlist.end(),
-			std::inserter(blocks_removed, blocks_removed.end()));
+		const bool active = m_list.count(p) > 0;
+		if (want && !active) {
+			m_list.insert(p);
+			if (want_abm)
+				blocks_added.insert(p);
+			else
+				extra_blocks_added.insert(p);
+		} else if (!want && active) {
+			m_list.erase(p);
+			blocks_removed.insert(p);
+		}
+	}
+	m_dirty.clear();
+	m_extra_list = std::move(extralist);
 
 	/*
 		Do some least-effort sanity checks to hopefully catch code bugs.
 	*/
-	assert(newlist.size() >= extralist.size());
-	assert(newlist.size() >= m_abm_list.size());
-	assert(blocks_removed.size() <= m_list.size());
+	assert(m_list.size() >= m_extra_list.size());
+	assert(m_list.size() >= m_abm_list.size());
+	assert(m_abm_list.size() >= m_player_refs.size());
+	assert(m_abm_list.size() >= m_forceloaded_list.size());
 	if (!blocks_added.empty()) {
-		assert(newlist.count(*blocks_added.begin()) > 0);
+		assert(m_list.count(*blocks_added.begin()) > 0);
+		assert(m_abm_list.count(*blocks_added.begin()) > 0);
 		assert(blocks_removed.count(*blocks_added.begin()) == 0);
 	}
 	if (!extra_blocks_added.empty()) {
-		assert(newlist.count(*extra_blocks_added.begin()) > 0);
-		assert(extralist.count(*extra_blocks_added.begin()) > 0);
+		assert(m_list.count(*extra_blocks_added.begin()) > 0);
+		assert(m_extra_list.count(*extra_blocks_added.begin()) > 0);
+		assert(m_abm_list.count(*extra_blocks_added.begin()) == 0);
 		assert(blocks_added.count(*extra_blocks_added.begin()) == 0);
 	}
 	if (!blocks_removed.empty()) {
-		assert(newlist.count(*blocks_removed.begin()) == 0);
-		assert(extralist.count(*blocks_removed.begin()) == 0);
-		assert(m_list.count(*blocks_removed.begin()) > 0);
+		assert(m_list.count(*blocks_removed.begin()) == 0);
+		assert(m_extra_list.count(*blocks_removed.begin()) == 0);
+		assert(m_abm_list.count(*blocks_removed.begin()) == 0);
 	}
-
-	// Update m_list
-	m_list = std::move(newlist);
 }
 
 /*
@@ -190,6 +256,19 @@ ServerEnvironment::ServerEnvironment(std::unique_ptr<ServerMap> map,
 	m_cache_nodetimer_interval = rangelim(g_settings->getFloat("nodetimer_interval"), 0.1f, 1);
 	m_cache_abm_time_budget = g_settings->getFloat("abm_time_budget");
 
+	u16 abm_scan_threads = g_settings->getU16("abm_scan_threads");
+	if (abm_scan_threads > 0) {
+		// the server thread takes part in the scan too
+		m_abm_scan_pool = std::make_unique<WorkerPool>("ABMScan",
+			abm_scan_threads - 1);
+	}
+
+	u16 collision_threads = g_settings->getU16("entity_collision_threads");
+	if (collision_threads > 0) {
+		m_collision_pool = std::make_unique<WorkerPool>("Collision",
+			collision_threads - 1);
+	}
+
 	m_step_time_counter = mb->addCounter(
 		"minetest_env_step_time", "Time spent in environment step (in microseconds)");
 
@@ -854,6 +933,71 @@ void ServerEnvironment::clearObjects(ClearObjectsMode mode)
 		<< " in " << num_blocks_cleared << " blocks" << std::endl;
 }
 
+// Number of blocks scanned at once before dispatching the triggers
+static constexpr size_t ABM_SCAN_BATCH_SIZE = 1024;
+// Number of blocks handed to a worker at once
+static constexpr size_t ABM_SCAN_CHUNK_SIZE = 16;
+
+void ServerEnvironment::stepABMsParallel(ABMHandler &abmhandler,
+	const std::vector<v3s16> &blocks, TimeTaker &timer, u32 max_time_ms,
+	int &blocks_scanned, int &abms_run, int &blocks_cached)
+{
+	if (abmhandler.empty())
+		return;
+
+	std::vector<ABMBlockScan> jobs(std::min(blocks.size(), ABM_SCAN_BATCH_SIZE));
+	size_t processed = 0;
+
+	for (size_t offset = 0; offset < blocks.size(); offset += ABM_SCAN_BATCH_SIZE) {
+		const size_t end = std::min(blocks.size(), offset + ABM_SCAN_BATCH_SIZE);
+
+		// Collect the blocks of this batch
+		size_t count = 0;
+		for (size_t k = offset; k < end; k++) {
+			MapBlock *block = m_map->getBlockNoCreateNoEx(blocks[k]);
+			if (!block)
+				continue;
+
+			// Set current time as timestamp
+			block->setTimestampNoChangedFlag(m_game_time);
+
+			abmhandler.prepareScan(m_map.get(), block, jobs[count++], myrand());
+		}
+
+		// Scan them in parallel. The map is not modified meanwhile since
+		// we hold the environment lock.
+		{
+			ScopeProfiler sp(g_profiler, "ServerEnv: ABM scan (parallel)", SPT_AVG);
+			const size_t num_chunks = (count + ABM_SCAN_CHUNK_SIZE - 1) / ABM_SCAN_CHUNK_SIZE;
+			m_abm_scan_pool->parallelFor(num_chunks, [&] (size_t chunk) {
+				const size_t first = chunk * ABM_SCAN_CHUNK_SIZE;
+				const size_t last = std::min(count, first + ABM_SCAN_CHUNK_SIZE);
+				for (size_t j = first; j < last; j++)
+					abmhandler.scan(jobs[j]);
+			});
+		}
+
+		// Run the triggers
+		ScopeProfiler sp(g_profiler, "ServerEnv: ABM dispatch (parallel)", SPT_AVG);
+		for (size_t j = 0; j < count; j++) {
+			ABMBlockScan &job = jobs[j];
+			processed++;
+			blocks_cached += job.cached ? 1 : 0;
+			blocks_scanned += job.scanned ? 1 : 0;
+
+			abmhandler.dispatch(job, abms_run);
+
+			u32 time_ms = timer.getTimerTime();
+			if (time_ms > max_time_ms) {
+				warningstream << "active block modifiers took "
+					  << time_ms << "ms (processed " << processed << " of "
+					  << blocks.size() << " active blocks)" << std::endl;
+				return;
+			}
+		}
+	}
+}
+
 void ServerEnvironment::step(float dtime)
 {
 	ScopeProfiler sp2(g_profiler, "ServerEnv::step()", SPT_AVG);
@@ -1027,29 +1171,35 @@ void ServerEnvironment::step(float dtime)
 		std::copy(m_active_blocks.m_abm_list.begin(), m_active_blocks.m_abm_list.end(), output.begin());
 		std::shuffle(output.begin(), output.end(), MyRandGenerator());
 
-		int i = 0;
 		// determine the time budget for ABMs
 		u32 max_time_ms = m_cache_abm_interval * 1000 * m_cache_abm_time_budget;
-		for (const v3s16 &p : output) {
-			MapBlock *block = m_map->getBlockNoCreateNoEx(p);
-			if (!block)
-				continue;
+		if (m_abm_scan_pool) {
+			stepABMsParallel(abmhandler, output, timer, max_time_ms,
+				blocks_scanned, abms_run, blocks_cached);
+		} else {
+			ScopeProfiler sp(g_profiler, "ServerEnv: ABMs (serial)", SPT_AVG);
+			int i = 0;
+			for (const v3s16 &p : output) {
+				MapBlock *block = m_map->getBlockNoCreateNoEx(p);
+				if (!block)
+					continue;
 
-			i++;
+				i++;
 
-			// Set current time as timestamp
-			block->setTimestampNoChangedFlag(m_game_time);
+				// Set current time as timestamp
+				block->setTimestampNoChangedFlag(m_game_time);
 
-			/* Handle ActiveBlockModifiers */
-			abmhandler.apply(block, blocks_scanned, abms_run, blocks_cached);
+				/* Handle ActiveBlockModifiers */
+				abmhandler.apply(block, blocks_scanned, abms_run, blocks_cached);
 
-			u32 time_ms = timer.getTimerTime();
+				u32 time_ms = timer.getTimerTime();
 
-			if (time_ms > max_time_ms) {
-				warningstream << "active block modifiers took "
-					  << time_ms << "ms (processed " << i << " of "
-					  << output.size() << " active blocks)" << std::endl;
-				break;
+				if (time_ms > max_time_ms) {
+					warningstream << "active block modifiers took "
+						  << time_ms << "ms (processed " << i << " of "
+						  << output.size() << " active blocks)" << std::endl;
+					break;
+				}
 			}
 		}
 		g_profiler->avg("ServerEnv: active blocks", m_active_blocks.m_abm_list.size());
@@ -1081,6 +1231,13 @@ void ServerEnvironment::step(float dtime)
 			send_recommended = true;
 		}
 
+		// Compute the collisions of all objects at once. Nothing is
+		// modified meanwhile, the results are applied in step() below.
+		if (m_collision_pool) {
+			ScopeProfiler sp(g_profiler, "ServerEnv: SAO collisions (parallel)", SPT_AVG);
+			m_ao_manager.prepareStep(dtime, m_collision_pool.get());
+		}
+
 		u32 object_count = 0;
 
 		auto cb_state = [&](ServerActiveObject *obj) {
@@ -1236,7 +1393,7 @@ void ServerEnvironment::getAddedActiveObjects(PlayerSAO *playersao, s16 radius,
 	if (!playersao->isEffectivelyObservedBy(playersao->getPlayer()->getName()))
 		throw ModError("Player does not observe itself");
 
-	m_ao_manager.getAddedActiveObjectsAroundPos(
+	m_ao_manager.getAddedActiveObjectsForObserver(playersao->getId(),
 		playersao->getBasePosition(), playersao->getPlayer()->getName(),
 		radius_f, player_radius_f,
 		current_objects, added_objects);
@@ -5,6 +5,8 @@
 #pragma once
 
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 
 #include "activeobject.h"
@@ -27,11 +29,17 @@ struct StaticObject;
 class ServerActiveObject;
 class Server;
 class ServerScripting;
+class WorkerPool;
+class TimeTaker;
 enum AccessDeniedCode : u8;
 typedef u16 session_t;
 
 /*
 	List of active blocks, used by ServerEnvironment
+
+	The set of blocks around players is maintained incrementally: only
+	players that moved into another block since the last update cause
+	work proportional to the active block volume.
 */
 
 class ActiveBlockList
@@ -54,12 +62,20 @@ class ActiveBlockList
 
 	void clear() {
 		m_list.clear();
+		m_abm_list.clear();
+		m_extra_list.clear();
+		m_player_refs.clear();
+		m_players.clear();
+		m_forceloaded_prev.clear();
+		m_dirty.clear();
 	}
 
 	/// @return true if block was newly added
 	bool add(v3s16 p) {
 		if (m_list.insert(p).second) {
 			m_abm_list.insert(p);
+			// re-evaluated on next update
+			m_dirty.push_back(p);
 			return true;
 		}
 		return false;
@@ -68,15 +84,40 @@ class ActiveBlockList
 	void remove(v3s16 p) {
 		m_list.erase(p);
 		m_abm_list.erase(p);
+		// re-evaluated on next update
+		m_dirty.push_back(p);
 	}
 
 	// list of all active blocks
-	std::set<v3s16> m_list;
+	std::unordered_set<v3s16> m_list;
 	// list of blocks for ABM processing
 	// subset of `m_list` that does not contain view cone affected blocks
-	std::set<v3s16> m_abm_list;
+	std::unordered_set<v3s16> m_abm_list;
 	// list of blocks that are always active, not modified by this class
 	std::set<v3s16> m_forceloaded_list;
+
+private:
+	struct PlayerState {
+		v3s16 pos; // block position
+		s16 range;
+		bool seen;
+	};
+
+	// Adds to (or removes from) the reference count of all blocks within
+	// `range` of `pos` and not within `except_range` of `except_pos`
+	void refSphere(v3s16 pos, s16 range, v3s16 except_pos, s16 except_range,
+		bool add);
+
+	// number of players whose active block range covers a block
+	std::unordered_map<v3s16, u16> m_player_refs;
+	// state of each player as of the last update, by object id
+	std::unordered_map<u16, PlayerState> m_players;
+	// view cone blocks as of the last update
+	std::unordered_set<v3s16> m_extra_list;
+	// copy of m_forceloaded_list as of the last update
+	std::set<v3s16> m_forceloaded_prev;
+	// blocks whose state needs to be re-evaluated
+	std::vector<v3s16> m_dirty;
 };
 
 /*
@@ -239,6 +280,13 @@ class ServerEnvironment final : public Environment
 		return m_ao_manager.getObjectsInArea(box, objects, include_obj_cb);
 	}
 
+	// Find the active objects around several points at once
+	void getObjectsInsideRadii(const std::vector<v3f> &centers, float radius,
+			server::ActiveObjectMgr::BatchQueryResult &result)
+	{
+		return m_ao_manager.getObjectsInsideRadii(centers, radius, result);
+	}
+
 	// Clear objects, loading and going through every MapBlock
 	void clearObjects(ClearObjectsMode mode);
 
@@ -317,6 +365,14 @@ class ServerEnvironment final : public Environment
 	*/
 	void removeRemovedObjects();
 
+	/*
+		Run ABMs on the given blocks, scanning them on m_abm_scan_pool
+		and dispatching the triggers on this thread.
+	*/
+	void stepABMsParallel(ABMHandler &abmhandler, const std::vector<v3s16> &blocks,
+			TimeTaker &timer, u32 max_time_ms,
+			int &blocks_scanned, int &abms_run, int &blocks_cached);
+
 	/*
 		Convert stored objects from block to active
 	*/
@@ -380,6 +436,10 @@ class ServerEnvironment final : public Environment
 	u32 m_last_clear_objects_time = 0;
 	// Active block modifiers
 	std::vector<ABMWithState> m_abms;
+	// Threads for scanning blocks for ABM triggers (nullptr = serial)
+	std::unique_ptr<WorkerPool> m_abm_scan_pool;
+	// Threads for computing entity collisions before the step (nullptr = serial)
+	std::unique_ptr<WorkerPool> m_collision_pool;
 	LBMManager m_lbm_mgr;
 	// An interval for generally sending object positions and stuff
 	float m_recommended_send_interval = 0.1f;
@@ -22,7 +22,9 @@
 #include "config.h"
 #include "server.h"
 #include "database/database.h"
+#include "database/database-async.h"
 #include "database/database-dummy.h"
+#include "database/database-mmap.h"
 #include "database/database-sqlite3.h"
 #include "script/scripting_server.h"
 #include "irrlicht_changes/printing.h"
@@ -48,6 +50,78 @@ void MapDatabaseAccessor::loadBlock(v3s16 blockpos, std::string &ret)
 		dbase_ro->loadBlock(blockpos, &ret);
 }
 
+void MapDatabaseAccessor::loadBlocks(const std::vector<v3s16> &blockpos,
+	const MapDatabase::LoadCallback &cb)
+{
+	if (!dbase_ro) {
+		dbase->loadBlocks(blockpos, cb);
+		return;
+	}
+
+	std::vector<v3s16> missing;
+	dbase->loadBlocks(blockpos, [&] (const v3s16 &pos, std::string &data) {
+		if (data.empty())
+			missing.push_back(pos);
+		else
+			cb(pos, data);
+	});
+	if (!missing.empty())
+		dbase_ro->loadBlocks(missing, cb);
+}
+
+namespace {
+
+// Falls back to the handle of the read-only database for missing blocks
+class FallbackReadHandle : public MapDatabaseReadHandle
+{
+public:
+	FallbackReadHandle(std::unique_ptr<MapDatabaseReadHandle> handle,
+			std::unique_ptr<MapDatabaseReadHandle> handle_ro) :
+		m_handle(std::move(handle)), m_handle_ro(std::move(handle_ro))
+	{}
+
+	bool loadBlock(const v3s16 &pos, std::string *block)
+	{
+		if (!m_handle->loadBlock(pos, block))
+			return false;
+		if (!block->empty())
+			return true;
+		return m_handle_ro->loadBlock(pos, block);
+	}
+
+	void loadBlocks(const std::vector<v3s16> &pos,
+		const MapDatabase::LoadCallback &cb, std::vector<v3s16> &unavailable)
+	{
+		std::vector<v3s16> missing;
+		m_handle->loadBlocks(pos, [&] (const v3s16 &p, std::string &data) {
+			if (data.empty())
+				missing.push_back(p);
+			else
+				cb(p, data);
+		}, unavailable);
+		if (!missing.empty())
+			m_handle_ro->loadBlocks(missing, cb, unavailable);
+	}
+
+private:
+	std::unique_ptr<MapDatabaseReadHandle> m_handle;
+	std::unique_ptr<MapDatabaseReadHandle> m_handle_ro;
+};
+
+}
+
+std::unique_ptr<MapDatabaseReadHandle> MapDatabaseAccessor::createReadHandle()
+{
+	auto handle = dbase->createReadHandle();
+	if (!handle || !dbase_ro)
+		return handle;
+
+	auto handle_ro = dbase_ro->createReadHandle();
+	if (!handle_ro)
+		return nullptr;
+	return std::make_unique<FallbackReadHandle>(std::move(handle), std::move(handle_ro));
+}
+
 /*
 	ServerMap
 */
@@ -77,6 +151,11 @@ ServerMap::ServerMap(const std::string &savedir, IGameDef *gamedef,
 	}
 	std::string backend = conf.get("backend");
 	m_db.dbase = createDatabase(backend, savedir, conf);
+	if (g_settings->getBool("map_save_async")) {
+		// Writes are queued up to this size before saving has to wait for the disk
+		const size_t max_queued = 64 * 1024 * 1024;
+		m_db.dbase = new MapDatabaseAsync(m_db.dbase, max_queued);
+	}
 	if (conf.exists("readonly_backend")) {
 		std::string readonly_dir = savedir + DIR_DELIM + "readonly";
 		m_db.dbase_ro = createDatabase(conf.get("readonly_backend"), readonly_dir, conf);
@@ -224,6 +303,19 @@ bool ServerMap::initBlockMake(v3s16 blockpos, BlockMakeData *data)
 	data->blockpos_max = bpmax;
 	data->nodedef = m_nodedef;
 
+	/*
+		Load what exists of this and the neighboring blocks in one go
+	*/
+	{
+		std::vector<v3s16> area;
+		area.reserve(VoxelArea(full_bpmin, full_bpmax).getVolume());
+		for (s16 x = full_bpmin.X; x <= full_bpmax.X; x++)
+		for (s16 z = full_bpmin.Z; z <= full_bpmax.Z; z++)
+		for (s16 y = full_bpmin.Y; y <= full_bpmax.Y; y++)
+			area.emplace_back(x, y, z);
+		loadBlocks(area);
+	}
+
 	/*
 		Create the whole area of this and the neighboring blocks
 	*/
@@ -237,7 +329,8 @@ bool ServerMap::initBlockMake(v3s16 blockpos, BlockMakeData *data)
 		for (s16 y = full_bpmin.Y; y <= full_bpmax.Y; y++) {
 			v3s16 p(x, y, z);
 
-			MapBlock *block = emergeBlock(p, false);
+			// Anything on disk was loaded above
+			MapBlock *block = getBlockNoCreateNoEx(p);
 			if (block == NULL) {
 				block = createBlock(p);
 
@@ -577,8 +670,12 @@ MapDatabase *ServerMap::createDatabase(
 {
 	MapDatabase *db = nullptr;
 
-	if (name == "sqlite3")
-		db = new MapDatabaseSQLite3(savedir);
+	if (name == "sqlite3") {
+		u32 cache_size = 0;
+		conf.getU32NoEx("sqlite_cache_size", cache_size);
+		db = new MapDatabaseSQLite3(savedir,
+			conf.getFlag("sqlite_high_throughput"), cache_size);
+	}
 	if (name == "dummy")
 		db = new Database_Dummy();
 	#if USE_LEVELDB
@@ -589,6 +686,15 @@ MapDatabase *ServerMap::createDatabase(
 	if (name == "redis")
 		db = new Database_Redis(conf);
 	#endif
+	#ifndef _WIN32
+	if (name == "mmap") {
+		u32 segment_size = 0;
+		conf.getU32NoEx("mmap_segment_size", segment_size);
+		db = new MapDatabaseMmap(savedir, segment_size > 0 ?
+			(size_t)std::min<u32>(segment_size, 1024) * 1024 * 1024 :
+			MapDatabaseMmap::DEFAULT_SEGMENT_SIZE);
+	}
+	#endif
 	#if USE_POSTGRESQL
 	if (name == "postgresql") {
 		std::string connect_string;
@@ -621,6 +727,7 @@ bool ServerMap::saveBlock(MapBlock *block)
 {
 	// FIXME: serialization happens under mutex
 	MutexAutoLock dblock(m_db.mutex);
+	MapDatabaseAccessor::WriteScope write(m_db);
 	return saveBlock(block, m_db.dbase, m_map_compression_level);
 }
 
@@ -743,9 +850,36 @@ MapBlock* ServerMap::loadBlock(v3s16 blockpos)
 	return getBlockNoCreateNoEx(blockpos);
 }
 
+void ServerMap::loadBlocks(const std::vector<v3s16> &blockpos)
+{
+	std::vector<v3s16> to_load;
+	for (v3s16 p : blockpos) {
+		if (!getBlockNoCreateNoEx(p))
+			to_load.push_back(p);
+	}
+	if (to_load.empty())
+		return;
+
+	std::vector<std::pair<v3s16, std::string>> loaded;
+	{
+		ScopeProfiler sp(g_profiler, "ServerMap: load blocks - sync (sum)");
+		MutexAutoLock dblock(m_db.mutex);
+		m_db.loadBlocks(to_load, [&] (const v3s16 &pos, std::string &data) {
+			if (!data.empty())
+				loaded.emplace_back(pos, std::move(data));
+		});
+	}
+
+	for (auto &it : loaded) {
+		if (!getBlockNoCreateNoEx(it.first))
+			loadBlock(it.second, it.first);
+	}
+}
+
 bool ServerMap::deleteBlock(v3s16 blockpos)
 {
 	MutexAutoLock dblock(m_db.mutex);
+	MapDatabaseAccessor::WriteScope write(m_db);
 	if (!m_db.dbase->deleteBlock(blockpos))
 		return false;
 
@@ -4,16 +4,17 @@
 
 #pragma once
 
+#include <atomic>
 #include <vector>
 #include <memory>
 
 #include "map.h"
+#include "database/database.h"
 #include "util/container.h" // UniqueQueue
 #include "util/metricsbackend.h" // ptr typedefs
 #include "map_settings_manager.h"
 
 class Settings;
-class MapDatabase;
 class IRollbackManager;
 class EmergeManager;
 class ServerEnvironment;
@@ -29,9 +30,34 @@ struct MapDatabaseAccessor {
 	/// Fallback database for read operations
 	MapDatabase *dbase_ro = nullptr;
 
+	/// Incremented before and after every write to dbase, so that readers
+	/// can tell whether data they read earlier could be outdated.
+	/// It is odd while a write is in progress.
+	std::atomic<u32> write_counter{0};
+
+	/// Marks a write to dbase for its lifetime
+	/// @note create locked
+	class WriteScope {
+	public:
+		WriteScope(MapDatabaseAccessor &db) : m_db(db) { m_db.write_counter++; }
+		~WriteScope() { m_db.write_counter++; }
+		DISABLE_CLASS_COPY(WriteScope)
+	private:
+		MapDatabaseAccessor &m_db;
+	};
+
 	/// Load a block, taking dbase_ro into account.
 	/// @note call locked
 	void loadBlock(v3s16 blockpos, std::string &ret);
+	/// Load several blocks at once, taking dbase_ro into account.
+	/// @note call locked
+	void loadBlocks(const std::vector<v3s16> &blockpos,
+		const MapDatabase::LoadCallback &cb);
+
+	/// Handle for loads without the lock, taking dbase_ro into account.
+	/// Null if a database doesn't support it.
+	/// @note call locked
+	std::unique_ptr<MapDatabaseReadHandle> createReadHandle();
 };
 
 /*
@@ -119,6 +145,9 @@ class ServerMap : public Map
 
 	// Load block in a synchronous fashion
 	MapBlock *loadBlock(v3s16 p);
+	// Load all blocks that are not in memory yet in a synchronous fashion,
+	// with as few database queries as possible
+	void loadBlocks(const std::vector<v3s16> &blockpos);
 	/// Load a block that was already read from disk. Used by EmergeManager.
 	/// @return non-null block (but can be blank)
 	MapBlock *loadBlock(const std::string &blob, v3s16 p, bool save_after_load=false);
@@ -0,0 +1,172 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#include "threading/taskscheduler.h"
+#include "threading/thread.h"
+#include "debug.h"
+#include <algorithm>
+#include <thread>
+
+// Worker of the scheduler the current thread belongs to, if any
+static thread_local const TaskScheduler *t_scheduler = nullptr;
+static thread_local size_t t_worker = 0;
+
+class TaskSchedulerThread : public Thread
+{
+public:
+	TaskSchedulerThread(const std::string &name, TaskScheduler *scheduler,
+			size_t index) :
+		Thread(name), m_scheduler(scheduler), m_index(index)
+	{}
+
+protected:
+	void *run()
+	{
+		BEGIN_DEBUG_EXCEPTION_HANDLER
+
+		t_scheduler = m_scheduler;
+		t_worker = m_index;
+
+		TaskScheduler::Item item;
+		while (true) {
+			if (m_scheduler->dequeue(m_index, item)) {
+				m_scheduler->run(item);
+				continue;
+			}
+			if (!m_scheduler->waitWork())
+				break;
+		}
+
+		END_DEBUG_EXCEPTION_HANDLER
+
+		return nullptr;
+	}
+
+private:
+	TaskScheduler *m_scheduler;
+	const size_t m_index;
+};
+
+TaskScheduler::TaskScheduler(const std::string &name, unsigned int num_threads)
+{
+	num_threads = std::max(num_threads, 1U);
+	for (unsigned int i = 0; i < num_threads; i++)
+		m_queues.emplace_back(std::make_unique<Queue>());
+	for (unsigned int i = 0; i < num_threads; i++) {
+		m_threads.emplace_back(std::make_unique<TaskSchedulerThread>(
+			name + std::to_string(i), this, i));
+		m_threads.back()->start();
+	}
+}
+
+TaskScheduler::~TaskScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	for (auto &thread : m_threads)
+		thread->stop();
+	m_cv.notify_all();
+	for (auto &thread : m_threads)
+		thread->wait();
+}
+
+TaskScheduler &TaskScheduler::shared()
+{
+	static TaskScheduler scheduler("Task",
+		std::max(std::thread::hardware_concurrency(), 2U) - 1);
+	return scheduler;
+}
+
+std::shared_ptr<TaskScheduler::Subsystem> TaskScheduler::addSubsystem(
+		const std::string &name, unsigned int max_running)
+{
+	return std::make_shared<Subsystem>(name, std::max(max_running, 1U));
+}
+
+void TaskScheduler::submit(const std::shared_ptr<Subsystem> &subsystem, Task task,
+		Priority priority)
+{
+	Item item{std::move(task), subsystem, priority};
+	{
+		std::lock_guard<std::mutex> lock(subsystem->m_mutex);
+		if (subsystem->m_running >= subsystem->m_max_running) {
+			subsystem->m_waiting[priority].push_back(std::move(item));
+			return;
+		}
+		subsystem->m_running++;
+	}
+	enqueue(std::move(item));
+}
+
+void TaskScheduler::enqueue(Item &&item)
+{
+	const size_t worker = t_scheduler == this ? t_worker :
+		m_next_queue++ % m_queues.size();
+	{
+		Queue &queue = *m_queues[worker];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.items[item.priority].push_back(std::move(item));
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queued++;
+	}
+	m_cv.notify_one();
+}
+
+bool TaskScheduler::dequeue(size_t worker, Item &item)
+{
+	if (m_queued == 0)
+		return false;
+
+	for (u8 prio = 0; prio < PRIORITY_COUNT; prio++) {
+		// own queue first, then steal from the others
+		for (size_t i = 0; i < m_queues.size(); i++) {
+			Queue &queue = *m_queues[(worker + i) % m_queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			auto &items = queue.items[prio];
+			if (!items.empty()) {
+				item = std::move(items.front());
+				items.pop_front();
+				m_queued--;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void TaskScheduler::run(Item &item)
+{
+	item.task();
+	item.task = nullptr;
+
+	// Released last, this may be the last reference
+	const std::shared_ptr<Subsystem> subsystem = std::move(item.subsystem);
+
+	// Let the next waiting task of the subsystem run
+	Item next;
+	{
+		std::lock_guard<std::mutex> lock(subsystem->m_mutex);
+		auto it = std::find_if(std::begin(subsystem->m_waiting),
+			std::end(subsystem->m_waiting),
+			[] (const std::deque<Item> &waiting) { return !waiting.empty(); });
+		if (it == std::end(subsystem->m_waiting)) {
+			subsystem->m_running--;
+			return;
+		}
+		next = std::move(it->front());
+		it->pop_front();
+	}
+	enqueue(std::move(next));
+}
+
+bool TaskScheduler::waitWork()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_cv.wait(lock, [this] { return m_stop || m_queued > 0; });
+	return !m_stop;
+}
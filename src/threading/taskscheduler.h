@@ -0,0 +1,124 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "irrlichttypes.h"
+#include "util/basic_macros.h"
+
+class TaskSchedulerThread;
+
+/**
+ * Worker threads that run tasks for several subsystems, so that the cores
+ * left idle by one subsystem can be used by another.
+ *
+ * Every worker has a queue per priority. Tasks submitted from a worker go to
+ * its own queue, other tasks are spread over the workers. Workers without
+ * work steal the oldest tasks of the others, the highest priority first.
+ *
+ * A subsystem limits how many of its tasks may run at once. Tasks over the
+ * limit wait in the subsystem until one of its running tasks is done.
+ *
+ * Tasks must not throw. Tasks that are still queued when the scheduler is
+ * destroyed are run first.
+ *
+ * Nothing preempts a task, so tasks must not wait for long on locks or I/O
+ * and must not run for unbounded time. Work like that (emerge, async Lua)
+ * keeps its own threads, so that it can't hold workers that others need.
+ */
+class TaskScheduler
+{
+	friend class TaskSchedulerThread;
+public:
+	enum Priority : u8 {
+		PRIORITY_HIGH,
+		PRIORITY_NORMAL,
+		PRIORITY_LOW,
+		PRIORITY_COUNT
+	};
+
+	using Task = std::function<void()>;
+
+	class Subsystem;
+
+	/// @param name thread name prefix
+	/// @param num_threads number of worker threads, at least one is started
+	TaskScheduler(const std::string &name, unsigned int num_threads);
+	~TaskScheduler();
+
+	DISABLE_CLASS_COPY(TaskScheduler)
+
+	/// The scheduler shared by the engine, with a thread for every core
+	/// but one. It is started on first use.
+	static TaskScheduler &shared();
+
+	unsigned int getThreadCount() const { return m_threads.size(); }
+
+	/// @param max_running how many tasks of the subsystem may run at once
+	std::shared_ptr<Subsystem> addSubsystem(const std::string &name,
+		unsigned int max_running);
+
+	void submit(const std::shared_ptr<Subsystem> &subsystem, Task task,
+		Priority priority = PRIORITY_NORMAL);
+
+private:
+	struct Item {
+		Task task;
+		std::shared_ptr<Subsystem> subsystem;
+		Priority priority;
+	};
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Item> items[PRIORITY_COUNT];
+	};
+
+	// Hands a task that may run now to a worker
+	void enqueue(Item &&item);
+	// Takes a task from the worker's own queue or steals one
+	bool dequeue(size_t worker, Item &item);
+	void run(Item &item);
+	// Waits for work, returns false on shutdown
+	bool waitWork();
+
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::vector<std::unique_ptr<TaskSchedulerThread>> m_threads;
+
+	// for sleeping workers
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	bool m_stop = false;
+	// number of queued tasks, changed under m_mutex when increased
+	std::atomic<size_t> m_queued{0};
+	std::atomic<size_t> m_next_queue{0};
+};
+
+class TaskScheduler::Subsystem
+{
+	friend class TaskScheduler;
+public:
+	Subsystem(const std::string &name, unsigned int max_running) :
+		m_name(name), m_max_running(max_running)
+	{}
+
+	const std::string &getName() const { return m_name; }
+
+private:
+	const std::string m_name;
+
+	std::mutex m_mutex;
+	const unsigned int m_max_running;
+	unsigned int m_running = 0;
+	// tasks over the limit
+	std::deque<Item> m_waiting[PRIORITY_COUNT];
+};
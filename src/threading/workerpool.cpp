@@ -0,0 +1,98 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#include "threading/workerpool.h"
+#include "debug.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(const std::string &name, unsigned int num_threads,
+		TaskScheduler &scheduler) :
+	m_scheduler(scheduler),
+	m_num_threads(num_threads),
+	m_state(std::make_shared<State>())
+{
+	if (num_threads > 0)
+		m_subsystem = scheduler.addSubsystem(name, num_threads);
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t)> &fn)
+{
+	if (count == 0)
+		return;
+	if (m_num_threads == 0 || count == 1) {
+		std::exception_ptr exptr;
+		for (size_t i = 0; i < count; i++) {
+			try {
+				fn(i);
+			} catch (...) {
+				if (!exptr)
+					exptr = std::current_exception();
+			}
+		}
+		if (exptr)
+			std::rethrow_exception(exptr);
+		return;
+	}
+
+	State &state = *m_state;
+	size_t job_id;
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		sanity_check(!state.fn);
+		state.fn = &fn;
+		state.next = 0;
+		state.count = count;
+		state.remaining = count;
+		state.exptr = nullptr;
+		job_id = ++state.job_id;
+	}
+
+	// Helpers that only start after the job is done return immediately
+	const size_t helpers = std::min<size_t>(m_num_threads, count - 1);
+	for (size_t i = 0; i < helpers; i++) {
+		m_scheduler.submit(m_subsystem, [state = m_state, job_id] {
+			work(*state, job_id);
+		}, TaskScheduler::PRIORITY_HIGH);
+	}
+
+	work(state, job_id);
+
+	std::exception_ptr exptr;
+	{
+		std::unique_lock<std::mutex> lock(state.mutex);
+		state.cv_done.wait(lock, [&] { return state.remaining == 0; });
+		state.fn = nullptr;
+		std::swap(exptr, state.exptr);
+	}
+	if (exptr)
+		std::rethrow_exception(exptr);
+}
+
+void WorkerPool::work(State &state, size_t job_id)
+{
+	while (true) {
+		size_t i;
+		const std::function<void(size_t)> *fn;
+		{
+			std::lock_guard<std::mutex> lock(state.mutex);
+			if (state.job_id != job_id || state.next >= state.count)
+				return;
+			i = state.next++;
+			fn = state.fn;
+		}
+
+		std::exception_ptr exptr;
+		try {
+			(*fn)(i);
+		} catch (...) {
+			exptr = std::current_exception();
+		}
+
+		std::lock_guard<std::mutex> lock(state.mutex);
+		if (exptr && !state.exptr)
+			state.exptr = exptr;
+		if (--state.remaining == 0)
+			state.cv_done.notify_all();
+	}
+}
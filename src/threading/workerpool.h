@@ -0,0 +1,72 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2026 Luanti Authors
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "threading/taskscheduler.h"
+#include "util/basic_macros.h"
+
+/**
+ * Fork-join style data parallelism on top of a TaskScheduler.
+ *
+ * Work is handed out in the form of an index range, see `parallelFor`.
+ * The calling thread participates in the work, so a pool with zero
+ * threads is valid and simply runs everything serially.
+ * The other threads are borrowed from the scheduler, the pool is one of its
+ * subsystems.
+ */
+class WorkerPool
+{
+public:
+	/// @param name name of the subsystem
+	/// @param num_threads number of additional threads to use at most
+	WorkerPool(const std::string &name, unsigned int num_threads,
+		TaskScheduler &scheduler = TaskScheduler::shared());
+
+	DISABLE_CLASS_COPY(WorkerPool)
+
+	/// @return number of threads that can execute work at most, including the caller
+	unsigned int getConcurrency() const { return m_num_threads + 1; }
+
+	/**
+	 * Runs `fn(i)` for every i in [0, count) and waits for completion.
+	 *
+	 * Indices are processed in no particular order and by any thread.
+	 * If any invocation throws the first exception is re-thrown here
+	 * after all others have finished.
+	 * Must not be called concurrently or from inside of `fn`.
+	 */
+	void parallelFor(size_t count, const std::function<void(size_t)> &fn);
+
+private:
+	// Shared with the tasks, which may outlive the pool
+	struct State {
+		std::mutex mutex;
+		std::condition_variable cv_done;
+
+		// Current job (protected by mutex)
+		size_t job_id = 0;
+		const std::function<void(size_t)> *fn = nullptr;
+		size_t next = 0;
+		size_t count = 0;
+		size_t remaining = 0;
+		std::exception_ptr exptr;
+	};
+
+	// Processes items of the job until none are left.
+	static void work(State &state, size_t job_id);
+
+	TaskScheduler &m_scheduler;
+	std::shared_ptr<TaskScheduler::Subsystem> m_subsystem;
+	const unsigned int m_num_threads;
+	std::shared_ptr<State> m_state;
+};
@@ -5,6 +5,8 @@
 #include "test.h"
 
 #include "mock_activeobject.h"
+#include "util/serialize.h"
+#include <sstream>
 
 class TestActiveObject : public TestBase
 {
@@ -15,6 +17,7 @@ class TestActiveObject : public TestBase
 	void runTests(IGameDef *gamedef);
 
 	void testAOAttributes();
+	void testCompactPositionUpdate();
 };
 
 static TestActiveObject g_test_instance;
@@ -22,6 +25,7 @@ static TestActiveObject g_test_instance;
 void TestActiveObject::runTests(IGameDef *gamedef)
 {
 	TEST(testAOAttributes);
+	TEST(testCompactPositionUpdate);
 }
 
 void TestActiveObject::testAOAttributes()
@@ -32,3 +36,48 @@ void TestActiveObject::testAOAttributes()
 	ao.setId(558);
 	UASSERT(ao.getId() == 558);
 }
+
+void TestActiveObject::testCompactPositionUpdate()
+{
+	AOPositionUpdate update;
+	update.position = v3f(-1234.567f, 89.01f, 300000.0f);
+	update.velocity = v3f(12.3f, -45.6f, 0.0f);
+	update.acceleration = v3f(0.0f, -98.1f, 0.0f);
+	update.rotation = v3f(0.0f, 270.5f, 359.999f);
+	update.do_interpolate = true;
+	update.update_interval = 0.09f;
+
+	std::ostringstream os(std::ios::binary);
+	writeU8(os, AO_CMD_UPDATE_POSITION);
+	update.serialize(os);
+	const std::string full = os.str();
+	const std::string compact = AOPositionUpdate::compactCommand(full);
+	UASSERT(!compact.empty());
+	UASSERT(compact.size() < full.size());
+	UASSERTEQ(int, compact[0], AO_CMD_UPDATE_POSITION_COMPACT);
+
+	AOPositionUpdate result;
+	std::istringstream is(compact.substr(1), std::ios::binary);
+	result.deSerializeCompact(is);
+	UASSERT(result.position.getDistanceFrom(update.position) < 0.02f);
+	UASSERT(result.velocity.getDistanceFrom(update.velocity) < 0.1f);
+	UASSERT(result.acceleration.getDistanceFrom(update.acceleration) < 0.1f);
+	UASSERT(std::fabs(result.rotation.Y - update.rotation.Y) < 0.01f);
+	// wraps around to 0
+	UASSERT(result.rotation.Z < 0.01f || result.rotation.Z > 359.98f);
+	UASSERT(result.do_interpolate);
+	UASSERT(!result.is_end_position);
+	UASSERT(std::fabs(result.update_interval - update.update_interval) < 0.001f);
+
+	// Zero vectors are left out
+	update.velocity = update.acceleration = update.rotation = v3f();
+	std::ostringstream os2(std::ios::binary);
+	UASSERT(update.serializeCompact(os2));
+	UASSERTEQ(size_t, os2.str().size(), 1 + 12 + 2);
+
+	// Too fast for the compact form
+	update.velocity = v3f(5000.0f, 0.0f, 0.0f);
+	std::ostringstream os3(std::ios::binary);
+	UASSERT(!update.serializeCompact(os3));
+	UASSERT(os3.str().empty());
+}
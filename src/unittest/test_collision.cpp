@@ -5,6 +5,9 @@
 #include "test.h"
 #include "dummymap.h"
 #include "environment.h"
+#include "gamedef.h"
+#include "mapblock.h"
+#include "nodedef.h"
 #include "irrlicht_changes/printing.h"
 
 #include "collision.h"
@@ -18,6 +21,7 @@ class TestCollision : public TestBase {
 
 	void testAxisAlignedCollision();
 	void testCollisionMoveSimple(IGameDef *gamedef);
+	void testCollisionBoxCache(IGameDef *gamedef);
 };
 
 static TestCollision g_test_instance;
@@ -26,6 +30,7 @@ void TestCollision::runTests(IGameDef *gamedef)
 {
 	TEST(testAxisAlignedCollision);
 	TEST(testCollisionMoveSimple, gamedef);
+	TEST(testCollisionBoxCache, gamedef);
 }
 
 namespace {
@@ -377,3 +382,80 @@ void TestCollision::testCollisionMoveSimple(IGameDef *gamedef)
 	// No warnings should have been raised during our test.
 	UASSERT(!g_collision_problems_encountered);
 }
+
+void TestCollision::testCollisionBoxCache(IGameDef *gamedef)
+{
+	auto env = std::make_unique<TestEnvironment>(gamedef);
+	Map &map = env->getMap();
+
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++)
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+		map.setNode({x, 0, z}, MapNode(t_CONTENT_STONE));
+	map.setNode({3, 1, 4}, MapNode(t_CONTENT_STONE));
+	map.setNode({5, 1, 4}, MapNode(t_CONTENT_WATER));
+
+	// bounciness too large for the cache entry
+	ContentFeatures f;
+	f.name = "test:very_bouncy";
+	f.groups["bouncy"] = 300;
+	const content_t c_bouncy =
+		const_cast<NodeDefManager *>(gamedef->ndef())->set(f.name, f);
+	map.setNode({8, 1, 8}, MapNode(c_bouncy));
+
+	const aabb3f box(fpos(-0.1f, 0, -0.1f), fpos(0.1f, 1.4f, 0.1f));
+	const v3f starts[] = {
+		fpos(0, 0.5f, 0), fpos(4, 1, 4), fpos(2.5f, 0.5f, 4),
+		fpos(4.5f, 0.6f, 4), fpos(15.9f, 3, 15.9f), fpos(0, -100, 0),
+		fpos(8, 2, 8),
+	};
+	const v3f speeds[] = {
+		fpos(0, 0, 0), fpos(3, 0, 0), fpos(-3, 2, 0), fpos(0, -5, 1),
+	};
+
+	/* same results with and without the cache */
+	for (v3f start : starts)
+	for (v3f start_speed : speeds) {
+		v3f pos[2], speed[2];
+		collisionMoveResult res[2];
+		for (int i = 0; i < 2; i++) {
+			map.use_collision_cache = i == 1;
+			pos[i] = start;
+			speed[i] = start_speed;
+			res[i] = collisionMoveSimple(env.get(), gamedef, box, 0.6f * BS,
+				0.2f, &pos[i], &speed[i], fpos(0, -9.81f, 0));
+		}
+		UASSERTEQ_V3F(pos[1], pos[0]);
+		UASSERTEQ_V3F(speed[1], speed[0]);
+		UASSERTEQ(bool, res[1].collides, res[0].collides);
+		UASSERTEQ(bool, res[1].touching_ground, res[0].touching_ground);
+		UASSERTEQ(size_t, res[1].collisions.size(), res[0].collisions.size());
+	}
+
+	/* changing a node drops the cache */
+	v3f pos = fpos(0, 0.5f, 0), speed;
+	auto res = collisionMoveSimple(env.get(), gamedef, box, 0.0f, 0.05f,
+		&pos, &speed, fpos(0, -9.81f, 0));
+	UASSERT(res.touching_ground);
+
+	map.setNode({0, 0, 0}, MapNode(CONTENT_AIR));
+	pos = fpos(0, 0.5f, 0);
+	speed = v3f();
+	res = collisionMoveSimple(env.get(), gamedef, box, 0.0f, 0.05f,
+		&pos, &speed, fpos(0, -9.81f, 0));
+	UASSERT(!res.touching_ground);
+	UASSERT(pos.Y < fpos(0, 0.5f, 0).Y);
+
+	/* only nodes that aren't plain cubes take up entries */
+	MapBlock *block = map.getBlockNoCreate({0, 0, 0});
+	const BlockCollisionBoxes *boxes = block->getCollisionBoxes();
+	// the floor without the removed node, and the one on top of it
+	UASSERTEQ(size_t, boxes->cubes.count(), MAP_BLOCKSIZE * MAP_BLOCKSIZE - 1 + 1);
+	UASSERTEQ(size_t, boxes->nodes.size(), 1);
+	UASSERTEQ(int, boxes->nodes[0].kind, BlockCollisionBoxes::NODE_UNCACHED);
+
+	/* light changes keep the cache */
+	MapNode n = map.getNode({3, 1, 4});
+	n.setLight(LIGHTBANK_DAY, 5, gamedef->ndef()->getLightingFlags(n));
+	map.setNode({3, 1, 4}, n);
+	UASSERT(block->getCollisionBoxes() == boxes);
+}
@@ -12,6 +12,7 @@
 #include "network/mtp/internal.h"
 #include "network/networkpacket.h"
 #include "network/socket.h"
+#include <random>
 
 class TestConnection : public TestBase {
 public:
@@ -27,6 +28,7 @@ class TestConnection : public TestBase {
 
 	void testNetworkPacketSerialize();
 	void testHelpers();
+	void testReliablePacketBuffer();
 	void testConnectSendReceive();
 };
 
@@ -36,6 +38,7 @@ void TestConnection::runTests(IGameDef *gamedef)
 {
 	TEST(testNetworkPacketSerialize);
 	TEST(testHelpers);
+	TEST(testReliablePacketBuffer);
 	TEST(testConnectSendReceive);
 }
 
@@ -143,6 +146,86 @@ void TestConnection::testHelpers()
 }
 
 
+void TestConnection::testReliablePacketBuffer()
+{
+	/*
+		Send 1000 packets that are all in flight at once, losing 10% of
+		the packets and of the acks, across the seqnum wrap around.
+	*/
+	const u32 proto_id = 0x12345678;
+	const u16 first_seqnum = 65000;
+	const u16 count = 1000;
+	const float resend_timeout = 0.5f;
+	Address a(127,0,0,1, 10);
+	std::mt19937 gen(0x5eed);
+	auto lost = [&] () { return gen() % 10 == 0; };
+	auto make = [&] (u16 seqnum) {
+		SharedBuffer<u8> data(2);
+		writeU16(&data[0], seqnum);
+		return con::makePacket(a, con::makeReliablePacket(data, seqnum),
+			proto_id, 1, 0);
+	};
+
+	con::ReliablePacketBuffer sent, received;
+	std::vector<u16> wire;
+	for (u16 i = 0; i < count; i++) {
+		const u16 seqnum = first_seqnum + i;
+		auto p = make(seqnum);
+		// like ConnectionSendThread does
+		sent.insert(p, seqnum + 1 - MAX_RELIABLE_WINDOW_SIZE);
+		wire.push_back(seqnum);
+	}
+	UASSERTEQ(u32, sent.size(), count);
+
+	u16 next_incoming = first_seqnum;
+	u32 delivered = 0, resent = 0;
+	int rounds = 0;
+	while (!sent.empty()) {
+		UASSERT(++rounds < 200);
+		for (u16 seqnum : wire) {
+			if (lost())
+				continue;
+
+			if (seqnum == next_incoming) {
+				next_incoming++;
+				delivered++;
+				u16 first;
+				while (received.getFirstSeqnum(first) && first == next_incoming) {
+					UASSERTEQ(u16, received.popFirst()->getSeqnum(), next_incoming);
+					next_incoming++;
+					delivered++;
+				}
+			} else if (con::seqnum_in_window(seqnum, next_incoming,
+					MAX_RELIABLE_WINDOW_SIZE_RECV)) {
+				// like ConnectionReceiveThread does
+				auto p = make(seqnum);
+				received.insert(p, next_incoming);
+			}
+
+			// duplicates are acked again
+			if (lost())
+				continue;
+			try {
+				auto p = sent.popSeqnum(seqnum);
+				UASSERT(p->totaltime >= 0);
+			} catch (con::NotFoundException &e) {
+			}
+		}
+
+		sent.incrementTimeouts(resend_timeout);
+		wire.clear();
+		for (auto &p : sent.getResend(resend_timeout, count))
+			wire.push_back(p->getSeqnum());
+		resent += wire.size();
+	}
+
+	UASSERTEQ(u32, delivered, count);
+	UASSERTEQ(u16, next_incoming, (u16)(first_seqnum + count));
+	UASSERT(received.empty());
+	UASSERT(resent > 0);
+	UASSERTEQ(u32, sent.getTimedOuts(0), 0);
+}
+
 void TestConnection::testConnectSendReceive()
 {
 
@@ -5,6 +5,9 @@
 #include "test.h"
 
 #include "util/container.h"
+#include <memory>
+#include <thread>
+#include <vector>
 
 class TestDataStructures : public TestBase
 {
@@ -19,6 +22,11 @@ class TestDataStructures : public TestBase
 	void testMap3();
 	void testMap4();
 	void testMap5();
+
+	void testMPSCQueue();
+	void testMPSCQueueThreads();
+	void testSPSCRing();
+	void testSPSCRingThreads();
 };
 
 static TestDataStructures g_test_instance;
@@ -31,6 +39,12 @@ void TestDataStructures::runTests(IGameDef *gamedef)
 	TEST(testMap3);
 	TEST(testMap4);
 	TEST(testMap5);
+
+	rawstream << "-------- MPSCQueue / SPSCRing" << std::endl;
+	TEST(testMPSCQueue);
+	TEST(testMPSCQueueThreads);
+	TEST(testSPSCRing);
+	TEST(testSPSCRingThreads);
 }
 
 namespace {
@@ -168,3 +182,100 @@ void TestDataStructures::testMap5()
 		break;
 	}
 }
+
+void TestDataStructures::testMPSCQueue()
+{
+	MPSCQueue<std::unique_ptr<int>> queue;
+	std::unique_ptr<int> v;
+
+	UASSERT(queue.empty());
+	UASSERT(!queue.try_pop_front(v));
+	UASSERT(!queue.pop_frontNoEx(0));
+	EXCEPTION_CHECK(ItemNotFoundException, queue.pop_front(0));
+
+	queue.push_back(std::make_unique<int>(1));
+	queue.push_back(std::make_unique<int>(2));
+	queue.push_back(std::make_unique<int>(3));
+	UASSERT(!queue.empty());
+
+	UASSERT(queue.try_pop_front(v) && *v == 1);
+	UASSERTEQ(int, *queue.pop_front(0), 2);
+	UASSERTEQ(int, *queue.pop_frontNoEx(), 3);
+	UASSERT(queue.empty());
+
+	// left over items are freed
+	queue.push_back(std::make_unique<int>(4));
+}
+
+void TestDataStructures::testMPSCQueueThreads()
+{
+	constexpr u32 PRODUCERS = 4, ITEMS = 20000;
+	MPSCQueue<u32> queue;
+
+	std::vector<std::thread> threads;
+	for (u32 p = 0; p < PRODUCERS; p++) {
+		threads.emplace_back([&queue, p] {
+			for (u32 i = 0; i < ITEMS; i++)
+				queue.push_back(p << 16 | i);
+		});
+	}
+
+	std::vector<u32> received;
+	for (u32 n = 0; n < PRODUCERS * ITEMS; n++)
+		received.push_back(queue.pop_frontNoEx());
+	for (auto &thread : threads)
+		thread.join();
+	UASSERT(queue.empty());
+
+	// items of each producer arrive in order
+	std::vector<u32> next(PRODUCERS, 0);
+	for (u32 v : received) {
+		UASSERTEQ(u32, v & 0xffff, next[v >> 16]);
+		next[v >> 16]++;
+	}
+	for (u32 p = 0; p < PRODUCERS; p++)
+		UASSERTEQ(u32, next[p], ITEMS);
+}
+
+void TestDataStructures::testSPSCRing()
+{
+	SPSCRing<int> ring(5);
+	int v;
+
+	UASSERTEQ(size_t, ring.capacity(), 8);
+	UASSERT(!ring.try_pop_front(v));
+	UASSERTEQ(int, ring.pop_frontNoEx(0), 0);
+
+	for (int i = 1; i <= 8; i++)
+		UASSERT(ring.try_push_back(i));
+	UASSERT(!ring.try_push_back(9));
+	UASSERTEQ(size_t, ring.size(), 8);
+
+	UASSERT(ring.try_pop_front(v) && v == 1);
+	UASSERT(ring.try_push_back(9));
+	for (int i = 2; i <= 9; i++)
+		UASSERTEQ(int, ring.pop_frontNoEx(0), i);
+	UASSERT(ring.empty());
+}
+
+void TestDataStructures::testSPSCRingThreads()
+{
+	constexpr u32 ITEMS = 100000;
+	SPSCRing<u32> ring(64);
+
+	std::thread producer([&ring] {
+		for (u32 i = 1; i <= ITEMS; i++) {
+			while (!ring.try_push_back(i))
+				std::this_thread::yield();
+		}
+	});
+
+	std::vector<u32> received;
+	for (u32 n = 0; n < ITEMS; n++)
+		received.push_back(ring.pop_frontNoEx(1000));
+	producer.join();
+	UASSERT(ring.empty());
+
+	for (u32 i = 0; i < ITEMS; i++)
+		UASSERTEQ(u32, received[i], i + 1);
+}
@@ -98,6 +98,27 @@ SECTION("random operations") {
 		CHECK(expected_ids.empty());
 	};
 
+	const auto testRandomBatchQuery = [&]() {
+		constexpr size_t count = 20;
+		std::array<f32, 3> min[count], max[count];
+		std::vector<std::unordered_set<u16>> expected_ids(count);
+		for (size_t q = 0; q < count; ++q) {
+			for (uint8_t d = 0; d < 3; ++d) {
+				min[q][d] = pr.range(-1500, 1500);
+				max[q][d] = min[q][d] + pr.range(1, 1000);
+			}
+			objvec.rangeQuery(min[q], max[q], [&](auto _, u16 id) {
+				expected_ids[q].insert(id);
+			});
+		}
+		kds.batchRangeQuery(min, max, count, [&](size_t q, auto point, u16 id) {
+			CHECK(expected_ids[q].count(id) == 1);
+			expected_ids[q].erase(id);
+		});
+		for (const auto &ids : expected_ids)
+			CHECK(ids.empty());
+	};
+
 	for (u16 id = 1; id < 1000; ++id) {
 		const auto point = randPos();
 		objvec.insert(point, id);
@@ -109,6 +130,9 @@ SECTION("random operations") {
 		for (int i = 0; i < 1000; ++i) {
 			testRandomQuery();
 		}
+		for (int i = 0; i < 50; ++i) {
+			testRandomBatchQuery();
+		}
 	};
 
 	testRandomQueries();
@@ -26,6 +26,8 @@ class TestMapBlock : public TestBase
 
 	void testSave29(IGameDef *gamedef);
 
+	void testSerializeUncompressed(IGameDef *gamedef);
+
 	void testLoad29(IGameDef *gamedef);
 
 	// Tests loading a MapBlock from Minetest-c55 0.3
@@ -42,6 +44,7 @@ void TestMapBlock::runTests(IGameDef *gamedef)
 	TEST(testSaveLoad, gamedef, SER_FMT_VER_HIGHEST_WRITE);
 	TEST(testSaveLoadLowest, gamedef);
 	TEST(testSave29, gamedef);
+	TEST(testSerializeUncompressed, gamedef);
 	TEST(testLoad29, gamedef);
 	TEST(testLoad20, gamedef);
 	TEST(testLoadNonStd, gamedef);
@@ -356,3 +359,43 @@ void TestMapBlock::testLoadNonStd(IGameDef *gamedef)
 	for (s16 i = 0; i < 16; i++)
 		UASSERTEQ(int, block.getNodeNoEx({i, 1, 0}).param2, data_lo[i]);
 }
+
+void TestMapBlock::testSerializeUncompressed(IGameDef *gamedef)
+{
+	MapBlock block({}, gamedef);
+	PcgRandom r(0xbad5eed);
+	for (size_t i = 0; i < MapBlock::nodecount; ++i)
+		block.getData()[i] = MapNode(r.next() % 3);
+
+	// compressing the output separately must give the same result
+	for (bool disk : {false, true}) {
+		std::ostringstream os1(std::ios_base::binary);
+		block.serialize(os1, SER_FMT_VER_HIGHEST_WRITE, disk, -1);
+
+		std::ostringstream os_raw(std::ios_base::binary), os2(std::ios_base::binary);
+		block.serializeUncompressed(os_raw, SER_FMT_VER_HIGHEST_WRITE, disk);
+		const std::string raw = os_raw.str();
+		compress((const u8 *)raw.data(), raw.size(), os2, SER_FMT_VER_HIGHEST_WRITE, -1);
+
+		UASSERT(os1.str() == os2.str());
+	}
+
+	// the modification stamp must change on modification only
+	u64 stamp = block.getModificationStamp();
+	std::ostringstream os(std::ios_base::binary);
+	block.serialize(os, SER_FMT_VER_HIGHEST_WRITE, false, -1);
+	UASSERTEQ(u64, block.getModificationStamp(), stamp);
+	block.setNode(v3s16(1, 2, 3), MapNode(CONTENT_AIR));
+	UASSERT(block.getModificationStamp() != stamp);
+
+	// and only on changes that are sent to clients
+	stamp = block.getModificationStamp();
+	block.setTimestamp(block.getTimestamp() + 100);
+	block.raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_STATIC_DATA_CHANGED);
+	UASSERTEQ(u64, block.getModificationStamp(), stamp);
+	block.setLightingComplete(block.getLightingComplete() ^ 1);
+	UASSERT(block.getModificationStamp() != stamp);
+
+	MapBlock block2({}, gamedef);
+	UASSERT(block2.getModificationStamp() != block.getModificationStamp());
+}
@@ -6,11 +6,19 @@
 
 #include "test.h"
 
+#include <algorithm>
+#include <fstream>
 #include <functional>
+#include <map>
 #include <memory>
 #include <optional>
+#include "database/database-async.h"
 #include "database/database-dummy.h"
+#include "database/database-mmap.h"
 #include "database/database-sqlite3.h"
+#include "exceptions.h"
+#include "filesys.h"
+#include "noise.h"
 #if USE_LEVELDB
 #include "database/database-leveldb.h"
 #endif
@@ -57,6 +65,87 @@ class MapDatabaseProvider
 	MapDatabase *m_db = nullptr;
 };
 
+typedef std::map<s64, std::string> BlockMap;
+
+// Makes writes visible only on endSave() and remembers every committed state,
+// i.e. everything a crash could leave behind.
+class TransactionRecorder : public MapDatabase
+{
+public:
+	TransactionRecorder(std::vector<BlockMap> *commits) : m_commits(commits) {}
+
+	// Make the n-th following write fail, by returning false or by throwing
+	void failWrite(int n, bool do_throw)
+	{
+		m_fail_countdown = n;
+		m_fail_throw = do_throw;
+	}
+
+	void beginSave()
+	{
+		if (m_in_transaction)
+			throw DatabaseException("transaction within a transaction");
+		m_in_transaction = true;
+	}
+	void abortSave()
+	{
+		m_uncommitted.clear();
+		m_in_transaction = false;
+	}
+	void endSave()
+	{
+		for (auto &it : m_uncommitted) {
+			if (it.second)
+				m_committed[it.first] = *it.second;
+			else
+				m_committed.erase(it.first);
+		}
+		m_uncommitted.clear();
+		m_in_transaction = false;
+		m_commits->push_back(m_committed);
+	}
+
+	bool saveBlock(const v3s16 &pos, std::string_view data)
+	{
+		return write(pos, std::string(data));
+	}
+	void loadBlock(const v3s16 &pos, std::string *block)
+	{
+		auto it = m_committed.find(getBlockAsInteger(pos));
+		*block = it == m_committed.end() ? "" : it->second;
+	}
+	bool deleteBlock(const v3s16 &pos)
+	{
+		return write(pos, std::nullopt);
+	}
+	void listAllLoadableBlocks(std::vector<v3s16> &dst)
+	{
+		for (auto &it : m_committed)
+			dst.push_back(getIntegerAsBlock(it.first));
+	}
+
+private:
+	bool write(const v3s16 &pos, std::optional<std::string> data)
+	{
+		if (m_fail_countdown > 0 && --m_fail_countdown == 0) {
+			if (m_fail_throw)
+				throw DatabaseException("write failed");
+			return false;
+		}
+		m_uncommitted[getBlockAsInteger(pos)] = std::move(data);
+		if (!m_in_transaction)
+			endSave();
+		return true;
+	}
+
+	bool m_in_transaction = false;
+	int m_fail_countdown = 0;
+	bool m_fail_throw = false;
+	BlockMap m_committed;
+	std::map<s64, std::optional<std::string>> m_uncommitted;
+	std::vector<BlockMap> *m_commits;
+};
+
 }
 
 class TestMapDatabase : public TestBase
@@ -70,9 +159,15 @@ class TestMapDatabase : public TestBase
 
 	void testSave();
 	void testLoad();
+	void testLoadMany();
+	void testLoadUncommitted();
+	void testReadHandle();
 	void testList(int expect);
 	void testRemove();
 	void testPositionEncoding();
+	void testAsyncOrdering();
+	void testAsyncFailure();
+	void testMmapCompaction(const std::string &dir);
 
 private:
 	MapDatabaseProvider *provider = nullptr;
@@ -92,6 +187,11 @@ void TestMapDatabase::runTests(IGameDef *gamedef)
 	sanity_check(!test_data.empty());
 
 	TEST(testPositionEncoding);
+	TEST(testAsyncOrdering);
+	TEST(testAsyncFailure);
+#ifndef _WIN32
+	TEST(testMmapCompaction, test_dir + DIR_DELIM + "compaction");
+#endif
 
 	rawstream << "-------- Dummy" << std::endl;
 
@@ -111,6 +211,32 @@ void TestMapDatabase::runTests(IGameDef *gamedef)
 	runTestsForCurrentDB();
 	delete provider;
 
+	rawstream << "-------- SQLite3 (high throughput)" << std::endl;
+
+	provider = new MapDatabaseProvider([&] () {
+		return new MapDatabaseSQLite3(test_dir, true, 4096);
+	});
+	runTestsForCurrentDB();
+	delete provider;
+
+	rawstream << "-------- Async (SQLite3)" << std::endl;
+
+	provider = new MapDatabaseProvider([&] () {
+		return new MapDatabaseAsync(new MapDatabaseSQLite3(test_dir), 1024);
+	});
+	runTestsForCurrentDB();
+	delete provider;
+
+#ifndef _WIN32
+	rawstream << "-------- Mmap" << std::endl;
+
+	provider = new MapDatabaseProvider([&] () {
+		return new MapDatabaseMmap(test_dir);
+	});
+	runTestsForCurrentDB();
+	delete provider;
+#endif
+
 #if USE_LEVELDB
 	rawstream << "-------- LevelDB" << std::endl;
 
@@ -142,6 +268,9 @@ void TestMapDatabase::runTestsForCurrentDB()
 	// order-sensitive
 	TEST(testSave);
 	TEST(testLoad);
+	TEST(testLoadMany);
+	TEST(testLoadUncommitted);
+	TEST(testReadHandle);
 	TEST(testList, 1);
 	TEST(testRemove);
 	TEST(testList, 0);
@@ -175,6 +304,94 @@ void TestMapDatabase::testLoad()
 	}
 }
 
+void TestMapDatabase::testLoadMany()
+{
+	auto *db = provider->get();
+
+	// enough to need several queries
+	std::vector<v3s16> pp;
+	for (s16 i = -50; i < 50; i++)
+		pp.emplace_back(1, i, 3);
+	pp.emplace_back(1, 2, 4);
+
+	std::map<s64, std::string> results;
+	db->loadBlocks(pp, [&] (const v3s16 &pos, std::string &data) {
+		// exactly once per position
+		UASSERT(results.emplace(MapDatabase::getBlockAsInteger(pos), data).second);
+	});
+	UASSERTEQ(size_t, results.size(), pp.size());
+	for (v3s16 p : pp) {
+		const std::string &data = results[MapDatabase::getBlockAsInteger(p)];
+		if (p == v3s16(1, 2, 3)) {
+			UASSERT(data == test_data);
+		} else {
+			UASSERT(data.empty());
+		}
+	}
+}
+
+void TestMapDatabase::testLoadUncommitted()
+{
+	auto *db = provider->get();
+	const v3s16 pos(1, 2, 5);
+	std::string dest;
+
+	// writes must be visible before the save ends
+	UASSERT(db->saveBlock(pos, test_data));
+	db->loadBlock(pos, &dest);
+	UASSERT(dest == test_data);
+	dest.clear();
+	db->loadBlocks({pos, {1, 2, 3}}, [&] (const v3s16 &p, std::string &data) {
+		if (p == pos)
+			dest = data;
+	});
+	UASSERT(dest == test_data);
+
+	UASSERT(db->deleteBlock(pos));
+	db->loadBlock(pos, &dest);
+	UASSERT(dest.empty());
+}
+
+void TestMapDatabase::testReadHandle()
+{
+	auto *db = provider->get();
+	auto handle = db->createReadHandle();
+	if (!handle)
+		return;
+	std::string dest;
+
+	// committed data
+	UASSERT(handle->loadBlock({1, 2, 3}, &dest));
+	UASSERT(dest == test_data);
+	dest = "not empty";
+	UASSERT(handle->loadBlock({1, 2, 4}, &dest));
+	UASSERT(dest.empty());
+
+	// uncommitted data is either visible or left to the database
+	const v3s16 pos(1, 2, 5);
+	UASSERT(db->saveBlock(pos, test_data));
+	dest.clear();
+	if (handle->loadBlock(pos, &dest))
+		UASSERT(dest == test_data);
+
+	std::vector<v3s16> pp{pos, {1, 2, 3}, {1, 2, 4}};
+	std::vector<v3s16> unavailable;
+	std::map<s64, std::string> results;
+	handle->loadBlocks(pp, [&] (const v3s16 &p, std::string &data) {
+		UASSERT(results.emplace(MapDatabase::getBlockAsInteger(p), data).second);
+	}, unavailable);
+	// exactly once per position, one way or the other
+	for (v3s16 p : unavailable)
+		UASSERT(results.emplace(MapDatabase::getBlockAsInteger(p), "").second);
+	UASSERTEQ(size_t, results.size(), pp.size());
+	UASSERT(results[MapDatabase::getBlockAsInteger({1, 2, 3})] == test_data);
+	UASSERT(results[MapDatabase::getBlockAsInteger({1, 2, 4})].empty());
+	if (std::find(unavailable.begin(), unavailable.end(), pos) == unavailable.end())
+		UASSERT(results[MapDatabase::getBlockAsInteger(pos)] == test_data);
+
+	UASSERT(db->deleteBlock(pos));
+}
+
 void TestMapDatabase::testList(int expect)
 {
 	auto *db = provider->get();
@@ -224,3 +441,148 @@ void TestMapDatabase::testPositionEncoding()
 	UASSERT(db->getIntegerAsBlock(-0x800800800) == v3s16(-2048, -2048, -2048))
 	UASSERT(db->getIntegerAsBlock(-0x314e3807b) == v3s16(-123, 456, -789))
 }
+
+void TestMapDatabase::testAsyncOrdering()
+{
+	std::vector<BlockMap> commits;
+	// state after each save as seen by the caller
+	std::vector<BlockMap> states;
+	BlockMap state;
+
+	auto db = std::make_unique<MapDatabaseAsync>(
+		new TransactionRecorder(&commits), 4096);
+	PcgRandom r(4321);
+	for (int i = 0; i < 200; i++) {
+		const bool in_save = i % 10 != 9;
+		if (in_save)
+			db->beginSave();
+		const int count = in_save ? r.range(1, 10) : 1;
+		for (int j = 0; j < count; j++) {
+			v3s16 pos(r.range(0, 15), 0, 0);
+			s64 key = MapDatabase::getBlockAsInteger(pos);
+			if (r.range(0, 4) == 0) {
+				UASSERT(db->deleteBlock(pos));
+				state.erase(key);
+			} else {
+				std::string data = std::to_string(i) + ":" + std::to_string(j) +
+					std::string(r.range(0, 200), 'x');
+				UASSERT(db->saveBlock(pos, data));
+				state[key] = data;
+			}
+		}
+		if (in_save)
+			db->endSave();
+		states.push_back(state);
+
+		// reads must always see the latest write
+		v3s16 pos(r.range(0, 15), 0, 0);
+		auto it = state.find(MapDatabase::getBlockAsInteger(pos));
+		std::string dest = "not empty";
+		db->loadBlock(pos, &dest);
+		UASSERT(dest == (it == state.end() ? "" : it->second));
+	}
+	db.reset();
+
+	// Every commit must match the state after some save, in order
+	UASSERT(!commits.empty());
+	size_t k = 0;
+	for (const auto &commit : commits) {
+		while (k < states.size() && states[k] != commit)
+			k++;
+		UASSERT(k < states.size());
+	}
+	UASSERT(commits.back() == states.back());
+}
+
+void TestMapDatabase::testAsyncFailure()
+{
+	std::vector<BlockMap> commits;
+	auto *recorder = new TransactionRecorder(&commits);
+	auto db = std::make_unique<MapDatabaseAsync>(recorder, 4096);
+	BlockMap state;
+
+	// A failed write, either way, discards the whole transaction, which is
+	// then committed again by the next attempt (after a second).
+	for (bool do_throw : {false, true}) {
+		db->flush();
+		recorder->failWrite(2, do_throw);
+		const size_t ncommits = commits.size();
+		db->beginSave();
+		for (s16 i = 0; i < 3; i++) {
+			v3s16 pos(i, do_throw, 0);
+			std::string data = "block " + std::to_string(i);
+			UASSERT(db->saveBlock(pos, data));
+			state[MapDatabase::getBlockAsInteger(pos)] = data;
+		}
+		db->endSave();
+		db->flush();
+
+		UASSERT(commits.size() == ncommits + 1);
+		UASSERT(commits.back() == state);
+	}
+}
+
+#ifndef _WIN32
+void TestMapDatabase::testMmapCompaction(const std::string &dir)
+{
+	fs::RecursiveDelete(dir);
+	BlockMap state;
+	PcgRandom r(1234);
+
+	// tiny segments, so that there is a lot to compact
+	const size_t segment_size = 4096;
+	for (int round = 0; round < 3; round++) {
+		auto db = std::make_unique<MapDatabaseMmap>(dir, segment_size);
+		for (int i = 0; i < 2000; i++) {
+			v3s16 pos(r.range(0, 99), round, 0);
+			s64 key = MapDatabase::getBlockAsInteger(pos);
+			if (r.range(0, 4) == 0) {
+				UASSERT(db->deleteBlock(pos));
+				state.erase(key);
+			} else {
+				std::string data = std::to_string(i) + std::string(r.range(0, 100), 'x');
+				UASSERT(db->saveBlock(pos, data));
+				state[key] = data;
+			}
+			if (i % 100 == 0)
+				db->endSave();
+		}
+		while (db->compact())
+			;
+
+		std::vector<v3s16> list;
+		db->listAllLoadableBlocks(list);
+		UASSERTEQ(size_t, list.size(), state.size());
+		for (v3s16 pos : list) {
+			std::string dest;
+			db->loadBlock(pos, &dest);
+			UASSERT(dest == state[MapDatabase::getBlockAsInteger(pos)]);
+		}
+		// garbage should be mostly gone
+		UASSERT(fs::GetDirListing(dir + DIR_DELIM + "map.segments").size() < 20);
+	}
+
+	// a partial write at the end is dropped, everything else survives
+	std::vector<fs::DirListNode> files = fs::GetDirListing(dir + DIR_DELIM + "map.segments");
+	std::string last;
+	for (const auto &node : files)
+		last = std::max(last, node.name);
+	{
+		std::ofstream os(dir + DIR_DELIM + "map.segments" + DIR_DELIM + last,
+			std::ios::binary | std::ios::app);
+		os << std::string("\0\0\0\x10garbage", 11);
+	}
+	auto db = std::make_unique<MapDatabaseMmap>(dir, segment_size);
+	for (const auto &it : state) {
+		std::string dest;
+		db->loadBlock(MapDatabase::getIntegerAsBlock(it.first), &dest);
+		UASSERT(dest == it.second);
+	}
+	UASSERT(db->saveBlock({0, 0, 0}, "new"));
+	db.reset();
+	db = std::make_unique<MapDatabaseMmap>(dir, segment_size);
+	std::string dest;
+	db->loadBlock({0, 0, 0}, &dest);
+	UASSERT(dest == "new");
+}
+#endif
@@ -4,10 +4,17 @@
 
 #include "test.h"
 
+#include <algorithm>
 #include "emerge.h"
+#include "dummymap.h"
+#include "map.h"
+#include "mapgen/cavegen.h"
 #include "mapgen/mapgen.h"
+#include "mapgen/mapgen_v7.h"
 #include "mapgen/mg_biome.h"
 #include "mock_server.h"
+#include "noise.h"
+#include "threading/workerpool.h"
 
 class TestMapgen : public TestBase
 {
@@ -18,6 +25,10 @@ class TestMapgen : public TestBase
 	void runTests(IGameDef *gamedef);
 
 	void testBiomeGen(IGameDef *gamedef);
+	void testBiomeGenNoiseCache(IGameDef *gamedef);
+	void testForEachSliceZ();
+	void testCavesParallel(IGameDef *gamedef);
+	void testPlacementFilter();
 };
 
 static TestMapgen g_test_instance;
@@ -37,6 +48,10 @@ namespace {
 void TestMapgen::runTests(IGameDef *gamedef)
 {
 	TEST(testBiomeGen, gamedef);
+	TEST(testBiomeGenNoiseCache, gamedef);
+	TEST(testForEachSliceZ);
+	TEST(testCavesParallel, gamedef);
+	TEST(testPlacementFilter);
 }
 
 void TestMapgen::testBiomeGen(IGameDef *gamedef)
@@ -123,3 +138,151 @@ void TestMapgen::testBiomeGen(IGameDef *gamedef)
 	}
 }
 
+
+void TestMapgen::testBiomeGenNoiseCache(IGameDef *gamedef)
+{
+	MockServer server(getTestTempDirectory());
+	MockBiomeManager bmgr(&server);
+	bmgr.setNodeDefManager(gamedef->getNodeDefManager());
+
+	std::unique_ptr<BiomeParams> params(BiomeManager::createBiomeParams(BIOMEGEN_ORIGINAL));
+
+	constexpr v3s16 CSIZE(16, 16, 16);
+	constexpr size_t COUNT = CSIZE.X * CSIZE.Z;
+	std::unique_ptr<BiomeGen> uncached(
+		bmgr.createBiomeGen(BIOMEGEN_ORIGINAL, params.get(), CSIZE));
+	std::unique_ptr<BiomeGen> cached(
+		bmgr.createBiomeGen(BIOMEGEN_ORIGINAL, params.get(), CSIZE));
+	NoiseCache2D cache(1024 * 1024);
+	cached->noise_cache = &cache;
+
+	auto *expected = dynamic_cast<BiomeGenOriginal *>(uncached.get());
+	auto *actual = dynamic_cast<BiomeGenOriginal *>(cached.get());
+	UASSERT(expected && actual);
+
+	// Chunks on top of each other, the blend is added to the results in place
+	const v3s16 columns[] = {v3s16(-32, 0, 48), v3s16(1000, 0, -2000)};
+	for (v3s16 column : columns) {
+		for (s16 y = -48; y <= 48; y += CSIZE.Y) {
+			const v3s16 pmin(column.X, y, column.Z);
+			uncached->calcBiomeNoise(pmin);
+			cached->calcBiomeNoise(pmin);
+			UASSERT(std::equal(actual->heatmap, actual->heatmap + COUNT,
+				expected->heatmap));
+			UASSERT(std::equal(actual->humidmap, actual->humidmap + COUNT,
+				expected->humidmap));
+		}
+	}
+
+	// heat, humidity and their blend once per column
+	UASSERTEQ(u64, cache.getMisses(), 4 * ARRLEN(columns));
+	UASSERTEQ(u64, cache.getHits(), 4 * 6 * ARRLEN(columns));
+}
+
+void TestMapgen::testForEachSliceZ()
+{
+	WorkerPool pool("MapgenTest", 3);
+	for (WorkerPool *p : {(WorkerPool *)nullptr, &pool}) {
+		for (s16 rows : {1, 5, 80}) {
+			std::vector<int> visited(rows, 0);
+			Mapgen::forEachSliceZ(p, -40, -40 + rows - 1, [&] (s16 z_min, s16 z_max) {
+				UASSERT(z_min <= z_max);
+				for (s16 z = z_min; z <= z_max; z++)
+					visited[z + 40]++;
+			});
+			// every row exactly once
+			UASSERT(std::all_of(visited.begin(), visited.end(),
+				[] (int n) { return n == 1; }));
+		}
+	}
+}
+
+void TestMapgen::testCavesParallel(IGameDef *gamedef)
+{
+	const NodeDefManager *ndef = gamedef->getNodeDefManager();
+	MockServer server(getTestTempDirectory());
+	MockBiomeManager bmgr(&server);
+	bmgr.setNodeDefManager(ndef);
+
+	Biome *b = BiomeManager::create(BIOMETYPE_NORMAL);
+	b->name = "stone";
+	b->c_top = t_CONTENT_GRASS;
+	b->depth_top = 1;
+	b->c_filler = t_CONTENT_BRICK;
+	b->depth_filler = 3;
+	b->c_stone = t_CONTENT_STONE;
+	UASSERT(bmgr.add(b) != OBJDEF_INVALID_HANDLE);
+
+	std::unique_ptr<BiomeParams> params(BiomeManager::createBiomeParams(BIOMEGEN_ORIGINAL));
+	constexpr v3s16 CSIZE(32, 32, 32);
+	std::unique_ptr<BiomeGen> biomegen(
+		bmgr.createBiomeGen(BIOMEGEN_ORIGINAL, params.get(), CSIZE));
+
+	const v3s16 nmin(-64, -48, 32);
+	const v3s16 nmax = nmin + CSIZE - v3s16(1, 1, 1);
+	biomegen->calcBiomeNoise(nmin);
+	std::vector<biome_t> biomemap(CSIZE.X * CSIZE.Z, b->index);
+
+	const v3s16 bpmin = getNodeBlockPos(nmin - v3s16(0, 1, 0));
+	const v3s16 bpmax = getNodeBlockPos(nmax + v3s16(0, 1, 0));
+	DummyMap map(gamedef, bpmin, bpmax);
+
+	MapgenV7Params mgparams;
+	size_t initial_air = 0;
+	auto generate = [&] (WorkerPool *pool) {
+		MMVManip vm(&map);
+		vm.initialEmerge(bpmin, bpmax, false);
+		const VoxelArea &area = vm.m_area;
+		// Stone with air above, so that there are tunnel entrances too
+		for (s16 z = area.MinEdge.Z; z <= area.MaxEdge.Z; z++)
+		for (s16 y = area.MinEdge.Y; y <= area.MaxEdge.Y; y++)
+		for (s16 x = area.MinEdge.X; x <= area.MaxEdge.X; x++) {
+			vm.m_data[area.index(x, y, z)] =
+				MapNode(y > nmin.Y + 20 ? CONTENT_AIR : t_CONTENT_STONE);
+		}
+		initial_air = std::count(vm.m_data, vm.m_data + area.getVolume(),
+			MapNode(CONTENT_AIR));
+
+		CavesNoiseIntersection caves(ndef, &bmgr, biomegen.get(), CSIZE,
+			&mgparams.np_cave1, &mgparams.np_cave2, 12345, mgparams.cave_width);
+		caves.generateCaves(&vm, nmin, nmax, biomemap.data(), pool);
+		return std::vector<MapNode>(vm.m_data, vm.m_data + area.getVolume());
+	};
+
+	const std::vector<MapNode> expected = generate(nullptr);
+	// some tunnels were dug
+	UASSERT((size_t)std::count(expected.begin(), expected.end(),
+		MapNode(CONTENT_AIR)) > initial_air);
+
+	WorkerPool pool("MapgenTest", 3);
+	for (int i = 0; i < 3; i++)
+		UASSERT(generate(&pool) == expected);
+}
+
+void TestMapgen::testPlacementFilter()
+{
+	const s16 heightmap[6] = {3, -7, 12, 0, 5, 5};
+	const biome_t biomemap[6] = {1, 4, 4, 1, 4, 1};
+	PlacementFilter filter;
+
+	// nothing to filter by
+	filter.update(nullptr, nullptr, 6);
+	UASSERTEQ(s16, filter.height_min, S16_MIN);
+	UASSERTEQ(s16, filter.height_max, S16_MAX);
+	UASSERT(filter.biomeOverlap({2}) == PlacementFilter::BIOMES_ALL);
+
+	filter.update(heightmap, biomemap, 6);
+	UASSERTEQ(s16, filter.height_min, -7);
+	UASSERTEQ(s16, filter.height_max, 12);
+	UASSERT(filter.biomeOverlap({}) == PlacementFilter::BIOMES_ALL);
+	UASSERT(filter.biomeOverlap({2, 3, 100}) == PlacementFilter::BIOMES_NONE);
+	UASSERT(filter.biomeOverlap({4, 100}) == PlacementFilter::BIOMES_SOME);
+	UASSERT(filter.biomeOverlap({1, 2, 4}) == PlacementFilter::BIOMES_ALL);
+
+	// nothing is left over from the last map
+	filter.update(heightmap, biomemap, 1);
+	UASSERTEQ(s16, filter.height_min, 3);
+	UASSERTEQ(s16, filter.height_max, 3);
+	UASSERT(filter.biomeOverlap({1}) == PlacementFilter::BIOMES_ALL);
+	UASSERT(filter.biomeOverlap({4}) == PlacementFilter::BIOMES_NONE);
+}
@@ -4,6 +4,7 @@
 
 #include "test.h"
 
+#include <algorithm>
 #include <cmath>
 #include "exceptions.h"
 #include "noise.h"
@@ -26,6 +27,9 @@ class TestNoise : public TestBase {
 	void testNoise3dPoint();
 	void testNoise3dBulk();
 	void testNoiseInvalidParams();
+	void testNoiseSimd();
+	void testNoiseCache();
+	void testNoiseFractal2dGrid();
 
 	static const float expected_2d_results[10 * 10];
 	static const float expected_3d_results[10 * 10 * 10];
@@ -46,6 +50,9 @@ void TestNoise::runTests(IGameDef *gamedef)
 	TEST(testNoise3dPoint);
 	TEST(testNoise3dBulk);
 	TEST(testNoiseInvalidParams);
+	TEST(testNoiseSimd);
+	TEST(testNoiseCache);
+	TEST(testNoiseFractal2dGrid);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -160,6 +167,126 @@ void TestNoise::testNoiseInvalidParams()
 	UASSERT(exception_thrown);
 }
 
+void TestNoise::testNoiseSimd()
+{
+	const NoiseParams nps[] = {
+		NoiseParams(20, 40, v3f(50, 50, 50), 9, 5, 0.6, 2.0),
+		NoiseParams(0, 1, v3f(33, 17, 11), 1, 3, 0.5, 2.0,
+			NOISE_FLAG_EASED | NOISE_FLAG_ABSVALUE),
+	};
+	// odd sizes to cover the remainders of the vector loops
+	const u32 sx = 21, sy = 13, sz = 11;
+	std::vector<float> persistence(sx * sy * sz, 0.5f);
+
+	// calculates some noise with each of the instruction sets
+	auto calculate = [&] (NoiseSimd simd) {
+		std::vector<float> out;
+		if (!setNoiseSimd(simd))
+			return out;
+		for (const NoiseParams &np : nps) {
+			for (float *pmap : {(float *)nullptr, persistence.data()}) {
+				Noise noise_3d(&np, 1337, sx, sy, sz);
+				float *r = noise_3d.noiseMap3D(-1234.5f, 48, 31000.25f, pmap);
+				out.insert(out.end(), r, r + sx * sy * sz);
+				Noise noise_2d(&np, 1337, sx, sy);
+				r = noise_2d.noiseMap2D(-1234.5f, 31000.25f, pmap);
+				out.insert(out.end(), r, r + sx * sy);
+			}
+		}
+		return out;
+	};
+
+	const NoiseSimd orig_simd = getNoiseSimd();
+	const std::vector<float> expected = calculate(NoiseSimd::None);
+	UASSERT(!expected.empty());
+	for (NoiseSimd simd : {NoiseSimd::SSE2, NoiseSimd::AVX2}) {
+		const std::vector<float> actual = calculate(simd);
+		// exactly the same
+		UASSERT(actual.empty() || actual == expected);
+	}
+	setNoiseSimd(orig_simd);
+}
+
+void TestNoise::testNoiseCache()
+{
+	const NoiseParams np(20, 40, v3f(50, 50, 50), 9, 5, 0.6, 2.0);
+	const u32 sx = 16, sy = 16;
+	const size_t count = sx * sy;
+	// room for two results
+	NoiseCache2D cache(2 * count * sizeof(float));
+
+	Noise uncached(&np, 1337, sx, sy);
+	Noise noise(&np, 1337, sx, sy);
+	auto check = [&] (float x, float y) {
+		float *expected = uncached.noiseMap2D(x, y);
+		float *actual = cache.noiseMap2D(&noise, x, y);
+		UASSERT(actual == noise.result);
+		UASSERT(std::equal(actual, actual + count, expected));
+	};
+
+	check(0, 0);
+	check(16, 0);
+	UASSERTEQ(u64, cache.getMisses(), 2);
+	UASSERTEQ(u64, cache.getHits(), 0);
+	UASSERTEQ(size_t, cache.getSize(), 2 * count * sizeof(float));
+
+	check(0, 0);
+	check(16, 0);
+	UASSERTEQ(u64, cache.getMisses(), 2);
+	UASSERTEQ(u64, cache.getHits(), 2);
+
+	// other seed, parameters and size are different entries
+	noise.seed = uncached.seed = 1338;
+	check(0, 0);
+	noise.seed = uncached.seed = 1337;
+	noise.np.octaves = uncached.np.octaves = 4;
+	check(0, 0);
+	noise.np.octaves = uncached.np.octaves = 5;
+	UASSERTEQ(u64, cache.getMisses(), 4);
+	UASSERTEQ(u64, cache.getHits(), 2);
+
+	// the least recently used results were dropped
+	check(16, 0);
+	check(0, 0);
+	UASSERTEQ(u64, cache.getMisses(), 6);
+	UASSERTEQ(size_t, cache.getSize(), 2 * count * sizeof(float));
+
+	cache.clear();
+	UASSERTEQ(size_t, cache.getSize(), 0);
+	check(0, 0);
+	UASSERTEQ(u64, cache.getMisses(), 7);
+}
+
+void TestNoise::testNoiseFractal2dGrid()
+{
+	const NoiseParams nps[] = {
+		NoiseParams(20, 40, v3f(50, 50, 50), 9, 5, 0.6, 2.0),
+		NoiseParams(0, 1, v3f(33, 17, 11), 1, 3, 0.5, 2.0,
+			NOISE_FLAG_EASED | NOISE_FLAG_ABSVALUE),
+		// fine octaves, hashed point by point
+		NoiseParams(-0.5, 2, v3f(20, 30, 20), 7, 3, 0.4, 3.0, 0),
+	};
+	const NoiseSimd orig_simd = getNoiseSimd();
+	for (NoiseSimd simd : {NoiseSimd::None, NoiseSimd::SSE2, NoiseSimd::AVX2}) {
+		if (!setNoiseSimd(simd))
+			continue;
+		for (const NoiseParams &np : nps)
+		for (float step : {1.0f, 16.0f}) {
+			const u32 sx = 7, sy = 5;
+			const float x = -1234 + step / 2, y = 31000;
+			float r[sx * sy];
+			NoiseFractal2DGrid(&np, x, y, step, step, sx, sy, 1337, r);
+			for (u32 j = 0; j != sy; j++)
+			for (u32 i = 0; i != sx; i++) {
+				// exactly the same
+				UASSERT(r[j * sx + i] ==
+					NoiseFractal2D(&np, x + i * step, y + j * step, 1337));
+			}
+		}
+	}
+	setNoiseSimd(orig_simd);
+}
+
 const float TestNoise::expected_2d_results[10 * 10] = {
 	19.11726, 18.49626, 16.48476, 15.02135, 14.75713, 16.26008, 17.54822,
 	18.06860, 18.57016, 18.48407, 18.49649, 17.89160, 15.94162, 14.54901,
@@ -146,6 +146,32 @@ class TestServerActiveObjectMgr {
 		getObjectsInAreaNaive(box, expected);
 		compareObjects(actual, expected);
 	}
+
+	void compareObjectsInsideRadii(const std::vector<v3f> &centers, float radius)
+	{
+		server::ActiveObjectMgr::BatchQueryResult result;
+		saomgr.getObjectsInsideRadii(centers, radius, result);
+		REQUIRE(result.size() == centers.size());
+		for (size_t q = 0; q < centers.size(); q++) {
+			std::vector<ServerActiveObject *> actual(
+					result.objects.begin() + result.offsets[q],
+					result.objects.begin() + result.offsets[q + 1]);
+			std::vector<ServerActiveObject *> expected;
+			getObjectsInsideRadiusNaive(centers[q], radius, expected);
+			compareObjects(actual, expected);
+		}
+	}
+
+	void compareAddedActiveObjects(u16 observer_id, const v3f &pos, float radius)
+	{
+		std::vector<u16> actual, expected;
+		const std::set<u16> current_objects;
+		saomgr.getAddedActiveObjectsForObserver(observer_id, pos, "singleplayer",
+				radius, 0, current_objects, actual);
+		saomgr.getAddedActiveObjectsAroundPos(pos, "singleplayer",
+				radius, 0, current_objects, expected);
+		CHECK(actual == expected);
+	}
 };
 
 
@@ -306,6 +332,11 @@ SECTION("spatial index") {
 		aabb3f box(random_pos(), random_pos());
 		box.repair();
 		saomgr.compareObjectsInArea(box);
+
+		std::vector<v3f> centers;
+		for (int i = 0; i < 5; i++)
+			centers.push_back(random_pos());
+		saomgr.compareObjectsInsideRadii(centers, radius(gen));
 	};
 
 	// Grow: Insertion twice as likely as deletion
@@ -327,4 +358,51 @@ SECTION("spatial index") {
 	}
 }
 
+SECTION("interest grid") {
+	TestServerActiveObjectMgr saomgr;
+	std::mt19937 gen(0x123456);
+	std::uniform_int_distribution<s32> coordinate(-1000, 1000);
+	const auto random_pos = [&]() {
+		return v3f(coordinate(gen), coordinate(gen), coordinate(gen));
+	};
+
+	// Observers move around a bit and sometimes change their range
+	constexpr u16 observer_ids[] = {60000, 60001, 60002};
+	std::uniform_real_distribution<f32> radius(0, 700);
+	v3f observer_pos[3];
+	f32 observer_radius[3];
+	for (int i = 0; i < 3; i++) {
+		observer_pos[i] = random_pos();
+		observer_radius[i] = radius(gen);
+	}
+
+	std::uniform_int_distribution<u32> percent(0, 99);
+	const auto step = [&]() {
+		const auto p = percent(gen);
+		if (p < 30) {
+			saomgr.registerObject(std::make_unique<MockServerActiveObject>(nullptr, random_pos()));
+		} else if (p < 50) {
+			if (!saomgr.empty())
+				saomgr.removeObject(saomgr.randomId(gen));
+		} else if (p < 90) {
+			if (!saomgr.empty())
+				saomgr.updateObjectPos(saomgr.randomId(gen), random_pos());
+		} else {
+			const int i = p % 3;
+			std::uniform_real_distribution<f32> offset(-200, 200);
+			observer_pos[i] += v3f(offset(gen), offset(gen), offset(gen));
+			if (p % 2)
+				observer_radius[i] = radius(gen);
+		}
+		for (int i = 0; i < 3; i++)
+			saomgr.compareAddedActiveObjects(observer_ids[i], observer_pos[i],
+					observer_radius[i]);
+	};
+
+	for (u32 i = 0; i < 3000; ++i)
+		step();
+
+	saomgr.clear();
+}
+
 }
@@ -6,8 +6,12 @@
 
 #include <atomic>
 #include <iostream>
+#include <stdexcept>
+#include <vector>
 #include "threading/semaphore.h"
+#include "threading/taskscheduler.h"
 #include "threading/thread.h"
+#include "threading/workerpool.h"
 
 
 class TestThreading : public TestBase {
@@ -19,6 +23,8 @@ class TestThreading : public TestBase {
 	void testStartStopWait();
 	void testAtomicSemaphoreThread();
 	void testTLS();
+	void testWorkerPool();
+	void testTaskScheduler();
 };
 
 static TestThreading g_test_instance;
@@ -28,6 +34,8 @@ void TestThreading::runTests(IGameDef *gamedef)
 	TEST(testStartStopWait);
 	TEST(testAtomicSemaphoreThread);
 	TEST(testTLS);
+	TEST(testWorkerPool);
+	TEST(testTaskScheduler);
 }
 
 class SimpleTestThread : public Thread {
@@ -227,3 +235,96 @@ void TestThreading::testTLS()
 		}
 	}
 }
+
+
+void TestThreading::testWorkerPool()
+{
+	for (unsigned int num_threads : {0, 1, 4}) {
+		WorkerPool pool("WorkerPoolTest", num_threads);
+		UASSERTEQ(unsigned int, pool.getConcurrency(), num_threads + 1);
+
+		// every index must be processed exactly once, also when reused
+		for (size_t count : {0, 1, 7, 1000}) {
+			std::vector<std::atomic<u32>> hits(count);
+			for (auto &it : hits)
+				it = 0;
+			pool.parallelFor(count, [&] (size_t i) {
+				++hits[i];
+			});
+			for (auto &it : hits)
+				UASSERT(it == 1);
+		}
+
+		// exceptions are passed to the caller
+		std::atomic<u32> processed(0);
+		EXCEPTION_CHECK(std::runtime_error, pool.parallelFor(100, [&] (size_t i) {
+			++processed;
+			if (i == 42)
+				throw std::runtime_error("test");
+		}));
+		UASSERT(processed == 100);
+	}
+}
+
+
+void TestThreading::testTaskScheduler()
+{
+	const auto wait_for = [] (const std::function<bool()> &cond) {
+		for (int i = 0; i < 5000 && !cond(); i++)
+			sleep_ms(1);
+		UASSERT(cond());
+	};
+
+	// The concurrency limit of a subsystem is kept
+	{
+		TaskScheduler scheduler("SchedulerTest", 4);
+		auto subsystem = scheduler.addSubsystem("limited", 2);
+		std::atomic<u32> running(0), max_running(0), done(0);
+		for (int i = 0; i < 40; i++) {
+			scheduler.submit(subsystem, [&] {
+				u32 now = ++running;
+				u32 prev = max_running;
+				while (now > prev && !max_running.compare_exchange_weak(prev, now))
+					;
+				sleep_ms(1);
+				--running;
+				++done;
+			});
+		}
+		wait_for([&] { return done == 40; });
+		UASSERT(max_running <= 2);
+	}
+
+	// Higher priorities go first
+	{
+		TaskScheduler scheduler("SchedulerTest", 1);
+		auto subsystem = scheduler.addSubsystem("test", 10);
+		std::atomic<bool> release(false);
+		std::atomic<u32> done(0);
+		std::vector<int> order;
+		scheduler.submit(subsystem, [&] {
+			while (!release)
+				sleep_ms(1);
+		});
+		scheduler.submit(subsystem, [&] { order.push_back(2); ++done; },
+			TaskScheduler::PRIORITY_LOW);
+		scheduler.submit(subsystem, [&] { order.push_back(0); ++done; },
+			TaskScheduler::PRIORITY_HIGH);
+		scheduler.submit(subsystem, [&] { order.push_back(1); ++done; });
+		release = true;
+		wait_for([&] { return done == 3; });
+		UASSERT(order == std::vector<int>({0, 1, 2}));
+	}
+
+	// Tasks can submit tasks, idle workers steal them
+	{
+		TaskScheduler scheduler("SchedulerTest", 4);
+		auto subsystem = scheduler.addSubsystem("test", 4);
+		std::atomic<u32> done(0);
+		scheduler.submit(subsystem, [&] {
+			for (int i = 0; i < 100; i++)
+				scheduler.submit(subsystem, [&] { ++done; });
+		});
+		wait_for([&] { return done == 100; });
+	}
+}
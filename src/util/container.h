@@ -9,9 +9,13 @@
 #include "exceptions.h"
 #include "threading/mutex_auto_lock.h"
 #include "threading/semaphore.h"
+#include <atomic>
+#include <chrono>
 #include <list>
 #include <vector>
 #include <map>
+#include <memory>
+#include <optional>
 #include <set>
 #include <queue>
 #include <cassert>
@@ -132,6 +136,12 @@ class MutexedQueue
 		return m_queue.empty();
 	}
 
+	size_t size() const
+	{
+		MutexAutoLock lock(m_mutex);
+		return m_queue.size();
+	}
+
 	void push_back(const T &t)
 	{
 		MutexAutoLock lock(m_mutex);
@@ -236,6 +246,287 @@ class MutexedQueue
 	Semaphore m_signal;
 };
 
+/*
+	Lets the single consumer of a lock-free queue sleep until there are items.
+	Producers only post the semaphore if the consumer is actually asleep, so
+	they don't contend on it while the consumer is busy.
+*/
+
+class ConsumerSignal
+{
+public:
+	// Called by a producer after an item has become visible
+	void notify()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_sleeping.load(std::memory_order_relaxed) &&
+				m_sleeping.exchange(false, std::memory_order_relaxed))
+			m_signal.post();
+	}
+
+	// Waits until `ready()` is true, at most wait_time_max_ms (0 = don't wait)
+	template<typename F>
+	bool waitFor(const F &ready, u32 wait_time_max_ms)
+	{
+		if (ready())
+			return true;
+		if (wait_time_max_ms == 0)
+			return false;
+
+		const auto deadline = std::chrono::steady_clock::now() +
+			std::chrono::milliseconds(wait_time_max_ms);
+		while (!prepareSleep(ready)) {
+			const auto left = std::chrono::ceil<std::chrono::milliseconds>(
+				deadline - std::chrono::steady_clock::now()).count();
+			if (left > 0)
+				m_signal.wait(left);
+			m_sleeping.store(false, std::memory_order_relaxed);
+			// wakeups can be left over from an earlier wait
+			if (ready())
+				return true;
+			if (left <= 0)
+				return false;
+		}
+		return true;
+	}
+
+	// Waits until `ready()` is true
+	template<typename F>
+	void waitFor(const F &ready)
+	{
+		while (!ready() && !prepareSleep(ready)) {
+			m_signal.wait();
+			m_sleeping.store(false, std::memory_order_relaxed);
+		}
+	}
+
+private:
+	// Announces that the consumer is going to sleep, returns true if it
+	// should not because there are items after all
+	template<typename F>
+	bool prepareSleep(const F &ready)
+	{
+		m_sleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!ready())
+			return false;
+		m_sleeping.store(false, std::memory_order_relaxed);
+		return true;
+	}
+
+	std::atomic<bool> m_sleeping{false};
+	Semaphore m_signal;
+};
+
+/*
+	Lock-free multi-producer single-consumer queue
+
+	Pushing never blocks and costs an allocation and an atomic exchange, so it
+	is suited for many threads handing results to one.
+	The pop functions and empty() must only be called from a single thread at
+	a time.
+*/
+
+template<typename T>
+class MPSCQueue
+{
+public:
+	MPSCQueue()
+	{
+		m_head = m_tail = new Node();
+	}
+
+	~MPSCQueue()
+	{
+		while (m_tail) {
+			Node *next = m_tail->next.load(std::memory_order_relaxed);
+			delete m_tail;
+			m_tail = next;
+		}
+	}
+
+	DISABLE_CLASS_COPY(MPSCQueue)
+
+	bool empty() const
+	{
+		return !m_tail->next.load(std::memory_order_acquire);
+	}
+
+	void push_back(const T &t)
+	{
+		push(new Node(t));
+	}
+
+	void push_back(T &&t)
+	{
+		push(new Node(std::move(t)));
+	}
+
+	bool try_pop_front(T &t)
+	{
+		if (empty())
+			return false;
+		t = pop();
+		return true;
+	}
+
+	/* this version of pop_front returns an empty element of T on timeout.
+	* Make sure default constructor of T creates a recognizable "empty" element
+	*/
+	T pop_frontNoEx(u32 wait_time_max_ms)
+	{
+		if (m_signal.waitFor(ready(), wait_time_max_ms))
+			return pop();
+
+		return T();
+	}
+
+	T pop_front(u32 wait_time_max_ms)
+	{
+		if (m_signal.waitFor(ready(), wait_time_max_ms))
+			return pop();
+
+		throw ItemNotFoundException("MPSCQueue: queue is empty");
+	}
+
+	T pop_frontNoEx()
+	{
+		m_signal.waitFor(ready());
+		return pop();
+	}
+
+private:
+	struct Node {
+		Node() = default;
+		template<typename U>
+		Node(U &&t) : value(std::forward<U>(t)) {}
+
+		std::atomic<Node *> next{nullptr};
+		std::optional<T> value;
+	};
+
+	void push(Node *node)
+	{
+		Node *prev = m_head.exchange(node, std::memory_order_acq_rel);
+		// Until this the consumer does not see the node or any after it
+		prev->next.store(node, std::memory_order_release);
+		m_signal.notify();
+	}
+
+	auto ready() const
+	{
+		return [this] { return !empty(); };
+	}
+
+	// Requires that the queue is not empty
+	T pop()
+	{
+		Node *next = m_tail->next.load(std::memory_order_acquire);
+		T t = std::move(*next->value);
+		next->value.reset();
+		delete m_tail;
+		m_tail = next;
+		return t;
+	}
+
+	// Most recently pushed node
+	std::atomic<Node *> m_head;
+	// Node before the oldest item, only used by the consumer
+	Node *m_tail;
+	ConsumerSignal m_signal;
+};
+
+/*
+	Lock-free bounded single-producer single-consumer ring buffer
+
+	The capacity is rounded up to a power of two. Pushing fails instead of
+	blocking when the ring is full.
+*/
+
+template<typename T>
+class SPSCRing
+{
+public:
+	SPSCRing(size_t capacity)
+	{
+		size_t n = 1;
+		while (n < capacity)
+			n *= 2;
+		m_items = std::make_unique<T[]>(n);
+		m_mask = n - 1;
+	}
+
+	DISABLE_CLASS_COPY(SPSCRing)
+
+	size_t capacity() const { return m_mask + 1; }
+
+	// Only approximate while the other thread is active
+	size_t size() const
+	{
+		return m_tail.load(std::memory_order_acquire) -
+			m_head.load(std::memory_order_acquire);
+	}
+
+	bool empty() const { return size() == 0; }
+
+	// Producer only. Returns false if the ring is full.
+	bool try_push_back(T &&t)
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) > m_mask)
+			return false;
+		m_items[tail & m_mask] = std::move(t);
+		m_tail.store(tail + 1, std::memory_order_release);
+		m_signal.notify();
+		return true;
+	}
+
+	bool try_push_back(const T &t)
+	{
+		T copy(t);
+		return try_push_back(std::move(copy));
+	}
+
+	// Consumer only
+	bool try_pop_front(T &t)
+	{
+		if (empty())
+			return false;
+		t = pop();
+		return true;
+	}
+
+	/* Consumer only. Returns an empty element of T on timeout.
+	* Make sure default constructor of T creates a recognizable "empty" element
+	*/
+	T pop_frontNoEx(u32 wait_time_max_ms)
+	{
+		if (m_signal.waitFor([this] { return !empty(); }, wait_time_max_ms))
+			return pop();
+
+		return T();
+	}
+
+private:
+	// Requires that the ring is not empty
+	T pop()
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		T t = std::move(m_items[head & m_mask]);
+		m_items[head & m_mask] = T();
+		m_head.store(head + 1, std::memory_order_release);
+		return t;
+	}
+
+	std::unique_ptr<T[]> m_items;
+	size_t m_mask;
+	// Next item to pop, written by the consumer
+	alignas(64) std::atomic<size_t> m_head{0};
+	// Next free slot, written by the producer
+	alignas(64) std::atomic<size_t> m_tail{0};
+	ConsumerSignal m_signal;
+};
+
 /*
 	LRU cache
 */
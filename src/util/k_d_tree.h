@@ -319,6 +319,15 @@ class KdTree
 		rangeQuery(0, 0, min, max, cb);
 	}
 
+	//! Runs the queries min[q], max[q] for the q in active[0, n) at once,
+	//! calls cb(q, point, id) for every hit. Uses active as a stack.
+	template<typename F>
+	void batchRangeQuery(const Point *min, const Point *max,
+			std::vector<uint32_t> &active, size_t n, const F &cb) const
+	{
+		batchRangeQuery(0, 0, min, max, active, 0, n, cb);
+	}
+
 	void remove(Idx internalIdx)
 	{
 		assert(!deleted[internalIdx]);
@@ -380,6 +389,54 @@ class KdTree
 			cb(point, ids[ptid]);
 		}
 	}
+
+	template<typename F>
+	void batchRangeQuery(size_t root, uint8_t split,
+			const Point *min, const Point *max,
+			std::vector<uint32_t> &active, size_t begin, size_t end,
+			const F &cb) const
+	{
+		if (root >= cap() || begin == end)
+			return;
+		const auto ptid = tree[root];
+		const auto coord = items.points.begin(split)[ptid];
+		const auto nextSplit = (split + 1) % Dim;
+
+		// Partition the queries like rangeQuery() does, pushing the ones
+		// that go left and then the ones that go right
+		const size_t left_begin = active.size();
+		for (size_t i = begin; i < end; ++i) {
+			const auto q = active[i];
+			if (min[q][split] <= coord)
+				active.push_back(q);
+		}
+		const size_t right_begin = active.size();
+		for (size_t i = begin; i < end; ++i) {
+			const auto q = active[i];
+			if (max[q][split] >= coord)
+				active.push_back(q);
+		}
+		const size_t right_end = active.size();
+
+		batchRangeQuery(2*root + 2, nextSplit, min, max, active,
+				right_begin, right_end, cb);
+		batchRangeQuery(2*root + 1, nextSplit, min, max, active,
+				left_begin, right_begin, cb);
+		active.resize(left_begin);
+
+		if (deleted[ptid])
+			return;
+		const auto point = items.points.getPoint(ptid);
+		for (size_t i = begin; i < end; ++i) {
+			const auto q = active[i];
+			bool inside = true;
+			for (uint8_t d = 0; d < Dim; ++d)
+				inside = inside && point[d] >= min[q][d] && point[d] <= max[q][d];
+			if (inside)
+				cb(q, point, ids[ptid]);
+		}
+	}
+
 	SortedPoints<Dim, Component> items;
 	std::unique_ptr<Id[]> ids;
 	std::unique_ptr<Idx[]> tree;
@@ -440,6 +497,21 @@ class DynamicKdTrees
 			tree.rangeQuery(min, max, cb);
 	}
 
+	//! Runs count range queries with a single traversal of every tree.
+	//! cb(q, point, id) is called for every point in query q.
+	template<typename F>
+	void batchRangeQuery(const Point *min, const Point *max, size_t count,
+			const F &cb) const
+	{
+		std::vector<uint32_t> active;
+		for (const auto &tree : trees) {
+			active.clear();
+			for (size_t q = 0; q < count; ++q)
+				active.push_back(q);
+			tree.batchRangeQuery(min, max, active, count, cb);
+		}
+	}
+
 	size_t size() const
 	{
 		return n_entries - deleted;